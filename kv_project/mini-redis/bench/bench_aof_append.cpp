@@ -0,0 +1,111 @@
+/**
+ * 创建者：程序员老廖
+ * 日期：2025年8月12日
+ */
+
+// AOF 追加路径基准：模拟服务端写命令的调用方式——持写锁调用 AofLogger::appendRaw 追加一条 SET 原始命令。
+// 每组先跑一遍只加解锁、不追加的空循环作为基线，报告：
+//   append ：appendRaw 循环的 ns/op，减去基线即为 AOF 给写路径带来的开销
+//   drain  ：再加上 shutdown 等 writer 把剩余数据写完，即吞吐意义上的 ns/op
+// writer 使用 aof.mode=no（只 writev 不刷盘），避免磁盘速度掩盖队列本身的开销。
+//
+// 用法：bench_aof_append [ops] [dir]
+
+#include "mini_redis/aof.hpp"
+#include "mini_redis/config.hpp"
+#include "mini_redis/resp.hpp"
+
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+using mini_redis::AofLogger;
+using mini_redis::AofOptions;
+
+namespace
+{
+
+  using Clock = std::chrono::steady_clock;
+
+  double nsPerOp(Clock::time_point t0, Clock::time_point t1, size_t ops)
+  {
+    return std::chrono::duration<double, std::nano>(t1 - t0).count() / static_cast<double>(ops);
+  }
+
+  // threads 个线程共用一把写锁，各自追加 ops / threads 条命令
+  template <typename Fn>
+  void runThreads(size_t threads, size_t ops, std::mutex &mu, Fn fn)
+  {
+    std::vector<std::thread> ths;
+    for (size_t t = 0; t < threads; ++t)
+      ths.emplace_back([&, t]
+                       {
+                         for (size_t i = t; i < ops; i += threads)
+                         {
+                           std::lock_guard<std::mutex> lk(mu);
+                           fn(i);
+                         } });
+    for (auto &th : ths)
+      th.join();
+  }
+
+  void runCase(size_t threads, size_t value_bytes, size_t ops, const std::string &dir)
+  {
+    std::vector<std::string> cmds;
+    for (size_t i = 0; i < 1024; ++i)
+      cmds.push_back(mini_redis::toRespArray({std::string("SET"), "key:" + std::to_string(i * 7919), std::string(value_bytes, 'v')}));
+    std::mutex mu;
+    volatile size_t sink = 0;
+
+    auto b0 = Clock::now();
+    runThreads(threads, ops, mu, [&](size_t i)
+               { sink = sink + cmds[i & 1023].size(); });
+    double base_ns = nsPerOp(b0, Clock::now(), ops);
+
+    AofOptions opts;
+    opts.enabled = true;
+    opts.mode = mini_redis::AofMode::kNo;
+    opts.dir = dir;
+    opts.filename = "bench_aof_append.aof";
+    opts.prealloc_bytes = 0;
+    opts.segment_bytes = 0;
+    AofLogger aof;
+    std::string err;
+    if (!aof.init(opts, err))
+    {
+      std::fprintf(stderr, "init failed: %s\n", err.c_str());
+      std::exit(1);
+    }
+    auto t0 = Clock::now();
+    runThreads(threads, ops, mu, [&](size_t i)
+               { aof.appendRaw(cmds[i & 1023]); });
+    auto t1 = Clock::now();
+    mini_redis::AofManifest m = aof.manifest();
+    aof.shutdown();
+    auto t2 = Clock::now();
+
+    std::printf("threads=%zu value=%5zuB  base %6.1f ns/op  append %7.1f ns/op (aof +%6.1f)  drain %7.1f ns/op\n", threads,
+                value_bytes, base_ns, nsPerOp(t0, t1, ops), nsPerOp(t0, t1, ops) - base_ns, nsPerOp(t0, t2, ops));
+    for (const auto &name : m.incrs)
+      ::unlink((dir + "/" + name).c_str());
+    ::unlink(aof.path().c_str());
+  }
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+  size_t ops = argc > 1 ? static_cast<size_t>(std::strtoull(argv[1], nullptr, 10)) : 2000000;
+  std::string dir = argc > 2 ? argv[2] : "/tmp";
+  std::printf("ops=%zu\n", ops);
+  for (size_t threads : {1, 4})
+    for (size_t value_bytes : {16, 512})
+      runCase(threads, value_bytes, ops, dir);
+  return 0;
+}
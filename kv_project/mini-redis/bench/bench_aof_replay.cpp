@@ -0,0 +1,231 @@
+/**
+ * 创建者：程序员老廖
+ * 日期：2025年8月12日
+ */
+
+// AOF 回放基准：生成一个 AOF 文件（SET / SET EX / HSET / HDEL / ZADD / ZREM / EXPIRE / DEL 混合），报告三种读法的吞吐：
+//   parse-only：64KB 一块读文件，零拷贝解析出每条命令但不执行，作为“解析器速度”的上限参照
+//   legacy    ：复刻旧实现，整个文件读进内存后手工解析、逐参数拷贝，只执行 SET/DEL/EXPIRE（其余命令被丢弃）
+//   AofLogger ：AofLogger::load，经命令表全量回放，按分片批量执行
+//
+// 用法：bench_aof_replay [commands] [path]
+
+#include "mini_redis/aof.hpp"
+#include "mini_redis/config.hpp"
+#include "mini_redis/kv.hpp"
+#include "mini_redis/resp.hpp"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+using mini_redis::AofLogger;
+using mini_redis::AofOptions;
+using mini_redis::KeyValueStore;
+using mini_redis::ParseStatus;
+using mini_redis::RespCommand;
+using mini_redis::RespParser;
+
+namespace
+{
+
+  using Clock = std::chrono::steady_clock;
+  const size_t kKeys = 200000;
+
+  bool writeAof(const std::string &path, size_t n, size_t &bytes)
+  {
+    FILE *f = std::fopen(path.c_str(), "wb");
+    if (!f)
+      return false;
+    std::string out;
+    bytes = 0;
+    for (size_t i = 0; i < n; ++i)
+    {
+      std::string k = std::to_string((i * 7919) % kKeys);
+      switch (i % 10)
+      {
+      case 0:
+      case 1:
+        out += mini_redis::toRespArray({std::string("HSET"), "h:" + k, "f" + std::to_string(i % 16), std::string(32, 'h')});
+        break;
+      case 2:
+        out += mini_redis::toRespArray({std::string("ZADD"), "z:" + k, std::to_string(i % 1000), "m" + std::to_string(i % 64)});
+        break;
+      case 3:
+        out += mini_redis::toRespArray({std::string("HDEL"), "h:" + k, "f" + std::to_string((i + 5) % 16)});
+        break;
+      case 4:
+        out += mini_redis::toRespArray({std::string("ZREM"), "z:" + k, "m" + std::to_string((i + 7) % 64)});
+        break;
+      case 5:
+        out += mini_redis::toRespArray({std::string("SET"), "key:" + k, std::string(64, 'v'), std::string("EX"), std::string("3600")});
+        break;
+      case 6:
+        out += mini_redis::toRespArray({std::string("EXPIRE"), "h:" + k, std::string("3600")});
+        break;
+      case 7:
+        out += mini_redis::toRespArray({std::string("DEL"), "key:" + k, "key:" + std::to_string((i * 31) % kKeys)});
+        break;
+      default:
+        out += mini_redis::toRespArray({std::string("SET"), "key:" + k, std::string(64, 'v')});
+        break;
+      }
+      if (out.size() >= (1 << 20) || i + 1 == n)
+      {
+        if (std::fwrite(out.data(), 1, out.size(), f) != out.size())
+        {
+          std::fclose(f);
+          return false;
+        }
+        bytes += out.size();
+        out.clear();
+      }
+    }
+    return std::fclose(f) == 0;
+  }
+
+  double seconds(Clock::time_point t0)
+  {
+    return std::chrono::duration<double>(Clock::now() - t0).count();
+  }
+
+  void report(const char *name, size_t n, size_t bytes, double sec, size_t keys)
+  {
+    std::printf("%-11s %10.0f cmds/s  %8.1f MB/s  (%.3f s, keys=%zu)\n", name, static_cast<double>(n) / sec,
+                static_cast<double>(bytes) / 1048576.0 / sec, sec, keys);
+  }
+
+  size_t parseOnly(const std::string &path)
+  {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+      return 0;
+    RespParser parser;
+    RespCommand cmd;
+    std::string buf(64 * 1024, '\0');
+    size_t n = 0;
+    ssize_t r;
+    while ((r = ::read(fd, buf.data(), buf.size())) > 0)
+    {
+      parser.append(std::string_view(buf.data(), static_cast<size_t>(r)));
+      while (parser.tryParseCommand(cmd) == ParseStatus::kOk)
+        ++n;
+    }
+    ::close(fd);
+    return n;
+  }
+
+  // 旧实现的回放逻辑
+  void legacyLoad(const std::string &path, KeyValueStore &store)
+  {
+    int rfd = ::open(path.c_str(), O_RDONLY);
+    if (rfd < 0)
+      return;
+    std::string buf(1 << 20, '\0');
+    std::string data;
+    ssize_t r;
+    while ((r = ::read(rfd, buf.data(), buf.size())) > 0)
+      data.append(buf.data(), static_cast<size_t>(r));
+    ::close(rfd);
+    size_t pos = 0;
+    auto readLine = [&](std::string &out) -> bool
+    {
+      size_t e = data.find("\r\n", pos);
+      if (e == std::string::npos)
+        return false;
+      out.assign(data.data() + pos, e - pos);
+      pos = e + 2;
+      return true;
+    };
+    while (pos < data.size())
+    {
+      if (data[pos++] != '*')
+        break;
+      std::string line;
+      if (!readLine(line))
+        break;
+      int n = std::stoi(line);
+      std::vector<std::string> parts;
+      parts.reserve(static_cast<size_t>(n));
+      for (int i = 0; i < n; ++i)
+      {
+        ++pos; // '$'
+        readLine(line);
+        size_t len = static_cast<size_t>(std::stoi(line));
+        parts.emplace_back(data.data() + pos, len);
+        pos += len + 2;
+      }
+      std::string cmd;
+      for (char c : parts[0])
+        cmd.push_back(static_cast<char>(::toupper(c)));
+      if (cmd == "SET" && parts.size() == 3)
+        store.set(parts[1], parts[2]);
+      else if (cmd == "DEL" && parts.size() >= 2)
+        store.del(std::vector<std::string>(parts.begin() + 1, parts.end()));
+      else if (cmd == "EXPIRE" && parts.size() == 3)
+        store.expire(parts[1], std::stoll(parts[2]));
+    }
+  }
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+  size_t n = argc > 1 ? static_cast<size_t>(std::strtoull(argv[1], nullptr, 10)) : 2000000;
+  std::string dir = argc > 2 ? argv[2] : "/tmp";
+  const std::string file = "bench_aof_replay.aof";
+  const std::string path = dir + "/" + file;
+  size_t bytes = 0;
+  if (!writeAof(path, n, bytes))
+  {
+    std::fprintf(stderr, "write %s failed\n", path.c_str());
+    return 1;
+  }
+  std::printf("commands=%zu  aof=%.1f MB\n", n, static_cast<double>(bytes) / 1048576.0);
+
+  {
+    auto t0 = Clock::now();
+    size_t parsed = parseOnly(path);
+    report("parse-only", parsed, bytes, seconds(t0), 0);
+  }
+  {
+    KeyValueStore store;
+    auto t0 = Clock::now();
+    legacyLoad(path, store);
+    report("legacy", n, bytes, seconds(t0), store.size());
+  }
+  {
+    KeyValueStore store;
+    AofOptions opts;
+    opts.enabled = true;
+    opts.dir = dir;
+    opts.filename = file;
+    opts.prealloc_bytes = 0;
+    AofLogger aof;
+    std::string err;
+    if (!aof.init(opts, err))
+    {
+      std::fprintf(stderr, "init failed: %s\n", err.c_str());
+      return 1;
+    }
+    auto t0 = Clock::now();
+    if (!aof.load(store, err))
+    {
+      std::fprintf(stderr, "load failed: %s\n", err.c_str());
+      return 1;
+    }
+    report("AofLogger", n, bytes, seconds(t0), store.size());
+    // 生成的单文件作为 base 纳入了清单，init 另建了增量段与清单文件
+    for (const auto &name : aof.manifest().incrs)
+      ::unlink((dir + "/" + name).c_str());
+    ::unlink(aof.path().c_str());
+  }
+  ::unlink(path.c_str());
+  return 0;
+}
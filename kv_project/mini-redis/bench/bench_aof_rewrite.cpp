@@ -0,0 +1,141 @@
+/**
+ * 创建者：程序员老廖
+ * 日期：2025年8月12日
+ */
+
+// AOF 重写基准：同一份数据集（string / hash / zset 各占一部分 key）分别用两种格式执行 BGREWRITEAOF，
+// 报告重写耗时、文件大小，以及重启时 AofLogger::load 把重写结果加载进空 store 的耗时。
+//   resp        ：旧格式，每个 string 一条 SET，每个 hash 字段一条 HSET，每个 zset 成员一条 ZADD
+//   rdb-preamble：MRDB3 快照 + 增量命令（这里没有并发写入，增量为空）
+// 文件大小为清单中全部文件之和
+//
+// 用法：bench_aof_rewrite [keys] [fields_per_collection] [dir]
+
+#include "mini_redis/aof.hpp"
+#include "mini_redis/config.hpp"
+#include "mini_redis/kv.hpp"
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+using mini_redis::AofLogger;
+using mini_redis::AofOptions;
+using mini_redis::KeyValueStore;
+
+namespace
+{
+
+  using Clock = std::chrono::steady_clock;
+
+  double seconds(Clock::time_point t0)
+  {
+    return std::chrono::duration<double>(Clock::now() - t0).count();
+  }
+
+  void fill(KeyValueStore &store, size_t keys, size_t fields)
+  {
+    for (size_t i = 0; i < keys; ++i)
+    {
+      std::string k = std::to_string(i);
+      switch (i % 4)
+      {
+      case 0:
+        for (size_t f = 0; f < fields; ++f)
+          store.hset("h:" + k, "field:" + std::to_string(f), std::string(32, 'h'));
+        break;
+      case 1:
+        for (size_t f = 0; f < fields; ++f)
+          store.zadd("z:" + k, static_cast<double>(f) * 1.5, "member:" + std::to_string(f));
+        break;
+      default:
+        store.set("key:" + k, std::string(64, 'v'), i % 8 == 2 ? std::optional<int64_t>(3600 * 1000) : std::nullopt);
+        break;
+      }
+    }
+  }
+
+  void runMode(const char *name, bool preamble, KeyValueStore &store, const std::string &dir)
+  {
+    AofOptions opts;
+    opts.enabled = true;
+    opts.dir = dir;
+    opts.filename = "bench_aof_rewrite.aof";
+    opts.prealloc_bytes = 0;
+    opts.use_rdb_preamble = preamble;
+    std::string err;
+    double rewrite_sec = 0;
+    mini_redis::AofManifest m;
+    {
+      AofLogger aof;
+      if (!aof.init(opts, err))
+      {
+        std::fprintf(stderr, "init failed: %s\n", err.c_str());
+        std::exit(1);
+      }
+      std::mutex mu;
+      auto t0 = Clock::now();
+      if (!aof.bgRewrite(store, mu, err))
+      {
+        std::fprintf(stderr, "rewrite failed: %s\n", err.c_str());
+        std::exit(1);
+      }
+      while (aof.rewriteInProgress())
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      rewrite_sec = seconds(t0);
+      m = aof.manifest();
+    }
+    // 重写后的 AOF 即清单中的 base 加切换点之后的增量段（这里没有并发写入，增量段为空）
+    uint64_t size = 0;
+    std::vector<std::string> files = m.incrs;
+    files.push_back(m.base);
+    for (const auto &f : files)
+    {
+      struct stat st{};
+      if (::stat((dir + "/" + f).c_str(), &st) == 0)
+        size += static_cast<uint64_t>(st.st_size);
+    }
+
+    KeyValueStore loaded;
+    AofLogger aof;
+    if (!aof.init(opts, err))
+    {
+      std::fprintf(stderr, "init failed: %s\n", err.c_str());
+      std::exit(1);
+    }
+    auto t0 = Clock::now();
+    if (!aof.load(loaded, err))
+    {
+      std::fprintf(stderr, "load failed: %s\n", err.c_str());
+      std::exit(1);
+    }
+    double load_sec = seconds(t0);
+    std::printf("%-13s rewrite %8.1f ms  size %8.1f MB  load %8.1f ms  (keys %zu/%zu)\n", name, rewrite_sec * 1000.0,
+                static_cast<double>(size) / 1048576.0, load_sec * 1000.0, loaded.size(), store.size());
+    aof.shutdown();
+    files.push_back(opts.filename + ".manifest");
+    for (const auto &f : files)
+      ::unlink((dir + "/" + f).c_str());
+  }
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+  size_t keys = argc > 1 ? static_cast<size_t>(std::strtoull(argv[1], nullptr, 10)) : 400000;
+  size_t fields = argc > 2 ? static_cast<size_t>(std::strtoull(argv[2], nullptr, 10)) : 16;
+  std::string dir = argc > 3 ? argv[3] : "/tmp";
+  KeyValueStore store;
+  fill(store, keys, fields);
+  std::printf("keys=%zu  fields_per_collection=%zu\n", keys, fields);
+  runMode("resp", false, store, dir);
+  runMode("rdb-preamble", true, store, dir);
+  return 0;
+}
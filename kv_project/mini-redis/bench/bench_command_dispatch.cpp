@@ -0,0 +1,99 @@
+/**
+ * 创建者：程序员老廖
+ * 日期：2025年8月12日
+ */
+
+// 命令分发基准：只测"命令名 -> 处理逻辑"这一步。
+// 对比旧实现（每条命令先拷贝并转大写，再按 if 链逐个字符串比较）与命令表完美哈希 lookupCommand。
+//
+// 用法：bench_command_dispatch [total_lookups]
+
+#include "mini_redis/commands.hpp"
+
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace
+{
+
+  // 旧 handle_command 的比较顺序（SYNC/PSYNC 在 execute_one 中还会再转一次大写）
+  const char *const kLegacyOrder[] = {
+      "PING", "ECHO", "SET", "GET", "KEYS", "FLUSHALL", "DEL", "EXISTS", "EXPIRE",
+      "TTL", "HSET", "HGET", "HDEL", "HEXISTS", "HGETALL", "HLEN", "ZADD", "ZREM",
+      "ZRANGE", "ZSCORE", "BGSAVE", "SAVE", "BGREWRITEAOF", "CONFIG", "INFO"};
+
+  int legacyDispatch(std::string_view name)
+  {
+    if (name.size() == 4 || name.size() == 5)
+    {
+      std::string up;
+      up.reserve(name.size());
+      for (char ch : name)
+        up.push_back(static_cast<char>(::toupper(ch)));
+      if (up == "PSYNC" || up == "SYNC")
+        return 100;
+    }
+    std::string cmd;
+    cmd.reserve(name.size());
+    for (char c : name)
+      cmd.push_back(static_cast<char>(::toupper(c)));
+    int i = 0;
+    for (const char *n : kLegacyOrder)
+    {
+      if (cmd == n)
+        return i;
+      ++i;
+    }
+    return -1;
+  }
+
+  int tableDispatch(std::string_view name)
+  {
+    const mini_redis::CommandSpec *spec = mini_redis::lookupCommand(name);
+    return spec ? spec->arity : -1;
+  }
+
+  template <typename F>
+  double nsPerLookup(const std::vector<std::string> &mix, size_t total, long &sink, F &&fn)
+  {
+    auto t0 = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < total; ++i)
+      sink += fn(mix[i % mix.size()]);
+    auto t1 = std::chrono::steady_clock::now();
+    return static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0).count()) /
+           static_cast<double>(total);
+  }
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+  size_t total = argc > 1 ? static_cast<size_t>(std::strtoull(argv[1], nullptr, 10)) : 20000000;
+  struct Mix
+  {
+    const char *label;
+    std::vector<std::string> names;
+  };
+  const Mix mixes[] = {
+      {"get/set", {"GET", "SET", "GET", "GET", "set", "get"}},
+      {"hash", {"HSET", "HGET", "HGETALL", "hdel", "HEXISTS", "HLEN"}},
+      {"zset", {"ZADD", "ZRANGE", "ZSCORE", "zrem"}},
+      {"tail", {"INFO", "CONFIG", "BGREWRITEAOF", "ZSCORE", "ping"}},
+      {"unknown", {"FOO", "MGET", "HMSET", "incr"}},
+  };
+  std::printf("total_lookups=%zu\n", total);
+  std::printf("%-10s %18s %18s %10s\n", "mix", "legacy(ns/lookup)", "table(ns/lookup)", "speedup");
+  long sink = 0;
+  for (const auto &m : mixes)
+  {
+    double old_ns = nsPerLookup(m.names, total, sink, legacyDispatch);
+    double new_ns = nsPerLookup(m.names, total, sink, tableDispatch);
+    std::printf("%-10s %18.2f %18.2f %9.1fx\n", m.label, old_ns, new_ns, old_ns / new_ns);
+  }
+  return sink == 0 ? 1 : 0;
+}
@@ -0,0 +1,149 @@
+/**
+ * 创建者：程序员老廖
+ * 日期：2025年8月12日
+ */
+
+// 主动过期基准：n 个带 TTL 的 key，其中 expired_pct% 已到期，反复调用一次定时器 tick 的回收逻辑，
+// 统计每个 tick 的耗时、回收数，以及回收完全部到期 key 需要多少个 tick。
+// 对照组在 bench 内模拟旧实现：每分片一个 unordered_map 过期索引，每 tick 共 64 步、
+// 每个分片 std::advance 到随机位置后顺序检查（旧表遍历本身是 O(n)）。
+//
+// 用法：bench_expire_cycle [keys] [expired_pct] [budget_us]
+
+#include "mini_redis/kv.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+using mini_redis::KeyValueStore;
+
+namespace
+{
+
+  using Clock = std::chrono::steady_clock;
+
+  double usSince(Clock::time_point t0)
+  {
+    return static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - t0).count()) / 1000.0;
+  }
+
+  // 旧实现的等价模拟（不含对象本身，只保留过期索引与随机起点扫描）
+  struct RandomScanBaseline
+  {
+    static constexpr size_t kShards = 16;
+    std::unordered_map<std::string, int64_t> index[kShards];
+    size_t cursor = 0;
+
+    int step(int max_steps, int64_t now)
+    {
+      int per_shard = max_steps / static_cast<int>(kShards);
+      if (per_shard < 1)
+        per_shard = 1;
+      int removed = 0;
+      int budget = max_steps;
+      size_t first = cursor++ % kShards;
+      for (size_t n = 0; n < kShards && budget > 0; ++n)
+      {
+        auto &idx = index[(first + n) % kShards];
+        if (idx.empty())
+          continue;
+        auto it = idx.begin();
+        std::advance(it, static_cast<long>(static_cast<size_t>(std::rand()) % idx.size()));
+        for (int i = 0; i < per_shard && budget > 0 && !idx.empty(); ++i, --budget)
+        {
+          if (it == idx.end())
+            it = idx.begin();
+          if (it->second >= 0 && now >= it->second)
+          {
+            it = idx.erase(it);
+            ++removed;
+          }
+          else
+          {
+            ++it;
+          }
+        }
+      }
+      return removed;
+    }
+  };
+
+  void report(const char *name, size_t ticks, double total_us, double max_us, size_t removed, size_t target)
+  {
+    double avg = ticks ? total_us / static_cast<double>(ticks) : 0;
+    std::printf("%-12s ticks=%-8zu avg_tick=%9.1f us  max_tick=%9.1f us  reclaimed/tick=%9.1f  reclaimed=%zu/%zu",
+                name, ticks, avg, max_us, ticks ? static_cast<double>(removed) / static_cast<double>(ticks) : 0.0,
+                removed, target);
+    if (removed < target && removed > 0)
+      std::printf("  (est. ticks to finish=%.0f)", static_cast<double>(ticks) * static_cast<double>(target) / static_cast<double>(removed));
+    std::printf("\n");
+  }
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+  size_t n = argc > 1 ? static_cast<size_t>(std::strtoull(argv[1], nullptr, 10)) : 2000000;
+  size_t pct = argc > 2 ? static_cast<size_t>(std::strtoull(argv[2], nullptr, 10)) : 50;
+  int64_t budget_us = argc > 3 ? std::strtoll(argv[3], nullptr, 10) : 1000;
+  // 旧实现 tick 数上限：随机扫描回收全部 key 需要数万个 tick，只跑一段后按速率估算
+  const size_t kBaselineTicks = 200;
+
+  // 与 KeyValueStore::nowMs() 同一时钟
+  int64_t now = std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now().time_since_epoch()).count();
+  size_t target = 0;
+  std::vector<int64_t> deadlines(n);
+  for (size_t i = 0; i < n; ++i)
+  {
+    // 到期的 key 已过期 1 秒，其余一小时后到期；按下标交错，模拟到期 key 散布在整个键空间
+    bool expired = (i % 100) < pct;
+    deadlines[i] = expired ? now - 1000 : now + 3600 * 1000;
+    target += expired ? 1 : 0;
+  }
+
+  {
+    RandomScanBaseline base;
+    for (size_t i = 0; i < n; ++i)
+    {
+      std::string k = "key:" + std::to_string(i);
+      base.index[std::hash<std::string>{}(k) % RandomScanBaseline::kShards][k] = deadlines[i];
+    }
+    size_t ticks = 0, removed = 0;
+    double total = 0, max_us = 0;
+    while (removed < target && ticks < kBaselineTicks)
+    {
+      auto t0 = Clock::now();
+      removed += static_cast<size_t>(base.step(64, now));
+      double us = usSince(t0);
+      total += us;
+      max_us = us > max_us ? us : max_us;
+      ++ticks;
+    }
+    report("random-scan", ticks, total, max_us, removed, target);
+  }
+
+  {
+    KeyValueStore store;
+    for (size_t i = 0; i < n; ++i)
+      store.setWithExpireAtMs("key:" + std::to_string(i), "v", deadlines[i]);
+    size_t ticks = 0, removed = 0;
+    double total = 0, max_us = 0;
+    while (removed < target)
+    {
+      auto t0 = Clock::now();
+      removed += static_cast<size_t>(store.activeExpireCycle(mini_redis::ExpireCycle::kSlow, budget_us));
+      double us = usSince(t0);
+      total += us;
+      max_us = us > max_us ? us : max_us;
+      ++ticks;
+    }
+    report("expire-heap", ticks, total, max_us, removed, target);
+    std::printf("volatile keys left=%zu (expected %zu), budget=%lld us\n", store.volatileKeys(), n - target,
+                static_cast<long long>(budget_us));
+  }
+  return 0;
+}
@@ -0,0 +1,112 @@
+/**
+ * 创建者：程序员老廖
+ * 日期：2025年8月12日
+ */
+
+// 键空间哈希表基准：连续插入 N 个 key（单线程，无锁），逐次记录插入耗时，
+// 对比 std::unordered_map 与 Dict（开放寻址 + 渐进 rehash）的尾延迟和每个 key 的内存占用。
+// unordered_map 在扩容时一次性重挂所有节点，延迟尖刺集中体现在 max / p99.99 上。
+//
+// 用法：bench_keyspace_dict [keys]
+
+#include "mini_redis/dict.hpp"
+#include "mini_redis/kv.hpp"
+
+#include <malloc.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+using mini_redis::Dict;
+using mini_redis::ValueRecord;
+
+namespace
+{
+
+  struct Result
+  {
+    double bytes_per_key;
+    double p50_ns;
+    double p99_ns;
+    double p999_ns;
+    double p9999_ns;
+    double max_ns;
+  };
+
+  size_t heapInUse()
+  {
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+    struct mallinfo2 mi = mallinfo2();
+    return mi.uordblks + mi.hblkhd; // hblkhd：大块直接 mmap 的部分（大表的槽数组）
+#else
+    return 0;
+#endif
+  }
+
+  double pct(std::vector<int64_t> &v, double p)
+  {
+    size_t idx = static_cast<size_t>(p * static_cast<double>(v.size() - 1));
+    std::nth_element(v.begin(), v.begin() + static_cast<long>(idx), v.end());
+    return static_cast<double>(v[idx]);
+  }
+
+  template <typename Insert>
+  Result run(const std::vector<std::string> &keys, Insert &&insert)
+  {
+    std::vector<int64_t> lat(keys.size());
+    size_t before = heapInUse();
+    for (size_t i = 0; i < keys.size(); ++i)
+    {
+      auto t0 = std::chrono::steady_clock::now();
+      insert(keys[i]);
+      auto t1 = std::chrono::steady_clock::now();
+      lat[i] = std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0).count();
+    }
+    size_t after = heapInUse();
+    Result r{};
+    r.bytes_per_key = static_cast<double>(after - before) / static_cast<double>(keys.size());
+    r.max_ns = static_cast<double>(*std::max_element(lat.begin(), lat.end()));
+    r.p50_ns = pct(lat, 0.50);
+    r.p99_ns = pct(lat, 0.99);
+    r.p999_ns = pct(lat, 0.999);
+    r.p9999_ns = pct(lat, 0.9999);
+    return r;
+  }
+
+  void print(const char *name, const Result &r)
+  {
+    std::printf("%-15s %10.1f %9.0f %9.0f %9.0f %10.0f %12.0f\n", name, r.bytes_per_key, r.p50_ns, r.p99_ns,
+                r.p999_ns, r.p9999_ns, r.max_ns);
+  }
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+  size_t n = argc > 1 ? static_cast<size_t>(std::strtoull(argv[1], nullptr, 10)) : 4000000;
+  std::vector<std::string> keys;
+  keys.reserve(n);
+  for (size_t i = 0; i < n; ++i)
+    keys.push_back("key:" + std::to_string(i));
+  const std::string value = "value-012345678"; // 15 字节，落在 SSO 内，只比较表本身的开销
+
+  std::printf("keys=%zu, value=ValueRecord{15B string, expire}\n", n);
+  std::printf("%-15s %10s %9s %9s %9s %10s %12s\n", "table", "bytes/key", "p50(ns)", "p99(ns)", "p99.9(ns)",
+              "p99.99(ns)", "max(ns)");
+  {
+    std::unordered_map<std::string, ValueRecord> m;
+    print("unordered_map", run(keys, [&](const std::string &k)
+                               { m[k] = ValueRecord{value, -1}; }));
+  }
+  {
+    Dict<ValueRecord> d;
+    print("Dict", run(keys, [&](const std::string &k)
+                      { d[k] = ValueRecord{value, -1}; }));
+  }
+  return 0;
+}
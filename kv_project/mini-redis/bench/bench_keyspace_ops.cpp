@@ -0,0 +1,104 @@
+/**
+ * 创建者：程序员老廖
+ * 日期：2025年8月12日
+ */
+
+// 键空间基准：构造 string / hash / zset 混合、部分带 TTL 的键空间，
+// 统计每个 key 的堆内存，以及 GET / EXISTS / HGET / ZSCORE / SET 覆盖写的单次耗时。
+// 只使用 KeyValueStore 的公开接口，可以在改动前后的代码上分别编译对比。
+//
+// 用法：bench_keyspace_ops [keys] [ops]
+
+#include "mini_redis/kv.hpp"
+
+#include <malloc.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+
+using mini_redis::KeyValueStore;
+
+namespace
+{
+
+  size_t heapInUse()
+  {
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+    struct mallinfo2 mi = mallinfo2();
+    return mi.uordblks + mi.hblkhd;
+#else
+    return 0;
+#endif
+  }
+
+  template <typename F>
+  double nsPerOp(size_t ops, F &&fn)
+  {
+    auto t0 = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < ops; ++i)
+      fn(i);
+    auto t1 = std::chrono::steady_clock::now();
+    return static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0).count()) /
+           static_cast<double>(ops);
+  }
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+  size_t n = argc > 1 ? static_cast<size_t>(std::strtoull(argv[1], nullptr, 10)) : 1000000;
+  size_t ops = argc > 2 ? static_cast<size_t>(std::strtoull(argv[2], nullptr, 10)) : 2000000;
+  // 80% string（其中一半带 TTL）、10% hash、10% zset，每个 hash / zset 一个元素
+  std::vector<std::string> skeys, hkeys, zkeys;
+  for (size_t i = 0; i < n; ++i)
+  {
+    std::string k = "key:" + std::to_string(i);
+    if (i % 10 == 8)
+      hkeys.push_back(std::move(k));
+    else if (i % 10 == 9)
+      zkeys.push_back(std::move(k));
+    else
+      skeys.push_back(std::move(k));
+  }
+
+  KeyValueStore store;
+  size_t before = heapInUse();
+  for (size_t i = 0; i < skeys.size(); ++i)
+  {
+    if (i % 2 == 0)
+      store.set(skeys[i], "value-012345678", 3600 * 1000);
+    else
+      store.set(skeys[i], "value-012345678");
+  }
+  for (const auto &k : hkeys)
+    store.hset(k, "f", "v");
+  for (const auto &k : zkeys)
+    store.zadd(k, 1.0, "m");
+  size_t after = heapInUse();
+
+  std::mt19937_64 rng(7);
+  std::vector<size_t> idx(ops);
+  for (auto &x : idx)
+    x = static_cast<size_t>(rng());
+
+  size_t sink = 0;
+  std::printf("keys=%zu (string %zu, hash %zu, zset %zu), ops=%zu\n", n, skeys.size(), hkeys.size(), zkeys.size(), ops);
+  std::printf("bytes/key            %8.1f\n", static_cast<double>(after - before) / static_cast<double>(n));
+  std::printf("GET (ns/op)          %8.1f\n", nsPerOp(ops, [&](size_t i)
+                                                      { sink += store.get(skeys[idx[i] % skeys.size()]).has_value(); }));
+  std::printf("GET miss (ns/op)     %8.1f\n", nsPerOp(ops, [&](size_t i)
+                                                      { sink += store.get("missing:" + std::to_string(i & 1023)).has_value(); }));
+  std::printf("EXISTS (ns/op)       %8.1f\n", nsPerOp(ops, [&](size_t i)
+                                                      { sink += store.exists(zkeys[idx[i] % zkeys.size()]); }));
+  std::printf("HGET (ns/op)         %8.1f\n", nsPerOp(ops, [&](size_t i)
+                                                      { sink += store.hget(hkeys[idx[i] % hkeys.size()], "f").has_value(); }));
+  std::printf("ZSCORE (ns/op)       %8.1f\n", nsPerOp(ops, [&](size_t i)
+                                                      { sink += store.zscore(zkeys[idx[i] % zkeys.size()], "m").has_value(); }));
+  std::printf("SET overwrite (ns/op)%8.1f\n", nsPerOp(ops, [&](size_t i)
+                                                      { sink += store.set(skeys[idx[i] % skeys.size()], "value-876543210"); }));
+  return sink == 0 ? 1 : 0;
+}
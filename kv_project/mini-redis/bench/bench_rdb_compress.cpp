@@ -0,0 +1,121 @@
+/**
+ * 创建者：程序员老廖
+ * 日期：2025年8月12日
+ */
+
+// RDB 块压缩基准：同一份数据分别关闭 / 开启 rdb.compression 导出再加载，
+// 比较导出耗时、文件大小、加载耗时，并给出压缩线程的压缩比与吞吐（即 INFO 中的两项）。
+// 数据模拟线上：key 前缀高度重复，值是结构相同的 JSON 文档。
+//
+// 用法：bench_rdb_compress [keys] [dir]
+
+#include "mini_redis/kv.hpp"
+#include "mini_redis/rdb.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <memory>
+#include <string>
+
+using mini_redis::KeyValueStore;
+using mini_redis::Rdb;
+using mini_redis::RdbCompressStats;
+using mini_redis::RdbOptions;
+
+namespace
+{
+
+  using Clock = std::chrono::steady_clock;
+
+  double msSince(Clock::time_point t0)
+  {
+    return static_cast<double>(std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - t0).count()) / 1000.0;
+  }
+
+  std::string jsonDoc(size_t i)
+  {
+    std::string id = std::to_string(i);
+    return "{\"id\":" + id + ",\"name\":\"user-" + id + "\",\"email\":\"user" + id +
+           "@example.com\",\"active\":" + (i % 3 ? "true" : "false") + ",\"plan\":\"" + (i % 7 ? "free" : "pro") +
+           "\",\"tags\":[\"cache\",\"session\"],\"visits\":" + std::to_string(i * 7 % 1000) +
+           ",\"updated_at\":\"2025-08-12T10:" + std::to_string(10 + i % 50) + ":00Z\"}";
+  }
+
+  void fill(KeyValueStore &store, size_t n)
+  {
+    for (size_t i = 0; i < n; ++i)
+    {
+      std::string k = "user:profile:" + std::to_string(i);
+      if (i % 20 == 18)
+      {
+        for (int f = 0; f < 4; ++f)
+          store.hset(k, "field" + std::to_string(f), "value-" + std::to_string(i));
+      }
+      else if (i % 20 == 19)
+      {
+        for (int m = 0; m < 4; ++m)
+          store.zadd(k, static_cast<double>(i + m), "member" + std::to_string(m));
+      }
+      else
+      {
+        store.set(k, jsonDoc(i));
+      }
+    }
+  }
+
+  void run(const char *name, const KeyValueStore &store, RdbOptions opts)
+  {
+    Rdb rdb(opts);
+    std::string err;
+    auto t0 = Clock::now();
+    bool ok = rdb.save(store, err);
+    double dump_ms = msSince(t0);
+    double size_mb = ok ? static_cast<double>(std::filesystem::file_size(rdb.path())) / 1048576.0 : 0;
+    RdbCompressStats cs = rdb.lastCompressStats();
+
+    double load_ms[2] = {0, 0};
+    size_t keys = 0;
+    for (int i = 0; i < 2 && ok; ++i)
+    {
+      // 第一轮单线程顺序加载，第二轮按 CPU 核数并行
+      opts.load_threads = i == 0 ? 1 : 0;
+      Rdb loader(opts);
+      auto fresh = std::make_unique<KeyValueStore>();
+      t0 = Clock::now();
+      ok = loader.load(*fresh, err);
+      load_ms[i] = msSince(t0);
+      keys = fresh->size();
+    }
+    std::printf("%-16s dump=%8.1f ms  size=%7.1f MB  load(1 thread)=%8.1f ms  load(all)=%8.1f ms  keys=%zu", name, dump_ms,
+                size_mb, load_ms[0], load_ms[1], keys);
+    if (cs.stored_bytes > 0)
+      std::printf("  ratio=%.2f  compress=%.0f MB/s",
+                  static_cast<double>(cs.raw_bytes) / static_cast<double>(cs.stored_bytes),
+                  cs.compress_us > 0 ? static_cast<double>(cs.raw_bytes) / static_cast<double>(cs.compress_us) : 0.0);
+    std::printf("%s\n", ok ? "" : ("  FAILED: " + err).c_str());
+  }
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+  size_t n = argc > 1 ? static_cast<size_t>(std::strtoull(argv[1], nullptr, 10)) : 2000000;
+  std::string dir = argc > 2 ? argv[2] : "/tmp/bench_rdb_compress";
+  RdbOptions plain, packed;
+  plain.dir = dir + "/plain";
+  packed.dir = dir + "/lz4";
+  packed.compression = true;
+  std::filesystem::create_directories(plain.dir);
+  std::filesystem::create_directories(packed.dir);
+
+  auto store = std::make_unique<KeyValueStore>();
+  auto t0 = Clock::now();
+  fill(*store, n);
+  std::printf("keys=%zu  fill=%.0f ms\n", store->size(), msSince(t0));
+  run("compression=off", *store, plain);
+  run("compression=on", *store, packed);
+  std::filesystem::remove_all(dir);
+  return 0;
+}
@@ -0,0 +1,174 @@
+/**
+ * 创建者：程序员老廖
+ * 日期：2025年8月12日
+ */
+
+// RDB 格式基准：同一份数据分别以 MRDB2（文本）与 MRDB3（二进制）导出再加载，
+// 比较导出 / 加载耗时、文件大小，以及 zset 分值往返后的误差。
+// MRDB2 的导出在 bench 内按旧实现复刻（逐记录 to_string 拼接 + 每行一次 write）；加载两种格式都走 Rdb::load。
+//
+// 用法：bench_rdb_format [keys] [dir]
+//   数据：90% string（一半带 TTL）、5% hash（4 个字段）、5% zset（4 个成员）
+
+#include "mini_redis/kv.hpp"
+#include "mini_redis/rdb.hpp"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <memory>
+#include <string>
+
+using mini_redis::KeyValueStore;
+using mini_redis::Rdb;
+using mini_redis::RdbOptions;
+
+namespace
+{
+
+  using Clock = std::chrono::steady_clock;
+
+  double msSince(Clock::time_point t0)
+  {
+    return static_cast<double>(std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - t0).count()) / 1000.0;
+  }
+
+  double scoreOf(size_t i, size_t j) { return static_cast<double>(i) * 0.123456789 + static_cast<double>(j) / 3.0; }
+
+  void fill(KeyValueStore &store, size_t n)
+  {
+    for (size_t i = 0; i < n; ++i)
+    {
+      std::string k = "key:" + std::to_string(i);
+      if (i % 20 == 18)
+      {
+        for (int f = 0; f < 4; ++f)
+          store.hset(k, "field" + std::to_string(f), "value-" + std::to_string(i));
+      }
+      else if (i % 20 == 19)
+      {
+        for (size_t m = 0; m < 4; ++m)
+          store.zadd(k, scoreOf(i, m), "member" + std::to_string(m));
+      }
+      else if (i % 2 == 0)
+      {
+        store.set(k, "value-" + std::to_string(i), 3600 * 1000);
+      }
+      else
+      {
+        store.set(k, "value-" + std::to_string(i));
+      }
+    }
+  }
+
+  bool writeLine(int fd, const std::string &s) { return ::write(fd, s.data(), s.size()) == static_cast<ssize_t>(s.size()); }
+
+  // 旧版 Rdb::save 的 MRDB2 导出逻辑
+  bool saveV2(const KeyValueStore &store, const std::string &path)
+  {
+    int fd = ::open(path.c_str(), O_CREAT | O_TRUNC | O_WRONLY, 0644);
+    if (fd < 0)
+      return false;
+    auto snap_str = store.snapshot();
+    auto snap_hash = store.snapshotHash();
+    auto snap_zset = store.snapshotZSet();
+    bool ok = writeLine(fd, "MRDB2\n") && writeLine(fd, "STR " + std::to_string(snap_str.size()) + "\n");
+    for (const auto &kv : snap_str)
+    {
+      std::string rec;
+      rec.append(std::to_string(kv.first.size())).append(" ").append(kv.first).append(" ").append(std::to_string(kv.second.value.size())).append(" ").append(kv.second.value).append(" ").append(std::to_string(kv.second.expire_at_ms)).append("\n");
+      ok = ok && writeLine(fd, rec);
+    }
+    ok = ok && writeLine(fd, "HASH " + std::to_string(snap_hash.size()) + "\n");
+    for (const auto &kv : snap_hash)
+    {
+      std::string head;
+      head.append(std::to_string(kv.first.size())).append(" ").append(kv.first).append(" ").append(std::to_string(kv.second.expire_at_ms)).append(" ").append(std::to_string(kv.second.fields.size())).append("\n");
+      ok = ok && writeLine(fd, head);
+      for (const auto &fv : kv.second.fields)
+      {
+        std::string line;
+        line.append(std::to_string(fv.first.size())).append(" ").append(fv.first).append(" ").append(std::to_string(fv.second.size())).append(" ").append(fv.second).append("\n");
+        ok = ok && writeLine(fd, line);
+      }
+    }
+    ok = ok && writeLine(fd, "ZSET " + std::to_string(snap_zset.size()) + "\n");
+    for (const auto &z : snap_zset)
+    {
+      std::string head;
+      head.append(std::to_string(z.key.size())).append(" ").append(z.key).append(" ").append(std::to_string(z.expire_at_ms)).append(" ").append(std::to_string(z.items.size())).append("\n");
+      ok = ok && writeLine(fd, head);
+      for (const auto &it : z.items)
+      {
+        std::string line;
+        line.append(std::to_string(it.first)).append(" ").append(std::to_string(it.second.size())).append(" ").append(it.second).append("\n");
+        ok = ok && writeLine(fd, line);
+      }
+    }
+    ::fsync(fd);
+    ::close(fd);
+    return ok;
+  }
+
+  void loadAndCheck(const char *name, const RdbOptions &opts, size_t n, double dump_ms)
+  {
+    auto store = std::make_unique<KeyValueStore>();
+    Rdb rdb(opts);
+    std::string err;
+    auto t0 = Clock::now();
+    bool ok = rdb.load(*store, err);
+    double load_ms = msSince(t0);
+    // 抽查 zset 分值的往返误差
+    double max_err = 0;
+    for (size_t i = 19; i < n; i += 20 * 97)
+    {
+      auto sc = store->zscore("key:" + std::to_string(i), "member1");
+      if (sc)
+        max_err = std::fmax(max_err, std::fabs(*sc - scoreOf(i, 1)));
+    }
+    struct stat st{};
+    ::stat(rdb.path().c_str(), &st);
+    std::printf("%s  dump=%9.1f ms  load=%9.1f ms  size=%8.1f MB  keys=%zu  max_score_err=%.3g%s\n", name, dump_ms, load_ms,
+                static_cast<double>(st.st_size) / 1048576.0, store->size(), max_err, ok ? "" : ("  LOAD FAILED: " + err).c_str());
+  }
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+  size_t n = argc > 1 ? static_cast<size_t>(std::strtoull(argv[1], nullptr, 10)) : 10000000;
+  std::string dir = argc > 2 ? argv[2] : "/tmp/bench_rdb_format";
+  RdbOptions v2, v3;
+  v2.dir = dir + "/v2";
+  v3.dir = dir + "/v3";
+  std::filesystem::create_directories(v2.dir);
+  std::filesystem::create_directories(v3.dir);
+
+  double v2_ms = 0, v3_ms = 0;
+  {
+    auto store = std::make_unique<KeyValueStore>();
+    auto t0 = Clock::now();
+    fill(*store, n);
+    std::printf("keys=%zu  fill=%.0f ms\n", store->size(), msSince(t0));
+    t0 = Clock::now();
+    if (!saveV2(*store, v2.dir + "/" + v2.filename))
+      std::printf("MRDB2 dump failed\n");
+    v2_ms = msSince(t0);
+    Rdb rdb(v3);
+    std::string err;
+    t0 = Clock::now();
+    if (!rdb.save(*store, err))
+      std::printf("MRDB3 dump failed: %s\n", err.c_str());
+    v3_ms = msSince(t0);
+  }
+  loadAndCheck("MRDB2", v2, n, v2_ms);
+  loadAndCheck("MRDB3", v3, n, v3_ms);
+  std::filesystem::remove_all(dir);
+  return 0;
+}
@@ -0,0 +1,132 @@
+/**
+ * 创建者：程序员老廖
+ * 日期：2025年8月12日
+ */
+
+// RDB 冷启动基准：生成 n 个 key 的 RDB 文件后，在一个全新的子进程里加载，
+// 报告加载耗时与子进程峰值 RSS（VmHWM）。加载前用 POSIX_FADV_DONTNEED
+// 把文件逐出页缓存，模拟冷启动。只使用 Rdb / KeyValueStore 的公开接口，可以在改动前后的代码上分别编译对比。
+//
+// 用法：bench_rdb_load [keys] [dir]
+//       bench_rdb_load --load dir     （子进程模式）
+
+#include "mini_redis/kv.hpp"
+#include "mini_redis/rdb.hpp"
+
+#include <fcntl.h>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <memory>
+#include <string>
+
+extern char **environ;
+
+using mini_redis::KeyValueStore;
+using mini_redis::Rdb;
+using mini_redis::RdbOptions;
+
+namespace
+{
+
+  // 读 /proc/self/status 的 VmHWM：ru_maxrss 会继承 exec 之前父进程地址空间的峰值，VmHWM 只属于当前映像
+  long maxRssKb()
+  {
+    FILE *f = std::fopen("/proc/self/status", "r");
+    if (!f)
+      return 0;
+    char line[256];
+    long kb = 0;
+    while (std::fgets(line, sizeof(line), f))
+    {
+      if (std::strncmp(line, "VmHWM:", 6) == 0)
+      {
+        kb = std::strtol(line + 6, nullptr, 10);
+        break;
+      }
+    }
+    std::fclose(f);
+    return kb;
+  }
+
+  int loadMode(const std::string &dir)
+  {
+    RdbOptions opts;
+    opts.dir = dir;
+    Rdb rdb(opts);
+    int fd = ::open(rdb.path().c_str(), O_RDONLY);
+    if (fd >= 0)
+    {
+      ::fdatasync(fd);
+      ::posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+      ::close(fd);
+    }
+    long base_kb = maxRssKb();
+    KeyValueStore store;
+    std::string err;
+    auto t0 = std::chrono::steady_clock::now();
+    bool ok = rdb.load(store, err);
+    double ms = static_cast<double>(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - t0).count()) / 1000.0;
+    long peak_kb = maxRssKb();
+    std::printf("load=%.1f ms  keys=%zu  peak_rss=%.1f MB (before load %.1f MB)%s\n", ms, store.size(),
+                static_cast<double>(peak_kb) / 1024.0, static_cast<double>(base_kb) / 1024.0, ok ? "" : ("  FAILED: " + err).c_str());
+    return ok ? 0 : 1;
+  }
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+  if (argc > 2 && std::strcmp(argv[1], "--load") == 0)
+    return loadMode(argv[2]);
+
+  size_t n = argc > 1 ? static_cast<size_t>(std::strtoull(argv[1], nullptr, 10)) : 5000000;
+  std::string dir = argc > 2 ? argv[2] : "/tmp/bench_rdb_load";
+  std::filesystem::create_directories(dir);
+  {
+    RdbOptions opts;
+    opts.dir = dir;
+    auto store = std::make_unique<KeyValueStore>();
+    for (size_t i = 0; i < n; ++i)
+    {
+      std::string k = "key:" + std::to_string(i);
+      if (i % 20 == 18)
+        store->hset(k, "field", "value-" + std::to_string(i));
+      else if (i % 20 == 19)
+        store->zadd(k, static_cast<double>(i), "member");
+      else
+        store->set(k, "value-" + std::to_string(i));
+    }
+    Rdb rdb(opts);
+    std::string err;
+    if (!rdb.save(*store, err))
+    {
+      std::printf("save failed: %s\n", err.c_str());
+      return 1;
+    }
+    std::printf("keys=%zu  rdb=%.1f MB\n", n, static_cast<double>(std::filesystem::file_size(rdb.path())) / 1048576.0);
+    std::fflush(stdout);
+  }
+
+  // 在新进程里加载，峰值 RSS 不受生成阶段影响
+  std::string self = "/proc/self/exe";
+  char arg0[] = "bench_rdb_load";
+  char arg1[] = "--load";
+  char *args[] = {arg0, arg1, dir.data(), nullptr};
+  pid_t pid = 0;
+  if (::posix_spawn(&pid, self.c_str(), nullptr, nullptr, args, environ) != 0)
+  {
+    std::perror("posix_spawn");
+    return 1;
+  }
+  int status = 0;
+  ::waitpid(pid, &status, 0);
+  std::filesystem::remove_all(dir);
+  return WIFEXITED(status) ? WEXITSTATUS(status) : 1;
+}
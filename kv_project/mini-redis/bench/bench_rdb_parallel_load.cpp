@@ -0,0 +1,79 @@
+/**
+ * 创建者：程序员老廖
+ * 日期：2025年8月12日
+ */
+
+// RDB 并行加载扩展性基准：生成一份 n 个 key 的分块 MRDB3 文件，
+// 依次以 1, 2, 4, ... max_threads 个线程加载到全新的 KeyValueStore，报告耗时与相对单线程的加速比。
+// threads=1 走顺序解析路径。文件加载前已在页缓存中（热启动），只衡量解码与插入本身的扩展性。
+//
+// 用法：bench_rdb_parallel_load [keys] [max_threads] [dir]
+
+#include "mini_redis/kv.hpp"
+#include "mini_redis/rdb.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <thread>
+
+using mini_redis::KeyValueStore;
+using mini_redis::Rdb;
+using mini_redis::RdbOptions;
+
+int main(int argc, char **argv)
+{
+  size_t n = argc > 1 ? static_cast<size_t>(std::strtoull(argv[1], nullptr, 10)) : 5000000;
+  int max_threads = argc > 2 ? std::atoi(argv[2]) : static_cast<int>(std::thread::hardware_concurrency());
+  std::string dir = argc > 3 ? argv[3] : "/tmp/bench_rdb_parallel_load";
+  if (max_threads < 1)
+    max_threads = 1;
+  std::filesystem::create_directories(dir);
+  RdbOptions opts;
+  opts.dir = dir;
+  {
+    auto store = std::make_unique<KeyValueStore>();
+    for (size_t i = 0; i < n; ++i)
+    {
+      std::string k = "key:" + std::to_string(i);
+      if (i % 20 == 18)
+        store->hset(k, "field", "value-" + std::to_string(i));
+      else if (i % 20 == 19)
+        store->zadd(k, static_cast<double>(i), "member");
+      else
+        store->set(k, "value-" + std::to_string(i));
+    }
+    Rdb rdb(opts);
+    std::string err;
+    if (!rdb.save(*store, err))
+    {
+      std::printf("save failed: %s\n", err.c_str());
+      return 1;
+    }
+    std::printf("keys=%zu  rdb=%.1f MB  hardware_concurrency=%u\n", n,
+                static_cast<double>(std::filesystem::file_size(rdb.path())) / 1048576.0, std::thread::hardware_concurrency());
+  }
+
+  double base_ms = 0;
+  for (int t = 1; t <= max_threads; t *= 2)
+  {
+    opts.load_threads = t;
+    Rdb rdb(opts);
+    auto store = std::make_unique<KeyValueStore>();
+    std::string err;
+    auto t0 = std::chrono::steady_clock::now();
+    bool ok = rdb.load(*store, err);
+    double ms = static_cast<double>(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - t0).count()) / 1000.0;
+    if (t == 1)
+      base_ms = ms;
+    std::printf("threads=%-3d load=%9.1f ms  speedup=%5.2fx  keys=%zu%s\n", t, ms, base_ms / ms, store->size(),
+                ok ? "" : ("  FAILED: " + err).c_str());
+    if (t * 2 > max_threads && t != max_threads)
+      t = max_threads / 2; // 保证最后一轮正好是 max_threads
+  }
+  std::filesystem::remove_all(dir);
+  return 0;
+}
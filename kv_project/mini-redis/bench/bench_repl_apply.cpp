@@ -0,0 +1,185 @@
+/**
+ * 创建者：程序员老廖
+ * 日期：2025年8月12日
+ */
+
+// replica 应用速率基准：预先生成一段主库复制流（+OFFSET 行 + 写命令，SET/HSET/ZADD/EXPIRE/DEL 混合），
+// 按 recv 大小切块喂给 replica 的应用逻辑，报告每秒应用的命令数。
+//   per-command：复刻旧实现，8KB 一块，tryParseOne 拷贝出每个参数，逐条调用 KeyValueStore 接口（每条各加一次分片锁）
+//   batched    ：256KB 一块，零拷贝解析，ReplApplier 按分片分组、每组加一次锁经命令表执行
+// readers > 0 时另起若干线程持续 GET，模拟 replica 同时承担读流量时的锁竞争。
+//
+// 用法：bench_repl_apply [commands] [readers]
+
+#include "mini_redis/aof.hpp"
+#include "mini_redis/kv.hpp"
+#include "mini_redis/repl_apply.hpp"
+#include "mini_redis/resp.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <string>
+#include <thread>
+#include <vector>
+
+using mini_redis::KeyValueStore;
+using mini_redis::ParseStatus;
+using mini_redis::ReplApplier;
+using mini_redis::RespCommand;
+using mini_redis::RespParser;
+using mini_redis::RespType;
+
+namespace
+{
+
+  using Clock = std::chrono::steady_clock;
+  const size_t kKeys = 100000;
+
+  std::string buildStream(size_t n)
+  {
+    std::string out;
+    int64_t offset = 0;
+    for (size_t i = 0; i < n; ++i)
+    {
+      std::string k = std::to_string((i * 7919) % kKeys);
+      std::string cmd;
+      switch (i % 10)
+      {
+      case 0:
+        cmd = mini_redis::toRespArray({std::string("HSET"), "h:" + k, "f" + std::to_string(i % 16), std::string(32, 'h')});
+        break;
+      case 1:
+        cmd = mini_redis::toRespArray({std::string("ZADD"), "z:" + k, std::to_string(i % 1000), "m" + std::to_string(i % 64)});
+        break;
+      case 2:
+        cmd = mini_redis::toRespArray({std::string("EXPIRE"), "h:" + k, std::string("3600")});
+        break;
+      case 3:
+        cmd = mini_redis::toRespArray({std::string("DEL"), "key:" + k, "key:" + std::to_string((i * 31) % kKeys)});
+        break;
+      default:
+        cmd = mini_redis::toRespArray({std::string("SET"), "key:" + k, std::string(64, 'v')});
+        break;
+      }
+      offset += static_cast<int64_t>(cmd.size());
+      out += "+OFFSET " + std::to_string(offset) + "\r\n";
+      out += cmd;
+    }
+    return out;
+  }
+
+  // 旧实现的应用逻辑
+  void applyPerCommand(KeyValueStore &store, const std::string &stream)
+  {
+    RespParser parser;
+    const size_t chunk = 8 * 1024;
+    for (size_t pos = 0; pos < stream.size(); pos += chunk)
+    {
+      parser.append(std::string_view(stream).substr(pos, chunk));
+      while (auto v = parser.tryParseOne())
+      {
+        if (v->type != RespType::kArray || v->array.empty())
+          continue;
+        std::string cmd;
+        for (char c : v->array[0].bulk)
+          cmd.push_back(static_cast<char>(::toupper(c)));
+        auto &a = v->array;
+        if (cmd == "SET")
+          store.set(a[1].bulk, a[2].bulk);
+        else if (cmd == "DEL")
+        {
+          std::vector<std::string> keys;
+          for (size_t i = 1; i < a.size(); ++i)
+            keys.emplace_back(a[i].bulk);
+          store.del(keys);
+        }
+        else if (cmd == "EXPIRE")
+          store.expire(a[1].bulk, std::stoll(a[2].bulk));
+        else if (cmd == "HSET")
+          store.hset(a[1].bulk, a[2].bulk, a[3].bulk);
+        else if (cmd == "ZADD")
+          store.zadd(a[1].bulk, std::stod(a[2].bulk), a[3].bulk);
+      }
+    }
+  }
+
+  void applyBatched(KeyValueStore &store, const std::string &stream)
+  {
+    RespParser parser;
+    ReplApplier applier(store);
+    std::deque<RespCommand> batch;
+    const size_t chunk = 256 * 1024;
+    for (size_t pos = 0; pos < stream.size(); pos += chunk)
+    {
+      parser.append(std::string_view(stream).substr(pos, chunk));
+      size_t n = 0;
+      while (true)
+      {
+        std::string_view line;
+        ParseStatus st = parser.tryParseStatusLine(line);
+        if (st == ParseStatus::kIncomplete)
+          break;
+        if (st == ParseStatus::kOk)
+          continue;
+        if (n == batch.size())
+          batch.emplace_back();
+        if (parser.tryParseCommand(batch[n]) != ParseStatus::kOk)
+          break;
+        applier.add(batch[n++].args);
+      }
+      applier.flush();
+    }
+  }
+
+  template <typename Fn>
+  double run(const char *name, size_t n, size_t readers, Fn &&apply)
+  {
+    KeyValueStore store;
+    for (size_t i = 0; i < kKeys; ++i)
+      store.set("key:" + std::to_string(i), std::string(64, 'v'));
+    std::atomic<bool> stop{false};
+    std::atomic<uint64_t> reads{0};
+    std::vector<std::thread> ths;
+    for (size_t t = 0; t < readers; ++t)
+      ths.emplace_back([&, t]
+                       {
+        uint64_t local = 0;
+        size_t i = t * 12345;
+        while (!stop.load(std::memory_order_relaxed))
+        {
+          store.get("key:" + std::to_string(i++ % kKeys));
+          ++local;
+        }
+        reads += local; });
+    auto t0 = Clock::now();
+    apply(store);
+    double sec = std::chrono::duration<double>(Clock::now() - t0).count();
+    stop = true;
+    for (auto &th : ths)
+      th.join();
+    double ops = static_cast<double>(n) / sec;
+    std::printf("%-13s %10.0f ops/s  (%.3f s, keys=%zu, reader GET %.0f/s)\n", name, ops, sec, store.size(),
+                static_cast<double>(reads.load()) / sec);
+    return ops;
+  }
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+  size_t n = argc > 1 ? static_cast<size_t>(std::strtoull(argv[1], nullptr, 10)) : 2000000;
+  size_t readers = argc > 2 ? static_cast<size_t>(std::strtoull(argv[2], nullptr, 10)) : 0;
+  std::string stream = buildStream(n);
+  std::printf("commands=%zu  stream=%.1f MB  readers=%zu\n", n, static_cast<double>(stream.size()) / 1048576.0, readers);
+  double base = run("per-command", n, readers, [&](KeyValueStore &s)
+                    { applyPerCommand(s, stream); });
+  double batched = run("batched", n, readers, [&](KeyValueStore &s)
+                       { applyBatched(s, stream); });
+  std::printf("speedup %.2fx\n", batched / base);
+  return 0;
+}
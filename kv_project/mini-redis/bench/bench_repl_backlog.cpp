@@ -0,0 +1,119 @@
+/**
+ * 创建者：程序员老廖
+ * 日期：2025年8月12日
+ */
+
+// 复制积压缓冲基准：n 条 SET 命令写入 backlog 并投递给 r 个 replica 的发送队列，每 batch 条清空一次队列（模拟发送完成），
+// 报告每条命令的平均耗时。对照组在 bench 内复刻旧实现：4MB std::string backlog 写满后 erase(0, drop)，
+// 每个 replica 各自拷贝一份 +OFFSET 行与命令。两组都从空 backlog 开始，前 4MB 之后进入饱和状态。
+//
+// 用法：bench_repl_backlog [commands] [replicas] [value_bytes]
+
+#include "mini_redis/aof.hpp"
+#include "mini_redis/repl_backlog.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+using mini_redis::ReplBacklog;
+using mini_redis::ReplSpan;
+
+namespace
+{
+
+  using Clock = std::chrono::steady_clock;
+  const size_t kBacklogCap = 4 * 1024 * 1024;
+  const size_t kBatch = 64;
+
+  double nsPerOp(Clock::time_point t0, size_t n)
+  {
+    return static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - t0).count()) / static_cast<double>(n);
+  }
+
+  // 旧实现：string backlog + 每个 replica 一份拷贝
+  struct StringBacklog
+  {
+    std::string buf;
+    int64_t offset = 0;
+
+    void append(const std::string &data)
+    {
+      if (buf.size() + data.size() <= kBacklogCap)
+      {
+        buf.append(data);
+      }
+      else if (data.size() >= kBacklogCap)
+      {
+        buf.assign(data.data() + (data.size() - kBacklogCap), kBacklogCap);
+      }
+      else
+      {
+        buf.erase(0, (buf.size() + data.size()) - kBacklogCap);
+        buf.append(data);
+      }
+    }
+  };
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+  size_t n = argc > 1 ? static_cast<size_t>(std::strtoull(argv[1], nullptr, 10)) : 100000;
+  size_t replicas = argc > 2 ? static_cast<size_t>(std::strtoull(argv[2], nullptr, 10)) : 4;
+  size_t value_bytes = argc > 3 ? static_cast<size_t>(std::strtoull(argv[3], nullptr, 10)) : 64;
+
+  std::vector<std::string> cmds;
+  for (size_t i = 0; i < 1024; ++i)
+    cmds.push_back(mini_redis::toRespArray({std::string("SET"), "key:" + std::to_string(i), std::string(value_bytes, 'v')}));
+  std::printf("commands=%zu  replicas=%zu  cmd_bytes=%zu\n", n, replicas, cmds[0].size());
+
+  {
+    StringBacklog backlog;
+    std::vector<std::vector<std::string>> queues(replicas);
+    auto t0 = Clock::now();
+    for (size_t i = 0; i < n; ++i)
+    {
+      const std::string &cmd = cmds[i & 1023];
+      backlog.offset += static_cast<int64_t>(cmd.size());
+      backlog.append(cmd);
+      std::string off = "+OFFSET " + std::to_string(backlog.offset) + "\r\n";
+      for (auto &q : queues)
+      {
+        q.push_back(off);
+        q.push_back(cmd);
+      }
+      if (i % kBatch == kBatch - 1)
+        for (auto &q : queues)
+          q.clear();
+    }
+    std::printf("string+copy   %8.1f ns/cmd\n", nsPerOp(t0, n));
+  }
+
+  {
+    ReplBacklog backlog(kBacklogCap);
+    std::vector<std::vector<ReplSpan>> queues(replicas);
+    auto t0 = Clock::now();
+    for (size_t i = 0; i < n; ++i)
+    {
+      ReplSpan span{nullptr, backlog.append(cmds[i & 1023])};
+      if (replicas > 0)
+        span.block = backlog.tail();
+      // 与 server 的投递一致：同一块内首尾相接的数据合并为一段
+      for (auto &q : queues)
+      {
+        if (!q.empty() && q.back().block == span.block && q.back().bytes.data() + q.back().bytes.size() == span.bytes.data())
+          q.back().bytes = std::string_view(q.back().bytes.data(), q.back().bytes.size() + span.bytes.size());
+        else
+          q.push_back(span);
+      }
+      if (i % kBatch == kBatch - 1)
+        for (auto &q : queues)
+          q.clear();
+    }
+    std::printf("ring+shared   %8.1f ns/cmd  (histlen=%zu)\n", nsPerOp(t0, n), backlog.histLen());
+  }
+  return 0;
+}
@@ -0,0 +1,142 @@
+/**
+ * 创建者：程序员老廖
+ * 日期：2025年8月12日
+ */
+
+// RESP 解析基准：一次读到 N 条 pipeline 命令后逐条解析，
+// 对比旧实现（每条命令拷贝参数与原始字节、再 buffer.erase(0, pos)）与游标式零拷贝 tryParseCommand。
+//
+// 用法：bench_resp_parser [value_bytes] [total_cmds]
+
+#include "mini_redis/resp.hpp"
+
+#include <charconv>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+using mini_redis::ParseStatus;
+using mini_redis::RespCommand;
+using mini_redis::RespParser;
+
+namespace
+{
+
+  // 旧 RespParser::tryParseOneWithRaw 的等价实现，只保留客户端命令（bulk 数组）路径
+  class LegacyParser
+  {
+  public:
+    void append(std::string_view d) { buf_.append(d.data(), d.size()); }
+
+    bool next(std::vector<std::string> &args, std::string &raw)
+    {
+      size_t pos = 0;
+      int64_t n = 0;
+      if (buf_.empty() || buf_[pos++] != '*' || !readInt(pos, n))
+        return false;
+      args.clear();
+      for (int64_t i = 0; i < n; ++i)
+      {
+        int64_t len = 0;
+        if (pos >= buf_.size() || buf_[pos++] != '$' || !readInt(pos, len))
+          return false;
+        if (buf_.size() < pos + static_cast<size_t>(len) + 2)
+          return false;
+        args.emplace_back(buf_.data() + pos, static_cast<size_t>(len));
+        pos += static_cast<size_t>(len) + 2;
+      }
+      raw.assign(buf_.data(), pos);
+      buf_.erase(0, pos);
+      return true;
+    }
+
+  private:
+    bool readInt(size_t &pos, int64_t &v)
+    {
+      size_t e = buf_.find("\r\n", pos);
+      if (e == std::string::npos)
+        return false;
+      std::string line(buf_.data() + pos, e - pos);
+      std::from_chars(line.data(), line.data() + line.size(), v);
+      pos = e + 2;
+      return true;
+    }
+
+    std::string buf_;
+  };
+
+  std::string makePipeline(size_t depth, size_t value_bytes)
+  {
+    std::string value(value_bytes, 'v');
+    std::string out;
+    for (size_t i = 0; i < depth; ++i)
+    {
+      std::string key = "key:" + std::to_string(i);
+      out += "*3\r\n$3\r\nSET\r\n$" + std::to_string(key.size()) + "\r\n" + key + "\r\n$" +
+             std::to_string(value.size()) + "\r\n" + value + "\r\n";
+    }
+    return out;
+  }
+
+  template <typename F>
+  double nsPerCmd(size_t depth, size_t total, F &&round)
+  {
+    size_t rounds = total / depth > 0 ? total / depth : 1;
+    auto t0 = std::chrono::steady_clock::now();
+    size_t parsed = 0;
+    for (size_t i = 0; i < rounds; ++i)
+      parsed += round();
+    auto t1 = std::chrono::steady_clock::now();
+    if (parsed != rounds * depth)
+      std::fprintf(stderr, "parsed %zu, expected %zu\n", parsed, rounds * depth);
+    return static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0).count()) /
+           static_cast<double>(rounds * depth);
+  }
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+  size_t value_bytes = argc > 1 ? static_cast<size_t>(std::strtoull(argv[1], nullptr, 10)) : 32;
+  size_t total = argc > 2 ? static_cast<size_t>(std::strtoull(argv[2], nullptr, 10)) : 2000000;
+  std::printf("value_bytes=%zu total_cmds=%zu (SET key value)\n", value_bytes, total);
+  std::printf("%-10s %16s %16s %10s\n", "pipeline", "legacy(ns/cmd)", "cursor(ns/cmd)", "speedup");
+  const size_t depths[] = {1, 16, 256, 4096};
+  size_t sink = 0;
+  for (size_t depth : depths)
+  {
+    std::string input = makePipeline(depth, value_bytes);
+
+    LegacyParser legacy;
+    std::vector<std::string> args;
+    std::string raw;
+    double old_ns = nsPerCmd(depth, total, [&]
+                             {
+      legacy.append(input);
+      size_t n = 0;
+      while (legacy.next(args, raw))
+      {
+        sink += args[1].size() + raw.size();
+        ++n;
+      }
+      return n; });
+
+    RespParser parser;
+    RespCommand cmd;
+    double new_ns = nsPerCmd(depth, total, [&]
+                             {
+      parser.append(input);
+      size_t n = 0;
+      while (parser.tryParseCommand(cmd) == ParseStatus::kOk)
+      {
+        sink += cmd.args[1].size() + cmd.raw.size();
+        ++n;
+      }
+      return n; });
+
+    std::printf("%-10zu %16.1f %16.1f %9.1fx\n", depth, old_ns, new_ns, old_ns / new_ns);
+  }
+  return sink == 0 ? 1 : 0;
+}
@@ -0,0 +1,114 @@
+/**
+ * 创建者：程序员老廖
+ * 日期：2025年8月12日
+ */
+
+// 锁竞争基准：模拟 BGREWRITEAOF 的 snapshot() 与事件循环的 GET/SET 并发，
+// 对比单分片（等价于原来的全局锁）与多分片时 GET/SET 的尾延迟。
+//
+// 用法：bench_store_contention [keys] [ops]
+
+#include "mini_redis/kv.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+using mini_redis::KeyValueStore;
+
+namespace
+{
+
+  struct Result
+  {
+    double p50_us;
+    double p99_us;
+    double p999_us;
+    double max_us;
+    size_t snapshots;
+  };
+
+  double pct(std::vector<int64_t> &v, double p)
+  {
+    size_t idx = static_cast<size_t>(p * static_cast<double>(v.size() - 1));
+    std::nth_element(v.begin(), v.begin() + static_cast<long>(idx), v.end());
+    return static_cast<double>(v[idx]) / 1000.0;
+  }
+
+  Result runOnce(size_t shards, size_t keys, size_t ops, bool with_snapshot)
+  {
+    KeyValueStore store(shards);
+    for (size_t i = 0; i < keys; ++i)
+      store.set("key:" + std::to_string(i), "value:" + std::to_string(i));
+
+    std::atomic<bool> stop{false};
+    std::atomic<size_t> snapshots{0};
+    std::thread rewriter;
+    if (with_snapshot)
+    {
+      // 与 AofLogger::rewriterLoop 一样连续拷贝整个键空间
+      rewriter = std::thread([&]
+                             {
+        while (!stop.load(std::memory_order_relaxed))
+        {
+          auto s = store.snapshot();
+          auto h = store.snapshotHash();
+          auto z = store.snapshotZSet();
+          snapshots.fetch_add(1, std::memory_order_relaxed);
+        } });
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+
+    std::mt19937_64 rng(42);
+    std::vector<int64_t> lat;
+    lat.reserve(ops);
+    for (size_t i = 0; i < ops; ++i)
+    {
+      std::string k = "key:" + std::to_string(rng() % keys);
+      auto t0 = std::chrono::steady_clock::now();
+      if (i & 1)
+        store.set(k, "v");
+      else
+        (void)store.get(k);
+      auto t1 = std::chrono::steady_clock::now();
+      lat.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0).count());
+    }
+    stop.store(true);
+    if (rewriter.joinable())
+      rewriter.join();
+
+    Result r{};
+    r.p50_us = pct(lat, 0.50);
+    r.p99_us = pct(lat, 0.99);
+    r.p999_us = pct(lat, 0.999);
+    r.max_us = static_cast<double>(*std::max_element(lat.begin(), lat.end())) / 1000.0;
+    r.snapshots = snapshots.load();
+    return r;
+  }
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+  size_t keys = argc > 1 ? static_cast<size_t>(std::strtoull(argv[1], nullptr, 10)) : 1000000;
+  size_t ops = argc > 2 ? static_cast<size_t>(std::strtoull(argv[2], nullptr, 10)) : 2000000;
+  std::printf("keys=%zu ops=%zu (GET/SET 1:1)\n", keys, ops);
+  std::printf("%-8s %-10s %10s %10s %10s %12s %10s\n", "shards", "snapshot", "p50(us)", "p99(us)", "p99.9(us)", "max(us)", "snapshots");
+  const size_t shard_cfgs[] = {1, KeyValueStore::kDefaultShardCount};
+  for (size_t shards : shard_cfgs)
+  {
+    for (bool snap : {false, true})
+    {
+      Result r = runOnce(shards, keys, ops, snap);
+      std::printf("%-8zu %-10s %10.2f %10.2f %10.2f %12.2f %10zu\n", shards, snap ? "running" : "idle",
+                  r.p50_us, r.p99_us, r.p999_us, r.max_us, r.snapshots);
+    }
+  }
+  return 0;
+}
@@ -8,12 +8,16 @@
 #include <atomic>
 #include <optional>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <thread>
 #include <mutex>
 #include <condition_variable>
 #include <deque>
 #include <chrono>
+#include <functional>
+
+#include <sys/uio.h>
 
 #include "mini_redis/config.hpp"
 
@@ -22,68 +26,130 @@ namespace mini_redis
 
   class KeyValueStore;
 
+  // 多段 AOF 的清单（aof.dir/<filename>.manifest）：一个 base 加按追加顺序排列的增量段，最后一段是正在写入的段。
+  // base 是重写的结果（MRDB3 快照开头或纯命令），也可能是升级前的单文件 AOF；文件名均相对 aof.dir
+  struct AofManifest
+  {
+    std::string base;               // 空表示没有 base
+    std::vector<std::string> incrs; // <filename>.<n>.incr
+    int64_t next_seq = 1;           // 下一个新文件的编号
+  };
+
   class AofLogger
   {
   public:
     AofLogger();
     ~AofLogger();
 
+    // 读取清单并打开最后一个增量段继续追加；没有清单时把已有的单文件 AOF 作为 base 建立清单
     bool init(const AofOptions &opts, std::string &err);
     void shutdown();
 
     // Replay existing AOF into store. Returns true on success.
+    // 按清单依次回放 base 与各增量段。每条命令经命令表执行（与客户端写命令同一套 handler），不会再次追加到 AOF 或传播给 replica；
+    // 以 MRDB3 快照开头的文件（重写生成的 base）先加载快照再回放命令。
+    // 最后一段末尾不完整的命令被丢弃并截断文件；其余位置出现格式错误或残缺则加载失败。
+    // 回放前先清空 store，AOF 即全部数据；未知命令或参数不符使加载失败并报告其偏移。
+    // 类型冲突（惰性过期不记 DEL，已过期的 key 回放时可能还在）以命令为准覆盖旧 key，记 WARN 日志
     bool load(KeyValueStore &store, std::string &err);
 
     // Append a RESP array command like {"SET","k","v"}
+    // always 模式下等到该命令落盘才返回
     bool appendCommand(const std::vector<std::string> &parts);
 
     // Append raw RESP command bytes directly (as received), avoiding re-serialization
-    bool appendRaw(const std::string &raw_resp);
+    // 拷进追加缓冲即返回，不加锁、不等待；返回值是该命令在追加流中的结束偏移，单调递增，作为序号使用（AOF 未运行时为 0）。
+    // always 模式下 syncedSeq() 不小于该序号即已落盘：事件循环据此暂扣回复（组提交），复制线程等一整批追加完再 waitSynced 一次。
+    // 可多线程并发调用，流中的顺序即取得偏移的顺序；需要与执行顺序一致时由调用方的写锁保证
+    int64_t appendRaw(std::string_view raw_resp);
+
+    // 已 fdatasync 的最大序号（always 模式维护），可在任意线程无锁读取
+    int64_t syncedSeq() const { return synced_seq_.load(); }
+    // 阻塞到 seq 及之前的命令落盘；非 always 模式或 AOF 已停止时立即返回
+    void waitSynced(int64_t seq);
+    // always 模式下 writer 每推进一次 syncedSeq() 调用一次，运行在 writer 线程，应只做唤醒。
+    // writer 每次在锁内取一份当前回调，可在运行期间设置或以 nullptr 卸下；回调引用的对象要活到 shutdown() 之后再释放
+    void setSyncedCallback(std::function<void()> cb);
 
     bool isEnabled() const { return opts_.enabled; }
     AofMode mode() const { return opts_.mode; }
-    std::string path() const;
+    std::string path() const; // 清单文件路径
+    // 当前清单。除最后一个增量段外的文件都不再写入，可以直接拷走备份
+    AofManifest manifest() const;
 
     // Trigger background AOF rewrite (BGREWRITEAOF). Returns false if already running or AOF disabled.
-    bool bgRewrite(KeyValueStore &store, std::string &err);
+    // 重写线程持 snapshot_mu 拷贝一份一致快照，并在同一临界区内让 writer 切到新的增量段，之后的命令都落在新段里。
+    // 快照写成新的 base（use_rdb_preamble 时为 MRDB3，否则为每个 key 的最小命令集），
+    // 清单原子替换为新 base + 切换点之后的增量段，旧文件随后删除。writer 只在切段时停顿一次打开文件与写清单的时间。
+    // snapshot_mu 应为所有写命令执行并追加 AOF 时都持有的锁
+    bool bgRewrite(KeyValueStore &store, std::mutex &snapshot_mu, std::string &err);
+    bool rewriteInProgress() const { return rewriting_.load(); }
+    int64_t lastRewriteTimeMs() const { return last_rewrite_time_ms_.load(); } // 上次重写耗时，-1 表示尚未执行
 
   private:
-    int fd_ = -1;
+    // 回放时每次读取并批量应用的字节数。块内命令解析完立即执行，参数仍在缓存中；块再大反而因缓存失效变慢
+    static constexpr size_t kLoadChunkBytes = 64 * 1024;
+    // 追加缓冲：按字节偏移编址的分块环。偏移 off 落在第 off / kChunkBytes 块，占用槽位 (off / kChunkBytes) % kRingChunks。
+    // 块在首次写入时从池中取出（池空才分配），writer 写完整块后还回池里，稳态下不再分配内存
+    static constexpr size_t kChunkBytes = 256 * 1024;
+    static constexpr size_t kRingChunks = 1024; // 积压超过 256MB 尚未写入时，生产者等待 writer 腾出槽位
+    static constexpr size_t kPoolChunks = 16;   // 池中最多留这么多空闲块，多余的释放
+
+    int fd_ = -1;          // 当前增量段，init 之后只由 writer 线程切换
+    size_t seg_bytes_ = 0; // 当前增量段已写入的字节数
     AofOptions opts_;
     std::atomic<bool> running_{false};
     int timer_fd_ = -1; // used for everysec fsync
 
     // async writer
-    struct AofItem
-    {
-      std::string data;
-      int64_t seq;
-    };
+    // 生产者 fetch_add reserved_ 取得一段偏移，拷贝完后按偏移顺序推进 committed_；writer 写出 [consumed_, committed_)。
+    // mtx_ 只用于 writer 空闲时的睡眠/唤醒、切段请求与 cv_commit_，热路径上不加锁
+    std::atomic<char *> chunks_[kRingChunks] = {};
+    alignas(64) std::atomic<uint64_t> reserved_{0};
+    alignas(64) std::atomic<uint64_t> committed_{0};
+    alignas(64) std::atomic<uint64_t> consumed_{0}; // 只由 writer 推进；推进前先回收已写完的块
+    std::atomic<bool> writer_idle_{false};          // writer 即将在 cv_ 上睡眠，生产者此时才需要唤醒它
+    std::atomic<int> partial_{0};                   // 环满时分段发布、committed_ 停在命令中间的生产者数
+    std::mutex pool_mtx_;
+    std::vector<char *> pool_;
     std::thread writer_thread_;
     std::mutex mtx_;
     std::condition_variable cv_;
     std::condition_variable cv_commit_;
-    std::deque<AofItem> queue_;
+    std::deque<std::pair<uint64_t, int64_t>> rotations_; // 切段请求：写到该偏移后切到该编号的新段，受 mtx_ 保护
     std::atomic<bool> stop_{false};
-    size_t pending_bytes_ = 0;
     std::chrono::steady_clock::time_point last_sync_tp_{std::chrono::steady_clock::now()};
-    std::atomic<int64_t> seq_gen_{0};
-    int64_t last_synced_seq_ = 0;
+    std::atomic<int64_t> synced_seq_{0}; // 已刷盘的偏移，在 mtx_ 内推进，cv_commit_ 等待者与无锁读取者共用
+    std::function<void()> on_synced_;
+
+    // 清单：writer 切段与重写完成时修改，修改时先把新清单写盘再更新内存
+    mutable std::mutex manifest_mtx_;
+    std::condition_variable cv_manifest_;
+    AofManifest manifest_;
+    int64_t rotate_failed_seq_ = 0; // 重写请求的切段失败时记下段编号，重写线程据此放弃
 
     // BGREWRITEAOF state
     std::atomic<bool> rewriting_{false};
+    std::atomic<int64_t> last_rewrite_time_ms_{-1};
     std::thread rewriter_thread_;
-    std::mutex incr_mtx_;
-    std::vector<std::string> incr_cmds_;
-
-    // Pause writer to safely swap file descriptors
-    std::atomic<bool> pause_writer_{false};
-    std::mutex pause_mtx_;
-    std::condition_variable cv_pause_;
-    bool writer_is_paused_ = false;
 
     void writerLoop();
-    void rewriterLoop(KeyValueStore *store);
+    // 环中偏移 idx * kChunkBytes 起的块，没有时从池中取出并装入槽位
+    char *chunkFor(uint64_t idx);
+    // 把 [begin, end) 按块切成 iovec，最多 max_iov 段，返回实际覆盖到的结束偏移
+    uint64_t ringIov(uint64_t begin, uint64_t end, struct iovec *iov, int max_iov, int &iovcnt) const;
+    // writer 写完 [begin, end) 后回收其中的整块并发布 consumed_
+    void consumeRing(uint64_t begin, uint64_t end);
+    // 打开编号为 seq 的新增量段并写入清单，成功后关闭旧段。只在 init 与 writer 线程中调用
+    bool rotateSegment(int64_t seq);
+    bool loadManifest(bool &found, std::string &err);
+    bool writeManifest(const AofManifest &m, std::string &err) const;
+    bool loadFile(const std::string &name, KeyValueStore &store, bool last, size_t &commands, std::string &err);
+    std::string filePath(const std::string &name) const;
+    std::string segmentName(int64_t seq, const char *kind) const;
+    void rewriterLoop(KeyValueStore *store, std::mutex *snapshot_mu);
+    bool writeRdbPreamble(int wfd, const KeyValueStore &store, std::mutex &snapshot_mu, const std::function<bool()> &on_snapshot);
+    bool writeRespSnapshot(int wfd, const KeyValueStore &store, std::mutex &snapshot_mu, const std::function<bool()> &on_snapshot);
   };
 
   // helpers
@@ -0,0 +1,56 @@
+/**
+ * 创建者：程序员老廖
+ * 日期：2025年8月12日
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace mini_redis {
+
+class KeyValueStore;
+
+using CommandArgs = std::vector<std::string_view>;
+
+enum CommandFlag : uint32_t {
+  kCmdWrite = 1u << 0,       // 修改数据：执行期间持全局写锁，dirty 时写 AOF 并复制
+  kCmdReadonly = 1u << 1,
+  kCmdAdmin = 1u << 2,       // 持久化 / 配置 / 信息类
+  kCmdConnection = 1u << 3,  // 需要连接上下文（SYNC/PSYNC/REPLCONF/WAIT），由事件循环直接处理，handler 为空
+};
+
+struct CommandContext {
+  KeyValueStore& store;
+  bool dirty = false;  // handler 置位：本次确实修改了数据，需要传播到 AOF / replica
+};
+
+using CommandHandler = std::string (*)(CommandContext& ctx, const CommandArgs& args);
+
+struct CommandSpec {
+  const char* name;  // 大写
+  int arity;         // 与 Redis 相同：>0 为精确参数个数（含命令名），<0 为至少 -arity 个
+  uint32_t flags;
+  CommandHandler handler;
+};
+
+// 大小写不敏感的完美哈希查找，一次哈希 + 一次比较；未知命令返回 nullptr
+const CommandSpec* lookupCommand(std::string_view name);
+bool commandArityOk(const CommandSpec& spec, size_t argc);
+// 遍历全部命令（表顺序）
+const CommandSpec* commandTable(size_t& count);
+// 与 std::stoll 一样失败时抛异常，但要求整段都是数字（Redis 同样严格）
+int64_t parseInt64(std::string_view s);
+
+// 依赖服务端状态（RDB/AOF/复制）的命令，实现在 server.cpp
+std::string bgsaveCommand(CommandContext& ctx, const CommandArgs& args);
+std::string saveCommand(CommandContext& ctx, const CommandArgs& args);
+std::string bgrewriteaofCommand(CommandContext& ctx, const CommandArgs& args);
+std::string configCommand(CommandContext& ctx, const CommandArgs& args);
+std::string infoCommand(CommandContext& ctx, const CommandArgs& args);
+
+}  // namespace mini_redis
@@ -17,6 +17,12 @@ namespace mini_redis
     kAlways
   };
 
+  enum class IoBackend
+  {
+    kEpoll,
+    kIoUring
+  };
+
   struct AofOptions
   {
     bool enabled = false;
@@ -32,6 +38,9 @@ namespace mini_redis
     bool use_sync_file_range = false;         // 写入后触发后台回写（SFR_WRITE）
     size_t sfr_min_bytes = 512 * 1024;        // 达到该批量再调用 sync_file_range，避免过于频繁
     bool fadvise_dontneed_after_sync = false; // 每次 fdatasync 后对已同步范围做 DONTNEED
+    bool use_io_uring = false;                // writev+fdatasync 改为 io_uring 链式 WRITEV->FSYNC（由 io_backend 决定）
+    bool use_rdb_preamble = true;             // BGREWRITEAOF 生成的 base 为 MRDB3 快照，而不是每个 key 的命令
+    size_t segment_bytes = 64 * 1024 * 1024;  // 增量段写满该大小后切到新段，0 表示只在重写时切段
   };
 
   struct RdbOptions
@@ -39,6 +48,16 @@ namespace mini_redis
     bool enabled = true;
     std::string dir = "./data";
     std::string filename = "dump.rdb";
+    int load_threads = 0; // 启动时并行加载 RDB 的线程数，0 表示按 CPU 核数
+    bool compression = false; // 按块 LZ4 压缩记录区；全量同步发送的快照同样按此压缩
+  };
+
+  // 主库侧的复制参数
+  struct ReplicationOptions
+  {
+    bool diskless_sync = true;                  // 全量同步直接把快照流式写给 replica，不落盘
+    size_t diskless_buffer_bytes = 4 * 1024 * 1024; // 每个无盘同步在序列化线程与 socket 之间最多缓冲的字节数
+    size_t backlog_bytes = 4 * 1024 * 1024;         // 复制积压缓冲容量，决定断线多久内还能 PSYNC 续传；可用 CONFIG SET repl-backlog-size 调整
   };
 
   struct ReplicaOptions
@@ -52,8 +71,14 @@ namespace mini_redis
   {
     uint16_t port = 6379;
     std::string bind_address = "0.0.0.0";
+    int io_threads = 1; // reactor 线程数；>1 时每个线程各自 SO_REUSEPORT 监听
+    int io_offload_threads = 0; // 单 reactor 时的 I/O helper 线程数（read/解析/writev），0 表示关闭
+    IoBackend io_backend = IoBackend::kEpoll; // 事件后端；io_uring 不可用时启动阶段回退到 epoll
+    int active_expire_budget_us = 25000;     // 慢周期（200ms 定时器）主动过期的时间预算（微秒）
+    int active_expire_fast_budget_us = 1000; // 快周期（每次进入 epoll_wait 前）的时间预算（微秒）
     AofOptions aof;
     RdbOptions rdb;
+    ReplicationOptions repl;
     ReplicaOptions replica;
   };
 
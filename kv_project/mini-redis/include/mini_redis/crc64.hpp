@@ -0,0 +1,22 @@
+/**
+ * 创建者：程序员老廖
+ * 日期：2025年8月12日
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace mini_redis
+{
+
+  // CRC-64/Jones（与 Redis RDB 校验和相同：反射多项式 0x95ac9329ac4bc9b5，初值 0，无终值异或）。
+  // 采用 slice-by-8 查表，每次处理 8 字节；crc 传入上一段的结果即可分段计算
+  uint64_t crc64(uint64_t crc, const void *data, size_t len);
+
+  // 已知 crc(A) 与 crc(B)，求 crc(A || B)，len2 为 B 的字节数；
+  // 用于把文件切成若干段并行计算后合并（GF(2) 矩阵平方法，同 zlib 的 crc32_combine）
+  uint64_t crc64Combine(uint64_t crc1, uint64_t crc2, uint64_t len2);
+
+} // namespace mini_redis
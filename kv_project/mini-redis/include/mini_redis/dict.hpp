@@ -0,0 +1,386 @@
+/**
+ * 创建者：程序员老廖
+ * 日期：2025年8月12日
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <utility>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace mini_redis
+{
+
+  // 键为 std::string 的开放寻址哈希表，用于分片内的键空间。
+  // - 布局：每个槽一个控制字节（空 / 墓碑 / hash 低 7 位）加一个元素指针，16 个槽为一组，按组做三角探测，
+  //   组内用 SSE2 一次比较 16 个控制字节，只有 7 位标签命中才去读元素比较 key。
+  //   元素单独分配且不随 rehash 移动：槽数组每个槽只占 9 字节，负载可以放到 7/8，
+  //   迁移时也只搬指针；元素指针在该元素被删除前一直有效。
+  // - 扩容：Redis 式渐进 rehash。负载超过 7/8 时分配新表，此后每次插入/删除迁移旧表的一组，
+  //   rehashStep() 也可由空闲任务调用；查找期间同时查新旧两张表。不会出现一次搬迁全部元素的停顿。
+  // 非线程安全，由调用方加锁。
+  template <typename V>
+  class Dict
+  {
+  public:
+    Dict() = default;
+    ~Dict()
+    {
+      destroy(t_[0]);
+      destroy(t_[1]);
+    }
+    Dict(const Dict &) = delete;
+    Dict &operator=(const Dict &) = delete;
+
+    size_t size() const { return t_[0].used + t_[1].used; }
+    bool empty() const { return size() == 0; }
+    bool rehashing() const { return t_[1].cap != 0; }
+
+    V *find(std::string_view key)
+    {
+      return const_cast<V *>(static_cast<const Dict *>(this)->find(key));
+    }
+
+    const V *find(std::string_view key) const
+    {
+      if (empty())
+        return nullptr;
+      size_t h = hashOf(key);
+      for (const Table &t : t_)
+      {
+        size_t i = findIn(t, key, h);
+        if (i != kNpos)
+          return &t.slots[i]->value;
+      }
+      return nullptr;
+    }
+
+    bool contains(std::string_view key) const { return find(key) != nullptr; }
+
+    // 不存在时插入默认构造的 V；返回 {元素指针, 是否新插入}
+    std::pair<V *, bool> tryEmplace(std::string_view key)
+    {
+      size_t h = hashOf(key);
+      for (Table &t : t_)
+      {
+        size_t i = findIn(t, key, h);
+        if (i != kNpos)
+          return {&t.slots[i]->value, false};
+      }
+      if (rehashing())
+      {
+        rehashStep(1);
+        // 新表的容量足以容纳迁移期间的插入，这里只是兜底
+        if (rehashing() && overloaded(t_[1]))
+          rehashStep(static_cast<size_t>(-1));
+      }
+      if (!rehashing() && overloaded(t_[0]))
+        startRehash();
+      Table &t = rehashing() ? t_[1] : t_[0];
+      size_t i = findFree(t, h);
+      t.slots[i] = new Node{std::string(key), V()};
+      occupy(t, i, h);
+      return {&t.slots[i]->value, true};
+    }
+
+    V &operator[](std::string_view key) { return *tryEmplace(key).first; }
+
+    bool erase(std::string_view key)
+    {
+      return eraseWith(key, [](V &) {});
+    }
+
+    // 删除 key，销毁前以 fn(V &) 回调一次该元素（例如检查是否已过期）；返回是否找到并删除
+    template <typename F>
+    bool eraseWith(std::string_view key, F &&fn)
+    {
+      if (empty())
+        return false;
+      size_t h = hashOf(key);
+      bool removed = false;
+      for (Table &t : t_)
+      {
+        size_t i = findIn(t, key, h);
+        if (i != kNpos)
+        {
+          fn(t.slots[i]->value);
+          eraseAt(t, i);
+          removed = true;
+          break;
+        }
+      }
+      if (rehashing())
+        rehashStep(1);
+      return removed;
+    }
+
+    void clear()
+    {
+      destroy(t_[0]);
+      destroy(t_[1]);
+      rehash_pos_ = 0;
+    }
+
+    // fn(const std::string &key, const V &value)
+    template <typename F>
+    void forEach(F &&fn) const
+    {
+      for (const Table &t : t_)
+      {
+        for (size_t i = 0; i < t.cap; ++i)
+        {
+          if (t.ctrl[i] >= 0)
+            fn(t.slots[i]->key, t.slots[i]->value);
+        }
+      }
+    }
+
+    size_t slotCount() const { return t_[0].cap + t_[1].cap; }
+
+    // 预分配到可容纳 n 个元素而不触发扩容（批量加载前调用）。
+    // 表非空时一次性迁移全部元素，只应在没有延迟要求的场合使用
+    void reserve(size_t n)
+    {
+      size_t cap = kGroup;
+      while (n * 8 > cap * 7)
+        cap *= 2;
+      if (rehashing())
+        rehashStep(static_cast<size_t>(-1));
+      if (cap <= t_[0].cap)
+        return;
+      if (empty())
+      {
+        destroy(t_[0]);
+        allocate(t_[0], cap);
+        return;
+      }
+      allocate(t_[1], cap);
+      rehash_pos_ = 0;
+      rehashStep(static_cast<size_t>(-1));
+    }
+
+    // 迁移旧表的 groups 个分组；rehash 完成后新表替换旧表
+    void rehashStep(size_t groups)
+    {
+      while (groups-- > 0 && rehashing())
+      {
+        Table &from = t_[0];
+        if (rehash_pos_ < from.groups())
+        {
+          size_t base = rehash_pos_ * kGroup;
+          for (uint32_t m = matchFull(from.ctrl + base); m; m &= m - 1)
+          {
+            size_t i = base + lowestBit(m);
+            Node *node = from.slots[i];
+            size_t h = hashOf(node->key);
+            size_t j = findFree(t_[1], h);
+            t_[1].slots[j] = node;
+            occupy(t_[1], j, h);
+            // 旧表仍在被查找，必须保留探测链，因此写墓碑而不是空
+            from.ctrl[i] = kDeleted;
+            --from.used;
+            ++from.deleted;
+          }
+          ++rehash_pos_;
+        }
+        if (rehash_pos_ >= from.groups())
+        {
+          destroy(t_[0]);
+          t_[0] = t_[1];
+          t_[1] = Table{};
+          rehash_pos_ = 0;
+        }
+      }
+    }
+
+    // 槽数组、控制字节与元素节点占用的字节数（不含 key/value 自身的堆内存）
+    size_t memoryUsage() const
+    {
+      return slotCount() * (sizeof(Node *) + 1) + size() * sizeof(Node);
+    }
+
+  private:
+    static constexpr size_t kGroup = 16;
+    static constexpr size_t kNpos = static_cast<size_t>(-1);
+    // 满槽的控制字节为 hash 低 7 位（0..127），空槽与墓碑为负数
+    static constexpr int8_t kEmpty = -128;
+    static constexpr int8_t kDeleted = -2;
+
+    struct Node
+    {
+      std::string key;
+      V value;
+    };
+
+    struct Table
+    {
+      int8_t *ctrl = nullptr;
+      Node **slots = nullptr;
+      size_t cap = 0; // 槽数：kGroup 乘以 2 的幂
+      size_t used = 0;
+      size_t deleted = 0;
+      size_t groups() const { return cap / kGroup; }
+    };
+
+    static size_t hashOf(std::string_view key) { return std::hash<std::string_view>{}(key); }
+    static int8_t tagOf(size_t h) { return static_cast<int8_t>(h & 0x7F); }
+
+    static size_t lowestBit(uint32_t m) { return static_cast<size_t>(__builtin_ctz(m)); }
+
+    static uint32_t matchByte(const int8_t *g, int8_t b)
+    {
+#if defined(__SSE2__)
+      __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i *>(g));
+      return static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(c, _mm_set1_epi8(b))));
+#else
+      uint32_t m = 0;
+      for (size_t i = 0; i < kGroup; ++i)
+      {
+        if (g[i] == b)
+          m |= 1u << i;
+      }
+      return m;
+#endif
+    }
+
+    // 空槽或墓碑（符号位为 1）
+    static uint32_t matchFree(const int8_t *g)
+    {
+#if defined(__SSE2__)
+      return static_cast<uint32_t>(_mm_movemask_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(g))));
+#else
+      uint32_t m = 0;
+      for (size_t i = 0; i < kGroup; ++i)
+      {
+        if (g[i] < 0)
+          m |= 1u << i;
+      }
+      return m;
+#endif
+    }
+
+    static uint32_t matchFull(const int8_t *g) { return ~matchFree(g) & 0xFFFFu; }
+
+    // 负载（含墓碑）超过 7/8 视为过载
+    static bool overloaded(const Table &t)
+    {
+      return (t.used + t.deleted + 1) * 8 > t.cap * 7;
+    }
+
+    static size_t findIn(const Table &t, std::string_view key, size_t h)
+    {
+      if (t.used == 0)
+        return kNpos;
+      size_t mask = t.groups() - 1;
+      size_t g = (h >> 7) & mask;
+      int8_t tag = tagOf(h);
+      // 三角探测：组数为 2 的幂时可以遍历所有分组
+      for (size_t step = 1; step <= t.groups(); ++step)
+      {
+        const int8_t *ctrl = t.ctrl + g * kGroup;
+        for (uint32_t m = matchByte(ctrl, tag); m; m &= m - 1)
+        {
+          size_t i = g * kGroup + lowestBit(m);
+          if (t.slots[i]->key == key)
+            return i;
+        }
+        if (matchByte(ctrl, kEmpty))
+          return kNpos;
+        g = (g + step) & mask;
+      }
+      return kNpos;
+    }
+
+    // 调用方保证 key 不存在且表未满
+    static size_t findFree(const Table &t, size_t h)
+    {
+      size_t mask = t.groups() - 1;
+      size_t g = (h >> 7) & mask;
+      for (size_t step = 1;; ++step)
+      {
+        uint32_t m = matchFree(t.ctrl + g * kGroup);
+        if (m)
+          return g * kGroup + lowestBit(m);
+        g = (g + step) & mask;
+      }
+    }
+
+    static void occupy(Table &t, size_t i, size_t h)
+    {
+      if (t.ctrl[i] == kDeleted)
+        --t.deleted;
+      t.ctrl[i] = tagOf(h);
+      ++t.used;
+    }
+
+    static void eraseAt(Table &t, size_t i)
+    {
+      delete t.slots[i];
+      --t.used;
+      // 所在组里已有空槽时，任何探测都会停在这一组，可以直接置空而不留墓碑
+      size_t base = i - i % kGroup;
+      if (matchByte(t.ctrl + base, kEmpty))
+      {
+        t.ctrl[i] = kEmpty;
+      }
+      else
+      {
+        t.ctrl[i] = kDeleted;
+        ++t.deleted;
+      }
+    }
+
+    static void allocate(Table &t, size_t cap)
+    {
+      t.cap = cap;
+      t.used = 0;
+      t.deleted = 0;
+      t.ctrl = new int8_t[cap];
+      std::memset(t.ctrl, kEmpty, cap);
+      t.slots = new Node *[cap];
+    }
+
+    static void destroy(Table &t)
+    {
+      if (t.cap == 0)
+        return;
+      for (size_t i = 0; i < t.cap; ++i)
+      {
+        if (t.ctrl[i] >= 0)
+          delete t.slots[i];
+      }
+      delete[] t.ctrl;
+      delete[] t.slots;
+      t = Table{};
+    }
+
+    // 活跃元素超过一半时翻倍，否则同容量重建以清理墓碑。
+    // 迁移期间每次插入至少迁移一组，旧表迁完前新表最多再进 groups 个元素，负载仍低于 7/8。
+    void startRehash()
+    {
+      Table &t = t_[0];
+      size_t cap = t.cap == 0 ? kGroup : (t.used * 2 >= t.cap ? t.cap * 2 : t.cap);
+      if (t.used == 0)
+      {
+        destroy(t);
+        allocate(t, cap);
+        return;
+      }
+      allocate(t_[1], cap);
+      rehash_pos_ = 0;
+    }
+
+    Table t_[2];
+    size_t rehash_pos_ = 0; // 旧表 t_[0] 中下一个待迁移的分组
+  };
+
+} // namespace mini_redis
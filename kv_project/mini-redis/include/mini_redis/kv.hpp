@@ -5,26 +5,67 @@
 
 #pragma once
 
+#include "mini_redis/dict.hpp"
+
 #include <cstdint>
+#include <functional>
 #include <optional>
+#include <stdexcept>
 #include <string>
+#include <string_view>
 #include <unordered_map>
 #include <vector>
 #include <mutex>
 #include <memory>
+#include <atomic>
 
 namespace mini_redis
 {
 
+  enum class ObjectType : uint8_t
+  {
+    kNone = 0, // key 不存在
+    kString = 1,
+    kHash = 2,
+    kZSet = 3
+  };
+
+  // TYPE 命令的返回值："none" / "string" / "hash" / "zset"
+  const char *objectTypeName(ObjectType t);
+
+  // 主动过期周期：慢周期由定时器驱动；快周期在事件循环每次进入等待前尝试，
+  // 只在上一周期耗尽预算或堆积比例偏高时真正执行
+  enum class ExpireCycle
+  {
+    kSlow,
+    kFast
+  };
+
+  struct ExpireStats
+  {
+    uint64_t expired_keys = 0;  // 累计删除的过期 key（访问时惰性删除 + 主动过期）
+    uint64_t cycle_cpu_us = 0;  // 主动过期周期累计耗时（微秒）
+    double stale_ratio = 0;     // 估计的"已到期但尚未回收"占带 TTL key 的比例（平滑值）
+  };
+
+  // key 存在但类型与命令不符时由 KeyValueStore 抛出，命令分发层统一转换为 WRONGTYPE 错误
+  class WrongTypeError : public std::runtime_error
+  {
+  public:
+    WrongTypeError() : std::runtime_error("WRONGTYPE Operation against a key holding the wrong kind of value") {}
+  };
+
   struct ValueRecord
   {
     std::string value;
     int64_t expire_at_ms = -1; // -1 means no expiration
   };
 
+  using HashFields = std::unordered_map<std::string, std::string>;
+
   struct HashRecord
   {
-    std::unordered_map<std::string, std::string> fields;
+    HashFields fields;
     int64_t expire_at_ms = -1;
   };
 
@@ -34,6 +75,8 @@ namespace mini_redis
   {
     Skiplist();
     ~Skiplist();
+    Skiplist(const Skiplist &) = delete;
+    Skiplist &operator=(const Skiplist &) = delete;
     bool insert(double score, const std::string &member);
     bool erase(double score, const std::string &member);
     void rangeByRank(int64_t start, int64_t stop, std::vector<std::string> &out) const;
@@ -49,28 +92,50 @@ namespace mini_redis
     size_t length_;
   };
 
+  // 大 zset 的编码：跳表按 (score, member) 有序，member_to_score 按成员查分数。
+  // 元素不多时不用它，直接以有序数组内联在键空间对象里（见 KeyValueStore::Object）
   struct ZSetRecord
   {
-    // 小集合使用 vector；超过阈值转为 skiplist
-    bool use_skiplist = false;
-    std::vector<std::pair<double, std::string>> items; // 当 use_skiplist=false 使用
-    std::unique_ptr<Skiplist> sl;                      // 当 use_skiplist=true 使用
+    Skiplist sl;
     std::unordered_map<std::string, double> member_to_score;
-    int64_t expire_at_ms = -1;
   };
 
   class KeyValueStore
   {
   public:
-    bool set(const std::string &key, const std::string &value, std::optional<int64_t> ttl_ms = std::nullopt);
-    bool setWithExpireAtMs(const std::string &key, const std::string &value, int64_t expire_at_ms);
+    // 键空间按 key 的哈希拆分为 N 个分片，每个分片独立加锁；
+    // 快照/遍历类接口逐个分片加锁，避免长时间占用整个键空间
+    static constexpr size_t kDefaultShardCount = 16;
+    explicit KeyValueStore(size_t shard_count = kDefaultShardCount);
+    ~KeyValueStore();
+    KeyValueStore(const KeyValueStore &) = delete;
+    KeyValueStore &operator=(const KeyValueStore &) = delete;
+
+    // 以下接口作用于类型不符的 key 时抛出 WrongTypeError；SET 会覆盖任意类型，DEL/EXISTS/EXPIRE/TTL 不区分类型
+    // value 按值传入并移动进对象，调用方传临时串时省一次拷贝
+    bool set(const std::string &key, std::string value, std::optional<int64_t> ttl_ms = std::nullopt);
+    bool setWithExpireAtMs(const std::string &key, std::string value, int64_t expire_at_ms);
     std::optional<std::string> get(const std::string &key);
     int del(const std::vector<std::string> &keys);
     bool exists(const std::string &key);
     bool expire(const std::string &key, int64_t ttl_seconds);
     int64_t ttl(const std::string &key);
-    size_t size() const { return map_.size(); }
-    int expireScanStep(int max_steps);
+    ObjectType type(const std::string &key);
+    void flushAll();
+    // 预估将有 keys 个 key（如 RDB 加载前），提前把各分片的哈希表扩到位，避免加载过程中反复扩容
+    void reserve(size_t keys);
+    size_t size() const; // number of keys (all types)
+    size_t shardCount() const { return shard_count_; }
+    size_t shardIndex(std::string_view key) const;
+    // 当前线程持有第 shard 个分片的锁执行 fn，fn 内对该分片 key 的单 key 接口不再重复加锁，
+    // 连续多条命令落在同一分片时只加一次锁（复制流批量应用）。fn 内不得访问其他分片，也不得调用 size()/flushAll() 等全库接口
+    void withShardLocked(size_t shard, const std::function<void()> &fn);
+    // 主动过期：按到期时间从各分片的最小堆中回收已到期的 key，只要还有分片堆顶已到期就继续，
+    // 耗时超过 budget_us 即返回；返回本次删除的 key 数。到期 key 只会被弹出一次，代价为 O(到期数 * log n)。
+    // kFast 在上一周期未超时且 stale_ratio 低于阈值时直接返回，两次快周期间隔至少 2 * budget_us
+    int activeExpireCycle(ExpireCycle type, int64_t budget_us);
+    size_t volatileKeys() const; // 带 TTL 的 key 数
+    ExpireStats expireStats() const;
     std::vector<std::pair<std::string, ValueRecord>> snapshot() const;
     std::vector<std::pair<std::string, HashRecord>> snapshotHash() const;
     struct ZSetFlat
@@ -80,7 +145,7 @@ namespace mini_redis
       int64_t expire_at_ms;
     };
     std::vector<ZSetFlat> snapshotZSet() const;
-    std::vector<std::string> listKeys() const; // union of string/hash/zset keys (unique)
+    std::vector<std::string> listKeys() const; // all keys, unordered
 
     // Hash APIs
     // returns 1 if new field created, 0 if overwritten
@@ -104,25 +169,120 @@ namespace mini_redis
     bool setZSetExpireAtMs(const std::string &key, int64_t expire_at_ms);
 
   private:
+    // 小 hash 的紧凑编码：按插入顺序的 (field, value) 数组，线性查找
+    using HashPairs = std::vector<std::pair<std::string, std::string>>;
+    // 小 zset 的紧凑编码：按 (score, member) 有序的数组，按成员线性查找
+    using ZSetPairs = std::vector<std::pair<double, std::string>>;
+
+    // 键空间中的值对象。类型标签、编码与过期时间打包在一个 64 位字里，对象本身 40 字节，与原来的 ValueRecord 一样大。
+    // 字符串值内联；hash / zset 元素不超过 kCompactMaxEntries 时以紧凑数组内联（与 Redis 的 listpack 编码同理），
+    // 只有数组本身一次分配，超过后转为单独分配的 HashFields / ZSetRecord，之后不再转回
+    class Object
+    {
+    public:
+      Object() : meta_(pack(ObjectType::kString, -1)), str_() {}
+      ~Object() { release(); }
+      Object(Object &&o) noexcept;
+      Object &operator=(Object &&o) noexcept;
+      Object(const Object &) = delete;
+      Object &operator=(const Object &) = delete;
+
+      ObjectType type() const { return static_cast<ObjectType>(meta_ & 3u); }
+      // hash / zset 是否为紧凑编码；字符串总是 true
+      bool compact() const { return (meta_ & 4u) == 0; }
+      int64_t expireAt() const { return static_cast<int64_t>(meta_ >> 3) - 1; }
+      void setExpireAt(int64_t ms) { meta_ = pack(type(), ms) | (meta_ & 4u); }
+      bool expired(int64_t now_ms) const
+      {
+        int64_t at = expireAt();
+        return at >= 0 && now_ms >= at;
+      }
+
+      std::string &str() { return str_; }
+      const std::string &str() const { return str_; }
+      // 按编码取 hash / zset 的内容，调用方先看 compact()
+      HashPairs &hashPairs() { return hpairs_; }
+      const HashPairs &hashPairs() const { return hpairs_; }
+      HashFields &hash() { return *hash_; }
+      const HashFields &hash() const { return *hash_; }
+      ZSetPairs &zsetPairs() { return zpairs_; }
+      const ZSetPairs &zsetPairs() const { return zpairs_; }
+      ZSetRecord &zset() { return *zset_; }
+      const ZSetRecord &zset() const { return *zset_; }
+
+      // 替换为给定类型的空对象（hash / zset 为紧凑编码），过期时间清除
+      void reset(ObjectType t);
+      // 紧凑编码的 hash / zset 转为 HashFields / ZSetRecord，过期时间不变
+      void convert();
+
+    private:
+      static uint64_t pack(ObjectType t, int64_t expire_at_ms)
+      {
+        return (static_cast<uint64_t>(expire_at_ms + 1) << 3) | static_cast<uint64_t>(t);
+      }
+      void release();
+
+      uint64_t meta_; // (expire_at_ms + 1) << 3 | 非紧凑编码 << 2 | type
+      union
+      {
+        std::string str_;
+        HashPairs hpairs_;
+        HashFields *hash_;
+        ZSetPairs zpairs_;
+        ZSetRecord *zset_;
+      };
+    };
+
+    // 过期堆中的一项。TTL 被修改或 key 被删除时不去堆里删除旧项（惰性失效），
+    // 弹出时与对象当前的 expireAt() 比对，不一致即为过期作废的旧项
+    struct ExpireEntry
+    {
+      int64_t when;
+      std::string key;
+    };
+    // std::*_heap 默认是最大堆，比较取反得到按 when 升序的最小堆
+    struct ExpireLater
+    {
+      bool operator()(const ExpireEntry &a, const ExpireEntry &b) const { return a.when > b.when; }
+    };
+
+    struct alignas(64) Shard
+    {
+      // 每个 key 只在 keys_ 中出现一次（开放寻址 + 渐进 rehash，见 dict.hpp）
+      Dict<Object> keys_;
+      // 以 when 为序的最小堆（见 ExpireLater）
+      std::vector<ExpireEntry> expire_heap_;
+      size_t volatile_keys_ = 0; // keys_ 中带 TTL 的对象数，用于判断何时压缩堆中的作废项
+      uint64_t expired_keys_ = 0; // 本分片删除的过期 key 累计数
+      mutable std::mutex mu_;
+    };
+
+    // 单 key 接口的分片锁：当前线程已在 withShardLocked() 中持有该分片时不再加锁
+    class ShardLock;
+
+    Shard &shardFor(const std::string &key) const;
     static int64_t nowMs();
-    static bool isExpired(const ValueRecord &r, int64_t now_ms);
-    static bool isExpired(const HashRecord &r, int64_t now_ms);
-    static bool isExpired(const ZSetRecord &r, int64_t now_ms);
-    void cleanupIfExpired(const std::string &key, int64_t now_ms);
-    void cleanupIfExpiredHash(const std::string &key, int64_t now_ms);
-    void cleanupIfExpiredZSet(const std::string &key, int64_t now_ms);
-    static constexpr size_t kZsetVectorThreshold = 128;
+    // 查找未过期的对象；已过期的顺手删除并返回 nullptr
+    static Object *lookup(Shard &sh, const std::string &key, int64_t now_ms);
+    // 同 lookup，但要求类型为 t，不符时抛 WrongTypeError
+    static Object *lookupTyped(Shard &sh, const std::string &key, ObjectType t, int64_t now_ms);
+    // 取得类型为 t 的对象，不存在（或已过期）时创建空对象；只做一次哈希查找
+    static Object &obtain(Shard &sh, const std::string &key, ObjectType t, int64_t now_ms);
+    static void setExpire(Shard &sh, const std::string &key, Object &o, int64_t expire_at_ms);
+    // 对象的过期时间从 old_at 变为 new_at（-1 表示无 TTL / 对象被删除）时维护计数与过期堆
+    static void trackExpire(Shard &sh, const std::string &key, int64_t old_at, int64_t new_at);
+    static void compactExpireHeap(Shard &sh);
+    // 紧凑编码的元素上限，与 Redis hash-max-listpack-entries / zset-max-listpack-entries 的默认值相同
+    static constexpr size_t kCompactMaxEntries = 128;
 
   private:
-    std::unordered_map<std::string, ValueRecord> map_;
-    std::unordered_map<std::string, ValueRecord>::iterator scan_it_ = map_.end();
-    std::unordered_map<std::string, HashRecord> hmap_;
-    std::unordered_map<std::string, HashRecord>::iterator hscan_it_ = hmap_.end();
-    std::unordered_map<std::string, ZSetRecord> zmap_;
-    std::unordered_map<std::string, ZSetRecord>::iterator zscan_it_ = zmap_.end();
-    // Unified expire index for active expiration sampling
-    std::unordered_map<std::string, int64_t> expire_index_;
-    mutable std::mutex mu_;
+    size_t shard_count_;
+    std::unique_ptr<Shard[]> shards_;
+    std::atomic<size_t> expire_cursor_{0}; // 主动过期轮转到的起始分片
+    std::atomic<uint64_t> expire_cpu_us_{0};
+    std::atomic<int64_t> last_fast_cycle_us_{0};
+    std::atomic<bool> expire_timed_out_{false}; // 上一周期因预算耗尽返回，仍有到期 key 未回收
+    std::atomic<double> stale_ratio_{0};
   };
 
 } // namespace mini_redis
@@ -0,0 +1,25 @@
+/**
+ * 创建者：程序员老廖
+ * 日期：2025年8月12日
+ */
+
+#pragma once
+
+#include <cstddef>
+
+namespace mini_redis
+{
+
+  // LZ4 块格式的内置实现（不含帧格式），输出与 liblz4 的 LZ4_compress_default / LZ4_decompress_safe 互通。
+  // 单遍贪心匹配：4 字节哈希表、64KB 窗口，足以应对 RDB 中大量重复的 key 前缀与 JSON 值
+
+  // src 长度为 n 时压缩结果的最大长度
+  size_t lz4CompressBound(size_t n);
+
+  // 压缩 src[0, n) 到 dst，dst 至少要有 lz4CompressBound(n) 字节；返回压缩后的长度
+  size_t lz4Compress(const char *src, size_t n, char *dst);
+
+  // 解压到 dst，解压结果必须恰好是 raw_len 字节；输入损坏或任何越界都返回 false
+  bool lz4Decompress(const char *src, size_t n, char *dst, size_t raw_len);
+
+} // namespace mini_redis
@@ -5,28 +5,141 @@
 
 #pragma once
 
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <mutex>
 #include <string>
+#include <thread>
+#include <utility>
+#include <vector>
 
 #include "mini_redis/config.hpp"
+#include "mini_redis/kv.hpp"
 
 namespace mini_redis
 {
 
-  class KeyValueStore;
+  // 最近一次保存的压缩统计；未开启压缩时各项为 0
+  struct RdbCompressStats
+  {
+    uint64_t raw_bytes = 0;    // 记录区序列化后的字节数
+    uint64_t stored_bytes = 0; // 记录区压缩后实际写入文件的字节数
+    int64_t compress_us = 0;   // 压缩线程累计耗时
+  };
+
+  // replica 的复制位置：与快照对应的主库 run id 与复制偏移，保存在 RDB 旁边（path().repl），重启后据此 PSYNC 续传。
+  // offset < 0 表示未知（例如全量同步加载中途），此时不留位置文件
+  struct ReplPosition
+  {
+    std::string run_id;
+    int64_t offset = -1;
+  };
+
+  class RdbWriter;
 
   class Rdb
   {
   public:
+    // 字节流的接收方，返回 false 表示中止
+    using Sink = std::function<bool(const char *data, size_t len)>;
+
     Rdb() = default;
     explicit Rdb(const RdbOptions &opts) : opts_(opts) {}
+    ~Rdb();
+    Rdb(const Rdb &) = delete;
+    Rdb &operator=(const Rdb &) = delete;
     void setOptions(const RdbOptions &opts) { opts_ = opts; }
 
-    bool save(const KeyValueStore &store, std::string &err) const;
+    // 同步保存（SAVE）：在调用线程完成快照与写盘；已有保存在进行时失败
+    bool save(const KeyValueStore &store, std::string &err);
+    // 后台保存（BGSAVE）：立即返回，工作线程先持 snapshot_mu 拷贝一份一致快照（只做内存拷贝），
+    // 释放锁后再序列化、写临时文件、fsync 并 rename 覆盖正式文件。
+    // snapshot_mu 应为所有写命令都持有的锁，这样快照对应写入流上的某一个时刻
+    bool bgSave(const KeyValueStore &store, std::mutex &snapshot_mu, std::string &err);
+    // 无盘全量同步：持 snapshot_mu 调用 on_snapshot（调用方在锁内登记复制状态，返回 false 表示放弃）并拷贝快照，
+    // 释放锁后把 MRDB3 字节流分段交给 sink，不落盘。记录区总是分帧，接收端可以用 RdbStreamLoader 边收边解析
+    bool streamSnapshot(const KeyValueStore &store, std::mutex &snapshot_mu, const std::function<bool()> &on_snapshot,
+                        const Sink &sink, std::string &err) const;
     bool load(KeyValueStore &store, std::string &err) const;
     std::string path() const;
 
+    // replica 设置：每次 save()/bgSave() 在拷贝快照的同一临界区内取复制位置，RDB rename 之后写入 path().repl
+    void setReplPositionSource(std::function<ReplPosition()> fn) { repl_source_ = std::move(fn); }
+    // 读取与当前 RDB 文件配套的复制位置；文件缺失、格式不对或与 RDB 大小不符（RDB 已被别的保存覆盖）时返回 false
+    bool loadReplPosition(ReplPosition &pos) const;
+
+    bool bgSaveInProgress() const { return saving_.load(); }
+    int64_t lastBgSaveTimeMs() const { return last_bgsave_time_ms_.load(); } // 上次后台保存耗时，-1 表示尚未执行
+    bool lastBgSaveOk() const { return last_bgsave_ok_.load(); }
+    bool compressionEnabled() const { return opts_.compression; }
+    RdbCompressStats lastCompressStats() const;
+
   private:
+    struct Snapshot
+    {
+      std::vector<std::pair<std::string, ValueRecord>> strs;
+      std::vector<std::pair<std::string, HashRecord>> hashes;
+      std::vector<KeyValueStore::ZSetFlat> zsets;
+      bool has_repl = false; // 设置了 repl_source_ 时为 true，repl 为快照时刻的复制位置
+      ReplPosition repl;
+    };
+    Snapshot takeSnapshotLocked(const KeyValueStore &store) const; // takeSnapshot + 复制位置，调用方持快照锁
+    bool writeReplPosition(const ReplPosition &pos, uint64_t rdb_bytes, std::string &err) const;
+    static Snapshot takeSnapshot(const KeyValueStore &store);
+    // 写入 path().tmp 后 rename，保存中途失败或崩溃不会破坏上一份 RDB
+    bool writeSnapshot(const Snapshot &snap, RdbCompressStats &stats, std::string &err) const;
+    static bool encodeSnapshot(RdbWriter &w, const Snapshot &snap, bool framed, bool compress, RdbCompressStats &stats);
+    void setCompressStats(const RdbCompressStats &stats);
+    void bgSaveLoop(const KeyValueStore *store, std::mutex *snapshot_mu);
+
     RdbOptions opts_{};
+    std::function<ReplPosition()> repl_source_;
+    std::atomic<bool> saving_{false};
+    std::thread saver_thread_;
+    std::atomic<int64_t> last_bgsave_time_ms_{-1};
+    std::atomic<bool> last_bgsave_ok_{true};
+    std::atomic<uint64_t> last_raw_bytes_{0};
+    std::atomic<uint64_t> last_stored_bytes_{0};
+    std::atomic<int64_t> last_compress_us_{0};
+  };
+
+  // 增量解析 MRDB3 字节流（replica 接收全量同步时使用，不需要临时文件）：
+  // feed() 接受任意切分的数据，凑齐一帧或若干条完整记录就插入 store，CRC 边收边算、结束时校验。
+  // 缓冲中最多只有一帧或一段记录，内存占用与快照大小无关
+  class RdbStreamLoader
+  {
+  public:
+    explicit RdbStreamLoader(KeyValueStore &store) : store_(store) {}
+
+    // 返回本次数据中属于 RDB 的字节数；done() 之后剩下的字节不属于 RDB，由调用方继续处理
+    size_t feed(const char *data, size_t len);
+    bool done() const { return state_ == State::kDone; }
+    bool failed() const { return state_ == State::kFailed; }
+    const std::string &error() const { return err_; }
+
+  private:
+    enum class State
+    {
+      kMagic,
+      kHeader,
+      kBody,
+      kCrc,
+      kDone,
+      kFailed
+    };
+    // 处理缓冲中的下一个单元；数据不够时返回 false
+    bool step();
+    void consume(size_t n);
+    bool fail(const std::string &err);
+
+    KeyValueStore &store_;
+    State state_ = State::kMagic;
+    std::string buf_;
+    size_t pos_ = 0; // buf_ 中已处理的前缀
+    uint64_t crc_ = 0;
+    std::string scratch_;
+    std::string err_;
   };
 
 } // namespace mini_redis
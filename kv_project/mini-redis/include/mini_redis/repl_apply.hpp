@@ -0,0 +1,67 @@
+/**
+ * 创建者：程序员老廖
+ * 日期：2025年8月12日
+ */
+
+#pragma once
+
+#include "mini_redis/commands.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+namespace mini_redis
+{
+
+  class KeyValueStore;
+
+  // 批量应用写命令流（replica 的复制流、启动时的 AOF 回放）：一批命令按 key 所在分片分组，每个分片只加一次锁，
+  // 组内按到达顺序执行。同一 key 总在同一分片，因此对每个 key 的修改顺序与命令流一致；
+  // 不同分片之间的相对顺序不保证，批内不可见（整批应用完才确认偏移）。
+  // 命令经命令表执行，主库能复制、AOF 能记录的写命令这里都能应用；多 key 的 DEL 按分片拆开，
+  // 没有 key 的写命令（FLUSHALL）作为屏障，先应用之前分好组的命令再单独执行。
+  // 命令与本地 key 类型冲突时以命令流为准：删掉旧 key 再执行（与 RDB 加载的 putRecord 相同）。
+  // 流中的命令在主库上、写入 AOF 时都执行成功过，冲突只来自本地多出的数据：惰性过期不记 DEL，
+  // 回放时 TTL 按加载时刻重新计算，已过期的 key 可能还在；replica 上也可能有客户端的本地写入
+  class ReplApplier
+  {
+  public:
+    explicit ReplApplier(KeyValueStore &store);
+
+    // 加入一条命令。args 中的视图在 flush() 返回前必须保持有效。
+    // 不是可执行的写命令（未知命令、非写命令、参数个数不符）时直接跳过并返回 false
+    bool add(const CommandArgs &args);
+    // 应用已加入的全部命令并清空，返回本批命令数
+    size_t flush();
+
+    // 跳过的命令数：未知命令、非写命令、参数个数不符
+    uint64_t skipped() const { return skipped_; }
+    // 因类型冲突覆盖掉旧 key 的命令数
+    uint64_t overwritten() const { return overwritten_; }
+    // 本批（上次 flush 之后加入的命令）中第一条发生类型冲突的命令，即当初传给 add() 的 args；没有时为 nullptr
+    const CommandArgs *firstConflict() const { return conflict_; }
+
+  private:
+    struct Item
+    {
+      const CommandSpec *spec;
+      const CommandArgs *args;
+      const CommandArgs *origin; // 传给 add() 的原命令，拆开的 DEL 指向拆分前的那条
+    };
+
+    void applyOne(const CommandSpec &spec, const CommandArgs &args, const CommandArgs *origin);
+    void applyGroups();
+
+    KeyValueStore &store_;
+    std::vector<std::vector<Item>> groups_; // 每个分片一组，按到达顺序
+    std::vector<size_t> touched_;           // 本批有命令的分片
+    std::deque<CommandArgs> split_;         // 拆开的多 key 命令，deque 保证地址稳定
+    size_t pending_ = 0;
+    uint64_t skipped_ = 0;
+    uint64_t overwritten_ = 0;
+    const CommandArgs *conflict_ = nullptr;
+  };
+
+} // namespace mini_redis
@@ -0,0 +1,74 @@
+/**
+ * 创建者：程序员老廖
+ * 日期：2025年8月12日
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+namespace mini_redis
+{
+
+  // 复制缓冲中的一块。每条命令连同它前面的 "+OFFSET <结束偏移>\r\n" 只编码一次写进块里，
+  // backlog 与所有 replica 的发送队列引用同一块内存。已写入的字节不再改动，只在尾部追加
+  struct ReplBlock
+  {
+    std::unique_ptr<char[]> data;
+    size_t cap = 0;
+    size_t used = 0;
+    int64_t begin_offset = 0; // 块内第一条命令开始处的复制偏移
+  };
+
+  using ReplBlockRef = std::shared_ptr<const ReplBlock>;
+
+  // 共享块中的一段连续字节，持有块的引用，发送完之前块不会被释放
+  struct ReplSpan
+  {
+    ReplBlockRef block;
+    std::string_view bytes;
+  };
+
+  // 固定容量的复制积压缓冲：由定长块组成的环，写满后整块淘汰最老的数据，不搬移字节。
+  // 被淘汰的块若已没有 replica 引用，留作下一块复用，稳定运行时不再分配内存。
+  // 非线程安全，调用方需持有全局写锁（与分配复制偏移在同一临界区）
+  class ReplBacklog
+  {
+  public:
+    static constexpr size_t kBlockBytes = 16 * 1024;
+
+    explicit ReplBacklog(size_t capacity = 4 * 1024 * 1024);
+
+    // 追加一条已编码的命令，返回本条（含 +OFFSET 行）在尾块中的字节；需要投递时再用 tail() 取块的引用
+    std::string_view append(std::string_view cmd);
+    ReplBlockRef tail() const { return blocks_.back(); }
+
+    // 偏移 from 恰好落在 backlog 内的命令边界上时，按顺序返回其后的全部数据（引用共享块，不拷贝）；
+    // from 等于当前偏移时返回 true 且 out 为空
+    bool rangeFrom(int64_t from, std::vector<ReplSpan> &out) const;
+
+    // 运行时调整容量，变小时立即淘汰多出的块
+    void setCapacity(size_t bytes);
+
+    int64_t offset() const { return offset_; }  // 已产生的命令字节总数
+    int64_t startOffset() const;                // backlog 中最早一条命令的起始偏移
+    size_t capacity() const { return capacity_; }
+    size_t histLen() const { return held_; } // 当前保存的字节数（含 +OFFSET 行）
+
+  private:
+    void trim();
+    std::shared_ptr<ReplBlock> newBlock(size_t need);
+
+    std::deque<std::shared_ptr<ReplBlock>> blocks_;
+    std::shared_ptr<ReplBlock> spare_; // 淘汰下来、没有外部引用的块
+    size_t capacity_;
+    size_t held_ = 0;
+    int64_t offset_ = 0;
+  };
+
+} // namespace mini_redis
@@ -5,30 +5,80 @@
 
 #pragma once
 
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
 #include <string>
 #include <thread>
 
 #include "mini_redis/config.hpp"
+#include "mini_redis/rdb.hpp"
 
 namespace mini_redis
 {
 
+  class AofLogger;
+
+  // INFO 中 replica 一侧的复制状态
+  struct ReplicaStatus
+  {
+    std::string master_host;
+    uint16_t master_port = 0;
+    bool link_up = false;       // 已完成同步、正在接收命令流
+    ReplPosition position;      // 已应用到的主库 run id 与偏移
+    uint64_t full_syncs = 0;    // 本进程内发生的全量同步次数
+    uint64_t partial_syncs = 0; // PSYNC 续传成功次数（含重启后从本地快照续传）
+    uint64_t reconnects = 0;    // 断线后重新连接主库的次数
+  };
+
+  // 连接主库并持续应用复制流。断线后按指数退避重连，带着 run id 与已应用偏移 PSYNC，backlog 仍覆盖时只补发缺失部分。
+  // 复制流以批为单位持 write_mu 应用并追加到本地 AOF，与本地的 SAVE/BGSAVE 快照互斥，
+  // 快照因此总对应一个确定的复制位置（见 Rdb::setReplPositionSource）
   class ReplicaClient
   {
   public:
-    explicit ReplicaClient(const ServerConfig &cfg);
+    ReplicaClient(const ServerConfig &cfg, std::mutex &write_mu, AofLogger &aof, Rdb &rdb);
     ~ReplicaClient();
+    // 启动前设置：本地数据来自带复制位置的快照时，首次连接即尝试续传
+    void resumeFrom(const ReplPosition &pos) { pos_ = pos; }
     void start();
     void stop();
 
+    // 以下两个接口要求调用方持有 write_mu
+    ReplPosition position() const { return pos_; }
+    ReplicaStatus status() const;
+
   private:
+    static constexpr size_t kRecvBytes = 256 * 1024;
+    static constexpr size_t kMaxBatchBytes = 4 * 1024 * 1024; // 一批最多连续读这么多字节再应用
+    static constexpr int kAckIntervalMs = 1000;                // REPLCONF ACK 上报周期
+    static constexpr int kReconnectMinMs = 100;                // 重连退避：从 100ms 起每次翻倍，封顶 5s
+    static constexpr int kReconnectMaxMs = 5000;
+
     void threadMain();
+    // 一次连接的完整过程：握手、同步、应用命令流直到断线。返回是否完成过同步（用于重置退避）
+    bool session();
+    bool readLine(int fd, std::string &buf, std::string &line);
+    bool receiveSnapshot(int fd, const std::string &header, std::string &rest);
+    void closeSocket();
 
   private:
     const ServerConfig &cfg_;
+    std::mutex &write_mu_;
+    AofLogger &aof_;
+    Rdb &rdb_;
     std::thread th_;
-    bool running_ = false;
-    int64_t last_offset_ = 0;
+    std::atomic<bool> running_{false};
+    std::mutex mu_; // 保护 fd_，以及 stop() 唤醒退避等待
+    std::condition_variable cv_;
+    int fd_ = -1;
+    // 只由复制线程修改，且修改时持 write_mu；复制线程自己读取时不加锁
+    ReplPosition pos_;
+    std::atomic<bool> link_up_{false};
+    uint64_t full_syncs_ = 0; // 同 pos_，修改时持 write_mu
+    uint64_t partial_syncs_ = 0;
+    uint64_t reconnects_ = 0;
   };
 
 } // namespace mini_redis
@@ -30,11 +30,34 @@ struct RespValue {
   std::vector<RespValue> array;   // for arrays
 };
 
+// 客户端命令（bulk string 数组）的零拷贝视图：args 与 raw 都指向 RespParser 内部缓冲，
+// 只在下一次 append() 之前有效。raw 是整条命令的原始字节，AOF 可直接追加。
+struct RespCommand {
+  std::vector<std::string_view> args;
+  std::string_view raw;
+};
+
+enum class ParseStatus { kOk, kIncomplete, kError };
+
 class RespParser {
  public:
-  // Append newly read bytes into internal buffer
+  // Append newly read bytes into internal buffer. 已消费的前缀只在积累到一定量时才整体搬移，
+  // 因此会使之前返回的 RespCommand 视图失效。
   void append(std::string_view data);
 
+  // 解析一条客户端命令，只移动读游标，不拷贝参数。kError 时丢弃缓冲中剩余数据，调用方应回复错误并关闭连接
+  ParseStatus tryParseCommand(RespCommand& out);
+
+  // 复制流在命令之间插入 "+OFFSET <n>" 这样的状态行。下一项是状态行时取出其内容（不含 '+' 与 CRLF）返回 kOk；
+  // 行还不完整返回 kIncomplete；下一项不是状态行返回 kError，但不丢弃缓冲，调用方接着按命令解析
+  ParseStatus tryParseStatusLine(std::string_view& out);
+
+  // 把 cmd 及其之后已解析的数据退回缓冲，下次从 cmd 开始重新解析。cmd 必须是上次 append() 之后解析出来的
+  void unread(const RespCommand& cmd);
+
+  // 缓冲中尚未消费的字节数
+  size_t buffered() const { return buffer_.size() - rpos_; }
+
   // Try parse one full value. Return std::nullopt if incomplete; on error, returns value with type kError and bulk set to error msg
   std::optional<RespValue> tryParseOne();
 
@@ -42,15 +65,19 @@ class RespParser {
   std::optional<std::pair<RespValue, std::string>> tryParseOneWithRaw();
 
  private:
-  // parse helpers
-  bool parseLine(size_t& pos, std::string& out_line);
+  // parse helpers；pos 为 buffer_ 中的绝对位置，返回 false 表示数据不完整或格式错误
+  bool parseLine(size_t& pos, std::string_view& out_line);
   bool parseInteger(size_t& pos, int64_t& out_value);
   bool parseBulkString(size_t& pos, RespValue& out);
   bool parseSimple(size_t& pos, RespType t, RespValue& out);
   bool parseArray(size_t& pos, RespValue& out);
+  bool parseValue(size_t& pos, RespValue& out, bool& bad);
+  void reset();
 
  private:
   std::string buffer_;
+  size_t rpos_ = 0;  // 读游标：[0, rpos_) 已消费
+  size_t need_ = 0;  // 已知的下一条完整命令最少需要的缓冲长度（大 bulk 分片到达时避免反复重扫）
 };
 
 // RESP serialization helpers
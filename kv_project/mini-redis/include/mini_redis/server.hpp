@@ -5,12 +5,18 @@
 
 #pragma once
 
+#include <memory>
 #include <string>
+#include <vector>
 
 #include "mini_redis/config.hpp"
 
 namespace mini_redis {
 
+// 一个 reactor = 独立的 listen socket（SO_REUSEPORT）+ epoll + timerfd + 连接表；
+// io_backend=io_uring 时 epoll/timerfd 换成该 reactor 自己的 io_uring 实例
+struct Reactor;
+
 class Server {
  public:
   explicit Server(const ServerConfig& config);
@@ -18,15 +24,15 @@ class Server {
   int run();
 
  private:
-  int setupListen();
-  int setupEpoll();
-  int loop();
+  int setupListen(Reactor& r);
+  int setupEpoll(Reactor& r);
+  int setupUring(Reactor& r, std::string& err);
+  int loop(Reactor& r);
+  int loopUring(Reactor& r);
 
  private:
   const ServerConfig& config_;
-  int listen_fd_ = -1;
-  int epoll_fd_ = -1;
-  int timer_fd_ = -1;
+  std::vector<std::unique_ptr<Reactor>> reactors_;
 };
 
 }  // namespace mini_redis
@@ -5,11 +5,15 @@
 
 #pragma once
 
+#include <atomic>
+
 namespace mini_redis {
 
 class KeyValueStore;
 
 extern KeyValueStore g_store;
+// replica 正在加载全量同步的快照：期间拒绝客户端写命令。只在写锁内修改，写命令持写锁检查
+extern std::atomic<bool> g_loading;
 
 }  // namespace mini_redis
 
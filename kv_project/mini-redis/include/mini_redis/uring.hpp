@@ -0,0 +1,119 @@
+/**
+ * 创建者：程序员老廖
+ * 日期：2025年8月12日
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+struct iovec;
+struct io_uring_sqe;
+struct io_uring_cqe;
+struct io_uring_buf_ring;
+
+namespace mini_redis
+{
+
+  // 极简 io_uring 封装：直接使用 io_uring_setup/enter/register 系统调用，不依赖 liburing。
+  // 只提供服务端与 AOF 需要的几种操作；内核或头文件不支持时 init() 返回 false，调用方回退到 epoll。
+  // 非线程安全：一个 IoUring 只能由一个线程使用。
+  class IoUring
+  {
+  public:
+    enum class Op
+    {
+      kAccept,
+      kRecv,
+      kSend,
+      kRead,
+      kTimeout,
+      kWritev,
+      kFsync
+    };
+
+    struct Completion
+    {
+      uint64_t user_data = 0;
+      int32_t res = 0;
+      bool more = false;    // IORING_CQE_F_MORE：multishot 请求仍然有效
+      bool has_buf = false; // IORING_CQE_F_BUFFER：数据在 provided buffer bid 中
+      uint16_t bid = 0;
+    };
+
+    IoUring() = default;
+    ~IoUring();
+    IoUring(const IoUring &) = delete;
+    IoUring &operator=(const IoUring &) = delete;
+
+    bool init(unsigned entries, std::string &err);
+    bool ok() const { return ring_fd_ >= 0; }
+    // 检查当前内核是否支持 ops 中列出的全部 opcode
+    bool supports(const Op *ops, size_t n) const;
+    // multishot accept/recv 与 provided buffer ring 需要 6.0+，probe 无法探测这些 flag，只能看版本
+    static bool kernelAtLeast(int major, int minor);
+
+    // 以下 prep* 只填写 SQE，需调用 submit()/submitAndWait() 才会真正提交；SQ 满时自动先提交
+    bool prepAcceptMultishot(int fd, int flags, uint64_t user_data);
+    // 从 setupBufRing() 注册的缓冲组中取缓冲
+    bool prepRecvMultishot(int fd, uint64_t user_data);
+    // link：与下一个 SQE 串成链；skip_success：成功时不产生 CQE（失败/取消仍会产生）
+    bool prepSend(int fd, const void *buf, size_t len, uint64_t user_data, bool link, bool skip_success);
+    bool prepRead(int fd, void *buf, unsigned len, uint64_t user_data);
+    // 相对超时，到期 CQE 的 res 为 -ETIME；同一时刻只支持一个在途 timeout
+    bool prepTimeout(unsigned ms, uint64_t user_data);
+    bool prepWritev(int fd, const struct iovec *iov, unsigned n, uint64_t user_data, bool link);
+    bool prepFsync(int fd, bool datasync, uint64_t user_data);
+
+    // 提交已填写的 SQE，并至少等待 wait_nr 个 CQE
+    int submitAndWait(unsigned wait_nr);
+    int submit() { return submitAndWait(0); }
+    // SQ 剩余空位；提交一条链前应确认空位足够，否则链会被提交边界截断
+    unsigned sqSpace() const;
+    // 非阻塞取出一个 CQE
+    bool nextCompletion(Completion &out);
+
+    // provided buffer ring：count 必须是 2 的幂
+    bool setupBufRing(uint16_t bgid, unsigned count, unsigned buf_size, std::string &err);
+    char *bufAddr(uint16_t bid) const { return bufs_ + static_cast<size_t>(bid) * buf_size_; }
+    unsigned bufSize() const { return buf_size_; }
+    void recycleBuf(uint16_t bid);
+
+  private:
+    io_uring_sqe *getSqe();
+
+    int ring_fd_ = -1;
+    uint32_t features_ = 0;
+    // SQ
+    void *sq_ptr_ = nullptr;
+    size_t sq_map_sz_ = 0;
+    unsigned *sq_head_ = nullptr;
+    unsigned *sq_tail_ = nullptr;
+    unsigned *sq_array_ = nullptr;
+    unsigned sq_mask_ = 0;
+    unsigned sq_entries_ = 0;
+    unsigned sq_local_tail_ = 0;
+    io_uring_sqe *sqes_ = nullptr;
+    size_t sqes_map_sz_ = 0;
+    // CQ
+    void *cq_ptr_ = nullptr;
+    size_t cq_map_sz_ = 0;
+    unsigned *cq_head_ = nullptr;
+    unsigned *cq_tail_ = nullptr;
+    unsigned cq_mask_ = 0;
+    io_uring_cqe *cqes_ = nullptr;
+    // provided buffers
+    io_uring_buf_ring *br_ = nullptr;
+    size_t br_map_sz_ = 0;
+    char *bufs_ = nullptr;
+    unsigned buf_count_ = 0;
+    unsigned buf_size_ = 0;
+    uint16_t br_tail_ = 0;
+    uint16_t bgid_ = 0;
+    // IORING_OP_TIMEOUT 的 __kernel_timespec，需保持到提交完成
+    int64_t timeout_ts_[2] = {0, 0};
+  };
+
+} // namespace mini_redis
@@ -7,12 +7,19 @@
 
 #include "mini_redis/kv.hpp"
 #include "mini_redis/log.hpp"
+#include "mini_redis/rdb.hpp"
+#include "mini_redis/repl_apply.hpp"
+#include "mini_redis/resp.hpp"
+#include "mini_redis/uring.hpp"
 
 #include <fcntl.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <unistd.h>
 
+#include <algorithm>
+#include <cstring>
+#include <deque>
 #include <filesystem>
 #include <optional>
 #include <sys/uio.h>
@@ -51,6 +58,26 @@ namespace mini_redis
     return true;
   }
 
+  // 跳过 iov 中已写出的 n 字节：推进下标并就地收缩部分写出的那一块
+  static void consumeIov(struct iovec *iov, int iovcnt, int &idx, size_t n)
+  {
+    while (n > 0 && idx < iovcnt)
+    {
+      size_t avail = iov[idx].iov_len;
+      if (n < avail)
+      {
+        iov[idx].iov_base = static_cast<char *>(iov[idx].iov_base) + n;
+        iov[idx].iov_len = avail - n;
+        n = 0;
+      }
+      else
+      {
+        n -= avail;
+        ++idx;
+      }
+    }
+  }
+
   std::string toRespArray(const std::vector<std::string> &parts)
   {
     std::string out;
@@ -76,9 +103,182 @@ namespace mini_redis
   }
 
   AofLogger::AofLogger() = default;
-  AofLogger::~AofLogger() { shutdown(); }
+  AofLogger::~AofLogger()
+  {
+    shutdown();
+    for (auto &slot : chunks_)
+      delete[] slot.load();
+    for (char *buf : pool_)
+      delete[] buf;
+  }
+
+  std::string AofLogger::path() const { return joinPath(opts_.dir, opts_.filename + ".manifest"); }
+
+  std::string AofLogger::filePath(const std::string &name) const { return joinPath(opts_.dir, name); }
+
+  std::string AofLogger::segmentName(int64_t seq, const char *kind) const
+  {
+    return opts_.filename + "." + std::to_string(seq) + "." + kind;
+  }
+
+  AofManifest AofLogger::manifest() const
+  {
+    std::lock_guard<std::mutex> lk(manifest_mtx_);
+    return manifest_;
+  }
 
-  std::string AofLogger::path() const { return joinPath(opts_.dir, opts_.filename); }
+  // 清单格式（文本，每行一项）：
+  //   MRAOF 1
+  //   next <n>        下一个新文件的编号
+  //   base <name>     可选
+  //   incr <name>     按追加顺序，可有多行
+  bool AofLogger::loadManifest(bool &found, std::string &err)
+  {
+    found = false;
+    int rfd = ::open(path().c_str(), O_RDONLY);
+    if (rfd < 0)
+      return true;
+    std::string data;
+    char buf[4096];
+    ssize_t r;
+    while ((r = ::read(rfd, buf, sizeof(buf))) > 0)
+      data.append(buf, static_cast<size_t>(r));
+    ::close(rfd);
+    AofManifest m;
+    size_t pos = 0;
+    bool header = false;
+    while (pos < data.size())
+    {
+      size_t e = data.find('\n', pos);
+      if (e == std::string::npos)
+        e = data.size();
+      std::string line = data.substr(pos, e - pos);
+      pos = e + 1;
+      if (line.empty())
+        continue;
+      size_t sp = line.find(' ');
+      std::string key = line.substr(0, sp);
+      std::string val = sp == std::string::npos ? "" : line.substr(sp + 1);
+      if (!header)
+      {
+        if (line != "MRAOF 1")
+        {
+          err = "bad AOF manifest header: " + path();
+          return false;
+        }
+        header = true;
+      }
+      else if (key == "next")
+      {
+        try
+        {
+          m.next_seq = std::stoll(val);
+        }
+        catch (...)
+        {
+          err = "bad AOF manifest line: " + line;
+          return false;
+        }
+      }
+      else if (key == "base" && !val.empty())
+      {
+        m.base = val;
+      }
+      else if (key == "incr" && !val.empty())
+      {
+        m.incrs.push_back(val);
+      }
+      else
+      {
+        err = "bad AOF manifest line: " + line;
+        return false;
+      }
+    }
+    if (!header)
+    {
+      err = "empty AOF manifest: " + path();
+      return false;
+    }
+    manifest_ = std::move(m);
+    found = true;
+    return true;
+  }
+
+  // 写 path().tmp、fsync 后 rename 覆盖，再 fsync 目录：任何时刻磁盘上的清单都是完整的旧版本或新版本
+  bool AofLogger::writeManifest(const AofManifest &m, std::string &err) const
+  {
+    std::string out = "MRAOF 1\nnext " + std::to_string(m.next_seq) + "\n";
+    if (!m.base.empty())
+      out += "base " + m.base + "\n";
+    for (const auto &name : m.incrs)
+      out += "incr " + name + "\n";
+    std::string tmp = path() + ".tmp";
+    int wfd = ::open(tmp.c_str(), O_CREAT | O_TRUNC | O_WRONLY, 0644);
+    if (wfd < 0)
+    {
+      err = "open AOF manifest failed: " + tmp;
+      return false;
+    }
+    bool ok = writeAllFD(wfd, out.data(), out.size()) && ::fsync(wfd) == 0;
+    ::close(wfd);
+    if (!ok || ::rename(tmp.c_str(), path().c_str()) != 0)
+    {
+      ::unlink(tmp.c_str());
+      err = "write AOF manifest failed: " + path();
+      return false;
+    }
+    int dfd = ::open(opts_.dir.c_str(), O_RDONLY);
+    if (dfd >= 0)
+    {
+      ::fsync(dfd);
+      ::close(dfd);
+    }
+    return true;
+  }
+
+  bool AofLogger::rotateSegment(int64_t seq)
+  {
+    std::string name = segmentName(seq, "incr");
+    int fd = ::open(filePath(name).c_str(), O_CREAT | O_TRUNC | O_APPEND | O_WRONLY, 0644);
+    if (fd < 0)
+    {
+      MR_LOG("WARN", "open AOF segment failed: " << filePath(name));
+      return false;
+    }
+    // 预分配，降低元数据更新成本。KEEP_SIZE 只分配块不改文件长度，否则 O_APPEND 会把命令追加到预分配区之后
+#ifdef __linux__
+    size_t prealloc = opts_.prealloc_bytes;
+    if (opts_.segment_bytes > 0 && opts_.segment_bytes < prealloc)
+      prealloc = opts_.segment_bytes;
+    if (prealloc > 0)
+    {
+      ::fallocate(fd, FALLOC_FL_KEEP_SIZE, 0, static_cast<off_t>(prealloc));
+    }
+#endif
+    // 旧段先落盘再发布新清单：清单里不再写入的段总是完整的
+    if (fd_ >= 0)
+      ::fdatasync(fd_);
+    {
+      std::lock_guard<std::mutex> lk(manifest_mtx_);
+      AofManifest next = manifest_;
+      next.incrs.push_back(name);
+      next.next_seq = std::max(next.next_seq, seq + 1);
+      std::string err;
+      if (!writeManifest(next, err))
+      {
+        MR_LOG("WARN", "AOF segment switch failed: " << err);
+        ::close(fd);
+        ::unlink(filePath(name).c_str());
+        return false;
+      }
+      manifest_ = std::move(next);
+    }
+    if (fd_ >= 0)
+      ::close(fd_);
+    fd_ = fd;
+    seg_bytes_ = 0;
+    return true;
+  }
 
   bool AofLogger::init(const AofOptions &opts, std::string &err)
   {
@@ -92,19 +292,38 @@ namespace mini_redis
       err = "mkdir failed: " + opts_.dir;
       return false;
     }
-    fd_ = ::open(path().c_str(), O_CREAT | O_APPEND | O_WRONLY, 0644);
-    if (fd_ < 0)
-    {
-      err = "open AOF failed: " + path();
+    bool found = false;
+    if (!loadManifest(found, err))
       return false;
+    if (!found)
+    {
+      // 升级前的单文件 AOF 原样作为 base，第一次重写后被新 base 取代并删除
+      manifest_ = AofManifest{};
+      struct stat st;
+      if (::stat(filePath(opts_.filename).c_str(), &st) == 0)
+        manifest_.base = opts_.filename;
     }
-    // 预分配，降低元数据更新成本
-#ifdef __linux__
-    if (opts_.prealloc_bytes > 0)
+    if (manifest_.incrs.empty())
     {
-      posix_fallocate(fd_, 0, static_cast<off_t>(opts_.prealloc_bytes));
+      if (!rotateSegment(manifest_.next_seq))
+      {
+        err = "create AOF segment failed in " + opts_.dir;
+        return false;
+      }
+    }
+    else
+    {
+      // 接着最后一段追加；末尾若有残缺命令，load() 会先截断
+      std::string last = filePath(manifest_.incrs.back());
+      fd_ = ::open(last.c_str(), O_CREAT | O_APPEND | O_WRONLY, 0644);
+      if (fd_ < 0)
+      {
+        err = "open AOF failed: " + last;
+        return false;
+      }
+      struct stat st;
+      seg_bytes_ = ::fstat(fd_, &st) == 0 ? static_cast<size_t>(st.st_size) : 0;
     }
-#endif
     running_.store(true);
     stop_.store(false);
     writer_thread_ = std::thread(&AofLogger::writerLoop, this);
@@ -113,6 +332,9 @@ namespace mini_redis
 
   void AofLogger::shutdown()
   {
+    // 先等重写结束：重写要等 writer 切段，writer 必须还在运行
+    if (rewriter_thread_.joinable())
+      rewriter_thread_.join();
     running_.store(false);
     stop_.store(true);
     cv_.notify_all();
@@ -126,152 +348,287 @@ namespace mini_redis
     }
   }
 
+  void AofLogger::setSyncedCallback(std::function<void()> cb)
+  {
+    std::lock_guard<std::mutex> lg(mtx_);
+    on_synced_ = std::move(cb);
+  }
+
   bool AofLogger::appendCommand(const std::vector<std::string> &parts)
   {
-    if (!opts_.enabled || fd_ < 0)
+    if (!running_.load())
       return true;
-    std::string line = toRespArray(parts);
-    std::string line_copy;
-    bool need_incr = rewriting_.load();
-    if (need_incr)
-      line_copy = line; // 复制一份用于增量缓冲
-    int64_t my_seq = 0;
+    waitSynced(appendRaw(toRespArray(parts)));
+    return true;
+  }
+
+  int64_t AofLogger::appendRaw(std::string_view raw_resp)
+  {
+    if (!running_.load())
+      return 0;
+    const uint64_t pos = reserved_.fetch_add(raw_resp.size());
+    const uint64_t end = pos + raw_resp.size();
+    // 轮到自己发布：前面取得偏移的生产者都已发布。调用方持写锁时总是立即满足
+    auto waitTurn = [&]
     {
-      std::lock_guard<std::mutex> lg(mtx_);
-      pending_bytes_ += line.size();
-      my_seq = ++seq_gen_;
-      queue_.push_back(AofItem{std::move(line), my_seq});
-    }
-    if (need_incr)
+      while (committed_.load(std::memory_order_acquire) < pos && !stop_.load())
+        std::this_thread::yield();
+    };
+    bool turn = false;
+    const char *src = raw_resp.data();
+    for (uint64_t off = pos; off < end;)
     {
-      std::lock_guard<std::mutex> lk(incr_mtx_);
-      incr_cmds_.emplace_back(std::move(line_copy));
+      const uint64_t idx = off / kChunkBytes;
+      const uint64_t in = off % kChunkBytes;
+      const uint64_t n = std::min<uint64_t>(kChunkBytes - in, end - off);
+      // 槽位仍被上一圈的块占用：环已积压满。先发布已拷贝的部分，writer 才能写出并腾出槽位（超大命令也不会卡住自己）。
+      // writer 已退出时不再等待，之后的数据本来就不会写出
+      while (idx >= kRingChunks && consumed_.load(std::memory_order_acquire) < (idx - kRingChunks + 1) * kChunkBytes &&
+             !stop_.load())
+      {
+        if (!turn)
+        {
+          waitTurn();
+          turn = true;
+          ++partial_;
+        }
+        if (committed_.load(std::memory_order_relaxed) < off)
+          committed_.store(off);
+        ::usleep(100);
+      }
+      std::memcpy(chunkFor(idx) + in, src, n);
+      src += n;
+      off += n;
     }
-    cv_.notify_one();
-    if (opts_.mode == AofMode::kAlways)
+    if (!turn)
+      waitTurn();
+    committed_.store(end);
+    if (turn)
+      --partial_;
+    // 非 always 模式不急于落盘：积压不足一批时不唤醒 writer，它最迟 batch_wait_us 后自己醒来取走，
+    // 免得每条命令都让 writer 醒来写一次
+    const uint64_t wake_bytes = opts_.mode == AofMode::kAlways ? 0 : opts_.batch_bytes;
+    if (writer_idle_.load() && end - consumed_.load(std::memory_order_relaxed) >= wake_bytes)
     {
-      std::unique_lock<std::mutex> lk(mtx_);
-      cv_commit_.wait(lk, [&]
-                      { return last_synced_seq_ >= my_seq || stop_.load(); });
+      // writer 可能正要睡下：持 mtx_ 唤醒，不会错过
+      std::lock_guard<std::mutex> lg(mtx_);
+      cv_.notify_one();
     }
-    return true;
+    return static_cast<int64_t>(end);
   }
 
-  bool AofLogger::appendRaw(const std::string &raw_resp)
+  char *AofLogger::chunkFor(uint64_t idx)
   {
-    if (!opts_.enabled || fd_ < 0)
-      return true;
-    std::string line_copy;
-    bool need_incr = rewriting_.load();
-    if (need_incr)
-      line_copy = raw_resp; // 复制用于增量缓冲
-    int64_t my_seq = 0;
+    std::atomic<char *> &slot = chunks_[idx % kRingChunks];
+    char *buf = slot.load(std::memory_order_acquire);
+    if (buf)
+      return buf;
     {
-      std::lock_guard<std::mutex> lg(mtx_);
-      pending_bytes_ += raw_resp.size();
-      my_seq = ++seq_gen_;
-      queue_.push_back(AofItem{std::string(raw_resp), my_seq});
+      std::lock_guard<std::mutex> lk(pool_mtx_);
+      if (!pool_.empty())
+      {
+        buf = pool_.back();
+        pool_.pop_back();
+      }
     }
-    if (need_incr)
+    if (!buf)
+      buf = new char[kChunkBytes];
+    char *expected = nullptr;
+    if (slot.compare_exchange_strong(expected, buf, std::memory_order_acq_rel))
+      return buf;
+    // 同一块的另一个生产者先装好了
+    std::lock_guard<std::mutex> lk(pool_mtx_);
+    pool_.push_back(buf);
+    return expected;
+  }
+
+  uint64_t AofLogger::ringIov(uint64_t begin, uint64_t end, struct iovec *iov, int max_iov, int &iovcnt) const
+  {
+    iovcnt = 0;
+    while (begin < end && iovcnt < max_iov)
     {
-      std::lock_guard<std::mutex> lk(incr_mtx_);
-      incr_cmds_.emplace_back(std::move(line_copy));
+      const uint64_t in = begin % kChunkBytes;
+      const uint64_t n = std::min<uint64_t>(kChunkBytes - in, end - begin);
+      iov[iovcnt].iov_base = chunks_[(begin / kChunkBytes) % kRingChunks].load(std::memory_order_relaxed) + in;
+      iov[iovcnt].iov_len = n;
+      ++iovcnt;
+      begin += n;
     }
-    cv_.notify_one();
-    if (opts_.mode == AofMode::kAlways)
+    return begin;
+  }
+
+  void AofLogger::consumeRing(uint64_t begin, uint64_t end)
+  {
+    // 先把写完的整块还回池里并清空槽位，再发布 consumed_：生产者看到新的 consumed_ 时槽位一定已经空出
+    for (uint64_t idx = begin / kChunkBytes; (idx + 1) * kChunkBytes <= end; ++idx)
     {
-      std::unique_lock<std::mutex> lk(mtx_);
-      cv_commit_.wait(lk, [&]
-                      { return last_synced_seq_ >= my_seq || stop_.load(); });
+      char *buf = chunks_[idx % kRingChunks].exchange(nullptr, std::memory_order_relaxed);
+      std::lock_guard<std::mutex> lk(pool_mtx_);
+      if (pool_.size() < kPoolChunks)
+        pool_.push_back(buf);
+      else
+        delete[] buf;
     }
-    return true;
+    consumed_.store(end, std::memory_order_release);
+  }
+
+  void AofLogger::waitSynced(int64_t seq)
+  {
+    if (opts_.mode != AofMode::kAlways || seq <= synced_seq_.load())
+      return;
+    std::unique_lock<std::mutex> lk(mtx_);
+    cv_commit_.wait(lk, [&]
+                    { return synced_seq_.load() >= seq || stop_.load(); });
   }
 
   bool AofLogger::load(KeyValueStore &store, std::string &err)
   {
     if (!opts_.enabled)
       return true;
-    int rfd = ::open(path().c_str(), O_RDONLY);
+    AofManifest m = manifest();
+    std::vector<std::string> files;
+    if (!m.base.empty())
+      files.push_back(m.base);
+    files.insert(files.end(), m.incrs.begin(), m.incrs.end());
+    // AOF 是全部数据，回放不能叠加在已有数据之上（否则类型冲突的命令会被跳过，结果与宕机前不一致）
+    store.flushAll();
+    size_t commands = 0;
+    for (size_t i = 0; i < files.size(); ++i)
+    {
+      if (!loadFile(files[i], store, i + 1 == files.size(), commands, err))
+        return false;
+    }
+    MR_LOG("INFO", "AOF loaded " << files.size() << " files, " << commands << " commands");
+    return true;
+  }
+
+  bool AofLogger::loadFile(const std::string &name, KeyValueStore &store, bool last, size_t &commands, std::string &err)
+  {
+    const std::string file = filePath(name);
+    int rfd = ::open(file.c_str(), O_RDONLY);
     if (rfd < 0)
     {
-      // not fatal if file does not exist
-      return true;
+      err = "open AOF failed: " + file;
+      return false;
     }
-    std::string buf;
-    buf.resize(1 << 20);
-    std::string data;
+    // 按块读取，零拷贝解析出块内全部命令后交给 ReplApplier，经命令表按分片批量执行。
+    // 直接调用 handler，不经过 server 的 AOF 追加与复制传播；内存占用与文件大小无关。
+    // 重写生成的 base 以 MRDB3 快照开头（命令日志总以 '*' 开头），快照部分交给 RdbStreamLoader 直接插入记录
+    RespParser parser;
+    ReplApplier applier(store);
+    std::optional<RdbStreamLoader> preamble;
+    std::deque<RespCommand> batch;
+    std::vector<uint64_t> starts; // batch 中每条命令在文件中的起始偏移，出错时用于定位
+    std::string buf(kLoadChunkBytes, '\0');
+    uint64_t fed = 0;   // 已读取的文件字节数
+    uint64_t valid = 0; // 已完整解析的文件前缀长度
+    bool leading = true;
     while (true)
     {
       ssize_t r = ::read(rfd, buf.data(), buf.size());
       if (r < 0)
       {
-        err = "read AOF failed";
+        if (errno == EINTR)
+          continue;
+        err = "read AOF failed: " + file;
         ::close(rfd);
         return false;
       }
       if (r == 0)
         break;
-      data.append(buf.data(), static_cast<size_t>(r));
-    }
-    ::close(rfd);
-    // very simple replay: parse by lines; expect only SET/DEL/EXPIRE subset
-    // For robustness, reuse RespParser (not included here to avoid dependency circle). Minimal parse:
-    size_t pos = 0;
-    auto readLine = [&](std::string &out) -> bool
-    {
-    size_t e = data.find("\r\n", pos);
-    if (e == std::string::npos) return false;
-    out.assign(data.data() + pos, e - pos); pos = e + 2; return true; };
-    while (pos < data.size())
-    {
-      if (data[pos++] != '*')
-        break;
-      std::string line;
-      if (!readLine(line))
-        break;
-      int n = std::stoi(line);
-      std::vector<std::string> parts;
-      parts.reserve(n);
-      for (int i = 0; i < n; ++i)
+      std::string_view chunk(buf.data(), static_cast<size_t>(r));
+      fed += static_cast<uint64_t>(r);
+      if (leading)
+      {
+        // 旧版本 init 用 posix_fallocate 预分配会撑大文件长度，命令接在一段 0 之后追加；跳过这段 0
+        size_t z = chunk.find_first_not_of('\0');
+        if (z == std::string_view::npos)
+        {
+          valid = fed;
+          continue;
+        }
+        chunk.remove_prefix(z);
+        valid = fed - chunk.size();
+        leading = false;
+        if (chunk[0] != '*')
+          preamble.emplace(store);
+      }
+      if (preamble && !preamble->done())
       {
-        if (data[pos++] != '$')
+        size_t used = preamble->feed(chunk.data(), chunk.size());
+        if (preamble->failed())
         {
-          err = "bad bulk";
+          err = "bad rdb preamble in " + file + ": " + preamble->error();
+          ::close(rfd);
           return false;
         }
-        if (!readLine(line))
+        if (!preamble->done())
+          continue;
+        chunk.remove_prefix(used);
+        valid = fed - chunk.size();
+      }
+      parser.append(chunk);
+      size_t n = 0;
+      while (true)
+      {
+        if (n == batch.size())
         {
-          err = "bad bulk len";
+          batch.emplace_back();
+          starts.emplace_back();
+        }
+        starts[n] = valid;
+        ParseStatus st = parser.tryParseCommand(batch[n]);
+        if (st == ParseStatus::kIncomplete)
+          break;
+        if (st == ParseStatus::kError)
+        {
+          err = "bad RESP in " + file + " at offset " + std::to_string(valid);
+          ::close(rfd);
           return false;
         }
-        int len = std::stoi(line);
-        if (pos + static_cast<size_t>(len) + 2 > data.size())
+        if (!applier.add(batch[n].args))
         {
-          err = "trunc";
+          err = "unexecutable command '" + std::string(batch[n].args[0]) + "' in " + file + " at offset " + std::to_string(valid);
+          ::close(rfd);
           return false;
         }
-        parts.emplace_back(data.data() + pos, static_cast<size_t>(len));
-        pos += static_cast<size_t>(len) + 2; // skip CRLF
+        ++n;
+        valid = fed - parser.buffered();
       }
-      if (parts.empty())
-        continue;
-      std::string cmd;
-      cmd.reserve(parts[0].size());
-      for (char c : parts[0])
-        cmd.push_back(static_cast<char>(::toupper(c)));
-      if (cmd == "SET" && parts.size() == 3)
+      uint64_t overwritten = applier.overwritten();
+      commands += applier.flush();
+      const CommandArgs *bad = applier.firstConflict();
+      if (applier.overwritten() != overwritten && bad)
       {
-        store.set(parts[1], parts[2]);
+        // 惰性过期不写 DEL，回放时已过期的 key 可能还在，之后的命令按原样以新类型覆盖它
+        size_t i = 0;
+        while (i < n && &batch[i].args != bad)
+          ++i;
+        MR_LOG("WARN", "AOF replay overwrote " << (applier.overwritten() - overwritten) << " keys of another type in " << file
+                                               << ", first '" << (*bad)[0] << "' at offset " << (i < n ? starts[i] : valid));
       }
-      else if (cmd == "DEL" && parts.size() >= 2)
+    }
+    ::close(rfd);
+    if (preamble && !preamble->done())
+    {
+      // 快照由重写一次写完再发布，不完整说明文件已损坏，不能当作末尾残缺截掉
+      err = "truncated rdb preamble in " + file;
+      return false;
+    }
+    if (valid < fed)
+    {
+      // 之前的文件在切段前已落盘，只有正在写入的最后一段可能因宕机留下半条命令
+      if (!last)
       {
-        std::vector<std::string> keys(parts.begin() + 1, parts.end());
-        store.del(keys);
+        err = "truncated AOF file " + file + " at offset " + std::to_string(valid);
+        return false;
       }
-      else if (cmd == "EXPIRE" && parts.size() == 3)
+      // 丢弃残缺部分并截断文件，之后的追加才能接在完整命令后面
+      MR_LOG("WARN", "AOF truncated tail: " << (fed - valid) << " bytes discarded at offset " << valid << " of " << file);
+      if (::truncate(file.c_str(), static_cast<off_t>(valid)) != 0)
       {
-        int64_t sec = std::stoll(parts[2]);
-        store.expire(parts[1], sec);
+        err = "truncate AOF failed: " + file;
+        return false;
       }
     }
     return true;
@@ -284,49 +641,67 @@ namespace mini_redis
 
   void AofLogger::writerLoop()
   {
+    // 一批是追加流中连续的一段字节，按块切成几个 iovec；always 模式下一批就是一次组提交，覆盖其中的全部命令
     const size_t kBatchBytes = opts_.batch_bytes > 0 ? opts_.batch_bytes : (64 * 1024);
     const int kMaxIov = 64;
     const auto kWaitNs = std::chrono::microseconds(opts_.batch_wait_us > 0 ? opts_.batch_wait_us : 1000);
 
-    std::vector<AofItem> local;
-    local.reserve(256);
+    // io_uring：需要刷盘的批次把 WRITEV 与 FSYNC 串成一条链，一次 io_uring_enter 完成
+    IoUring ring;
+    bool use_ring = false;
+    if (opts_.use_io_uring)
+    {
+      std::string err;
+      const IoUring::Op ops[] = {IoUring::Op::kWritev, IoUring::Op::kFsync};
+      use_ring = ring.init(8, err) && ring.supports(ops, 2);
+      if (!use_ring)
+        MR_LOG("WARN", "AOF io_uring unavailable, using writev+fdatasync: " << (err.empty() ? "opcode not supported" : err));
+    }
 
     while (!stop_.load())
     {
-      // 若需要暂停以进行原子切换，则进入暂停状态
-      if (pause_writer_.load())
-      {
-        std::unique_lock<std::mutex> lk(pause_mtx_);
-        writer_is_paused_ = true;
-        cv_pause_.notify_all();
-        cv_pause_.wait(lk, [&]
-                       { return !pause_writer_.load() || stop_.load(); });
-        writer_is_paused_ = false;
-        if (stop_.load())
-          break;
-      }
-      local.clear();
-      size_t bytes = 0;
+      const uint64_t begin = consumed_.load(std::memory_order_relaxed);
+      uint64_t end = committed_.load(std::memory_order_acquire);
+      int64_t rotate_to = 0;
       {
         std::unique_lock<std::mutex> lk(mtx_);
-        if (queue_.empty())
+        if (end == begin && rotations_.empty())
         {
+          writer_idle_.store(true);
           cv_.wait_for(lk, kWaitNs, [&]
-                       { return stop_.load() || !queue_.empty(); });
+                       { return stop_.load() || committed_.load() != begin || !rotations_.empty(); });
+          writer_idle_.store(false);
+          end = committed_.load(std::memory_order_acquire);
         }
-        while (!queue_.empty() && (bytes < kBatchBytes) && (int)local.size() < kMaxIov)
+        // 切段请求：之前的字节留在旧段，先把它们写完，写到切换点时再切
+        if (!rotations_.empty())
         {
-          local.emplace_back(std::move(queue_.front()));
-          bytes += local.back().data.size();
-          queue_.pop_front();
+          if (rotations_.front().first <= begin)
+          {
+            rotate_to = rotations_.front().second;
+            rotations_.pop_front();
+          }
+          else
+          {
+            end = std::min(end, rotations_.front().first);
+          }
         }
-        if (pending_bytes_ >= bytes)
-          pending_bytes_ -= bytes;
-        else
-          pending_bytes_ = 0;
       }
+      const uint64_t avail = end;
+      end = std::min<uint64_t>(end, begin + kBatchBytes);
 
-      if (local.empty())
+      if (rotate_to != 0)
+      {
+        if (!rotateSegment(rotate_to))
+        {
+          std::lock_guard<std::mutex> lk(manifest_mtx_);
+          rotate_failed_seq_ = rotate_to;
+        }
+        cv_manifest_.notify_all();
+        continue;
+      }
+
+      if (end == begin)
       {
         // everysec 模式周期性刷盘
         if (opts_.mode == AofMode::kEverySec)
@@ -343,21 +718,49 @@ namespace mini_redis
         continue;
       }
 
-      // 组装 iovec
+      // 组装 iovec：直接指向环中的块，不再拷贝
       struct iovec iov[kMaxIov];
       int iovcnt = 0;
-      for (auto &it : local)
+      end = ringIov(begin, end, iov, kMaxIov, iovcnt);
+      const size_t bytes = static_cast<size_t>(end - begin);
+
+      // 本批次是否需要刷盘
+      const auto interval = std::chrono::milliseconds(opts_.sync_interval_ms > 0 ? opts_.sync_interval_ms : 1000);
+      const bool want_sync = opts_.mode == AofMode::kAlways ||
+                             (opts_.mode == AofMode::kEverySec && std::chrono::steady_clock::now() - last_sync_tp_ >= interval);
+
+      int start_idx = 0;
+      bool synced = false;
+      if (use_ring && want_sync)
       {
-        if (iovcnt >= kMaxIov)
-          break;
-        iov[iovcnt].iov_base = const_cast<char *>(it.data.data());
-        iov[iovcnt].iov_len = it.data.size();
-        ++iovcnt;
+        // WRITEV -> FSYNC(DATASYNC)：短写会让内核以 -ECANCELED 取消 FSYNC，剩余部分走下面的同步路径
+        int32_t wres = -1, fres = -1;
+        if (ring.prepWritev(fd_, iov, static_cast<unsigned>(iovcnt), 1, true) &&
+            ring.prepFsync(fd_, true, 2) && ring.submitAndWait(2) >= 0)
+        {
+          IoUring::Completion cqe;
+          int got = 0;
+          while (got < 2)
+          {
+            if (!ring.nextCompletion(cqe))
+            {
+              if (ring.submitAndWait(1) < 0)
+                break;
+              continue;
+            }
+            ++got;
+            if (cqe.user_data == 1)
+              wres = cqe.res;
+            else
+              fres = cqe.res;
+          }
+        }
+        if (wres > 0)
+          consumeIov(iov, iovcnt, start_idx, static_cast<size_t>(wres));
+        synced = fres == 0 && start_idx >= iovcnt;
       }
 
       // 聚合写入，处理部分写
-      int start_idx = 0;
-      size_t start_off = 0;
       while (start_idx < iovcnt)
       {
         ssize_t w = ::writev(fd_, &iov[start_idx], iovcnt - start_idx);
@@ -367,27 +770,12 @@ namespace mini_redis
           ::usleep(1000);
           break;
         }
-        size_t rem = static_cast<size_t>(w);
-        while (rem > 0 && start_idx < iovcnt)
-        {
-          size_t avail = iov[start_idx].iov_len - start_off;
-          if (rem < avail)
-          {
-            start_off += rem;
-            iov[start_idx].iov_base = static_cast<char *>(iov[start_idx].iov_base) + rem;
-            iov[start_idx].iov_len = avail - rem;
-            rem = 0;
-          }
-          else
-          {
-            rem -= avail;
-            ++start_idx;
-            start_off = 0;
-          }
-        }
+        consumeIov(iov, iovcnt, start_idx, static_cast<size_t>(w));
         if (w == 0)
           break; // 不太可能，但防止死循环
       }
+      // 数据已交给内核，块可以复用了
+      consumeRing(begin, end);
 
       // Linux 可选：触发后台回写，平滑尾部写放大
 #ifdef __linux__
@@ -410,7 +798,8 @@ namespace mini_redis
       // 模式处理
       if (opts_.mode == AofMode::kAlways)
       {
-        ::fdatasync(fd_);
+        if (!synced)
+          ::fdatasync(fd_);
 #ifdef __linux__
         if (opts_.fadvise_dontneed_after_sync)
         {
@@ -421,23 +810,24 @@ namespace mini_redis
           }
         }
 #endif
-        // 更新已提交序号并唤醒等待者
-        int64_t max_seq = 0;
-        for (auto &it : local)
-          max_seq = std::max(max_seq, it.seq);
+        // 更新已提交序号（本批结束偏移）并唤醒等待者
+        std::function<void()> on_synced;
         {
           std::lock_guard<std::mutex> lg(mtx_);
-          last_synced_seq_ = std::max(last_synced_seq_, max_seq);
+          synced_seq_.store(static_cast<int64_t>(end));
+          on_synced = on_synced_;
         }
         cv_commit_.notify_all();
+        if (on_synced)
+          on_synced();
       }
       else if (opts_.mode == AofMode::kEverySec)
       {
         auto now = std::chrono::steady_clock::now();
-        auto interval = std::chrono::milliseconds(opts_.sync_interval_ms > 0 ? opts_.sync_interval_ms : 1000);
-        if (now - last_sync_tp_ >= interval)
+        if (synced || now - last_sync_tp_ >= interval)
         {
-          ::fdatasync(fd_);
+          if (!synced)
+            ::fdatasync(fd_);
           last_sync_tp_ = now;
 #ifdef __linux__
           if (opts_.fadvise_dontneed_after_sync)
@@ -451,78 +841,60 @@ namespace mini_redis
 #endif
         }
       }
+
+      // 当前段写满后切到新段；切换失败就继续写旧段，下一批再试。
+      // 批次按字节截断，可能停在一条命令中间，只在命令边界上切：committed_ 的取值都是命令结尾，除非有超大命令正分段发布
+      seg_bytes_ += bytes;
+      if (opts_.segment_bytes > 0 && seg_bytes_ >= opts_.segment_bytes && end == avail && partial_.load() == 0)
+      {
+        int64_t seq = 0;
+        {
+          std::lock_guard<std::mutex> lk(manifest_mtx_);
+          seq = manifest_.next_seq++;
+        }
+        rotateSegment(seq);
+      }
     }
 
     // 退出前 flush
     if (fd_ >= 0)
     {
-      // 把剩余队列写完
-      while (true)
+      // 把环中剩余的数据写完
+      uint64_t begin = consumed_.load(std::memory_order_relaxed);
+      const uint64_t end = committed_.load(std::memory_order_acquire);
+      while (begin < end)
       {
-        std::vector<AofItem> rest;
-        size_t bytes = 0;
-        {
-          std::lock_guard<std::mutex> lg(mtx_);
-          while (!queue_.empty() && (int)rest.size() < 64)
-          {
-            rest.emplace_back(std::move(queue_.front()));
-            bytes += rest.back().data.size();
-            queue_.pop_front();
-          }
-          if (pending_bytes_ >= bytes)
-            pending_bytes_ -= bytes;
-          else
-            pending_bytes_ = 0;
-        }
-        if (rest.empty())
-          break;
         struct iovec iov2[64];
         int n = 0;
-        for (auto &it : rest)
-        {
-          iov2[n].iov_base = const_cast<char *>(it.data.data());
-          iov2[n].iov_len = it.data.size();
-          ++n;
-        }
+        const uint64_t stop = ringIov(begin, end, iov2, 64, n);
         int start_idx2 = 0;
-        size_t start_off2 = 0;
         while (start_idx2 < n)
         {
           ssize_t w2 = ::writev(fd_, &iov2[start_idx2], n - start_idx2);
-          if (w2 < 0)
-          {
-            if (errno == EINTR || errno == EAGAIN)
-              continue;
-            else
-              break;
-          }
-          size_t rem2 = static_cast<size_t>(w2);
-          while (rem2 > 0 && start_idx2 < n)
-          {
-            size_t avail2 = iov2[start_idx2].iov_len - start_off2;
-            if (rem2 < avail2)
-            {
-              start_off2 += rem2;
-              iov2[start_idx2].iov_base = static_cast<char *>(iov2[start_idx2].iov_base) + rem2;
-              iov2[start_idx2].iov_len = avail2 - rem2;
-              rem2 = 0;
-            }
-            else
-            {
-              rem2 -= avail2;
-              ++start_idx2;
-              start_off2 = 0;
-            }
-          }
-          if (w2 == 0)
+          if (w2 < 0 && (errno == EINTR || errno == EAGAIN))
+            continue;
+          if (w2 <= 0)
             break;
+          consumeIov(iov2, n, start_idx2, static_cast<size_t>(w2));
         }
+        consumeRing(begin, stop);
+        begin = stop;
       }
       ::fdatasync(fd_);
     }
+    // 队列已全部写入并刷盘，放行所有仍在等待的回复
+    std::function<void()> on_synced;
+    {
+      std::lock_guard<std::mutex> lg(mtx_);
+      synced_seq_.store(static_cast<int64_t>(committed_.load()));
+      on_synced = on_synced_;
+    }
+    cv_commit_.notify_all();
+    if (on_synced)
+      on_synced();
   }
 
-  bool AofLogger::bgRewrite(KeyValueStore &store, std::string &err)
+  bool AofLogger::bgRewrite(KeyValueStore &store, std::mutex &snapshot_mu, std::string &err)
   {
     if (!opts_.enabled)
     {
@@ -535,134 +907,170 @@ namespace mini_redis
       err = "rewrite already running";
       return false;
     }
-    rewriter_thread_ = std::thread(&AofLogger::rewriterLoop, this, &store);
+    // 上一次的线程已经结束（rewriting_ 已复位），回收后才能复用 std::thread
+    if (rewriter_thread_.joinable())
+      rewriter_thread_.join();
+    rewriter_thread_ = std::thread(&AofLogger::rewriterLoop, this, &store, &snapshot_mu);
     return true;
   }
 
-  static std::string joinPath(const std::string &dir, const std::string &file);
-
-  void AofLogger::rewriterLoop(KeyValueStore *store)
+  bool AofLogger::writeRdbPreamble(int wfd, const KeyValueStore &store, std::mutex &snapshot_mu, const std::function<bool()> &on_snapshot)
   {
-    // 1) 生成临时文件路径
-    std::string tmp_path = joinPath(opts_.dir, opts_.filename + ".rewrite.tmp");
-    int wfd = ::open(tmp_path.c_str(), O_CREAT | O_TRUNC | O_WRONLY, 0644);
-    if (wfd < 0)
+    Rdb::Sink sink = [wfd](const char *data, size_t len)
+    { return writeAllFD(wfd, data, len); };
+    // 只借用 MRDB3 编码，不压缩：重启时省掉解压
+    Rdb rdb;
+    std::string err;
+    if (!rdb.streamSnapshot(store, snapshot_mu, on_snapshot, sink, err))
     {
-      rewriting_.store(false);
-      return;
+      MR_LOG("WARN", "AOF rewrite: write rdb preamble failed: " << err);
+      return false;
     }
+    return true;
+  }
 
-    // 2) 遍历快照，输出最小命令集
+  bool AofLogger::writeRespSnapshot(int wfd, const KeyValueStore &store, std::mutex &snapshot_mu, const std::function<bool()> &on_snapshot)
+  {
+    std::vector<std::pair<std::string, ValueRecord>> strs;
+    std::vector<std::pair<std::string, HashRecord>> hashes;
+    std::vector<KeyValueStore::ZSetFlat> zsets;
+    {
+      std::lock_guard<std::mutex> lk(snapshot_mu);
+      if (!on_snapshot())
+        return false;
+      strs = store.snapshot();
+      hashes = store.snapshotHash();
+      zsets = store.snapshotZSet();
+    }
+    bool ok = true;
+    auto emit = [&](const std::vector<std::string> &parts)
+    {
+      std::string line = toRespArray(parts);
+      ok = ok && writeAllFD(wfd, line.data(), line.size());
+    };
+    auto emitExpire = [&](const std::string &key, int64_t expire_at_ms)
+    {
+      if (expire_at_ms <= 0)
+        return;
+      int64_t now = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+      int64_t ttl = (expire_at_ms - now) / 1000;
+      if (ttl < 1)
+        ttl = 1;
+      emit({"EXPIRE", key, std::to_string(ttl)});
+    };
     // String
+    for (const auto &kv : strs)
     {
-      auto snap = store->snapshot();
-      for (const auto &kv : snap)
-      {
-        const std::string &k = kv.first;
-        const auto &r = kv.second;
-        std::vector<std::string> parts = {"SET", k, r.value};
-        std::string line = toRespArray(parts);
-        writeAllFD(wfd, line.data(), line.size());
-        if (r.expire_at_ms > 0)
-        {
-          int64_t now = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
-          int64_t ttl = (r.expire_at_ms - now) / 1000;
-          if (ttl < 1)
-            ttl = 1;
-          std::vector<std::string> e = {"EXPIRE", k, std::to_string(ttl)};
-          std::string el = toRespArray(e);
-          writeAllFD(wfd, el.data(), el.size());
-        }
-      }
+      emit({"SET", kv.first, kv.second.value});
+      emitExpire(kv.first, kv.second.expire_at_ms);
     }
     // Hash
+    for (const auto &kv : hashes)
     {
-      auto snap = store->snapshotHash();
-      for (const auto &kv : snap)
-      {
-        const std::string &key = kv.first;
-        const auto &h = kv.second;
-        for (const auto &fv : h.fields)
-        {
-          std::vector<std::string> parts = {"HSET", key, fv.first, fv.second};
-          std::string line = toRespArray(parts);
-          writeAllFD(wfd, line.data(), line.size());
-        }
-        if (h.expire_at_ms > 0)
-        {
-          int64_t now = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
-          int64_t ttl = (h.expire_at_ms - now) / 1000;
-          if (ttl < 1)
-            ttl = 1;
-          std::vector<std::string> e = {"EXPIRE", key, std::to_string(ttl)};
-          std::string el = toRespArray(e);
-          writeAllFD(wfd, el.data(), el.size());
-        }
-      }
+      for (const auto &fv : kv.second.fields)
+        emit({"HSET", kv.first, fv.first, fv.second});
+      emitExpire(kv.first, kv.second.expire_at_ms);
     }
     // ZSet
+    for (const auto &flat : zsets)
     {
-      auto snap = store->snapshotZSet();
-      for (const auto &flat : snap)
-      {
-        for (const auto &it : flat.items)
-        {
-          std::vector<std::string> parts = {"ZADD", flat.key, std::to_string(it.first), it.second};
-          std::string line = toRespArray(parts);
-          writeAllFD(wfd, line.data(), line.size());
-        }
-        if (flat.expire_at_ms > 0)
-        {
-          int64_t now = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
-          int64_t ttl = (flat.expire_at_ms - now) / 1000;
-          if (ttl < 1)
-            ttl = 1;
-          std::vector<std::string> e = {"EXPIRE", flat.key, std::to_string(ttl)};
-          std::string el = toRespArray(e);
-          writeAllFD(wfd, el.data(), el.size());
-        }
-      }
+      for (const auto &it : flat.items)
+        emit({"ZADD", flat.key, std::to_string(it.first), it.second});
+      emitExpire(flat.key, flat.expire_at_ms);
     }
+    return ok;
+  }
 
-    // 3) 进入切换阶段：暂停 writer，写入最终增量并原子替换
-    pause_writer_.store(true);
+  void AofLogger::rewriterLoop(KeyValueStore *store, std::mutex *snapshot_mu)
+  {
+    auto start = std::chrono::steady_clock::now();
+    int64_t base_seq = 0, cut_seq = 0;
     {
-      std::unique_lock<std::mutex> lk(pause_mtx_);
-      cv_pause_.wait(lk, [&]
-                     { return writer_is_paused_; });
+      std::lock_guard<std::mutex> lk(manifest_mtx_);
+      base_seq = manifest_.next_seq++;
+      cut_seq = manifest_.next_seq++;
     }
-    // 在 writer 暂停期间，阻塞增量缓冲追加，确保没有遗漏
+    const std::string base_name = segmentName(base_seq, "base");
+    const std::string cut_name = segmentName(cut_seq, "incr");
+    auto fail = [&](const std::string &tmp_path)
     {
-      std::lock_guard<std::mutex> lg(incr_mtx_);
-      for (const auto &s : incr_cmds_)
-      {
-        writeAllFD(wfd, s.data(), s.size());
-      }
-      incr_cmds_.clear();
+      if (!tmp_path.empty())
+        ::unlink(tmp_path.c_str());
+      rewriting_.store(false);
+    };
+
+    // 1) 写临时文件，发布前不被清单引用
+    std::string tmp_path = filePath(base_name) + ".tmp";
+    int wfd = ::open(tmp_path.c_str(), O_CREAT | O_TRUNC | O_WRONLY, 0644);
+    if (wfd < 0)
+    {
+      MR_LOG("WARN", "AOF rewrite: open " << tmp_path << " failed");
+      fail("");
+      return;
     }
-    ::fdatasync(wfd);
-    // 原子替换并切换 fd
+
+    // 2) 持 snapshot_mu 拷贝快照的同一临界区内放入切段标记：
+    //    快照包含标记之前的全部命令，标记之后的命令由 writer 写进新段，不重不漏
+    auto cut = [this, cut_seq]
     {
-      std::string final_path = path();
-      ::close(fd_);
-      ::close(wfd);
-      ::rename(tmp_path.c_str(), final_path.c_str());
-      fd_ = ::open(final_path.c_str(), O_CREAT | O_APPEND | O_WRONLY, 0644);
-      // fsync 目录，保证 rename 持久
-      int dfd = ::open(opts_.dir.c_str(), O_RDONLY);
-      if (dfd >= 0)
       {
-        ::fsync(dfd);
-        ::close(dfd);
+        std::lock_guard<std::mutex> lk(mtx_);
+        rotations_.emplace_back(reserved_.load(), cut_seq);
       }
+      cv_.notify_one();
+      return true;
+    };
+    bool ok = opts_.use_rdb_preamble ? writeRdbPreamble(wfd, *store, *snapshot_mu, cut)
+                                     : writeRespSnapshot(wfd, *store, *snapshot_mu, cut);
+    ok = ok && ::fdatasync(wfd) == 0;
+    ::close(wfd);
+    if (!ok || ::rename(tmp_path.c_str(), filePath(base_name).c_str()) != 0)
+    {
+      MR_LOG("WARN", "AOF rewrite: write base failed");
+      // 标记可能已经入队，新段照常使用，只是 base 不变
+      fail(tmp_path);
+      return;
     }
-    pause_writer_.store(false);
-    cv_pause_.notify_all();
-    // 清理增量
+
+    // 3) 等 writer 切到新段，再原子替换清单：新 base + 切换点之后的增量段
+    std::vector<std::string> obsolete;
     {
-      std::lock_guard<std::mutex> lg(incr_mtx_);
-      incr_cmds_.clear();
+      std::unique_lock<std::mutex> lk(manifest_mtx_);
+      auto it = manifest_.incrs.end();
+      cv_manifest_.wait(lk, [&]
+                        {
+                          it = std::find(manifest_.incrs.begin(), manifest_.incrs.end(), cut_name);
+                          return it != manifest_.incrs.end() || rotate_failed_seq_ == cut_seq || stop_.load(); });
+      if (it == manifest_.incrs.end())
+      {
+        lk.unlock();
+        MR_LOG("WARN", "AOF rewrite: segment switch failed");
+        ::unlink(filePath(base_name).c_str());
+        fail("");
+        return;
+      }
+      AofManifest next;
+      next.base = base_name;
+      next.incrs.assign(it, manifest_.incrs.end());
+      next.next_seq = manifest_.next_seq;
+      std::string err;
+      if (!writeManifest(next, err))
+      {
+        lk.unlock();
+        MR_LOG("WARN", "AOF rewrite: " << err);
+        ::unlink(filePath(base_name).c_str());
+        fail("");
+        return;
+      }
+      if (!manifest_.base.empty())
+        obsolete.push_back(manifest_.base);
+      obsolete.insert(obsolete.end(), manifest_.incrs.begin(), it);
+      manifest_ = std::move(next);
     }
+    // 4) 新清单已落盘，旧 base 与切换点之前的段不再被引用
+    for (const auto &name : obsolete)
+      ::unlink(filePath(name).c_str());
+    last_rewrite_time_ms_.store(std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count());
     rewriting_.store(false);
   }
 
@@ -0,0 +1,356 @@
+/**
+ * 创建者：程序员老廖
+ * 日期：2025年8月12日
+ */
+
+#include "mini_redis/commands.hpp"
+
+#include "mini_redis/kv.hpp"
+#include "mini_redis/resp.hpp"
+
+#include <charconv>
+#include <optional>
+#include <stdexcept>
+
+namespace mini_redis
+{
+
+  int64_t parseInt64(std::string_view s)
+  {
+    int64_t v = 0;
+    auto [ptr, ec] = std::from_chars(s.data(), s.data() + s.size(), v);
+    if (ec != std::errc() || ptr != s.data() + s.size())
+      throw std::invalid_argument("not an integer");
+    return v;
+  }
+
+  namespace
+  {
+
+    bool equalsNoCase(std::string_view s, const char *upper)
+    {
+      size_t i = 0;
+      for (; i < s.size(); ++i)
+      {
+        // 表中命令名只含字母，|0x20 折叠后相等当且仅当是同一字母的大小写
+        if (upper[i] == '\0' || (static_cast<unsigned char>(s[i]) | 0x20u) != (static_cast<unsigned char>(upper[i]) | 0x20u))
+          return false;
+      }
+      return upper[i] == '\0';
+    }
+
+    std::string arrayOf(const std::vector<std::string> &items)
+    {
+      std::string out = "*" + std::to_string(items.size()) + "\r\n";
+      for (const auto &s : items)
+        out += respBulk(s);
+      return out;
+    }
+
+    std::string pingCommand(CommandContext &, const CommandArgs &args)
+    {
+      if (args.size() == 1)
+        return respSimpleString("PONG");
+      if (args.size() == 2)
+        return respBulk(args[1]);
+      return respError("ERR wrong number of arguments for 'PING'");
+    }
+
+    std::string echoCommand(CommandContext &, const CommandArgs &args)
+    {
+      return respBulk(args[1]);
+    }
+
+    std::string setCommand(CommandContext &ctx, const CommandArgs &args)
+    {
+      std::optional<int64_t> ttl_ms;
+      // minimal options support: EX seconds or PX milliseconds
+      size_t i = 3;
+      while (i < args.size())
+      {
+        std::string opt;
+        opt.reserve(args[i].size());
+        for (char ch : args[i])
+          opt.push_back(static_cast<char>(::toupper(ch)));
+        if (opt != "EX" && opt != "PX")
+          return respError("ERR syntax"); // unsupported option for now
+        if (i + 1 >= args.size())
+          return respError("ERR syntax");
+        try
+        {
+          int64_t n = parseInt64(args[i + 1]);
+          if (n < 0)
+            return respError("ERR invalid expire time in SET");
+          ttl_ms = opt == "EX" ? n * 1000 : n;
+        }
+        catch (...)
+        {
+          return respError("ERR value is not an integer or out of range");
+        }
+        i += 2;
+      }
+      ctx.store.set(std::string(args[1]), std::string(args[2]), ttl_ms);
+      ctx.dirty = true;
+      return respSimpleString("OK");
+    }
+
+    std::string getCommand(CommandContext &ctx, const CommandArgs &args)
+    {
+      auto val = ctx.store.get(std::string(args[1]));
+      if (!val.has_value())
+        return respNullBulk();
+      return respBulk(*val);
+    }
+
+    std::string keysCommand(CommandContext &ctx, const CommandArgs &args)
+    {
+      // 允许 KEYS 或 KEYS <pattern>，未带 pattern 时等价 '*'
+      if (args.size() > 2)
+        return respError("ERR wrong number of arguments for 'KEYS'");
+      std::string_view pattern = args.size() == 2 ? args[1] : std::string_view("*");
+      // 仅支持 '*' 通配（返回所有 keys）。复杂模式可后续扩展。
+      auto keys = ctx.store.listKeys();
+      if (pattern != "*")
+        keys.clear();
+      return arrayOf(keys);
+    }
+
+    std::string flushallCommand(CommandContext &ctx, const CommandArgs &)
+    {
+      ctx.store.flushAll();
+      ctx.dirty = true;
+      return respSimpleString("OK");
+    }
+
+    std::string delCommand(CommandContext &ctx, const CommandArgs &args)
+    {
+      std::vector<std::string> keys(args.begin() + 1, args.end());
+      int removed = ctx.store.del(keys);
+      ctx.dirty = removed > 0;
+      return respInteger(removed);
+    }
+
+    std::string existsCommand(CommandContext &ctx, const CommandArgs &args)
+    {
+      return respInteger(ctx.store.exists(std::string(args[1])) ? 1 : 0);
+    }
+
+    std::string expireCommand(CommandContext &ctx, const CommandArgs &args)
+    {
+      int64_t seconds = 0;
+      try
+      {
+        seconds = parseInt64(args[2]);
+      }
+      catch (...)
+      {
+        return respError("ERR value is not an integer or out of range");
+      }
+      bool ok = ctx.store.expire(std::string(args[1]), seconds);
+      ctx.dirty = ok;
+      return respInteger(ok ? 1 : 0);
+    }
+
+    std::string typeCommand(CommandContext &ctx, const CommandArgs &args)
+    {
+      return respSimpleString(objectTypeName(ctx.store.type(std::string(args[1]))));
+    }
+
+    std::string ttlCommand(CommandContext &ctx, const CommandArgs &args)
+    {
+      return respInteger(ctx.store.ttl(std::string(args[1])));
+    }
+
+    std::string hsetCommand(CommandContext &ctx, const CommandArgs &args)
+    {
+      int created = ctx.store.hset(std::string(args[1]), std::string(args[2]), std::string(args[3]));
+      ctx.dirty = true;
+      return respInteger(created);
+    }
+
+    std::string hgetCommand(CommandContext &ctx, const CommandArgs &args)
+    {
+      auto val = ctx.store.hget(std::string(args[1]), std::string(args[2]));
+      if (!val.has_value())
+        return respNullBulk();
+      return respBulk(*val);
+    }
+
+    std::string hdelCommand(CommandContext &ctx, const CommandArgs &args)
+    {
+      std::vector<std::string> fields(args.begin() + 2, args.end());
+      int removed = ctx.store.hdel(std::string(args[1]), fields);
+      ctx.dirty = removed > 0;
+      return respInteger(removed);
+    }
+
+    std::string hexistsCommand(CommandContext &ctx, const CommandArgs &args)
+    {
+      return respInteger(ctx.store.hexists(std::string(args[1]), std::string(args[2])) ? 1 : 0);
+    }
+
+    std::string hgetallCommand(CommandContext &ctx, const CommandArgs &args)
+    {
+      return arrayOf(ctx.store.hgetallFlat(std::string(args[1])));
+    }
+
+    std::string hlenCommand(CommandContext &ctx, const CommandArgs &args)
+    {
+      return respInteger(ctx.store.hlen(std::string(args[1])));
+    }
+
+    std::string zaddCommand(CommandContext &ctx, const CommandArgs &args)
+    {
+      double sc = 0;
+      try
+      {
+        sc = std::stod(std::string(args[2]));
+      }
+      catch (...)
+      {
+        return respError("ERR value is not a valid float");
+      }
+      int added = ctx.store.zadd(std::string(args[1]), sc, std::string(args[3]));
+      ctx.dirty = true;
+      return respInteger(added);
+    }
+
+    std::string zremCommand(CommandContext &ctx, const CommandArgs &args)
+    {
+      std::vector<std::string> members(args.begin() + 2, args.end());
+      int removed = ctx.store.zrem(std::string(args[1]), members);
+      ctx.dirty = removed > 0;
+      return respInteger(removed);
+    }
+
+    std::string zrangeCommand(CommandContext &ctx, const CommandArgs &args)
+    {
+      int64_t start = 0, stop = 0;
+      try
+      {
+        start = parseInt64(args[2]);
+        stop = parseInt64(args[3]);
+      }
+      catch (...)
+      {
+        return respError("ERR value is not an integer or out of range");
+      }
+      return arrayOf(ctx.store.zrange(std::string(args[1]), start, stop));
+    }
+
+    std::string zscoreCommand(CommandContext &ctx, const CommandArgs &args)
+    {
+      auto s = ctx.store.zscore(std::string(args[1]), std::string(args[2]));
+      if (!s.has_value())
+        return respNullBulk();
+      return respBulk(std::to_string(*s));
+    }
+
+    const CommandSpec kCommands[] = {
+        {"PING", -1, kCmdReadonly, pingCommand},
+        {"ECHO", 2, kCmdReadonly, echoCommand},
+        {"SET", -3, kCmdWrite, setCommand},
+        {"GET", 2, kCmdReadonly, getCommand},
+        {"KEYS", -1, kCmdReadonly, keysCommand},
+        {"FLUSHALL", 1, kCmdWrite, flushallCommand},
+        {"DEL", -2, kCmdWrite, delCommand},
+        {"EXISTS", 2, kCmdReadonly, existsCommand},
+        {"EXPIRE", 3, kCmdWrite, expireCommand},
+        {"TTL", 2, kCmdReadonly, ttlCommand},
+        {"TYPE", 2, kCmdReadonly, typeCommand},
+        {"HSET", 4, kCmdWrite, hsetCommand},
+        {"HGET", 3, kCmdReadonly, hgetCommand},
+        {"HDEL", -3, kCmdWrite, hdelCommand},
+        {"HEXISTS", 3, kCmdReadonly, hexistsCommand},
+        {"HGETALL", 2, kCmdReadonly, hgetallCommand},
+        {"HLEN", 2, kCmdReadonly, hlenCommand},
+        {"ZADD", 4, kCmdWrite, zaddCommand},
+        {"ZREM", -3, kCmdWrite, zremCommand},
+        {"ZRANGE", 4, kCmdReadonly, zrangeCommand},
+        {"ZSCORE", 3, kCmdReadonly, zscoreCommand},
+        {"BGSAVE", 1, kCmdAdmin, bgsaveCommand},
+        {"SAVE", 1, kCmdAdmin, saveCommand},
+        {"BGREWRITEAOF", 1, kCmdAdmin, bgrewriteaofCommand},
+        {"CONFIG", -2, kCmdAdmin, configCommand},
+        {"INFO", -1, kCmdAdmin, infoCommand},
+        {"SYNC", 1, kCmdAdmin | kCmdConnection, nullptr},
+        {"PSYNC", -1, kCmdAdmin | kCmdConnection, nullptr},
+        {"REPLCONF", -2, kCmdAdmin | kCmdConnection, nullptr},
+        {"WAIT", 3, kCmdConnection, nullptr},
+    };
+    const size_t kNumCommands = sizeof(kCommands) / sizeof(kCommands[0]);
+
+    // 完美哈希：FNV-1a（按 |0x20 折叠大小写）加种子，启动时搜索一个在 kSlots 个槽里无冲突的种子
+    const size_t kSlots = 128;
+    const size_t kMaxNameLen = 16;
+
+    inline uint32_t foldHash(std::string_view s, uint32_t seed)
+    {
+      uint32_t h = 2166136261u ^ seed;
+      for (unsigned char c : s)
+      {
+        h ^= c | 0x20u;
+        h *= 16777619u;
+      }
+      return h;
+    }
+
+    struct PerfectHash
+    {
+      uint32_t seed = 0;
+      int16_t slot[kSlots];
+
+      PerfectHash()
+      {
+        for (;; ++seed)
+        {
+          bool ok = true;
+          for (auto &s : slot)
+            s = -1;
+          for (size_t i = 0; i < kNumCommands && ok; ++i)
+          {
+            size_t idx = foldHash(kCommands[i].name, seed) & (kSlots - 1);
+            if (slot[idx] >= 0)
+              ok = false;
+            else
+              slot[idx] = static_cast<int16_t>(i);
+          }
+          if (ok)
+            return;
+        }
+      }
+    };
+
+    const PerfectHash &perfectHash()
+    {
+      static const PerfectHash ph;
+      return ph;
+    }
+
+  } // namespace
+
+  const CommandSpec *lookupCommand(std::string_view name)
+  {
+    if (name.empty() || name.size() > kMaxNameLen)
+      return nullptr;
+    const PerfectHash &ph = perfectHash();
+    int16_t i = ph.slot[foldHash(name, ph.seed) & (kSlots - 1)];
+    if (i < 0 || !equalsNoCase(name, kCommands[i].name))
+      return nullptr;
+    return &kCommands[i];
+  }
+
+  bool commandArityOk(const CommandSpec &spec, size_t argc)
+  {
+    if (spec.arity >= 0)
+      return argc == static_cast<size_t>(spec.arity);
+    return argc >= static_cast<size_t>(-spec.arity);
+  }
+
+  const CommandSpec *commandTable(size_t &count)
+  {
+    count = kNumCommands;
+    return kCommands;
+  }
+
+} // namespace mini_redis
@@ -10,6 +10,7 @@
 #include <sstream>
 
 #include "mini_redis/config.hpp"
+#include "mini_redis/repl_backlog.hpp"
 
 namespace mini_redis
 {
@@ -64,6 +65,86 @@ namespace mini_redis
       {
         cfg.bind_address = val;
       }
+      else if (key == "io_threads")
+      {
+        try
+        {
+          cfg.io_threads = std::stoi(val);
+        }
+        catch (...)
+        {
+          err = "invalid io_threads at line " + std::to_string(lineno);
+          return false;
+        }
+        if (cfg.io_threads < 1)
+        {
+          err = "invalid io_threads at line " + std::to_string(lineno);
+          return false;
+        }
+      }
+      else if (key == "io_offload_threads")
+      {
+        try
+        {
+          cfg.io_offload_threads = std::stoi(val);
+        }
+        catch (...)
+        {
+          err = "invalid io_offload_threads at line " + std::to_string(lineno);
+          return false;
+        }
+        if (cfg.io_offload_threads < 0)
+        {
+          err = "invalid io_offload_threads at line " + std::to_string(lineno);
+          return false;
+        }
+      }
+      else if (key == "active_expire_budget_us")
+      {
+        try
+        {
+          cfg.active_expire_budget_us = std::stoi(val);
+        }
+        catch (...)
+        {
+          err = "invalid active_expire_budget_us at line " + std::to_string(lineno);
+          return false;
+        }
+        if (cfg.active_expire_budget_us <= 0)
+        {
+          err = "invalid active_expire_budget_us at line " + std::to_string(lineno);
+          return false;
+        }
+      }
+      else if (key == "active_expire_fast_budget_us")
+      {
+        try
+        {
+          cfg.active_expire_fast_budget_us = std::stoi(val);
+        }
+        catch (...)
+        {
+          err = "invalid active_expire_fast_budget_us at line " + std::to_string(lineno);
+          return false;
+        }
+        if (cfg.active_expire_fast_budget_us <= 0)
+        {
+          err = "invalid active_expire_fast_budget_us at line " + std::to_string(lineno);
+          return false;
+        }
+      }
+      else if (key == "io_backend")
+      {
+        if (val == "epoll")
+          cfg.io_backend = IoBackend::kEpoll;
+        else if (val == "io_uring")
+          cfg.io_backend = IoBackend::kIoUring;
+        else
+        {
+          err = "invalid io_backend at line " + std::to_string(lineno);
+          return false;
+        }
+      }
       else if (key == "aof.enabled")
       {
         cfg.aof.enabled = (val == "1" || val == "true" || val == "yes");
@@ -158,6 +239,22 @@ namespace mini_redis
       {
         cfg.aof.fadvise_dontneed_after_sync = (val == "1" || val == "true" || val == "yes");
       }
+      else if (key == "aof.segment_bytes")
+      {
+        try
+        {
+          cfg.aof.segment_bytes = static_cast<size_t>(std::stoull(val));
+        }
+        catch (...)
+        {
+          err = "invalid aof.segment_bytes at line " + std::to_string(lineno);
+          return false;
+        }
+      }
+      else if (key == "aof.use_rdb_preamble")
+      {
+        cfg.aof.use_rdb_preamble = (val == "1" || val == "true" || val == "yes");
+      }
       else if (key == "rdb.enabled")
       {
         cfg.rdb.enabled = (val == "1" || val == "true" || val == "yes");
@@ -170,6 +267,60 @@ namespace mini_redis
       {
         cfg.rdb.filename = val;
       }
+      else if (key == "rdb.load_threads")
+      {
+        try
+        {
+          cfg.rdb.load_threads = std::stoi(val);
+        }
+        catch (...)
+        {
+          err = "invalid rdb.load_threads at line " + std::to_string(lineno);
+          return false;
+        }
+        if (cfg.rdb.load_threads < 0)
+        {
+          err = "invalid rdb.load_threads at line " + std::to_string(lineno);
+          return false;
+        }
+      }
+      else if (key == "rdb.compression")
+      {
+        cfg.rdb.compression = (val == "1" || val == "true" || val == "yes");
+      }
+      else if (key == "repl.diskless_sync")
+      {
+        cfg.repl.diskless_sync = (val == "1" || val == "true" || val == "yes");
+      }
+      else if (key == "repl.diskless_buffer_bytes")
+      {
+        try
+        {
+          cfg.repl.diskless_buffer_bytes = static_cast<size_t>(std::stoull(val));
+        }
+        catch (...)
+        {
+          err = "invalid repl.diskless_buffer_bytes at line " + std::to_string(lineno);
+          return false;
+        }
+      }
+      else if (key == "repl.backlog_bytes")
+      {
+        try
+        {
+          cfg.repl.backlog_bytes = static_cast<size_t>(std::stoull(val));
+        }
+        catch (...)
+        {
+          err = "invalid repl.backlog_bytes at line " + std::to_string(lineno);
+          return false;
+        }
+        if (cfg.repl.backlog_bytes < ReplBacklog::kBlockBytes)
+        {
+          err = "repl.backlog_bytes must be at least " + std::to_string(ReplBacklog::kBlockBytes) + " at line " + std::to_string(lineno);
+          return false;
+        }
+      }
       else if (key == "replica.enabled")
       {
         cfg.replica.enabled = (val == "1" || val == "true" || val == "yes");
@@ -0,0 +1,117 @@
+/**
+ * 创建者：程序员老廖
+ * 日期：2025年8月12日
+ */
+
+#include "mini_redis/crc64.hpp"
+
+namespace mini_redis
+{
+
+  namespace
+  {
+
+    struct Crc64Tables
+    {
+      uint64_t t[8][256];
+
+      Crc64Tables()
+      {
+        const uint64_t kPoly = 0x95ac9329ac4bc9b5ULL;
+        for (uint64_t i = 0; i < 256; ++i)
+        {
+          uint64_t c = i;
+          for (int k = 0; k < 8; ++k)
+            c = (c & 1) ? (c >> 1) ^ kPoly : c >> 1;
+          t[0][i] = c;
+        }
+        // t[k][i]：字节 i 之后再跟 k 个 0 字节时的 CRC，用于一次合并 8 个字节
+        for (int k = 1; k < 8; ++k)
+        {
+          for (int i = 0; i < 256; ++i)
+            t[k][i] = (t[k - 1][i] >> 8) ^ t[0][t[k - 1][i] & 0xFF];
+        }
+      }
+    };
+
+    const Crc64Tables &tables()
+    {
+      static const Crc64Tables tb;
+      return tb;
+    }
+
+    // 64x64 的 GF(2) 矩阵，mat[i] 为第 i 列
+    uint64_t gf2Times(const uint64_t *mat, uint64_t vec)
+    {
+      uint64_t sum = 0;
+      for (; vec; vec >>= 1, ++mat)
+      {
+        if (vec & 1)
+          sum ^= *mat;
+      }
+      return sum;
+    }
+
+    void gf2Square(uint64_t *square, const uint64_t *mat)
+    {
+      for (int n = 0; n < 64; ++n)
+        square[n] = gf2Times(mat, mat[n]);
+    }
+
+  } // namespace
+
+  uint64_t crc64(uint64_t crc, const void *data, size_t len)
+  {
+    const auto &t = tables().t;
+    const unsigned char *p = static_cast<const unsigned char *>(data);
+    while (len >= 8)
+    {
+      // 按小端读取 8 字节；大端机器上逐字节拼装保持结果一致
+      uint64_t w = static_cast<uint64_t>(p[0]) | static_cast<uint64_t>(p[1]) << 8 | static_cast<uint64_t>(p[2]) << 16 |
+                   static_cast<uint64_t>(p[3]) << 24 | static_cast<uint64_t>(p[4]) << 32 | static_cast<uint64_t>(p[5]) << 40 |
+                   static_cast<uint64_t>(p[6]) << 48 | static_cast<uint64_t>(p[7]) << 56;
+      crc ^= w;
+      crc = t[7][crc & 0xFF] ^ t[6][(crc >> 8) & 0xFF] ^ t[5][(crc >> 16) & 0xFF] ^ t[4][(crc >> 24) & 0xFF] ^
+            t[3][(crc >> 32) & 0xFF] ^ t[2][(crc >> 40) & 0xFF] ^ t[1][(crc >> 48) & 0xFF] ^ t[0][crc >> 56];
+      p += 8;
+      len -= 8;
+    }
+    while (len-- > 0)
+      crc = t[0][(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+    return crc;
+  }
+
+  uint64_t crc64Combine(uint64_t crc1, uint64_t crc2, uint64_t len2)
+  {
+    if (len2 == 0)
+      return crc1;
+    uint64_t even[64];
+    uint64_t odd[64];
+    // odd：向 CRC 寄存器追加一个 0 比特的算子
+    odd[0] = 0x95ac9329ac4bc9b5ULL;
+    uint64_t row = 1;
+    for (int n = 1; n < 64; ++n)
+    {
+      odd[n] = row;
+      row <<= 1;
+    }
+    gf2Square(even, odd); // 2 个 0 比特
+    gf2Square(odd, even); // 4 个 0 比特
+    // 之后每轮平方一次，按 len2 的二进制位把 crc1 推进 len2 个 0 字节
+    do
+    {
+      gf2Square(even, odd);
+      if (len2 & 1)
+        crc1 = gf2Times(even, crc1);
+      len2 >>= 1;
+      if (len2 == 0)
+        break;
+      gf2Square(odd, even);
+      if (len2 & 1)
+        crc1 = gf2Times(odd, crc1);
+      len2 >>= 1;
+    } while (len2 != 0);
+    return crc1 ^ crc2;
+  }
+
+} // namespace mini_redis
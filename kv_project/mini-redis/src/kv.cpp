@@ -8,8 +8,9 @@
 #include <chrono>
 #include <algorithm>
 #include <optional>
-#include <iterator>
+#include <random>
 #include <cstdlib>
+#include <new>
 
 namespace mini_redis
 {
@@ -174,120 +175,386 @@ namespace mini_redis
 
   // ---------------- KeyValueStore implementation -----------------
 
-  int64_t KeyValueStore::nowMs()
+  const char *objectTypeName(ObjectType t)
   {
-    using namespace std::chrono;
-    return duration_cast<milliseconds>(steady_clock::now().time_since_epoch()).count();
+    switch (t)
+    {
+    case ObjectType::kString:
+      return "string";
+    case ObjectType::kHash:
+      return "hash";
+    case ObjectType::kZSet:
+      return "zset";
+    default:
+      return "none";
+    }
   }
 
-  bool KeyValueStore::isExpired(const ValueRecord &r, int64_t now_ms)
+  KeyValueStore::Object::Object(Object &&o) noexcept : meta_(o.meta_)
   {
-    return r.expire_at_ms >= 0 && now_ms >= r.expire_at_ms;
+    switch (type())
+    {
+    case ObjectType::kHash:
+      if (compact())
+      {
+        new (&hpairs_) HashPairs(std::move(o.hpairs_));
+        return;
+      }
+      hash_ = o.hash_;
+      break;
+    case ObjectType::kZSet:
+      if (compact())
+      {
+        new (&zpairs_) ZSetPairs(std::move(o.zpairs_));
+        return;
+      }
+      zset_ = o.zset_;
+      break;
+    default:
+      new (&str_) std::string(std::move(o.str_));
+      return;
+    }
+    // 指针已转移，源对象变回空字符串，析构时不会重复释放
+    o.meta_ = pack(ObjectType::kString, -1);
+    new (&o.str_) std::string();
   }
 
-  bool KeyValueStore::isExpired(const HashRecord &r, int64_t now_ms)
+  KeyValueStore::Object &KeyValueStore::Object::operator=(Object &&o) noexcept
   {
-    return r.expire_at_ms >= 0 && now_ms >= r.expire_at_ms;
+    if (this != &o)
+    {
+      this->~Object();
+      new (this) Object(std::move(o));
+    }
+    return *this;
   }
 
-  bool KeyValueStore::isExpired(const ZSetRecord &r, int64_t now_ms)
+  void KeyValueStore::Object::release()
   {
-    return r.expire_at_ms >= 0 && now_ms >= r.expire_at_ms;
+    switch (type())
+    {
+    case ObjectType::kHash:
+      if (compact())
+        hpairs_.~HashPairs();
+      else
+        delete hash_;
+      break;
+    case ObjectType::kZSet:
+      if (compact())
+        zpairs_.~ZSetPairs();
+      else
+        delete zset_;
+      break;
+    default:
+      str_.~basic_string();
+      break;
+    }
   }
 
-  void KeyValueStore::cleanupIfExpired(const std::string &key, int64_t now_ms)
+  void KeyValueStore::Object::reset(ObjectType t)
   {
-    auto it = map_.find(key);
-    if (it == map_.end())
+    if (t == type() && compact())
+    {
+      // 同类型直接清空，复用已有分配
+      if (t == ObjectType::kString)
+        str_.clear();
+      else if (t == ObjectType::kHash)
+        hpairs_.clear();
+      else
+        zpairs_.clear();
+      meta_ = pack(t, -1);
       return;
-    if (isExpired(it->second, now_ms))
+    }
+    release();
+    meta_ = pack(t, -1);
+    if (t == ObjectType::kHash)
+      new (&hpairs_) HashPairs();
+    else if (t == ObjectType::kZSet)
+      new (&zpairs_) ZSetPairs();
+    else
+      new (&str_) std::string();
+  }
+
+  void KeyValueStore::Object::convert()
+  {
+    if (type() == ObjectType::kHash)
+    {
+      auto *fields = new HashFields();
+      fields->reserve(hpairs_.size() + 1);
+      for (auto &p : hpairs_)
+        fields->emplace(std::move(p.first), std::move(p.second));
+      hpairs_.~HashPairs();
+      hash_ = fields;
+    }
+    else
+    {
+      auto *rec = new ZSetRecord();
+      rec->member_to_score.reserve(zpairs_.size() + 1);
+      for (const auto &p : zpairs_)
+      {
+        rec->sl.insert(p.first, p.second);
+        rec->member_to_score.emplace(p.second, p.first);
+      }
+      zpairs_.~ZSetPairs();
+      zset_ = rec;
+    }
+    meta_ |= 4u;
+  }
+
+  KeyValueStore::KeyValueStore(size_t shard_count)
+      : shard_count_(shard_count > 0 ? shard_count : 1), shards_(new Shard[shard_count > 0 ? shard_count : 1]) {}
+
+  KeyValueStore::~KeyValueStore() = default;
+
+  size_t KeyValueStore::shardIndex(std::string_view key) const
+  {
+    // 再做一次混合，避免分片选择与分片内哈希表的分组分布相关
+    uint64_t h = static_cast<uint64_t>(std::hash<std::string_view>{}(key));
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    return static_cast<size_t>(h % shard_count_);
+  }
+
+  KeyValueStore::Shard &KeyValueStore::shardFor(const std::string &key) const
+  {
+    return shards_[shardIndex(key)];
+  }
+
+  // withShardLocked() 期间当前线程持有的分片
+  static thread_local const void *t_held_shard = nullptr;
+
+  class KeyValueStore::ShardLock
+  {
+  public:
+    explicit ShardLock(Shard &sh) : mu_(t_held_shard == &sh ? nullptr : &sh.mu_)
     {
-      map_.erase(it);
-      expire_index_.erase(key);
+      if (mu_)
+        mu_->lock();
     }
+    ~ShardLock()
+    {
+      if (mu_)
+        mu_->unlock();
+    }
+    ShardLock(const ShardLock &) = delete;
+    ShardLock &operator=(const ShardLock &) = delete;
+
+  private:
+    std::mutex *mu_;
+  };
+
+  void KeyValueStore::withShardLocked(size_t shard, const std::function<void()> &fn)
+  {
+    Shard &sh = shards_[shard];
+    std::lock_guard<std::mutex> lk(sh.mu_);
+    t_held_shard = &sh;
+    try
+    {
+      fn();
+    }
+    catch (...)
+    {
+      t_held_shard = nullptr;
+      throw;
+    }
+    t_held_shard = nullptr;
   }
 
-  void KeyValueStore::cleanupIfExpiredHash(const std::string &key, int64_t now_ms)
+  size_t KeyValueStore::size() const
   {
-    auto it = hmap_.find(key);
-    if (it == hmap_.end())
-      return;
-    if (isExpired(it->second, now_ms))
+    size_t n = 0;
+    for (size_t i = 0; i < shard_count_; ++i)
     {
-      hmap_.erase(it);
-      expire_index_.erase(key);
+      std::lock_guard<std::mutex> lk(shards_[i].mu_);
+      n += shards_[i].keys_.size();
     }
+    return n;
   }
 
-  void KeyValueStore::cleanupIfExpiredZSet(const std::string &key, int64_t now_ms)
+  int64_t KeyValueStore::nowMs()
   {
-    auto it = zmap_.find(key);
-    if (it == zmap_.end())
+    using namespace std::chrono;
+    return duration_cast<milliseconds>(steady_clock::now().time_since_epoch()).count();
+  }
+
+  KeyValueStore::Object *KeyValueStore::lookup(Shard &sh, const std::string &key, int64_t now_ms)
+  {
+    Object *o = sh.keys_.find(key);
+    if (!o)
+      return nullptr;
+    if (o->expired(now_ms))
+    {
+      sh.keys_.erase(key);
+      --sh.volatile_keys_;
+      ++sh.expired_keys_;
+      return nullptr;
+    }
+    return o;
+  }
+
+  KeyValueStore::Object *KeyValueStore::lookupTyped(Shard &sh, const std::string &key, ObjectType t, int64_t now_ms)
+  {
+    Object *o = lookup(sh, key, now_ms);
+    if (o && o->type() != t)
+      throw WrongTypeError();
+    return o;
+  }
+
+  KeyValueStore::Object &KeyValueStore::obtain(Shard &sh, const std::string &key, ObjectType t, int64_t now_ms)
+  {
+    auto [o, inserted] = sh.keys_.tryEmplace(key);
+    if (inserted)
+    {
+      o->reset(t);
+    }
+    else if (o->expired(now_ms))
+    {
+      // 过期对象原地替换为新对象，省去一次删除再插入
+      o->reset(t);
+      --sh.volatile_keys_;
+      ++sh.expired_keys_;
+    }
+    else if (o->type() != t)
+    {
+      throw WrongTypeError();
+    }
+    return *o;
+  }
+
+  void KeyValueStore::setExpire(Shard &sh, const std::string &key, Object &o, int64_t expire_at_ms)
+  {
+    trackExpire(sh, key, o.expireAt(), expire_at_ms);
+    o.setExpireAt(expire_at_ms);
+  }
+
+  void KeyValueStore::trackExpire(Shard &sh, const std::string &key, int64_t old_at, int64_t new_at)
+  {
+    if (old_at >= 0 && new_at < 0)
+      --sh.volatile_keys_;
+    else if (old_at < 0 && new_at >= 0)
+      ++sh.volatile_keys_;
+    if (new_at < 0 || new_at == old_at)
       return;
-    if (isExpired(it->second, now_ms))
+    sh.expire_heap_.push_back(ExpireEntry{new_at, key});
+    std::push_heap(sh.expire_heap_.begin(), sh.expire_heap_.end(), ExpireLater{});
+    // 反复修改 TTL 会在堆里留下作废项，超过有效项两倍时整体重建一次，摊还 O(1)
+    if (sh.expire_heap_.size() > 2 * sh.volatile_keys_ + 1024)
+      compactExpireHeap(sh);
+  }
+
+  void KeyValueStore::compactExpireHeap(Shard &sh)
+  {
+    auto &heap = sh.expire_heap_;
+    size_t kept = 0;
+    for (size_t i = 0; i < heap.size(); ++i)
     {
-      zmap_.erase(it);
-      expire_index_.erase(key);
+      const Object *o = sh.keys_.find(heap[i].key);
+      if (o && o->expireAt() == heap[i].when)
+      {
+        if (kept != i)
+          heap[kept] = std::move(heap[i]);
+        ++kept;
+      }
     }
+    heap.resize(kept);
+    std::make_heap(heap.begin(), heap.end(), ExpireLater{});
+    if (heap.capacity() > 2 * heap.size() + 1024)
+      heap.shrink_to_fit();
   }
 
-  bool KeyValueStore::set(const std::string &key, const std::string &value, std::optional<int64_t> ttl_ms)
+  bool KeyValueStore::set(const std::string &key, std::string value, std::optional<int64_t> ttl_ms)
   {
-    std::lock_guard<std::mutex> lk(mu_);
     int64_t expire_at = -1;
     if (ttl_ms.has_value())
     {
       expire_at = nowMs() + *ttl_ms;
     }
-    map_[key] = ValueRecord{value, expire_at};
-    if (expire_at >= 0) expire_index_[key] = expire_at; else expire_index_.erase(key);
-    return true;
+    return setWithExpireAtMs(key, std::move(value), expire_at);
   }
 
-  bool KeyValueStore::setWithExpireAtMs(const std::string &key, const std::string &value, int64_t expire_at_ms)
+  bool KeyValueStore::setWithExpireAtMs(const std::string &key, std::string value, int64_t expire_at_ms)
   {
-    std::lock_guard<std::mutex> lk(mu_);
-    map_[key] = ValueRecord{value, expire_at_ms};
-    if (expire_at_ms >= 0)
-    {
-      expire_index_[key] = expire_at_ms;
-    }
+    Shard &sh = shardFor(key);
+    ShardLock lk(sh);
+    // SET 覆盖任意类型的旧值
+    Object &o = *sh.keys_.tryEmplace(key).first;
+    int64_t old_at = o.expireAt();
+    o.reset(ObjectType::kString);
+    o.str() = std::move(value);
+    o.setExpireAt(expire_at_ms);
+    trackExpire(sh, key, old_at, expire_at_ms);
     return true;
   }
 
   std::optional<std::string> KeyValueStore::get(const std::string &key)
   {
-    std::lock_guard<std::mutex> lk(mu_);
-    int64_t now = nowMs();
-    cleanupIfExpired(key, now);
-    auto it = map_.find(key);
-    if (it == map_.end())
+    Shard &sh = shardFor(key);
+    ShardLock lk(sh);
+    const Object *o = lookupTyped(sh, key, ObjectType::kString, nowMs());
+    if (!o)
       return std::nullopt;
-    return it->second.value;
+    return o->str();
   }
 
   bool KeyValueStore::exists(const std::string &key)
   {
-    std::lock_guard<std::mutex> lk(mu_);
-    int64_t now = nowMs();
-    cleanupIfExpired(key, now);
-    return map_.find(key) != map_.end() || hmap_.find(key) != hmap_.end() || zmap_.find(key) != zmap_.end();
+    Shard &sh = shardFor(key);
+    ShardLock lk(sh);
+    return lookup(sh, key, nowMs()) != nullptr;
+  }
+
+  ObjectType KeyValueStore::type(const std::string &key)
+  {
+    Shard &sh = shardFor(key);
+    ShardLock lk(sh);
+    const Object *o = lookup(sh, key, nowMs());
+    return o ? o->type() : ObjectType::kNone;
+  }
+
+  void KeyValueStore::reserve(size_t keys)
+  {
+    // 按哈希分布到各分片的 key 数有波动，多留 1/16 余量
+    size_t per_shard = keys / shard_count_;
+    per_shard += per_shard / 16 + 16;
+    for (size_t i = 0; i < shard_count_; ++i)
+    {
+      std::lock_guard<std::mutex> lk(shards_[i].mu_);
+      shards_[i].keys_.reserve(per_shard);
+    }
+  }
+
+  void KeyValueStore::flushAll()
+  {
+    for (size_t i = 0; i < shard_count_; ++i)
+    {
+      Shard &sh = shards_[i];
+      std::lock_guard<std::mutex> lk(sh.mu_);
+      sh.keys_.clear();
+      std::vector<ExpireEntry>().swap(sh.expire_heap_);
+      sh.volatile_keys_ = 0;
+    }
   }
 
   int KeyValueStore::del(const std::vector<std::string> &keys)
   {
-    std::lock_guard<std::mutex> lk(mu_);
     int removed = 0;
     int64_t now = nowMs();
     for (const auto &k : keys)
     {
-      cleanupIfExpired(k, now);
-      auto it = map_.find(k);
-      if (it != map_.end())
+      Shard &sh = shardFor(k);
+      ShardLock lk(sh);
+      bool live = false;
+      bool volatile_key = false;
+      if (sh.keys_.eraseWith(k, [&](const Object &o)
+                             {
+                               live = !o.expired(now);
+                               volatile_key = o.expireAt() >= 0; }))
       {
-        map_.erase(it);
-        expire_index_.erase(k);
-        ++removed;
+        if (volatile_key)
+          --sh.volatile_keys_;
+        if (live)
+          ++removed;
       }
     }
     return removed;
@@ -295,138 +562,260 @@ namespace mini_redis
 
   bool KeyValueStore::expire(const std::string &key, int64_t ttl_seconds)
   {
-    std::lock_guard<std::mutex> lk(mu_);
+    Shard &sh = shardFor(key);
+    ShardLock lk(sh);
     int64_t now = nowMs();
-    cleanupIfExpired(key, now);
-    auto it = map_.find(key);
-    if (it == map_.end())
+    Object *o = lookup(sh, key, now);
+    if (!o)
       return false;
-    if (ttl_seconds < 0)
-    {
-      it->second.expire_at_ms = -1;
-      expire_index_.erase(key);
-      return true;
-    }
-    it->second.expire_at_ms = now + ttl_seconds * 1000;
-    expire_index_[key] = it->second.expire_at_ms;
+    setExpire(sh, key, *o, ttl_seconds < 0 ? -1 : now + ttl_seconds * 1000);
     return true;
   }
 
   int64_t KeyValueStore::ttl(const std::string &key)
   {
-    std::lock_guard<std::mutex> lk(mu_);
+    Shard &sh = shardFor(key);
+    ShardLock lk(sh);
     int64_t now = nowMs();
-    cleanupIfExpired(key, now);
-    auto it = map_.find(key);
-    if (it == map_.end())
+    const Object *o = lookup(sh, key, now);
+    if (!o)
       return -2; // key does not exist
-    if (it->second.expire_at_ms < 0)
+    if (o->expireAt() < 0)
       return -1; // no expire
-    int64_t ms_left = it->second.expire_at_ms - now;
+    int64_t ms_left = o->expireAt() - now;
     if (ms_left <= 0)
       return -2;
     return ms_left / 1000; // seconds (floor)
   }
 
-  int KeyValueStore::expireScanStep(int max_steps)
+  int KeyValueStore::activeExpireCycle(ExpireCycle type, int64_t budget_us)
   {
-    std::lock_guard<std::mutex> lk(mu_);
-    if (max_steps <= 0 || expire_index_.empty()) return 0;
+    using clock = std::chrono::steady_clock;
+    // 快周期的触发阈值与 Redis 的 ACTIVE_EXPIRE_CYCLE_ACCEPTABLE_STALE 一致
+    const double kAcceptableStale = 0.10;
+    // 每个分片每次加锁最多回收这么多个，避免长时间占住分片锁
+    const int kBatch = 64;
+    // 每次访问分片后随机抽查堆中的几项，估计还有多少比例已到期
+    const int kStaleSamples = 4;
+    if (budget_us <= 0)
+      budget_us = 1;
+    auto start = clock::now();
+    if (type == ExpireCycle::kFast)
+    {
+      if (!expire_timed_out_.load(std::memory_order_relaxed) &&
+          stale_ratio_.load(std::memory_order_relaxed) < kAcceptableStale)
+        return 0;
+      int64_t now_us = std::chrono::duration_cast<std::chrono::microseconds>(start.time_since_epoch()).count();
+      int64_t last = last_fast_cycle_us_.load(std::memory_order_relaxed);
+      // 多个 reactor 同时进入时只放行一个
+      if (now_us - last < 2 * budget_us ||
+          !last_fast_cycle_us_.compare_exchange_strong(last, now_us, std::memory_order_relaxed))
+        return 0;
+    }
+    auto deadline = start + std::chrono::microseconds(budget_us);
+    thread_local std::minstd_rand rng(std::random_device{}());
     int removed = 0;
+    size_t first = expire_cursor_.fetch_add(1, std::memory_order_relaxed) % shard_count_;
     int64_t now = nowMs();
-    // random starting point
-    auto it = expire_index_.begin();
-    std::advance(it, static_cast<long>(std::rand() % expire_index_.size())) ;
-    for (int i = 0; i < max_steps && !expire_index_.empty(); ++i)
-    {
-      if (it == expire_index_.end()) it = expire_index_.begin();
-      const std::string key = it->first;
-      int64_t when = it->second;
-      if (when >= 0 && now >= when)
+    // 只用最近一轮的抽样：前几轮抽到的到期项随后就被回收了
+    int sampled = 0, stale = 0, pass_sampled = 0, pass_stale = 0;
+    bool more = true;
+    bool timed_out = false;
+    while (more && !timed_out)
+    {
+      more = false;
+      if (pass_sampled > 0)
       {
-        // remove from all maps
-        map_.erase(key);
-        hmap_.erase(key);
-        zmap_.erase(key);
-        it = expire_index_.erase(it);
-        ++removed;
+        sampled = pass_sampled;
+        stale = pass_stale;
       }
-      else
+      pass_sampled = pass_stale = 0;
+      for (size_t n = 0; n < shard_count_; ++n)
       {
-        ++it;
+        Shard &sh = shards_[(first + n) % shard_count_];
+        std::lock_guard<std::mutex> lk(sh.mu_);
+        // 顺带推进渐进 rehash，写入停下来后旧表也能尽快释放
+        sh.keys_.rehashStep(1);
+        auto &heap = sh.expire_heap_;
+        int batch = 0;
+        while (!heap.empty() && heap.front().when <= now && batch < kBatch)
+        {
+          std::pop_heap(heap.begin(), heap.end(), ExpireLater{});
+          ExpireEntry e = std::move(heap.back());
+          heap.pop_back();
+          ++batch;
+          // 与对象当前的过期时间一致才删除，否则是作废的旧项
+          const Object *o = sh.keys_.find(e.key);
+          if (o && o->expireAt() == e.when)
+          {
+            sh.keys_.erase(e.key);
+            --sh.volatile_keys_;
+            ++sh.expired_keys_;
+            ++removed;
+          }
+        }
+        if (!heap.empty() && heap.front().when <= now)
+        {
+          more = true;
+          for (int k = 0; k < kStaleSamples; ++k)
+          {
+            ++pass_sampled;
+            if (heap[rng() % heap.size()].when <= now)
+              ++pass_stale;
+          }
+        }
+        else if (!heap.empty())
+        {
+          // 堆顶未到期则整个堆都未到期，相当于抽到的全部未到期
+          pass_sampled += kStaleSamples;
+        }
+        if (clock::now() >= deadline)
+        {
+          timed_out = more || n + 1 < shard_count_;
+          break;
+        }
       }
     }
+    if (pass_sampled > 0)
+    {
+      sampled = pass_sampled;
+      stale = pass_stale;
+    }
+    // 已回收完毕时堆积比例视为 0；否则按抽样估计，平滑方式同 Redis 的 stat_expired_stale_perc
+    double current = (timed_out && sampled > 0) ? static_cast<double>(stale) / static_cast<double>(sampled) : 0.0;
+    double prev = stale_ratio_.load(std::memory_order_relaxed);
+    stale_ratio_.store(current * 0.05 + prev * 0.95, std::memory_order_relaxed);
+    expire_timed_out_.store(timed_out, std::memory_order_relaxed);
+    auto spent = std::chrono::duration_cast<std::chrono::microseconds>(clock::now() - start).count();
+    expire_cpu_us_.fetch_add(static_cast<uint64_t>(spent), std::memory_order_relaxed);
     return removed;
   }
 
+  size_t KeyValueStore::volatileKeys() const
+  {
+    size_t n = 0;
+    for (size_t i = 0; i < shard_count_; ++i)
+    {
+      std::lock_guard<std::mutex> lk(shards_[i].mu_);
+      n += shards_[i].volatile_keys_;
+    }
+    return n;
+  }
+
+  ExpireStats KeyValueStore::expireStats() const
+  {
+    ExpireStats st;
+    for (size_t i = 0; i < shard_count_; ++i)
+    {
+      std::lock_guard<std::mutex> lk(shards_[i].mu_);
+      st.expired_keys += shards_[i].expired_keys_;
+    }
+    st.cycle_cpu_us = expire_cpu_us_.load(std::memory_order_relaxed);
+    st.stale_ratio = stale_ratio_.load(std::memory_order_relaxed);
+    return st;
+  }
+
   std::vector<std::pair<std::string, ValueRecord>> KeyValueStore::snapshot() const
   {
-    std::lock_guard<std::mutex> lk(mu_);
     std::vector<std::pair<std::string, ValueRecord>> out;
-    out.reserve(map_.size());
-    for (const auto &kv : map_)
+    for (size_t i = 0; i < shard_count_; ++i)
     {
-      out.emplace_back(kv.first, kv.second);
+      const Shard &sh = shards_[i];
+      std::lock_guard<std::mutex> lk(sh.mu_);
+      sh.keys_.forEach([&](const std::string &key, const Object &o)
+                       {
+        if (o.type() == ObjectType::kString)
+          out.emplace_back(key, ValueRecord{o.str(), o.expireAt()}); });
     }
     return out;
   }
 
   std::vector<std::pair<std::string, HashRecord>> KeyValueStore::snapshotHash() const
   {
-    std::lock_guard<std::mutex> lk(mu_);
     std::vector<std::pair<std::string, HashRecord>> out;
-    out.reserve(hmap_.size());
-    for (const auto &kv : hmap_)
-      out.emplace_back(kv.first, kv.second);
+    for (size_t i = 0; i < shard_count_; ++i)
+    {
+      const Shard &sh = shards_[i];
+      std::lock_guard<std::mutex> lk(sh.mu_);
+      sh.keys_.forEach([&](const std::string &key, const Object &o)
+                       {
+        if (o.type() != ObjectType::kHash)
+          return;
+        HashRecord rec;
+        rec.expire_at_ms = o.expireAt();
+        if (o.compact())
+          rec.fields.insert(o.hashPairs().begin(), o.hashPairs().end());
+        else
+          rec.fields = o.hash();
+        out.emplace_back(key, std::move(rec)); });
+    }
     return out;
   }
 
   std::vector<KeyValueStore::ZSetFlat> KeyValueStore::snapshotZSet() const
   {
-    std::lock_guard<std::mutex> lk(mu_);
     std::vector<ZSetFlat> out;
-    out.reserve(zmap_.size());
-    for (const auto &kv : zmap_)
-    {
-      ZSetFlat flat;
-      flat.key = kv.first;
-      flat.expire_at_ms = kv.second.expire_at_ms;
-      if (!kv.second.use_skiplist)
-        flat.items = kv.second.items;
-      else
-        kv.second.sl->toVector(flat.items);
-      out.emplace_back(std::move(flat));
+    for (size_t i = 0; i < shard_count_; ++i)
+    {
+      const Shard &sh = shards_[i];
+      std::lock_guard<std::mutex> lk(sh.mu_);
+      sh.keys_.forEach([&](const std::string &key, const Object &o)
+                       {
+        if (o.type() != ObjectType::kZSet)
+          return;
+        ZSetFlat flat;
+        flat.key = key;
+        flat.expire_at_ms = o.expireAt();
+        if (o.compact())
+          flat.items = o.zsetPairs();
+        else
+          o.zset().sl.toVector(flat.items);
+        out.emplace_back(std::move(flat)); });
     }
     return out;
   }
 
   std::vector<std::string> KeyValueStore::listKeys() const
   {
-    std::lock_guard<std::mutex> lk(mu_);
     std::vector<std::string> out;
-    out.reserve(map_.size() + hmap_.size() + zmap_.size());
-    for (const auto &kv : map_)
-      out.push_back(kv.first);
-    for (const auto &kv : hmap_)
-      out.push_back(kv.first);
-    for (const auto &kv : zmap_)
-      out.push_back(kv.first);
-    // 去重
-    std::sort(out.begin(), out.end());
-    out.erase(std::unique(out.begin(), out.end()), out.end());
+    for (size_t i = 0; i < shard_count_; ++i)
+    {
+      const Shard &sh = shards_[i];
+      std::lock_guard<std::mutex> lk(sh.mu_);
+      out.reserve(out.size() + sh.keys_.size());
+      sh.keys_.forEach([&](const std::string &key, const Object &)
+                       { out.push_back(key); });
+    }
     return out;
   }
 
   int KeyValueStore::hset(const std::string &key, const std::string &field, const std::string &value)
   {
-    std::lock_guard<std::mutex> lk(mu_);
-    int64_t now = nowMs();
-    cleanupIfExpiredHash(key, now);
-    auto &rec = hmap_[key];
-    auto it = rec.fields.find(field);
-    if (it == rec.fields.end())
+    Shard &sh = shardFor(key);
+    ShardLock lk(sh);
+    Object &o = obtain(sh, key, ObjectType::kHash, nowMs());
+    if (o.compact())
+    {
+      HashPairs &pairs = o.hashPairs();
+      auto it = std::find_if(pairs.begin(), pairs.end(), [&](const auto &p)
+                             { return p.first == field; });
+      if (it != pairs.end())
+      {
+        it->second = value;
+        return 0;
+      }
+      if (pairs.size() < kCompactMaxEntries)
+      {
+        pairs.emplace_back(field, value);
+        return 1;
+      }
+      o.convert();
+    }
+    HashFields &fields = o.hash();
+    auto it = fields.find(field);
+    if (it == fields.end())
     {
-      rec.fields[field] = value;
+      fields.emplace(field, value);
       return 1;
     }
     it->second = value;
@@ -435,236 +824,235 @@ namespace mini_redis
 
   std::optional<std::string> KeyValueStore::hget(const std::string &key, const std::string &field)
   {
-    std::lock_guard<std::mutex> lk(mu_);
-    int64_t now = nowMs();
-    cleanupIfExpiredHash(key, now);
-    auto it = hmap_.find(key);
-    if (it == hmap_.end())
+    Shard &sh = shardFor(key);
+    ShardLock lk(sh);
+    const Object *o = lookupTyped(sh, key, ObjectType::kHash, nowMs());
+    if (!o)
       return std::nullopt;
-    auto itf = it->second.fields.find(field);
-    if (itf == it->second.fields.end())
+    if (o->compact())
+    {
+      for (const auto &p : o->hashPairs())
+      {
+        if (p.first == field)
+          return p.second;
+      }
+      return std::nullopt;
+    }
+    auto itf = o->hash().find(field);
+    if (itf == o->hash().end())
       return std::nullopt;
     return itf->second;
   }
 
   int KeyValueStore::hdel(const std::string &key, const std::vector<std::string> &fields)
   {
-    std::lock_guard<std::mutex> lk(mu_);
-    int64_t now = nowMs();
-    cleanupIfExpiredHash(key, now);
-    auto it = hmap_.find(key);
-    if (it == hmap_.end())
+    Shard &sh = shardFor(key);
+    ShardLock lk(sh);
+    Object *o = lookupTyped(sh, key, ObjectType::kHash, nowMs());
+    if (!o)
       return 0;
     int removed = 0;
-    for (const auto &f : fields)
+    bool empty;
+    if (o->compact())
     {
-      auto itf = it->second.fields.find(f);
-      if (itf != it->second.fields.end())
+      HashPairs &pairs = o->hashPairs();
+      for (const auto &f : fields)
       {
-        it->second.fields.erase(itf);
-        ++removed;
+        auto it = std::find_if(pairs.begin(), pairs.end(), [&](const auto &p)
+                               { return p.first == f; });
+        if (it != pairs.end())
+        {
+          pairs.erase(it);
+          ++removed;
+        }
       }
+      empty = pairs.empty();
     }
-    if (it->second.fields.empty())
+    else
     {
-      hmap_.erase(it);
+      HashFields &map = o->hash();
+      for (const auto &f : fields)
+        removed += static_cast<int>(map.erase(f));
+      empty = map.empty();
+    }
+    if (empty)
+    {
+      bool volatile_key = o->expireAt() >= 0;
+      sh.keys_.erase(key);
+      if (volatile_key)
+        --sh.volatile_keys_;
     }
     return removed;
   }
 
   bool KeyValueStore::hexists(const std::string &key, const std::string &field)
   {
-    std::lock_guard<std::mutex> lk(mu_);
-    int64_t now = nowMs();
-    cleanupIfExpiredHash(key, now);
-    auto it = hmap_.find(key);
-    if (it == hmap_.end())
+    Shard &sh = shardFor(key);
+    ShardLock lk(sh);
+    const Object *o = lookupTyped(sh, key, ObjectType::kHash, nowMs());
+    if (!o)
       return false;
-    return it->second.fields.find(field) != it->second.fields.end();
+    if (o->compact())
+    {
+      const HashPairs &pairs = o->hashPairs();
+      return std::any_of(pairs.begin(), pairs.end(), [&](const auto &p)
+                         { return p.first == field; });
+    }
+    return o->hash().find(field) != o->hash().end();
   }
 
   std::vector<std::string> KeyValueStore::hgetallFlat(const std::string &key)
   {
-    std::lock_guard<std::mutex> lk(mu_);
-    int64_t now = nowMs();
-    cleanupIfExpiredHash(key, now);
+    Shard &sh = shardFor(key);
+    ShardLock lk(sh);
     std::vector<std::string> out;
-    auto it = hmap_.find(key);
-    if (it == hmap_.end())
+    const Object *o = lookupTyped(sh, key, ObjectType::kHash, nowMs());
+    if (!o)
       return out;
-    out.reserve(it->second.fields.size() * 2);
-    for (const auto &kv : it->second.fields)
+    auto append = [&out](const auto &fields)
     {
-      out.push_back(kv.first);
-      out.push_back(kv.second);
-    }
+      out.reserve(fields.size() * 2);
+      for (const auto &kv : fields)
+      {
+        out.push_back(kv.first);
+        out.push_back(kv.second);
+      }
+    };
+    if (o->compact())
+      append(o->hashPairs());
+    else
+      append(o->hash());
     return out;
   }
 
   int KeyValueStore::hlen(const std::string &key)
   {
-    std::lock_guard<std::mutex> lk(mu_);
-    int64_t now = nowMs();
-    cleanupIfExpiredHash(key, now);
-    auto it = hmap_.find(key);
-    if (it == hmap_.end())
+    Shard &sh = shardFor(key);
+    ShardLock lk(sh);
+    const Object *o = lookupTyped(sh, key, ObjectType::kHash, nowMs());
+    if (!o)
       return 0;
-    return static_cast<int>(it->second.fields.size());
+    return static_cast<int>(o->compact() ? o->hashPairs().size() : o->hash().size());
   }
 
   bool KeyValueStore::setHashExpireAtMs(const std::string &key, int64_t expire_at_ms)
   {
-    std::lock_guard<std::mutex> lk(mu_);
-    auto it = hmap_.find(key);
-    if (it == hmap_.end())
+    Shard &sh = shardFor(key);
+    ShardLock lk(sh);
+    Object *o = sh.keys_.find(key);
+    if (!o || o->type() != ObjectType::kHash)
       return false;
-    it->second.expire_at_ms = expire_at_ms;
-    if (expire_at_ms >= 0)
-      expire_index_[key] = expire_at_ms;
-    else
-      expire_index_.erase(key);
+    setExpire(sh, key, *o, expire_at_ms);
     return true;
   }
 
+  // 紧凑编码的 zset 按 (score, member) 排序
+  static bool zsetPairLess(const std::pair<double, std::string> &a, const std::pair<double, std::string> &b)
+  {
+    if (a.first != b.first)
+      return a.first < b.first;
+    return a.second < b.second;
+  }
+
   int KeyValueStore::zadd(const std::string &key, double score, const std::string &member)
   {
-    std::lock_guard<std::mutex> lk(mu_);
-    int64_t now = nowMs();
-    cleanupIfExpiredZSet(key, now);
-    auto &rec = zmap_[key];
-    auto mit = rec.member_to_score.find(member);
-    if (mit == rec.member_to_score.end())
+    Shard &sh = shardFor(key);
+    ShardLock lk(sh);
+    Object &o = obtain(sh, key, ObjectType::kZSet, nowMs());
+    if (o.compact())
     {
-      if (!rec.use_skiplist)
+      ZSetPairs &vec = o.zsetPairs();
+      auto old = std::find_if(vec.begin(), vec.end(), [&](const auto &p)
+                              { return p.second == member; });
+      int added = 1;
+      if (old != vec.end())
       {
-        auto &vec = rec.items;
-        auto it = std::lower_bound(vec.begin(), vec.end(), std::make_pair(score, member),
-                                   [](const auto &a, const auto &b)
-                                   {
-                                     if (a.first != b.first)
-                                       return a.first < b.first;
-                                     return a.second < b.second;
-                                   });
-        vec.insert(it, std::make_pair(score, member));
-        if (vec.size() > kZsetVectorThreshold)
-        {
-          rec.use_skiplist = true;
-          rec.sl = std::make_unique<Skiplist>();
-          for (const auto &pr : vec)
-            rec.sl->insert(pr.first, pr.second);
-          std::vector<std::pair<double, std::string>>().swap(rec.items);
-        }
-      }
-      else
-      {
-        rec.sl->insert(score, member);
+        if (old->first == score)
+          return 0;
+        vec.erase(old);
+        added = 0;
       }
+      auto pr = std::make_pair(score, member);
+      vec.insert(std::lower_bound(vec.begin(), vec.end(), pr, zsetPairLess), std::move(pr));
+      if (vec.size() > kCompactMaxEntries)
+        o.convert();
+      return added;
+    }
+    ZSetRecord &rec = o.zset();
+    auto mit = rec.member_to_score.find(member);
+    if (mit == rec.member_to_score.end())
+    {
+      rec.sl.insert(score, member);
       rec.member_to_score.emplace(member, score);
       return 1;
     }
-    else
-    {
-      double old = mit->second;
-      if (old == score)
-        return 0;
-      if (!rec.use_skiplist)
-      {
-        auto &vec = rec.items;
-        for (auto vit = vec.begin(); vit != vec.end(); ++vit)
-        {
-          if (vit->first == old && vit->second == member)
-          {
-            vec.erase(vit);
-            break;
-          }
-        }
-        auto it = std::lower_bound(vec.begin(), vec.end(), std::make_pair(score, member),
-                                   [](const auto &a, const auto &b)
-                                   {
-                                     if (a.first != b.first)
-                                       return a.first < b.first;
-                                     return a.second < b.second;
-                                   });
-        vec.insert(it, std::make_pair(score, member));
-        if (vec.size() > kZsetVectorThreshold)
-        {
-          rec.use_skiplist = true;
-          rec.sl = std::make_unique<Skiplist>();
-          for (const auto &pr : vec)
-            rec.sl->insert(pr.first, pr.second);
-          std::vector<std::pair<double, std::string>>().swap(rec.items);
-        }
-      }
-      else
-      {
-        rec.sl->erase(old, member);
-        rec.sl->insert(score, member);
-      }
-      mit->second = score;
+    if (mit->second == score)
       return 0;
-    }
+    rec.sl.erase(mit->second, member);
+    rec.sl.insert(score, member);
+    mit->second = score;
+    return 0;
   }
 
   int KeyValueStore::zrem(const std::string &key, const std::vector<std::string> &members)
   {
-    std::lock_guard<std::mutex> lk(mu_);
-    int64_t now = nowMs();
-    cleanupIfExpiredZSet(key, now);
-    auto it = zmap_.find(key);
-    if (it == zmap_.end())
+    Shard &sh = shardFor(key);
+    ShardLock lk(sh);
+    Object *o = lookupTyped(sh, key, ObjectType::kZSet, nowMs());
+    if (!o)
       return 0;
     int removed = 0;
-    for (const auto &m : members)
-    {
-      auto mit = it->second.member_to_score.find(m);
-      if (mit == it->second.member_to_score.end())
-        continue;
-      double sc = mit->second;
-      it->second.member_to_score.erase(mit);
-      if (!it->second.use_skiplist)
+    bool empty;
+    if (o->compact())
+    {
+      ZSetPairs &vec = o->zsetPairs();
+      for (const auto &m : members)
       {
-        auto &vec = it->second.items;
-        for (auto vit = vec.begin(); vit != vec.end(); ++vit)
+        auto it = std::find_if(vec.begin(), vec.end(), [&](const auto &p)
+                               { return p.second == m; });
+        if (it != vec.end())
         {
-          if (vit->first == sc && vit->second == m)
-          {
-            vec.erase(vit);
-            ++removed;
-            break;
-          }
+          vec.erase(it);
+          ++removed;
         }
       }
-      else
+      empty = vec.empty();
+    }
+    else
+    {
+      ZSetRecord &rec = o->zset();
+      for (const auto &m : members)
       {
-        if (it->second.sl->erase(sc, m))
+        auto mit = rec.member_to_score.find(m);
+        if (mit == rec.member_to_score.end())
+          continue;
+        if (rec.sl.erase(mit->second, m))
           ++removed;
+        rec.member_to_score.erase(mit);
       }
+      empty = rec.sl.size() == 0;
     }
-    if (!it->second.use_skiplist)
-    {
-      if (it->second.items.empty())
-        zmap_.erase(it);
-    }
-    else
+    if (empty)
     {
-      if (it->second.sl->size() == 0)
-        zmap_.erase(it);
+      bool volatile_key = o->expireAt() >= 0;
+      sh.keys_.erase(key);
+      if (volatile_key)
+        --sh.volatile_keys_;
     }
     return removed;
   }
 
   std::vector<std::string> KeyValueStore::zrange(const std::string &key, int64_t start, int64_t stop)
   {
-    std::lock_guard<std::mutex> lk(mu_);
-    int64_t now = nowMs();
-    cleanupIfExpiredZSet(key, now);
+    Shard &sh = shardFor(key);
+    ShardLock lk(sh);
     std::vector<std::string> out;
-    auto it = zmap_.find(key);
-    if (it == zmap_.end())
+    const Object *o = lookupTyped(sh, key, ObjectType::kZSet, nowMs());
+    if (!o)
       return out;
-    if (!it->second.use_skiplist)
+    if (o->compact())
     {
-      const auto &vec = it->second.items;
+      const auto &vec = o->zsetPairs();
       int64_t n = static_cast<int64_t>(vec.size());
       if (n == 0)
         return out;
@@ -678,36 +1066,42 @@ namespace mini_redis
     }
     else
     {
-      it->second.sl->rangeByRank(start, stop, out);
+      o->zset().sl.rangeByRank(start, stop, out);
     }
     return out;
   }
 
   std::optional<double> KeyValueStore::zscore(const std::string &key, const std::string &member)
   {
-    std::lock_guard<std::mutex> lk(mu_);
-    int64_t now = nowMs();
-    cleanupIfExpiredZSet(key, now);
-    auto it = zmap_.find(key);
-    if (it == zmap_.end())
+    Shard &sh = shardFor(key);
+    ShardLock lk(sh);
+    const Object *o = lookupTyped(sh, key, ObjectType::kZSet, nowMs());
+    if (!o)
+      return std::nullopt;
+    if (o->compact())
+    {
+      for (const auto &p : o->zsetPairs())
+      {
+        if (p.second == member)
+          return p.first;
+      }
       return std::nullopt;
-    auto mit = it->second.member_to_score.find(member);
-    if (mit == it->second.member_to_score.end())
+    }
+    const ZSetRecord &rec = o->zset();
+    auto mit = rec.member_to_score.find(member);
+    if (mit == rec.member_to_score.end())
       return std::nullopt;
     return mit->second;
   }
 
   bool KeyValueStore::setZSetExpireAtMs(const std::string &key, int64_t expire_at_ms)
   {
-    std::lock_guard<std::mutex> lk(mu_);
-    auto it = zmap_.find(key);
-    if (it == zmap_.end())
+    Shard &sh = shardFor(key);
+    ShardLock lk(sh);
+    Object *o = sh.keys_.find(key);
+    if (!o || o->type() != ObjectType::kZSet)
       return false;
-    it->second.expire_at_ms = expire_at_ms;
-    if (expire_at_ms >= 0)
-      expire_index_[key] = expire_at_ms;
-    else
-      expire_index_.erase(key);
+    setExpire(sh, key, *o, expire_at_ms);
     return true;
   }
 
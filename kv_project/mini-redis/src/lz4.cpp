@@ -0,0 +1,209 @@
+/**
+ * 创建者：程序员老廖
+ * 日期：2025年8月12日
+ */
+
+#include "mini_redis/lz4.hpp"
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace mini_redis
+{
+
+  // 序列 = token(高 4 位字面量长度，低 4 位匹配长度 - 4) [扩展长度] 字面量 offset(2B LE) [扩展长度]；
+  // 长度字段为 15 时后面跟若干字节继续累加，遇到非 255 的字节结束。
+  // 格式约束：最后 5 个字节必须是字面量，最后一个匹配必须在结尾前 12 字节之前开始
+  static const size_t kMinMatch = 4;
+  static const size_t kLastLiterals = 5;
+  static const size_t kMatchFindLimit = 12;
+  static const size_t kMaxDistance = 65535;
+  static const int kHashLog = 16;
+
+  static inline uint32_t read32(const uint8_t *p)
+  {
+    uint32_t v;
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+  }
+
+  static inline uint64_t read64(const uint8_t *p)
+  {
+    uint64_t v;
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+  }
+
+  static inline uint32_t hashSeq(uint32_t seq) { return (seq * 2654435761u) >> (32 - kHashLog); }
+
+  static inline uint8_t *writeLength(uint8_t *op, size_t len)
+  {
+    while (len >= 255)
+    {
+      *op++ = 255;
+      len -= 255;
+    }
+    *op++ = static_cast<uint8_t>(len);
+    return op;
+  }
+
+  // 输出一个序列：anchor 起 lit 个字面量，随后（match_len > 0 时）一个 offset / match_len 的匹配
+  static inline uint8_t *emitSequence(uint8_t *op, const uint8_t *anchor, size_t lit, size_t offset, size_t match_len)
+  {
+    uint8_t *token = op++;
+    if (lit >= 15)
+    {
+      *token = 15 << 4;
+      op = writeLength(op, lit - 15);
+    }
+    else
+    {
+      *token = static_cast<uint8_t>(lit << 4);
+    }
+    std::memcpy(op, anchor, lit);
+    op += lit;
+    if (match_len == 0)
+      return op;
+    *op++ = static_cast<uint8_t>(offset);
+    *op++ = static_cast<uint8_t>(offset >> 8);
+    size_t ml = match_len - kMinMatch;
+    if (ml >= 15)
+    {
+      *token |= 15;
+      op = writeLength(op, ml - 15);
+    }
+    else
+    {
+      *token |= static_cast<uint8_t>(ml);
+    }
+    return op;
+  }
+
+  size_t lz4CompressBound(size_t n) { return n + n / 255 + 16; }
+
+  size_t lz4Compress(const char *src, size_t n, char *dst)
+  {
+    const uint8_t *base = reinterpret_cast<const uint8_t *>(src);
+    const uint8_t *ip = base;
+    const uint8_t *anchor = base;
+    const uint8_t *iend = base + n;
+    uint8_t *op = reinterpret_cast<uint8_t *>(dst);
+    if (n > kMatchFindLimit)
+    {
+      const uint8_t *mflimit = iend - kMatchFindLimit;
+      const uint8_t *matchlimit = iend - kLastLiterals;
+      // 哈希表存相对 base 的位置；初值 0 指向开头，命中时仍会校验距离与内容
+      std::vector<uint32_t> table(size_t(1) << kHashLog, 0);
+      while (ip < mflimit)
+      {
+        uint32_t seq = read32(ip);
+        uint32_t h = hashSeq(seq);
+        const uint8_t *ref = base + table[h];
+        table[h] = static_cast<uint32_t>(ip - base);
+        if (ref >= ip || static_cast<size_t>(ip - ref) > kMaxDistance || read32(ref) != seq)
+        {
+          // 连续找不到匹配时步长逐渐变大，不可压缩的数据也能快速跳过
+          ip += 1 + (static_cast<size_t>(ip - anchor) >> 6);
+          continue;
+        }
+        // 向前扩展：匹配可能在命中位置之前就开始了
+        while (ip > anchor && ref > base && ip[-1] == ref[-1])
+        {
+          --ip;
+          --ref;
+        }
+        // 向后扩展，每次比较 8 字节
+        const uint8_t *mp = ip + kMinMatch;
+        const uint8_t *rp = ref + kMinMatch;
+        while (mp + 8 <= matchlimit)
+        {
+          uint64_t diff = read64(mp) ^ read64(rp);
+          if (diff != 0)
+          {
+            mp += __builtin_ctzll(diff) >> 3;
+            goto matched;
+          }
+          mp += 8;
+          rp += 8;
+        }
+        while (mp < matchlimit && *mp == *rp)
+        {
+          ++mp;
+          ++rp;
+        }
+      matched:
+        op = emitSequence(op, anchor, static_cast<size_t>(ip - anchor), static_cast<size_t>(ip - ref), static_cast<size_t>(mp - ip));
+        ip = mp;
+        anchor = ip;
+        // 匹配结尾附近的位置也登记进哈希表，提高下一次命中率
+        if (ip < mflimit)
+          table[hashSeq(read32(ip - 2))] = static_cast<uint32_t>(ip - 2 - base);
+      }
+    }
+    op = emitSequence(op, anchor, static_cast<size_t>(iend - anchor), 0, 0);
+    return static_cast<size_t>(op - reinterpret_cast<uint8_t *>(dst));
+  }
+
+  bool lz4Decompress(const char *src, size_t n, char *dst, size_t raw_len)
+  {
+    const uint8_t *ip = reinterpret_cast<const uint8_t *>(src);
+    const uint8_t *iend = ip + n;
+    uint8_t *out = reinterpret_cast<uint8_t *>(dst);
+    uint8_t *op = out;
+    uint8_t *oend = out + raw_len;
+    auto readLength = [&](size_t &len) -> bool
+    {
+      uint8_t b = 0;
+      do
+      {
+        if (ip >= iend)
+          return false;
+        b = *ip++;
+        len += b;
+      } while (b == 255);
+      return true;
+    };
+    while (ip < iend)
+    {
+      uint8_t token = *ip++;
+      size_t lit = token >> 4;
+      if (lit == 15 && !readLength(lit))
+        return false;
+      if (lit > static_cast<size_t>(iend - ip) || lit > static_cast<size_t>(oend - op))
+        return false;
+      std::memcpy(op, ip, lit);
+      op += lit;
+      ip += lit;
+      // 最后一个序列只有字面量
+      if (ip == iend)
+        break;
+      if (iend - ip < 2)
+        return false;
+      size_t offset = static_cast<size_t>(ip[0]) | (static_cast<size_t>(ip[1]) << 8);
+      ip += 2;
+      if (offset == 0 || offset > static_cast<size_t>(op - out))
+        return false;
+      size_t match_len = token & 15;
+      if (match_len == 15 && !readLength(match_len))
+        return false;
+      match_len += kMinMatch;
+      if (match_len > static_cast<size_t>(oend - op))
+        return false;
+      const uint8_t *m = op - offset;
+      if (offset >= match_len)
+      {
+        std::memcpy(op, m, match_len);
+        op += match_len;
+      }
+      else
+      {
+        // 重叠复制（如 offset=1 的游程），必须逐字节向前
+        for (size_t i = 0; i < match_len; ++i)
+          *op++ = m[i];
+      }
+    }
+    return op == oend;
+  }
+
+} // namespace mini_redis
@@ -73,6 +73,8 @@ namespace mini_redis
   {
     std::signal(SIGINT, handle_signal);
     std::signal(SIGTERM, handle_signal);
+    // 对端（客户端 / 正在全量同步的副本）中途断开时 write 返回 EPIPE 即可，不能让进程被 SIGPIPE 杀掉
+    std::signal(SIGPIPE, SIG_IGN);
     mini_redis::Server srv(config);
     return srv.run();
   }
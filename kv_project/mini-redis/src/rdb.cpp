@@ -5,14 +5,27 @@
 
 #include "mini_redis/rdb.hpp"
 
+#include "mini_redis/crc64.hpp"
 #include "mini_redis/kv.hpp"
+#include "mini_redis/log.hpp"
+#include "mini_redis/lz4.hpp"
 
 #include <fcntl.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <unistd.h>
 
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <deque>
 #include <filesystem>
+#include <memory>
+#include <string_view>
 
 namespace mini_redis
 {
@@ -28,148 +41,1334 @@ namespace mini_redis
 
   std::string Rdb::path() const { return joinPath(opts_.dir, opts_.filename); }
 
-  bool Rdb::save(const KeyValueStore &store, std::string &err) const
+  // MRDB3 二进制格式（整数均为小端）：
+  //   "MRDB3\n"
+  //   0xFB key 总数(varint)：加载前据此预分配键空间（可选，没有时按默认扩容）
+  //   0xFA：文件末尾带分块索引（可选）
+  //   0xF9：记录区分帧存放（可选，总是与 0xFA 同时出现）：开启压缩时，以及无盘全量同步的字节流
+  //   记录*：type(1B) expire(varint，expire_at_ms + 1，0 表示无 TTL) key(varint 长度 + 字节) 值
+  //     string：value
+  //     hash  ：varint 字段数，之后每个字段 field value
+  //     zset  ：varint 成员数，之后每个成员 member score(8B IEEE-754 double)
+  //   分帧时记录区换成若干帧：0xF8 codec(1B，0 原样 / 1 LZ4) varint 原始长度 varint 载荷长度 载荷，
+  //     每帧解出来就是一个完整的块（若干条记录）；未开启压缩或压缩不划算的块原样存放
+  //   0xFE 分块索引（有 0xFA 时）：varint 块数，每块 varint 偏移 + varint 长度（压缩时为整帧）；之后 8B 索引起始偏移
+  //   0xFF 结束标记
+  //   crc64(8B)：覆盖从 magic 到结束标记的全部字节
+  // 字符串均为 varint 长度 + 原始字节。旧的文本格式 MRDB1/MRDB2 仍可读取。
+  // 分块按记录边界切分（约 kChunkBytes 一块），各块互不依赖，加载时可由多个线程并行解码并插入。
+  // CRC 覆盖的是文件中的字节（压缩后的帧），加载时先校验再解压。
+  static const char kMagicV3[] = "MRDB3\n";
+  static const uint8_t kTypeString = 1;
+  static const uint8_t kTypeHash = 2;
+  static const uint8_t kTypeZSet = 3;
+  static const uint8_t kOpBlock = 0xF8;
+  static const uint8_t kOpFramed = 0xF9;
+  static const uint8_t kOpChunked = 0xFA;
+  static const uint8_t kOpResize = 0xFB;
+  static const uint8_t kOpChunkIndex = 0xFE;
+  static const uint8_t kTypeEof = 0xFF;
+  static const uint64_t kChunkBytes = 2u << 20;
+  static const uint8_t kCodecRaw = 0;
+  static const uint8_t kCodecLz4 = 1;
+
+  static void appendVarint(std::string &out, uint64_t v)
+  {
+    while (v >= 0x80)
+    {
+      out.push_back(static_cast<char>((v & 0x7F) | 0x80));
+      v >>= 7;
+    }
+    out.push_back(static_cast<char>(v));
+  }
+
+  // 压缩线程：按提交顺序逐块压缩成帧。序列化线程提交一块后立刻继续编码下一块，
+  // 并顺带写出已经压缩好的帧，于是压缩与编码、写盘重叠进行；在途块数有上限，内存占用有界。
+  // compress 为 false 时只分帧不压缩（无盘同步未开启压缩时）
+  class BlockCompressor
+  {
+  public:
+    explicit BlockCompressor(bool compress) : compress_(compress), worker_(&BlockCompressor::run, this) {}
+    ~BlockCompressor()
+    {
+      {
+        std::lock_guard<std::mutex> lk(mu_);
+        stop_ = true;
+      }
+      cv_.notify_all();
+      worker_.join();
+    }
+    BlockCompressor(const BlockCompressor &) = delete;
+    BlockCompressor &operator=(const BlockCompressor &) = delete;
+
+    // 提交一块原始记录；在途块已满时先等最早的一块压缩完成
+    void submit(std::string raw)
+    {
+      auto b = std::make_unique<Block>();
+      b->raw = std::move(raw);
+      std::unique_lock<std::mutex> lk(mu_);
+      done_cv_.wait(lk, [&]
+                    { return q_.size() < kMaxInFlight || q_.front()->done; });
+      q_.push_back(std::move(b));
+      cv_.notify_all();
+    }
+
+    // 取出最早提交的一帧。wait 为 false 时它还没压缩完就返回 false；队列为空也返回 false
+    bool pop(std::string &frame, bool wait)
+    {
+      std::unique_lock<std::mutex> lk(mu_);
+      if (wait)
+        done_cv_.wait(lk, [&]
+                      { return q_.empty() || q_.front()->done; });
+      if (q_.empty() || !q_.front()->done)
+        return false;
+      frame = std::move(q_.front()->frame);
+      q_.pop_front();
+      --next_;
+      done_cv_.notify_all();
+      return true;
+    }
+
+    RdbCompressStats stats() const
+    {
+      std::lock_guard<std::mutex> lk(mu_);
+      return stats_;
+    }
+
+  private:
+    static constexpr size_t kMaxInFlight = 4;
+
+    struct Block
+    {
+      std::string raw;
+      std::string frame;
+      bool done = false;
+    };
+
+    void run()
+    {
+      std::unique_lock<std::mutex> lk(mu_);
+      while (true)
+      {
+        cv_.wait(lk, [&]
+                 { return stop_ || next_ < q_.size(); });
+        if (stop_)
+          return;
+        // 只有 done 的块会被取走，未压缩的块地址在此期间不变
+        Block *b = q_[next_].get();
+        uint64_t raw_bytes = b->raw.size();
+        lk.unlock();
+        auto t0 = std::chrono::steady_clock::now();
+        encode(*b);
+        int64_t us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - t0).count();
+        lk.lock();
+        stats_.raw_bytes += raw_bytes;
+        stats_.stored_bytes += b->frame.size();
+        stats_.compress_us += us;
+        b->done = true;
+        ++next_;
+        done_cv_.notify_all();
+      }
+    }
+
+    void encode(Block &b)
+    {
+      size_t n = b.raw.size();
+      if (compress_)
+      {
+        scratch_.resize(lz4CompressBound(b.raw.size()));
+        n = lz4Compress(b.raw.data(), b.raw.size(), scratch_.data());
+      }
+      bool packed = n < b.raw.size();
+      const std::string_view payload = packed ? std::string_view(scratch_.data(), n) : std::string_view(b.raw);
+      b.frame.clear();
+      b.frame.reserve(payload.size() + 24);
+      b.frame.push_back(static_cast<char>(kOpBlock));
+      b.frame.push_back(static_cast<char>(packed ? kCodecLz4 : kCodecRaw));
+      appendVarint(b.frame, b.raw.size());
+      appendVarint(b.frame, payload.size());
+      b.frame.append(payload.data(), payload.size());
+      std::string().swap(b.raw);
+    }
+
+    mutable std::mutex mu_;
+    std::condition_variable cv_;      // 有新块或要求退出
+    std::condition_variable done_cv_; // 有块压缩完成或被取走
+    std::deque<std::unique_ptr<Block>> q_;
+    size_t next_ = 0; // q_ 中下一个待压缩块的下标
+    bool stop_ = false;
+    const bool compress_;
+    std::string scratch_;
+    RdbCompressStats stats_;
+    std::thread worker_; // 最后构造，启动时其余成员已就绪
+  };
+
+  // 带 1MB 缓冲的顺序写，写出时顺带累计 CRC64；任何一次 write（或 sink）失败后 finish() 返回 false。
+  // beginChunks() 与 endChunks() 之间写入的是记录区，由 cutChunk() 在记录边界切块并登记索引；
+  // 传入压缩器时记录区改为整块交给它压缩，写出的是压缩后的帧
+  class RdbWriter
+  {
+  public:
+    explicit RdbWriter(int fd) : fd_(fd) { buf_.reserve(kBufSize); }
+    // 写到 sink 而不是文件（无盘全量同步）
+    explicit RdbWriter(const Rdb::Sink &sink) : fd_(-1), sink_(&sink) { buf_.reserve(kBufSize); }
+
+    void raw(const void *p, size_t n)
+    {
+      const char *c = static_cast<const char *>(p);
+      if (bc_)
+      {
+        buf_.append(c, n);
+        return;
+      }
+      if (buf_.size() + n > kBufSize)
+      {
+        flush();
+        // 大值直接写出，不经过缓冲
+        if (n >= kBufSize)
+        {
+          emit(c, n);
+          return;
+        }
+      }
+      buf_.append(c, n);
+    }
+
+    void byte(uint8_t b) { raw(&b, 1); }
+
+    // 已写出（含缓冲中）的字节数，即下一个字节在文件中的偏移；记录区压缩期间无意义
+    uint64_t offset() const { return written_ + buf_.size(); }
+
+    void beginChunks(BlockCompressor *bc)
+    {
+      if (bc)
+      {
+        flush();
+        bc_ = bc;
+        buf_.reserve(kChunkBytes + (64u << 10));
+      }
+      chunk_start_ = offset();
+    }
+
+    // 当前块已累计的记录字节数
+    uint64_t chunkBytes() const { return bc_ ? buf_.size() : offset() - chunk_start_; }
+
+    void cutChunk()
+    {
+      if (bc_)
+      {
+        if (buf_.empty())
+          return;
+        std::string block;
+        block.reserve(kChunkBytes + (64u << 10));
+        block.swap(buf_);
+        bc_->submit(std::move(block));
+        drainFrames(false);
+        return;
+      }
+      uint64_t off = offset();
+      if (off > chunk_start_)
+      {
+        chunks_.emplace_back(chunk_start_, off - chunk_start_);
+        chunk_start_ = off;
+      }
+    }
+
+    // 结束记录区：切出最后一块，压缩时等全部帧写出；返回块索引（文件中的偏移与长度）
+    const std::vector<std::pair<uint64_t, uint64_t>> &endChunks()
+    {
+      cutChunk();
+      if (bc_)
+      {
+        drainFrames(true);
+        bc_ = nullptr;
+        buf_.clear();
+        buf_.shrink_to_fit();
+        buf_.reserve(kBufSize);
+      }
+      return chunks_;
+    }
+
+    void varint(uint64_t v)
+    {
+      char tmp[10];
+      size_t n = 0;
+      while (v >= 0x80)
+      {
+        tmp[n++] = static_cast<char>((v & 0x7F) | 0x80);
+        v >>= 7;
+      }
+      tmp[n++] = static_cast<char>(v);
+      raw(tmp, n);
+    }
+
+    void str(const std::string &s)
+    {
+      varint(s.size());
+      raw(s.data(), s.size());
+    }
+
+    void u64le(uint64_t v)
+    {
+      char tmp[8];
+      for (int i = 0; i < 8; ++i)
+        tmp[i] = static_cast<char>(v >> (8 * i));
+      raw(tmp, 8);
+    }
+
+    void f64(double d)
+    {
+      uint64_t bits;
+      std::memcpy(&bits, &d, sizeof(bits));
+      u64le(bits);
+    }
+
+    // 追加 CRC 并写出剩余数据
+    bool finish()
+    {
+      flush();
+      uint64_t crc = crc_;
+      u64le(crc);
+      flush();
+      return ok_;
+    }
+
+  private:
+    static constexpr size_t kBufSize = 1 << 20;
+
+    void flush()
+    {
+      if (buf_.empty())
+        return;
+      emit(buf_.data(), buf_.size());
+      buf_.clear();
+    }
+
+    void emit(const char *p, size_t n)
+    {
+      crc_ = crc64(crc_, p, n);
+      writeAll(p, n);
+      written_ += n;
+    }
+
+    // 按提交顺序写出已压缩好的帧并登记索引；wait 为 true 时写完所有在途帧
+    void drainFrames(bool wait)
+    {
+      std::string frame;
+      while (bc_->pop(frame, wait))
+      {
+        chunks_.emplace_back(written_, frame.size());
+        emit(frame.data(), frame.size());
+      }
+    }
+
+    void writeAll(const char *p, size_t n)
+    {
+      if (sink_)
+      {
+        ok_ = ok_ && (*sink_)(p, n);
+        return;
+      }
+      while (ok_ && n > 0)
+      {
+        ssize_t w = ::write(fd_, p, n);
+        if (w < 0)
+        {
+          if (errno == EINTR)
+            continue;
+          ok_ = false;
+          return;
+        }
+        p += w;
+        n -= static_cast<size_t>(w);
+      }
+    }
+
+    int fd_;
+    const Rdb::Sink *sink_ = nullptr;
+    std::string buf_;
+    uint64_t written_ = 0;
+    uint64_t crc_ = 0;
+    bool ok_ = true;
+    BlockCompressor *bc_ = nullptr;
+    uint64_t chunk_start_ = 0;
+    std::vector<std::pair<uint64_t, uint64_t>> chunks_;
+  };
+
+  class RdbReader
+  {
+  public:
+    RdbReader(const char *p, size_t n) : p_(p), end_(p + n) {}
+
+    bool byte(uint8_t &b)
+    {
+      if (p_ >= end_)
+        return false;
+      b = static_cast<uint8_t>(*p_++);
+      return true;
+    }
+
+    bool varint(uint64_t &v)
+    {
+      v = 0;
+      for (int shift = 0; shift < 64 && p_ < end_; shift += 7)
+      {
+        uint8_t b = static_cast<uint8_t>(*p_++);
+        v |= static_cast<uint64_t>(b & 0x7F) << shift;
+        if ((b & 0x80) == 0)
+          return true;
+      }
+      return false;
+    }
+
+    bool str(std::string &s)
+    {
+      uint64_t n = 0;
+      if (!varint(n) || n > static_cast<uint64_t>(end_ - p_))
+        return false;
+      s.assign(p_, static_cast<size_t>(n));
+      p_ += n;
+      return true;
+    }
+
+    bool f64(double &d)
+    {
+      if (end_ - p_ < 8)
+        return false;
+      uint64_t bits = 0;
+      for (int i = 7; i >= 0; --i)
+        bits = (bits << 8) | static_cast<unsigned char>(p_[i]);
+      p_ += 8;
+      std::memcpy(&d, &bits, sizeof(d));
+      return true;
+    }
+
+    const char *pos() const { return p_; }
+    bool atEnd() const { return p_ >= end_; }
+    size_t remaining() const { return static_cast<size_t>(end_ - p_); }
+    void skip(size_t n) { p_ += std::min(n, remaining()); }
+
+  private:
+    const char *p_;
+    const char *end_;
+  };
+
+  // 只读映射整个 RDB 文件，顺序访问；已解析过的前缀可以 release() 归还，
+  // 加载期间常驻的文件页只有当前窗口，而不是一份完整的文件拷贝
+  class MappedFile
+  {
+  public:
+    MappedFile() = default;
+    ~MappedFile()
+    {
+      if (data_)
+        ::munmap(const_cast<char *>(data_), size_);
+    }
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    // 文件不存在返回 false 且 err 为空；其它失败时填充 err
+    bool open(const std::string &path, std::string &err)
+    {
+      int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+      if (fd < 0)
+      {
+        if (errno != ENOENT)
+          err = "open rdb";
+        return false;
+      }
+      struct stat st{};
+      if (::fstat(fd, &st) < 0)
+      {
+        ::close(fd);
+        err = "stat rdb";
+        return false;
+      }
+      size_ = static_cast<size_t>(st.st_size);
+      if (size_ > 0)
+      {
+        void *p = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p == MAP_FAILED)
+        {
+          ::close(fd);
+          err = "mmap rdb";
+          return false;
+        }
+        data_ = static_cast<const char *>(p);
+        ::madvise(p, size_, MADV_SEQUENTIAL);
+      }
+      // 映射建立后即可关闭 fd
+      ::close(fd);
+      return true;
+    }
+
+    const char *data() const { return data_; }
+    size_t size() const { return size_; }
+    std::string_view view() const { return std::string_view(data_, size_); }
+
+    // [data, upto) 已经用完：每攒够 kReleaseStep 就对整页部分 MADV_DONTNEED
+    void release(const char *upto)
+    {
+      size_t off = static_cast<size_t>(upto - data_);
+      if (off < released_ + kReleaseStep)
+        return;
+      size_t page = static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+      size_t end = off / page * page;
+      ::madvise(const_cast<char *>(data_) + released_, end - released_, MADV_DONTNEED);
+      released_ = end;
+    }
+
+    // 归还 [begin, end) 内完整的页；可在多个线程中并发调用
+    void releaseRange(const char *begin, const char *end) const
+    {
+      size_t page = static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+      size_t b = (static_cast<size_t>(begin - data_) + page - 1) / page * page;
+      size_t e = static_cast<size_t>(end - data_) / page * page;
+      if (e > b)
+        ::madvise(const_cast<char *>(data_) + b, e - b, MADV_DONTNEED);
+    }
+
+  private:
+    static constexpr size_t kReleaseStep = 64u << 20;
+    const char *data_ = nullptr;
+    size_t size_ = 0;
+    size_t released_ = 0;
+  };
+
+  Rdb::~Rdb()
+  {
+    if (saver_thread_.joinable())
+      saver_thread_.join();
+  }
+
+  Rdb::Snapshot Rdb::takeSnapshot(const KeyValueStore &store)
+  {
+    Snapshot snap;
+    snap.strs = store.snapshot();
+    snap.hashes = store.snapshotHash();
+    snap.zsets = store.snapshotZSet();
+    return snap;
+  }
+
+  bool Rdb::save(const KeyValueStore &store, std::string &err)
   {
     if (!opts_.enabled)
       return true;
+    bool expected = false;
+    if (!saving_.compare_exchange_strong(expected, true))
+    {
+      err = "Background save already in progress";
+      return false;
+    }
+    RdbCompressStats stats;
+    bool ok = writeSnapshot(takeSnapshotLocked(store), stats, err);
+    if (ok)
+      setCompressStats(stats);
+    saving_.store(false);
+    return ok;
+  }
+
+  bool Rdb::bgSave(const KeyValueStore &store, std::mutex &snapshot_mu, std::string &err)
+  {
+    if (!opts_.enabled)
+    {
+      err = "rdb disabled";
+      return false;
+    }
+    bool expected = false;
+    if (!saving_.compare_exchange_strong(expected, true))
+    {
+      err = "Background save already in progress";
+      return false;
+    }
+    // 上一次的线程已经结束（saving_ 已复位），回收后才能复用 std::thread
+    if (saver_thread_.joinable())
+      saver_thread_.join();
+    saver_thread_ = std::thread(&Rdb::bgSaveLoop, this, &store, &snapshot_mu);
+    return true;
+  }
+
+  void Rdb::bgSaveLoop(const KeyValueStore *store, std::mutex *snapshot_mu)
+  {
+    auto start = std::chrono::steady_clock::now();
+    Snapshot snap;
+    {
+      std::lock_guard<std::mutex> lk(*snapshot_mu);
+      snap = takeSnapshotLocked(*store);
+    }
+    std::string err;
+    RdbCompressStats stats;
+    bool ok = writeSnapshot(snap, stats, err);
+    if (ok)
+      setCompressStats(stats);
+    else
+      MR_LOG("ERROR", "background rdb save failed: " << err);
+    last_bgsave_ok_.store(ok);
+    last_bgsave_time_ms_.store(std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count());
+    saving_.store(false);
+  }
+
+  void Rdb::setCompressStats(const RdbCompressStats &stats)
+  {
+    last_raw_bytes_.store(stats.raw_bytes);
+    last_stored_bytes_.store(stats.stored_bytes);
+    last_compress_us_.store(stats.compress_us);
+  }
+
+  RdbCompressStats Rdb::lastCompressStats() const
+  {
+    RdbCompressStats stats;
+    stats.raw_bytes = last_raw_bytes_.load();
+    stats.stored_bytes = last_stored_bytes_.load();
+    stats.compress_us = last_compress_us_.load();
+    return stats;
+  }
+
+  bool Rdb::writeSnapshot(const Snapshot &snap, RdbCompressStats &stats, std::string &err) const
+  {
     std::error_code ec;
     std::filesystem::create_directories(opts_.dir, ec);
-    int fd = ::open(path().c_str(), O_CREAT | O_TRUNC | O_WRONLY, 0644);
+    std::string tmp_path = path() + ".tmp";
+    int fd = ::open(tmp_path.c_str(), O_CREAT | O_TRUNC | O_WRONLY, 0644);
     if (fd < 0)
     {
       err = "open rdb failed";
       return false;
     }
-    auto snap_str = store.snapshot();
-    auto snap_hash = store.snapshotHash();
-    auto snap_zset = store.snapshotZSet();
-    // MRDB2
-    // Header: MRDB2\n
-    // Strings: STR count\n then per line: klen key vlen value expire_ms\n
-    // Hash: HASH count\n then per hash: klen key expire_ms num_fields\n then num_fields lines: flen field vlen value\n
-    // ZSet: ZSET count\n then per zset: klen key expire_ms num_items\n then num_items lines: score member_len member\n
-    std::string header = std::string("MRDB2\n");
-    if (::write(fd, header.data(), header.size()) < 0)
+    RdbWriter w(fd);
+    if (!encodeSnapshot(w, snap, opts_.compression, opts_.compression, stats))
     {
       ::close(fd);
-      err = "write hdr";
+      err = "write rdb";
       return false;
     }
-    // STR section
-    std::string line = std::string("STR ") + std::to_string(snap_str.size()) + "\n";
-    if (::write(fd, line.data(), line.size()) < 0)
+    if (::fsync(fd) < 0)
     {
       ::close(fd);
-      err = "write str cnt";
+      err = "fsync rdb";
+      return false;
+    }
+    struct stat st;
+    uint64_t rdb_bytes = ::fstat(fd, &st) == 0 ? static_cast<uint64_t>(st.st_size) : 0;
+    ::close(fd);
+    if (::rename(tmp_path.c_str(), path().c_str()) < 0)
+    {
+      err = "rename rdb";
       return false;
     }
-    for (const auto &kv : snap_str)
+    if (!snap.has_repl)
+      return true;
+    // 位置文件在 RDB 之后落地：两次 rename 之间崩溃时旧位置文件与新 RDB 大小对不上，重启时按未知处理
+    if (snap.repl.offset < 0)
     {
-      const std::string &k = kv.first;
-      const ValueRecord &r = kv.second;
-      std::string rec;
-      rec.append(std::to_string(k.size())).append(" ").append(k).append(" ").append(std::to_string(r.value.size())).append(" ").append(r.value).append(" ").append(std::to_string(r.expire_at_ms)).append("\n");
-      if (::write(fd, rec.data(), rec.size()) < 0)
+      std::filesystem::remove(path() + ".repl", ec);
+      return true;
+    }
+    return writeReplPosition(snap.repl, rdb_bytes, err);
+  }
+
+  Rdb::Snapshot Rdb::takeSnapshotLocked(const KeyValueStore &store) const
+  {
+    Snapshot snap = takeSnapshot(store);
+    if (repl_source_)
+    {
+      snap.has_repl = true;
+      snap.repl = repl_source_();
+    }
+    return snap;
+  }
+
+  // 位置文件一行文本：MRREPL1 <run_id> <offset> <RDB 字节数>
+  bool Rdb::writeReplPosition(const ReplPosition &pos, uint64_t rdb_bytes, std::string &err) const
+  {
+    std::string tmp_path = path() + ".repl.tmp";
+    std::string line = "MRREPL1 " + pos.run_id + " " + std::to_string(pos.offset) + " " + std::to_string(rdb_bytes) + "\n";
+    int fd = ::open(tmp_path.c_str(), O_CREAT | O_TRUNC | O_WRONLY, 0644);
+    if (fd < 0)
+    {
+      err = "open repl position failed";
+      return false;
+    }
+    bool ok = ::write(fd, line.data(), line.size()) == static_cast<ssize_t>(line.size()) && ::fsync(fd) == 0;
+    ::close(fd);
+    if (!ok || ::rename(tmp_path.c_str(), (path() + ".repl").c_str()) < 0)
+    {
+      err = "write repl position failed";
+      return false;
+    }
+    return true;
+  }
+
+  bool Rdb::loadReplPosition(ReplPosition &pos) const
+  {
+    FILE *f = std::fopen((path() + ".repl").c_str(), "r");
+    if (!f)
+      return false;
+    char run_id[128];
+    long long offset = -1;
+    unsigned long long rdb_bytes = 0;
+    int n = std::fscanf(f, "MRREPL1 %127s %lld %llu", run_id, &offset, &rdb_bytes);
+    std::fclose(f);
+    struct stat st;
+    if (n != 3 || offset < 0 || ::stat(path().c_str(), &st) != 0 || static_cast<uint64_t>(st.st_size) != rdb_bytes)
+      return false;
+    pos.run_id = run_id;
+    pos.offset = offset;
+    return true;
+  }
+
+  bool Rdb::streamSnapshot(const KeyValueStore &store, std::mutex &snapshot_mu, const std::function<bool()> &on_snapshot,
+                           const Sink &sink, std::string &err) const
+  {
+    Snapshot snap;
+    {
+      std::lock_guard<std::mutex> lk(snapshot_mu);
+      if (!on_snapshot())
       {
-        ::close(fd);
-        err = "write str rec";
+        err = "cancelled";
         return false;
       }
+      snap = takeSnapshot(store);
     }
-    // HASH section
-    line = std::string("HASH ") + std::to_string(snap_hash.size()) + "\n";
-    if (::write(fd, line.data(), line.size()) < 0)
+    RdbWriter w(sink);
+    RdbCompressStats stats;
+    if (!encodeSnapshot(w, snap, true, opts_.compression, stats))
     {
-      ::close(fd);
-      err = "write hash cnt";
+      err = "stream rdb";
       return false;
     }
-    for (const auto &kv : snap_hash)
+    return true;
+  }
+
+  bool Rdb::encodeSnapshot(RdbWriter &w, const Snapshot &snap, bool framed, bool compress, RdbCompressStats &stats)
+  {
+    w.raw(kMagicV3, sizeof(kMagicV3) - 1);
+    w.byte(kOpResize);
+    w.varint(snap.strs.size() + snap.hashes.size() + snap.zsets.size());
+    w.byte(kOpChunked);
+    std::unique_ptr<BlockCompressor> bc;
+    if (framed)
+    {
+      w.byte(kOpFramed);
+      bc = std::make_unique<BlockCompressor>(compress);
+    }
+    w.beginChunks(bc.get());
+    // 每条记录写完后检查一次，攒够 kChunkBytes 就在此处切块
+    auto cut = [&]
     {
-      const std::string &k = kv.first;
-      const HashRecord &r = kv.second;
-      std::string rec_head;
-      rec_head.append(std::to_string(k.size())).append(" ").append(k).append(" ").append(std::to_string(r.expire_at_ms)).append(" ").append(std::to_string(r.fields.size())).append("\n");
-      if (::write(fd, rec_head.data(), rec_head.size()) < 0)
+      if (w.chunkBytes() >= kChunkBytes)
+        w.cutChunk();
+    };
+    for (const auto &kv : snap.strs)
+    {
+      w.byte(kTypeString);
+      w.varint(static_cast<uint64_t>(kv.second.expire_at_ms + 1));
+      w.str(kv.first);
+      w.str(kv.second.value);
+      cut();
+    }
+    for (const auto &kv : snap.hashes)
+    {
+      w.byte(kTypeHash);
+      w.varint(static_cast<uint64_t>(kv.second.expire_at_ms + 1));
+      w.str(kv.first);
+      w.varint(kv.second.fields.size());
+      for (const auto &fv : kv.second.fields)
       {
-        ::close(fd);
-        err = "write hash head";
+        w.str(fv.first);
+        w.str(fv.second);
+      }
+      cut();
+    }
+    for (const auto &z : snap.zsets)
+    {
+      w.byte(kTypeZSet);
+      w.varint(static_cast<uint64_t>(z.expire_at_ms + 1));
+      w.str(z.key);
+      w.varint(z.items.size());
+      for (const auto &it : z.items)
+      {
+        w.str(it.second);
+        w.f64(it.first);
+      }
+      cut();
+    }
+    const auto &chunks = w.endChunks();
+    if (bc && compress)
+      stats = bc->stats();
+    uint64_t index_off = w.offset();
+    w.byte(kOpChunkIndex);
+    w.varint(chunks.size());
+    for (const auto &c : chunks)
+    {
+      w.varint(c.first);
+      w.varint(c.second);
+    }
+    w.u64le(index_off);
+    w.byte(kTypeEof);
+    return w.finish();
+  }
+
+  // 快照记录以快照为准：目标 key 已是其它类型时（加载进非空的 store，例如全量同步期间 replica 上的本地写入）先删掉再写，
+  // 不让 WrongTypeError 抛出加载线程
+  template <typename Fn>
+  static void putRecord(KeyValueStore &store, const std::string &key, Fn &&fn)
+  {
+    try
+    {
+      fn();
+    }
+    catch (const WrongTypeError &)
+    {
+      store.del({key});
+      fn();
+    }
+  }
+
+  // 解析记录直到结束标记（顺序加载）或范围末尾（in_chunk，分块加载）。
+  // m 非空时边解析边归还已用过的页，仅用于单线程顺序加载
+  static bool parseRecords(RdbReader &r, KeyValueStore &store, MappedFile *m, bool in_chunk, std::string &err)
+  {
+    std::string key, a, b;
+    while (true)
+    {
+      uint8_t type = 0;
+      uint64_t exp1 = 0;
+      if (m)
+        m->release(r.pos());
+      if (in_chunk && r.atEnd())
+        return true;
+      if (!r.byte(type))
+        break;
+      if (type == kTypeEof || type == kOpChunkIndex)
+      {
+        // 顺序加载时索引之后的内容已由 CRC 保证完整，不必再解析
+        if (!in_chunk)
+          return true;
+        err = "bad rdb chunk";
         return false;
       }
-      for (const auto &fv : r.fields)
+      if (type == kOpResize)
       {
-        std::string fline;
-        fline.append(std::to_string(fv.first.size())).append(" ").append(fv.first).append(" ").append(std::to_string(fv.second.size())).append(" ").append(fv.second).append("\n");
-        if (::write(fd, fline.data(), fline.size()) < 0)
+        uint64_t n = 0;
+        if (!r.varint(n))
+          break;
+        store.reserve(static_cast<size_t>(std::min<uint64_t>(n, r.remaining())));
+        continue;
+      }
+      if (type == kOpChunked)
+        continue;
+      if (!r.varint(exp1) || !r.str(key))
+        break;
+      int64_t exp = static_cast<int64_t>(exp1) - 1;
+      if (type == kTypeString)
+      {
+        if (!r.str(a))
+          break;
+        store.setWithExpireAtMs(key, a, exp);
+      }
+      else if (type == kTypeHash)
+      {
+        uint64_t n = 0;
+        if (!r.varint(n))
+          break;
+        for (uint64_t k = 0; k < n; ++k)
         {
-          ::close(fd);
-          err = "write hash field";
-          return false;
+          if (!r.str(a) || !r.str(b))
+          {
+            err = "trunc hash field";
+            return false;
+          }
+          putRecord(store, key, [&]
+                    { store.hset(key, a, b); });
         }
+        if (n > 0 && exp >= 0)
+          store.setHashExpireAtMs(key, exp);
+      }
+      else if (type == kTypeZSet)
+      {
+        uint64_t n = 0;
+        if (!r.varint(n))
+          break;
+        for (uint64_t k = 0; k < n; ++k)
+        {
+          double sc = 0;
+          if (!r.str(a) || !r.f64(sc))
+          {
+            err = "trunc zset item";
+            return false;
+          }
+          putRecord(store, key, [&]
+                    { store.zadd(key, sc, a); });
+        }
+        if (n > 0 && exp >= 0)
+          store.setZSetExpireAtMs(key, exp);
+      }
+      else
+      {
+        err = "bad rdb type " + std::to_string(type);
+        return false;
       }
     }
-    // ZSET section
-    line = std::string("ZSET ") + std::to_string(snap_zset.size()) + "\n";
-    if (::write(fd, line.data(), line.size()) < 0)
+    err = "trunc rdb";
+    return false;
+  }
+
+  // 解出一帧（r 位于 0xF8 之后）：原样存放的块直接指向映射，LZ4 块解压到 scratch
+  static bool decodeBlock(RdbReader &r, std::string &scratch, std::string_view &out, std::string &err)
+  {
+    uint8_t codec = 0;
+    uint64_t raw_len = 0, len = 0;
+    if (!r.byte(codec) || !r.varint(raw_len) || !r.varint(len) || len > r.remaining())
     {
-      ::close(fd);
-      err = "write zset cnt";
+      err = "trunc rdb block";
       return false;
     }
-    for (const auto &flat : snap_zset)
+    const char *payload = r.pos();
+    r.skip(static_cast<size_t>(len));
+    if (codec == kCodecRaw && raw_len == len)
     {
-      const std::string &k = flat.key;
-      std::string rec_head;
-      rec_head.append(std::to_string(k.size())).append(" ").append(k).append(" ").append(std::to_string(flat.expire_at_ms)).append(" ").append(std::to_string(flat.items.size())).append("\n");
-      if (::write(fd, rec_head.data(), rec_head.size()) < 0)
+      out = std::string_view(payload, static_cast<size_t>(len));
+      return true;
+    }
+    // LZ4 的压缩比不会超过 255:1，据此拒绝损坏的长度字段，避免超大分配
+    if (codec != kCodecLz4 || raw_len > len * 255 + 16)
+    {
+      err = "bad rdb block";
+      return false;
+    }
+    scratch.resize(static_cast<size_t>(raw_len));
+    if (!lz4Decompress(payload, static_cast<size_t>(len), scratch.data(), scratch.size()))
+    {
+      err = "corrupt rdb block";
+      return false;
+    }
+    out = scratch;
+    return true;
+  }
+
+  // 顺序加载分帧的记录区：逐帧解出后按块解析，直到索引或结束标记
+  static bool parseBlocks(RdbReader &r, KeyValueStore &store, MappedFile &m, std::string &err)
+  {
+    std::string scratch;
+    while (true)
+    {
+      m.release(r.pos());
+      uint8_t tag = 0;
+      if (!r.byte(tag))
       {
-        ::close(fd);
-        err = "write zset head";
+        err = "trunc rdb";
+        return false;
+      }
+      if (tag == kOpChunkIndex || tag == kTypeEof)
+        return true;
+      if (tag != kOpBlock)
+      {
+        err = "bad rdb block";
+        return false;
+      }
+      std::string_view block;
+      if (!decodeBlock(r, scratch, block, err))
+        return false;
+      RdbReader br(block.data(), block.size());
+      if (!parseRecords(br, store, nullptr, true, err))
+        return false;
+    }
+  }
+
+  // 解析索引中的一块；分帧文件的一块恰好是一整帧
+  static bool parseChunk(const char *p, size_t n, bool framed, KeyValueStore &store, std::string &scratch, std::string &err)
+  {
+    RdbReader r(p, n);
+    if (!framed)
+      return parseRecords(r, store, nullptr, true, err);
+    uint8_t tag = 0;
+    std::string_view block;
+    if (!r.byte(tag) || tag != kOpBlock || !decodeBlock(r, scratch, block, err) || !r.atEnd())
+    {
+      if (err.empty())
+        err = "bad rdb block";
+      return false;
+    }
+    RdbReader br(block.data(), block.size());
+    return parseRecords(br, store, nullptr, true, err);
+  }
+
+  // 整个文件的 CRC：切成 threads 段并行计算后合并；各段算完即归还页
+  static uint64_t fileCrc(MappedFile &m, size_t len, size_t threads)
+  {
+    const char *data = m.data();
+    const size_t kStep = 16u << 20;
+    auto crcRange = [&](size_t begin, size_t end)
+    {
+      uint64_t crc = 0;
+      for (size_t off = begin; off < end;)
+      {
+        size_t n = std::min(end - off, kStep);
+        crc = crc64(crc, data + off, n);
+        m.releaseRange(data + off, data + off + n);
+        off += n;
+      }
+      return crc;
+    };
+    if (threads <= 1 || len < threads * kStep)
+      return crcRange(0, len);
+    std::vector<uint64_t> crcs(threads);
+    std::vector<size_t> bounds(threads + 1);
+    for (size_t i = 0; i <= threads; ++i)
+      bounds[i] = len / threads * i;
+    bounds[threads] = len;
+    std::vector<std::thread> workers;
+    for (size_t i = 0; i < threads; ++i)
+      workers.emplace_back([&, i]
+                           { crcs[i] = crcRange(bounds[i], bounds[i + 1]); });
+    for (auto &t : workers)
+      t.join();
+    uint64_t crc = crcs[0];
+    for (size_t i = 1; i < threads; ++i)
+      crc = crc64Combine(crc, crcs[i], bounds[i + 1] - bounds[i]);
+    return crc;
+  }
+
+  // 读取文件末尾的分块索引；格式不对返回 false，调用方退回顺序加载
+  static bool readChunkIndex(std::string_view file, size_t body, size_t data_begin, std::vector<std::pair<size_t, size_t>> &chunks)
+  {
+    // body 末尾：... 0xFE 索引 | 8B 索引偏移 | 0xFF
+    if (body < data_begin + 9 || static_cast<uint8_t>(file[body - 1]) != kTypeEof)
+      return false;
+    uint64_t index_off = 0;
+    for (int i = 7; i >= 0; --i)
+      index_off = (index_off << 8) | static_cast<unsigned char>(file[body - 9 + static_cast<size_t>(i)]);
+    if (index_off < data_begin || index_off >= body - 9 || static_cast<uint8_t>(file[index_off]) != kOpChunkIndex)
+      return false;
+    RdbReader r(file.data() + index_off + 1, body - 9 - index_off - 1);
+    uint64_t n = 0;
+    if (!r.varint(n))
+      return false;
+    uint64_t expect_off = data_begin;
+    for (uint64_t i = 0; i < n; ++i)
+    {
+      uint64_t off = 0, len = 0;
+      if (!r.varint(off) || !r.varint(len) || off != expect_off || len > index_off - off)
         return false;
+      chunks.emplace_back(static_cast<size_t>(off), static_cast<size_t>(len));
+      expect_off = off + len;
+    }
+    return expect_off == index_off;
+  }
+
+  // MRDB3 读取：先整体校验 CRC，再解析；有分块索引且 threads > 1 时各线程按块并行解码插入，
+  // 否则顺序解析；分帧文件每块先解出再解析。任何越界都按截断处理
+  static bool loadBinary(MappedFile &m, KeyValueStore &store, size_t threads, std::string &err)
+  {
+    std::string_view file = m.view();
+    const size_t kMagicLen = sizeof(kMagicV3) - 1;
+    if (file.size() < kMagicLen + 1 + 8)
+    {
+      err = "trunc rdb";
+      return false;
+    }
+    size_t body = file.size() - 8;
+    uint64_t expect = 0;
+    for (int i = 7; i >= 0; --i)
+      expect = (expect << 8) | static_cast<unsigned char>(file[body + static_cast<size_t>(i)]);
+    if (fileCrc(m, body, threads) != expect)
+    {
+      err = "rdb checksum mismatch";
+      return false;
+    }
+    RdbReader r(file.data() + kMagicLen, body - kMagicLen);
+    // 文件头的操作码：预分配、分块与压缩标记
+    bool chunked = false;
+    bool framed = false;
+    while (!r.atEnd())
+    {
+      uint8_t op = static_cast<uint8_t>(*r.pos());
+      if (op == kOpChunked)
+      {
+        chunked = true;
+        r.skip(1);
       }
-      for (const auto &it : flat.items)
+      else if (op == kOpFramed)
       {
-        const double score = it.first;
-        const std::string &member = it.second;
-        std::string iline;
-        iline.append(std::to_string(score)).append(" ").append(std::to_string(member.size())).append(" ").append(member).append("\n");
-        if (::write(fd, iline.data(), iline.size()) < 0)
+        framed = true;
+        r.skip(1);
+      }
+      else if (op == kOpResize)
+      {
+        uint64_t n = 0;
+        r.skip(1);
+        if (!r.varint(n))
+          break;
+        store.reserve(static_cast<size_t>(std::min<uint64_t>(n, file.size())));
+      }
+      else
+      {
+        break;
+      }
+    }
+    std::vector<std::pair<size_t, size_t>> chunks;
+    size_t data_begin = static_cast<size_t>(r.pos() - file.data());
+    if (!chunked || threads <= 1 || !readChunkIndex(file, body, data_begin, chunks) || chunks.size() <= 1)
+      return framed ? parseBlocks(r, store, m, err) : parseRecords(r, store, &m, false, err);
+
+    std::atomic<size_t> next{0};
+    std::atomic<bool> failed{false};
+    std::mutex err_mu;
+    auto worker = [&]
+    {
+      std::string local_err, scratch;
+      for (size_t i = next.fetch_add(1); i < chunks.size() && !failed.load(); i = next.fetch_add(1))
+      {
+        const char *begin = file.data() + chunks[i].first;
+        if (!parseChunk(begin, chunks[i].second, framed, store, scratch, local_err))
         {
-          ::close(fd);
-          err = "write zset item";
+          std::lock_guard<std::mutex> lk(err_mu);
+          if (!failed.exchange(true))
+            err = local_err;
+          return;
+        }
+        m.releaseRange(begin, begin + chunks[i].second);
+      }
+    };
+    std::vector<std::thread> workers;
+    size_t n = std::min(threads, chunks.size());
+    for (size_t i = 1; i < n; ++i)
+      workers.emplace_back(worker);
+    worker();
+    for (auto &t : workers)
+      t.join();
+    return !failed.load();
+  }
+
+  // 跳过一条完整记录（不插入）：数据不够返回 0，不是记录（类型不认识）返回 -1
+  static int skipRecord(RdbReader &r)
+  {
+    uint8_t type = 0;
+    uint64_t exp1 = 0, n = 0;
+    if (!r.byte(type))
+      return 0;
+    if (type != kTypeString && type != kTypeHash && type != kTypeZSet)
+      return -1;
+    auto skipStr = [&r]
+    {
+      uint64_t len = 0;
+      if (!r.varint(len) || len > r.remaining())
+        return false;
+      r.skip(static_cast<size_t>(len));
+      return true;
+    };
+    if (!r.varint(exp1) || !skipStr())
+      return 0;
+    if (type == kTypeString)
+      return skipStr() ? 1 : 0;
+    if (!r.varint(n))
+      return 0;
+    for (uint64_t k = 0; k < n; ++k)
+    {
+      if (type == kTypeHash && !(skipStr() && skipStr()))
+        return 0;
+      if (type == kTypeZSet)
+      {
+        if (!skipStr() || r.remaining() < 8)
+          return 0;
+        r.skip(8);
+      }
+    }
+    return 1;
+  }
+
+  size_t RdbStreamLoader::feed(const char *data, size_t len)
+  {
+    if (state_ == State::kDone || state_ == State::kFailed)
+      return 0;
+    // 已处理的前缀超过一半时整体前移，缓冲只保留未凑齐的单元
+    if (pos_ > 0 && pos_ * 2 >= buf_.size())
+    {
+      buf_.erase(0, pos_);
+      pos_ = 0;
+    }
+    buf_.append(data, len);
+    while (state_ != State::kDone && state_ != State::kFailed && step())
+    {
+    }
+    if (state_ != State::kDone)
+      return len;
+    // 结束位置一定落在本次数据里，剩余部分全部来自本次
+    size_t rest = buf_.size() - pos_;
+    std::string().swap(buf_);
+    std::string().swap(scratch_);
+    pos_ = 0;
+    return len - rest;
+  }
+
+  void RdbStreamLoader::consume(size_t n)
+  {
+    crc_ = crc64(crc_, buf_.data() + pos_, n);
+    pos_ += n;
+  }
+
+  bool RdbStreamLoader::fail(const std::string &err)
+  {
+    err_ = err;
+    state_ = State::kFailed;
+    return false;
+  }
+
+  bool RdbStreamLoader::step()
+  {
+    // 超过这个长度的帧视为数据损坏，不再继续缓冲
+    const uint64_t kMaxFrame = 1ull << 30;
+    const char *begin = buf_.data() + pos_;
+    RdbReader r(begin, buf_.size() - pos_);
+    if (r.atEnd())
+      return false;
+    auto used = [&]
+    { return static_cast<size_t>(r.pos() - begin); };
+    switch (state_)
+    {
+    case State::kMagic:
+    {
+      const size_t kMagicLen = sizeof(kMagicV3) - 1;
+      if (r.remaining() < kMagicLen)
+        return false;
+      if (std::memcmp(begin, kMagicV3, kMagicLen) != 0)
+        return fail("bad magic");
+      consume(kMagicLen);
+      state_ = State::kHeader;
+      return true;
+    }
+    case State::kHeader:
+    {
+      uint8_t op = static_cast<uint8_t>(*begin);
+      if (op == kOpChunked || op == kOpFramed)
+      {
+        consume(1);
+      }
+      else if (op == kOpResize)
+      {
+        uint64_t n = 0;
+        r.skip(1);
+        if (!r.varint(n))
           return false;
+        // 计数来自主库，没有文件大小可参照，只设一个保守上限
+        store_.reserve(static_cast<size_t>(std::min<uint64_t>(n, 1ull << 26)));
+        consume(used());
+      }
+      else
+      {
+        state_ = State::kBody;
+      }
+      return true;
+    }
+    case State::kBody:
+    {
+      uint8_t tag = static_cast<uint8_t>(*begin);
+      if (tag == kOpBlock)
+      {
+        uint8_t codec = 0;
+        uint64_t raw_len = 0, len = 0;
+        r.skip(1);
+        if (!r.byte(codec) || !r.varint(raw_len) || !r.varint(len))
+          return false;
+        if (len > kMaxFrame)
+          return fail("bad rdb block");
+        if (r.remaining() < len)
+          return false;
+        RdbReader fr(begin + 1, used() - 1 + static_cast<size_t>(len));
+        std::string_view block;
+        if (!decodeBlock(fr, scratch_, block, err_))
+          return fail(err_);
+        RdbReader br(block.data(), block.size());
+        if (!parseRecords(br, store_, nullptr, true, err_))
+          return fail(err_);
+        consume(used() + static_cast<size_t>(len));
+        return true;
+      }
+      if (tag == kOpChunkIndex)
+      {
+        // 索引只对随机访问有用，流式加载校验格式后跳过
+        uint64_t n = 0, v = 0;
+        r.skip(1);
+        if (!r.varint(n))
+          return false;
+        for (uint64_t i = 0; i < n * 2; ++i)
+        {
+          if (!r.varint(v))
+            return false;
         }
+        if (r.remaining() < 9)
+          return false;
+        r.skip(8);
+        uint8_t eof = 0;
+        r.byte(eof);
+        if (eof != kTypeEof)
+          return fail("bad rdb index");
+        consume(used());
+        state_ = State::kCrc;
+        return true;
       }
+      if (tag == kTypeEof)
+      {
+        consume(1);
+        state_ = State::kCrc;
+        return true;
+      }
+      // 未分帧的记录区：取出已经完整到达的记录（每次不超过一块），批量解析
+      const char *end = begin;
+      while (static_cast<uint64_t>(end - begin) < kChunkBytes)
+      {
+        RdbReader t(end, static_cast<size_t>(buf_.data() + buf_.size() - end));
+        int rc = skipRecord(t);
+        if (rc < 0 && end == begin)
+          return fail("bad rdb type " + std::to_string(tag));
+        if (rc <= 0)
+          break;
+        end = t.pos();
+      }
+      if (end == begin)
+        return false;
+      RdbReader rr(begin, static_cast<size_t>(end - begin));
+      if (!parseRecords(rr, store_, nullptr, true, err_))
+        return fail(err_);
+      consume(static_cast<size_t>(end - begin));
+      return true;
+    }
+    case State::kCrc:
+    {
+      if (r.remaining() < 8)
+        return false;
+      uint64_t expect = 0;
+      for (int i = 7; i >= 0; --i)
+        expect = (expect << 8) | static_cast<unsigned char>(begin[i]);
+      if (expect != crc_)
+        return fail("rdb checksum mismatch");
+      consume(8);
+      state_ = State::kDone;
+      return true;
+    }
+    default:
+      return false;
     }
-    ::fsync(fd);
-    ::close(fd);
-    return true;
   }
 
   bool Rdb::load(KeyValueStore &store, std::string &err) const
   {
     if (!opts_.enabled)
       return true;
-    int fd = ::open(path().c_str(), O_RDONLY);
-    if (fd < 0)
-      return true; // no file is fine
-    std::string data;
-    data.resize(1 << 20);
-    std::string file;
-    while (true)
+    MappedFile m;
+    if (!m.open(path(), err))
+      return err.empty(); // no file is fine
+    if (m.view().substr(0, sizeof(kMagicV3) - 1) == kMagicV3)
     {
-      ssize_t r = ::read(fd, data.data(), data.size());
-      if (r < 0)
-      {
-        ::close(fd);
-        err = "read rdb";
-        return false;
-      }
-      if (r == 0)
-        break;
-      file.append(data.data(), static_cast<size_t>(r));
+      size_t threads = opts_.load_threads > 0 ? static_cast<size_t>(opts_.load_threads) : std::thread::hardware_concurrency();
+      return loadBinary(m, store, threads > 0 ? threads : 1, err);
     }
-    ::close(fd);
+    // 旧文本格式直接在映射上逐行解析
+    std::string_view file = m.view();
+    // 每条记录至少占若干字节，用文件大小给头部计数设上限，防止损坏的计数导致超大分配
+    auto reserveKeys = [&](size_t n)
+    { store.reserve(std::min(n, file.size() / 4)); };
     size_t pos = 0;
     auto readLine = [&](std::string &out) -> bool
     { size_t e = file.find('\n', pos); if (e==std::string::npos) return false; out.assign(file.data()+pos, e-pos); pos=e+1; return true; };
@@ -188,6 +1387,7 @@ namespace mini_redis
         return false;
       }
       int count = std::stoi(line);
+      reserveKeys(static_cast<size_t>(count));
       for (int i = 0; i < count; ++i)
       {
         if (!readLine(line))
@@ -232,6 +1432,7 @@ namespace mini_redis
       return false;
     }
     int str_count = std::stoi(line.substr(4));
+    reserveKeys(static_cast<size_t>(str_count));
     for (int i = 0; i < str_count; ++i)
     {
       if (!readLine(line))
@@ -269,6 +1470,7 @@ namespace mini_redis
       return false;
     }
     int hash_count = std::stoi(line.substr(5));
+    reserveKeys(static_cast<size_t>(str_count) + static_cast<size_t>(hash_count));
     for (int i = 0; i < hash_count; ++i)
     {
       if (!readLine(line))
@@ -318,7 +1520,8 @@ namespace mini_redis
       if (has_any)
       {
         for (const auto &fv : fvs)
-          store.hset(key, fv.first, fv.second);
+          putRecord(store, key, [&]
+                    { store.hset(key, fv.first, fv.second); });
         if (exp >= 0)
           store.setHashExpireAtMs(key, exp);
       }
@@ -335,6 +1538,7 @@ namespace mini_redis
       return false;
     }
     int zset_count = std::stoi(line.substr(5));
+    reserveKeys(static_cast<size_t>(str_count) + static_cast<size_t>(hash_count) + static_cast<size_t>(zset_count));
     for (int i = 0; i < zset_count; ++i)
     {
       if (!readLine(line))
@@ -373,7 +1577,8 @@ namespace mini_redis
         nextTok2(mlen_s);
         int ml = std::stoi(mlen_s);
         std::string member = line.substr(q, static_cast<size_t>(ml));
-        store.zadd(key, sc, member);
+        putRecord(store, key, [&]
+                  { store.zadd(key, sc, member); });
       }
       if (exp >= 0)
         store.setZSetExpireAtMs(key, exp);
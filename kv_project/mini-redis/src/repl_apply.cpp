@@ -0,0 +1,96 @@
+/**
+ * 创建者：程序员老廖
+ * 日期：2025年8月12日
+ */
+
+#include "mini_redis/repl_apply.hpp"
+
+#include "mini_redis/kv.hpp"
+
+#include <cstring>
+
+namespace mini_redis
+{
+
+  ReplApplier::ReplApplier(KeyValueStore &store) : store_(store), groups_(store.shardCount()) {}
+
+  bool ReplApplier::add(const CommandArgs &args)
+  {
+    if (pending_ == 0)
+      conflict_ = nullptr;
+    const CommandSpec *spec = lookupCommand(args[0]);
+    if (!spec || !(spec->flags & kCmdWrite) || !commandArityOk(*spec, args.size()))
+    {
+      ++skipped_;
+      return false;
+    }
+    ++pending_;
+    if (args.size() < 2)
+    {
+      // 无 key 的写命令：前面的命令先落地，再单独执行
+      applyGroups();
+      applyOne(*spec, args, &args);
+      return true;
+    }
+    auto push = [this, spec, &args](size_t shard, const CommandArgs *a)
+    {
+      if (groups_[shard].empty())
+        touched_.push_back(shard);
+      groups_[shard].push_back(Item{spec, a, &args});
+    };
+    if (std::strcmp(spec->name, "DEL") == 0 && args.size() > 2)
+    {
+      // 每个 key 单独成一条 DEL，各自进入所在分片的组
+      for (size_t i = 1; i < args.size(); ++i)
+      {
+        split_.push_back(CommandArgs{args[0], args[i]});
+        push(store_.shardIndex(args[i]), &split_.back());
+      }
+      return true;
+    }
+    push(store_.shardIndex(args[1]), &args);
+    return true;
+  }
+
+  size_t ReplApplier::flush()
+  {
+    applyGroups();
+    split_.clear();
+    size_t n = pending_;
+    pending_ = 0;
+    return n;
+  }
+
+  void ReplApplier::applyOne(const CommandSpec &spec, const CommandArgs &args, const CommandArgs *origin)
+  {
+    CommandContext ctx{store_};
+    try
+    {
+      spec.handler(ctx, args);
+    }
+    catch (const WrongTypeError &)
+    {
+      // 以命令流为准：删掉类型不符的旧 key 再执行一次（无 key 的命令不会冲突）
+      ++overwritten_;
+      if (!conflict_)
+        conflict_ = origin;
+      store_.del({std::string(args[1])});
+      spec.handler(ctx, args);
+    }
+  }
+
+  void ReplApplier::applyGroups()
+  {
+    for (size_t shard : touched_)
+    {
+      auto &group = groups_[shard];
+      store_.withShardLocked(shard, [&]
+                             {
+                               for (const Item &it : group)
+                                 applyOne(*it.spec, *it.args, it.origin); });
+      group.clear();
+    }
+    touched_.clear();
+  }
+
+} // namespace mini_redis
@@ -0,0 +1,122 @@
+/**
+ * 创建者：程序员老廖
+ * 日期：2025年8月12日
+ */
+
+#include "mini_redis/repl_backlog.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+
+namespace mini_redis
+{
+
+  static const char kOffsetPrefix[] = "+OFFSET ";
+  static const size_t kOffsetPrefixLen = sizeof(kOffsetPrefix) - 1;
+
+  ReplBacklog::ReplBacklog(size_t capacity) : capacity_(capacity) {}
+
+  std::shared_ptr<ReplBlock> ReplBacklog::newBlock(size_t need)
+  {
+    size_t cap = std::max(kBlockBytes, need);
+    std::shared_ptr<ReplBlock> b;
+    if (spare_ && spare_->cap >= cap)
+    {
+      b = std::move(spare_);
+    }
+    else
+    {
+      // 超过块大小的命令单独占一块，用完即释放，不留作复用
+      b = std::make_shared<ReplBlock>();
+      b->data.reset(new char[cap]);
+      b->cap = cap;
+    }
+    b->used = 0;
+    b->begin_offset = offset_;
+    return b;
+  }
+
+  std::string_view ReplBacklog::append(std::string_view cmd)
+  {
+    int64_t end = offset_ + static_cast<int64_t>(cmd.size());
+    char marker[32];
+    std::memcpy(marker, kOffsetPrefix, kOffsetPrefixLen);
+    char *p = std::to_chars(marker + kOffsetPrefixLen, marker + sizeof(marker) - 2, end).ptr;
+    *p++ = '\r';
+    *p++ = '\n';
+    size_t mlen = static_cast<size_t>(p - marker);
+    size_t need = mlen + cmd.size();
+    if (blocks_.empty() || blocks_.back()->cap - blocks_.back()->used < need)
+      blocks_.push_back(newBlock(need));
+    ReplBlock &b = *blocks_.back();
+    char *dst = b.data.get() + b.used;
+    std::memcpy(dst, marker, mlen);
+    std::memcpy(dst + mlen, cmd.data(), cmd.size());
+    b.used += need;
+    held_ += need;
+    offset_ = end;
+    trim();
+    return std::string_view(dst, need);
+  }
+
+  void ReplBacklog::trim()
+  {
+    // 保留至少 capacity_ 字节的历史；尾块正在写入，永不淘汰
+    while (blocks_.size() > 1 && held_ - blocks_.front()->used >= capacity_)
+    {
+      auto &front = blocks_.front();
+      held_ -= front->used;
+      // 仍被 replica 发送队列引用的块由最后一个引用者释放；引用计数为 1 时只有这里持有，不会再被别人拷贝
+      if (front->cap == kBlockBytes && front.use_count() == 1)
+        spare_ = std::move(front);
+      blocks_.pop_front();
+    }
+  }
+
+  void ReplBacklog::setCapacity(size_t bytes)
+  {
+    capacity_ = bytes;
+    trim();
+  }
+
+  int64_t ReplBacklog::startOffset() const
+  {
+    return blocks_.empty() ? offset_ : blocks_.front()->begin_offset;
+  }
+
+  bool ReplBacklog::rangeFrom(int64_t from, std::vector<ReplSpan> &out) const
+  {
+    if (from == offset_)
+      return true;
+    if (blocks_.empty() || from < startOffset() || from > offset_)
+      return false;
+    // 最后一个 begin_offset <= from 的块
+    auto it = std::upper_bound(blocks_.begin(), blocks_.end(), from, [](int64_t v, const std::shared_ptr<ReplBlock> &b)
+                               { return v < b->begin_offset; });
+    --it;
+    // 块内逐条跳过：每条是 +OFFSET <结束偏移>\r\n 加上 (结束偏移 - 开始偏移) 字节的命令
+    const ReplBlock &b = **it;
+    const char *base = b.data.get();
+    size_t pos = 0;
+    int64_t cur = b.begin_offset;
+    while (cur < from && pos < b.used)
+    {
+      const char *num = base + pos + kOffsetPrefixLen;
+      int64_t end = 0;
+      auto res = std::from_chars(num, base + b.used, end);
+      if (res.ec != std::errc() || end <= cur)
+        return false;
+      pos = static_cast<size_t>(res.ptr - base) + 2 + static_cast<size_t>(end - cur);
+      cur = end;
+    }
+    if (cur != from)
+      return false; // 不在命令边界上
+    if (pos < b.used)
+      out.push_back(ReplSpan{*it, std::string_view(base + pos, b.used - pos)});
+    for (++it; it != blocks_.end(); ++it)
+      out.push_back(ReplSpan{*it, std::string_view((*it)->data.get(), (*it)->used)});
+    return true;
+  }
+
+} // namespace mini_redis
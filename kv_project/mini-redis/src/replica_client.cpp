@@ -7,23 +7,34 @@
 
 #include "mini_redis/resp.hpp"
 #include "mini_redis/kv.hpp"
+#include "mini_redis/repl_apply.hpp"
 #include "mini_redis/rdb.hpp"
 #include "mini_redis/state.hpp"
 #include "mini_redis/aof.hpp"
+#include "mini_redis/log.hpp"
 
 #include <arpa/inet.h>
 #include <netinet/in.h>
+#include <poll.h>
+#include <strings.h>
 #include <sys/socket.h>
 #include <unistd.h>
 
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <chrono>
 #include <cstring>
+#include <deque>
+#include <string_view>
 
 using mini_redis::g_store;
 
 namespace mini_redis
 {
 
-  ReplicaClient::ReplicaClient(const ServerConfig &cfg) : cfg_(cfg) {}
+  ReplicaClient::ReplicaClient(const ServerConfig &cfg, std::mutex &write_mu, AofLogger &aof, Rdb &rdb)
+      : cfg_(cfg), write_mu_(write_mu), aof_(aof), rdb_(rdb) {}
   ReplicaClient::~ReplicaClient() { stop(); }
 
   void ReplicaClient::start()
@@ -39,133 +50,382 @@ namespace mini_redis
   {
     if (th_.joinable())
     {
-      running_ = false;
+      {
+        std::lock_guard<std::mutex> lk(mu_);
+        running_ = false;
+        // 让阻塞中的 recv/poll 立即返回
+        if (fd_ >= 0)
+          ::shutdown(fd_, SHUT_RDWR);
+      }
+      cv_.notify_all();
       th_.join();
     }
   }
 
+  ReplicaStatus ReplicaClient::status() const
+  {
+    ReplicaStatus st;
+    st.master_host = cfg_.replica.master_host;
+    st.master_port = cfg_.replica.master_port;
+    st.link_up = link_up_.load();
+    st.position = pos_;
+    st.full_syncs = full_syncs_;
+    st.partial_syncs = partial_syncs_;
+    st.reconnects = reconnects_;
+    return st;
+  }
+
+  void ReplicaClient::closeSocket()
+  {
+    std::lock_guard<std::mutex> lk(mu_);
+    if (fd_ >= 0)
+      ::close(fd_);
+    fd_ = -1;
+  }
+
   void ReplicaClient::threadMain()
   {
-    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    int backoff_ms = kReconnectMinMs;
+    while (running_)
+    {
+      bool synced = session();
+      closeSocket();
+      link_up_ = false;
+      if (!running_)
+        break;
+      // 同步成功过说明主库可用，断线后尽快重连；连不上或同步失败时逐次拉长间隔
+      if (synced)
+        backoff_ms = kReconnectMinMs;
+      MR_LOG("WARN", "replication link to " << cfg_.replica.master_host << ":" << cfg_.replica.master_port
+                                            << " down, reconnecting in " << backoff_ms << "ms");
+      {
+        std::unique_lock<std::mutex> lk(mu_);
+        cv_.wait_for(lk, std::chrono::milliseconds(backoff_ms), [this]
+                     { return !running_; });
+      }
+      backoff_ms = std::min(backoff_ms * 2, kReconnectMaxMs);
+      std::lock_guard<std::mutex> lk(write_mu_);
+      ++reconnects_;
+    }
+  }
+
+  bool ReplicaClient::session()
+  {
+    int fd = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
     if (fd < 0)
-      return;
+      return false;
+    {
+      std::lock_guard<std::mutex> lk(mu_);
+      fd_ = fd;
+      if (!running_)
+        return false;
+    }
     sockaddr_in addr{};
     addr.sin_family = AF_INET;
     addr.sin_port = htons(cfg_.replica.master_port);
     ::inet_pton(AF_INET, cfg_.replica.master_host.c_str(), &addr.sin_addr);
     if (::connect(fd, (sockaddr *)&addr, sizeof(addr)) < 0)
+      return false;
+    // 先上报自己的服务端口，主库 INFO 中显示的是可以直接连上的地址
+    std::string line;
+    std::string rest;
+    std::string hello = toRespArray({std::string("REPLCONF"), std::string("listening-port"), std::to_string(cfg_.port)});
+    ::send(fd, hello.data(), hello.size(), MSG_NOSIGNAL);
+    if (!readLine(fd, rest, line))
+      return false;
+    if (line[0] == '-')
+      MR_LOG("WARN", "REPLCONF listening-port refused: " << line);
+    // 知道主库 run id 与已应用偏移时先尝试续传，否则直接全量同步
+    std::string first;
+    if (!pos_.run_id.empty() && pos_.offset >= 0)
+      first = toRespArray({std::string("PSYNC"), pos_.run_id, std::to_string(pos_.offset)});
+    else
+      first = toRespArray({std::string("SYNC")});
+    ::send(fd, first.data(), first.size(), MSG_NOSIGNAL);
+    // 回复有两种：
+    //   +FULLRESYNC <run_id>，随后是快照与 +OFFSET <快照对应的偏移>
+    //   +OFFSET <请求的偏移>：续传，后面直接是缺失的命令
+    if (!readLine(fd, rest, line))
+      return false;
+    bool full = line.rfind("+FULLRESYNC ", 0) == 0;
+    if (full)
     {
-      ::close(fd);
-      return;
+      std::string run_id = line.substr(12);
+      {
+        // 加载期间本地数据与任何复制位置都对不上，这期间的快照不保存位置
+        std::lock_guard<std::mutex> lk(write_mu_);
+        pos_.offset = -1;
+      }
+      if (!readLine(fd, rest, line) || !receiveSnapshot(fd, line, rest) || !readLine(fd, rest, line))
+        return false;
+      std::lock_guard<std::mutex> lk(write_mu_);
+      pos_.run_id = run_id;
     }
-    // send SYNC/PSYNC
-    std::string first;
-    if (last_offset_ > 0)
+    int64_t offset = -1;
+    if (line.rfind("+OFFSET ", 0) == 0)
+      std::from_chars(line.data() + 8, line.data() + line.size(), offset);
+    if (offset < 0)
     {
-      first = toRespArray({std::string("PSYNC"), std::to_string(last_offset_)});
+      MR_LOG("ERROR", "unexpected sync reply from master: " << line);
+      return false;
     }
-    else
     {
-      first = toRespArray({std::string("SYNC")});
+      std::lock_guard<std::mutex> lk(write_mu_);
+      pos_.offset = offset;
+      ++(full ? full_syncs_ : partial_syncs_);
     }
-    ::send(fd, first.data(), first.size(), 0);
-    // read RDB bulk
+    if (full)
+    {
+      // 本地 AOF 与 RDB 仍是旧数据：重写 AOF，并保存一份带复制位置的快照，重启后可以直接续传
+      std::string err;
+      if (aof_.isEnabled() && !aof_.bgRewrite(g_store, write_mu_, err))
+        MR_LOG("WARN", "AOF rewrite after full sync failed: " << err);
+      if (cfg_.rdb.enabled && !rdb_.bgSave(g_store, write_mu_, err))
+        MR_LOG("WARN", "RDB save after full sync failed: " << err);
+    }
+    MR_LOG("INFO", (full ? "full" : "partial") << " sync with master done, offset " << offset);
+    link_up_ = true;
+
     RespParser parser;
-    std::string buf(8192, '\0');
+    parser.append(rest);
+    std::string buf(kRecvBytes, '\0');
+    ReplApplier applier(g_store);
+    std::deque<RespCommand> batch; // applier 持有其中 args 的地址，扩容不能搬动已有元素
+    auto sendAck = [&]
+    {
+      std::string ack = toRespArray({std::string("REPLCONF"), std::string("ACK"), std::to_string(pos_.offset)});
+      return ::send(fd, ack.data(), ack.size(), MSG_NOSIGNAL) == static_cast<ssize_t>(ack.size());
+    };
+    using Clock = std::chrono::steady_clock;
+    auto next_ack = Clock::now();
+    bool alive = true;
+    int64_t pending_offset = -1; // 已读到 +OFFSET、命令还没到齐
     while (running_)
     {
-      ssize_t r = ::recv(fd, buf.data(), buf.size(), 0);
-      if (r <= 0)
-        break;
-      parser.append(std::string_view(buf.data(), static_cast<size_t>(r)));
+      // 缓冲中已完整到达的命令作为一批：命令前的 +OFFSET <n> 是该命令结束处的偏移，整批应用完才确认。
+      // 命令视图指向 parser 缓冲，下一次 append() 前必须应用完
+      int64_t batch_offset = -1;
+      bool ack_now = false;
+      size_t n = 0;
       while (true)
       {
-        auto v = parser.tryParseOne();
-        if (!v.has_value())
+        std::string_view status;
+        ParseStatus st = parser.tryParseStatusLine(status);
+        if (st == ParseStatus::kIncomplete)
           break;
-        if (v->type == RespType::kBulkString)
-        {
-          // treat as RDB content; parse with Rdb::load by writing temp and reading
-          // For simplicity, reuse Rdb by writing to file and calling load
-          RdbOptions ropts = cfg_.rdb;
-          if (!ropts.enabled)
-            ropts.enabled = true;
-          Rdb r(ropts);
-          std::string path = r.path();
-          FILE *f = ::fopen(path.c_str(), "wb");
-          if (!f)
-            return;
-          fwrite(v->bulk.data(), 1, v->bulk.size(), f);
-          fclose(f);
-          std::string err;
-          r.load(g_store, err);
-        }
-        else if (v->type == RespType::kArray)
+        if (st == ParseStatus::kOk)
         {
-          // command array
-          if (v->array.empty())
-            continue;
-          std::string cmd;
-          for (char c : v->array[0].bulk)
-            cmd.push_back(static_cast<char>(::toupper(c)));
-          if (cmd == "SET" && v->array.size() == 3)
+          if (status.rfind("OFFSET ", 0) == 0)
           {
-            g_store.set(v->array[1].bulk, v->array[2].bulk);
-          }
-          else if (cmd == "DEL" && v->array.size() >= 2)
-          {
-            std::vector<std::string> keys;
-            for (size_t i = 1; i < v->array.size(); ++i)
-              keys.emplace_back(v->array[i].bulk);
-            g_store.del(keys);
-          }
-          else if (cmd == "EXPIRE" && v->array.size() == 3)
-          {
-            int64_t s = std::stoll(v->array[2].bulk);
-            g_store.expire(v->array[1].bulk, s);
-          }
-          else if (cmd == "HSET" && v->array.size() == 4)
-          {
-            g_store.hset(v->array[1].bulk, v->array[2].bulk, v->array[3].bulk);
-          }
-          else if (cmd == "HDEL" && v->array.size() >= 3)
-          {
-            std::vector<std::string> fs;
-            for (size_t i = 2; i < v->array.size(); ++i)
-              fs.emplace_back(v->array[i].bulk);
-            g_store.hdel(v->array[1].bulk, fs);
-          }
-          else if (cmd == "ZADD" && v->array.size() == 4)
-          {
-            double sc = std::stod(v->array[2].bulk);
-            g_store.zadd(v->array[1].bulk, sc, v->array[3].bulk);
-          }
-          else if (cmd == "ZREM" && v->array.size() >= 3)
-          {
-            std::vector<std::string> ms;
-            for (size_t i = 2; i < v->array.size(); ++i)
-              ms.emplace_back(v->array[i].bulk);
-            g_store.zrem(v->array[1].bulk, ms);
-          }
-          else if (v->type == RespType::kSimpleString)
-          {
-            // parse +OFFSET <num>
-            const std::string &s = v->bulk;
-            if (s.rfind("OFFSET ", 0) == 0)
-            {
-              try
-              {
-                last_offset_ = std::stoll(s.substr(8));
-              }
-              catch (...)
-              {
-              }
-            }
+            int64_t off = 0;
+            auto res = std::from_chars(status.data() + 7, status.data() + status.size(), off);
+            if (res.ec == std::errc())
+              pending_offset = off;
           }
+          continue;
         }
+        if (n == batch.size())
+          batch.emplace_back();
+        st = parser.tryParseCommand(batch[n]);
+        if (st == ParseStatus::kIncomplete)
+          break;
+        if (st == ParseStatus::kError)
+        {
+          MR_LOG("ERROR", "bad replication stream from master");
+          alive = false;
+          break;
+        }
+        const CommandArgs &args = batch[n].args;
+        if (args.size() >= 2 && args[0].size() == 8 && ::strncasecmp(args[0].data(), "REPLCONF", 8) == 0)
+        {
+          // REPLCONF GETACK *：主库有 WAIT 在等，本批应用完立即确认
+          ack_now = true;
+          continue;
+        }
+        if (applier.add(args))
+          ++n;
+        if (pending_offset >= 0)
+        {
+          batch_offset = pending_offset;
+          pending_offset = -1;
+        }
+      }
+      if (n > 0 || batch_offset >= 0)
+      {
+        int64_t aof_seq = 0;
+        {
+          // 与本地快照互斥：快照要么不含本批，要么含本批且位置已前进
+          std::lock_guard<std::mutex> lk(write_mu_);
+          applier.flush();
+          for (size_t i = 0; i < n; ++i)
+            aof_seq = aof_.appendRaw(batch[i].raw);
+          if (batch_offset >= 0)
+            pos_.offset = batch_offset;
+        }
+        // always 模式：整批一次落盘后再继续（之后的 ACK 才上报本批偏移），不在 write_mu 内等待
+        aof_.waitSynced(aof_seq);
+      }
+      // 定时上报已应用的偏移，主库据此计算 lag 与 WAIT
+      auto now = Clock::now();
+      if (!alive)
+        break;
+      if (ack_now || now >= next_ack)
+      {
+        if (!sendAck())
+          break;
+        next_ack = now + std::chrono::milliseconds(kAckIntervalMs);
+      }
+      pollfd pfd{fd, POLLIN, 0};
+      int wait_ms = static_cast<int>(std::chrono::duration_cast<std::chrono::milliseconds>(next_ack - now).count()) + 1;
+      int pr = ::poll(&pfd, 1, wait_ms);
+      if (pr < 0 && errno != EINTR)
+        break;
+      if (pr <= 0)
+        continue;
+      // 一次尽量多读：写入高峰时批次越大，每个分片的加锁次数摊得越薄。断线前已读到的数据先应用再退出
+      size_t got = 0;
+      while (got < kMaxBatchBytes)
+      {
+        ssize_t r = ::recv(fd, buf.data(), buf.size(), got == 0 ? 0 : MSG_DONTWAIT);
+        if (r > 0)
+        {
+          parser.append(std::string_view(buf.data(), static_cast<size_t>(r)));
+          got += static_cast<size_t>(r);
+          continue;
+        }
+        if (!(r < 0 && got > 0 && (errno == EAGAIN || errno == EWOULDBLOCK)))
+          alive = false;
+        break;
+      }
+    }
+    return true;
+  }
+
+  // 读一行（不含 \r\n）到 line，buf 中保留其后已收到的字节
+  bool ReplicaClient::readLine(int fd, std::string &buf, std::string &line)
+  {
+    char tmp[4096];
+    size_t eol;
+    while ((eol = buf.find("\r\n")) == std::string::npos)
+    {
+      if (!running_)
+        return false;
+      ssize_t r = ::recv(fd, tmp, sizeof(tmp), 0);
+      if (r <= 0)
+        return false;
+      buf.append(tmp, static_cast<size_t>(r));
+    }
+    line = buf.substr(0, eol);
+    buf.erase(0, eol + 2);
+    return !line.empty();
+  }
+
+  // 接收 +FULLRESYNC 之后的快照，边收边交给 RdbStreamLoader 解析插入，不落临时文件。header 是快照头一行：
+  //   $EOF:<40 字节标记>，之后是快照字节流与 <标记>   （无盘同步，事先不知道长度）
+  //   $<长度>，之后是快照字节与 \r\n                （落盘同步）
+  // rest 进来时是头之后已收到的字节，返回时是快照之后已经收到的字节（+OFFSET 与写命令）
+  bool ReplicaClient::receiveSnapshot(int fd, const std::string &line, std::string &rest)
+  {
+    std::string buf(kRecvBytes, '\0');
+    auto recvSome = [&](std::string &into)
+    {
+      ssize_t r = ::recv(fd, buf.data(), buf.size(), 0);
+      if (r <= 0)
+        return false;
+      into.append(buf.data(), static_cast<size_t>(r));
+      return true;
+    };
+    if (line[0] != '$')
+    {
+      MR_LOG("ERROR", "master refused sync: " << line);
+      return false;
+    }
+    std::string header = line.substr(1);
+    // EOF 模式以标记结尾；长度模式以剩余字节数结尾
+    std::string mark;
+    uint64_t remaining = 0;
+    if (header.rfind("EOF:", 0) == 0)
+    {
+      mark = header.substr(4);
+    }
+    else
+    {
+      try
+      {
+        remaining = std::stoull(header);
+      }
+      catch (...)
+      {
+        MR_LOG("ERROR", "bad sync header: " << header);
+        return false;
+      }
+    }
+    // 全量同步以主库快照替换本地数据。加载期间拒绝客户端写命令（g_loading），否则本地写入会与快照记录类型冲突、
+    // 混进同步后的数据；每块数据持写锁插入，等待网络时不持锁
+    {
+      std::lock_guard<std::mutex> lk(write_mu_);
+      g_loading = true;
+      g_store.flushAll();
+    }
+    struct LoadingGuard
+    {
+      std::mutex &mu;
+      ~LoadingGuard()
+      {
+        std::lock_guard<std::mutex> lk(mu);
+        g_loading = false;
       }
+    } loading_guard{write_mu_};
+    RdbStreamLoader loader(g_store);
+    std::string data = std::move(rest);
+    rest.clear();
+    while (true)
+    {
+      std::string_view in(data);
+      if (mark.empty())
+        in = in.substr(0, static_cast<size_t>(std::min<uint64_t>(remaining, in.size())));
+      size_t used;
+      {
+        std::lock_guard<std::mutex> lk(write_mu_);
+        used = loader.feed(in.data(), in.size());
+      }
+      if (loader.failed())
+      {
+        MR_LOG("ERROR", "load sync snapshot failed: " << loader.error());
+        g_store.flushAll();
+        return false;
+      }
+      if (mark.empty())
+        remaining -= used;
+      if (loader.done())
+      {
+        rest = data.substr(used);
+        break;
+      }
+      if (mark.empty() && remaining == 0)
+      {
+        MR_LOG("ERROR", "load sync snapshot failed: trunc rdb");
+        g_store.flushAll();
+        return false;
+      }
+      data.clear();
+      if (!running_ || !recvSome(data))
+        return false;
+    }
+    // 快照之后紧跟结束标记（EOF 模式）或 \r\n（长度模式）
+    const std::string tail = mark.empty() ? std::string("\r\n") : mark;
+    while (rest.size() < tail.size())
+    {
+      if (!running_ || !recvSome(rest))
+        return false;
+    }
+    if (rest.compare(0, tail.size(), tail) != 0)
+    {
+      MR_LOG("ERROR", "bad sync snapshot terminator");
+      return false;
     }
-    ::close(fd);
+    rest.erase(0, tail.size());
+    return true;
   }
 
 } // namespace mini_redis
@@ -10,21 +10,162 @@
 namespace mini_redis
 {
 
-  void RespParser::append(std::string_view data) { buffer_.append(data.data(), data.size()); }
+  namespace
+  {
+    // 已消费前缀至少这么大、且超过缓冲一半时才搬移，均摊下来每字节 O(1)
+    const size_t kCompactMin = 16 * 1024;
+    // 长度行（*N / $N）最多 20 位数字加符号，超过仍无 CRLF 视为协议错误
+    const size_t kMaxLenLine = 32;
+    const int64_t kMaxArgs = 1024 * 1024;
+    const int64_t kMaxBulk = 512LL * 1024 * 1024;
+
+    ParseStatus scanLen(const std::string &buf, size_t &pos, int64_t &out)
+    {
+      size_t end = buf.find("\r\n", pos);
+      if (end == std::string::npos)
+        return buf.size() - pos > kMaxLenLine ? ParseStatus::kError : ParseStatus::kIncomplete;
+      auto [ptr, ec] = std::from_chars(buf.data() + pos, buf.data() + end, out);
+      if (ec != std::errc() || ptr != buf.data() + end)
+        return ParseStatus::kError;
+      pos = end + 2;
+      return ParseStatus::kOk;
+    }
+  } // namespace
+
+  void RespParser::append(std::string_view data)
+  {
+    if (rpos_ > 0)
+    {
+      if (rpos_ == buffer_.size())
+      {
+        buffer_.clear();
+        rpos_ = 0;
+        need_ = 0;
+      }
+      else if (rpos_ >= kCompactMin && rpos_ * 2 >= buffer_.size())
+      {
+        buffer_.erase(0, rpos_);
+        need_ = need_ > rpos_ ? need_ - rpos_ : 0;
+        rpos_ = 0;
+      }
+    }
+    buffer_.append(data.data(), data.size());
+  }
+
+  void RespParser::reset()
+  {
+    buffer_.clear();
+    rpos_ = 0;
+    need_ = 0;
+  }
+
+  void RespParser::unread(const RespCommand &cmd)
+  {
+    rpos_ = static_cast<size_t>(cmd.raw.data() - buffer_.data());
+    need_ = 0;
+  }
+
+  ParseStatus RespParser::tryParseStatusLine(std::string_view &out)
+  {
+    if (rpos_ >= buffer_.size())
+      return ParseStatus::kIncomplete;
+    if (buffer_[rpos_] != '+')
+      return ParseStatus::kError;
+    size_t end = buffer_.find("\r\n", rpos_);
+    if (end == std::string::npos)
+      return ParseStatus::kIncomplete;
+    out = std::string_view(buffer_.data() + rpos_ + 1, end - rpos_ - 1);
+    rpos_ = end + 2;
+    return ParseStatus::kOk;
+  }
+
+  ParseStatus RespParser::tryParseCommand(RespCommand &out)
+  {
+    while (true)
+    {
+      if (rpos_ >= buffer_.size() || buffer_.size() < need_)
+        return ParseStatus::kIncomplete;
+      size_t pos = rpos_;
+      if (buffer_[pos] != '*')
+      {
+        reset();
+        return ParseStatus::kError;
+      }
+      ++pos;
+      int64_t count = 0;
+      ParseStatus st = scanLen(buffer_, pos, count);
+      if (st != ParseStatus::kOk)
+      {
+        if (st == ParseStatus::kError)
+          reset();
+        return st;
+      }
+      if (count <= 0)
+      {
+        // 空数组 / null 数组：跳过，与 Redis 一致
+        rpos_ = pos;
+        continue;
+      }
+      if (count > kMaxArgs)
+      {
+        reset();
+        return ParseStatus::kError;
+      }
+      out.args.clear();
+      for (int64_t i = 0; i < count; ++i)
+      {
+        if (pos >= buffer_.size())
+          return ParseStatus::kIncomplete;
+        if (buffer_[pos] != '$')
+        {
+          reset();
+          return ParseStatus::kError;
+        }
+        ++pos;
+        int64_t len = 0;
+        st = scanLen(buffer_, pos, len);
+        if (st == ParseStatus::kOk && (len < 0 || len > kMaxBulk))
+          st = ParseStatus::kError;
+        if (st != ParseStatus::kOk)
+        {
+          if (st == ParseStatus::kError)
+            reset();
+          return st;
+        }
+        size_t n = static_cast<size_t>(len);
+        if (buffer_.size() < pos + n + 2)
+        {
+          need_ = pos + n + 2;
+          return ParseStatus::kIncomplete;
+        }
+        if (buffer_[pos + n] != '\r' || buffer_[pos + n + 1] != '\n')
+        {
+          reset();
+          return ParseStatus::kError;
+        }
+        out.args.emplace_back(buffer_.data() + pos, n);
+        pos += n + 2;
+      }
+      out.raw = std::string_view(buffer_.data() + rpos_, pos - rpos_);
+      rpos_ = pos;
+      need_ = 0;
+      return ParseStatus::kOk;
+    }
+  }
 
-  bool RespParser::parseLine(size_t &pos, std::string &out_line)
+  bool RespParser::parseLine(size_t &pos, std::string_view &out_line)
   {
     size_t end = buffer_.find("\r\n", pos);
     if (end == std::string::npos)
       return false;
-    out_line.assign(buffer_.data() + pos, end - pos);
+    out_line = std::string_view(buffer_.data() + pos, end - pos);
     pos = end + 2;
     return true;
   }
 
   bool RespParser::parseInteger(size_t &pos, int64_t &out_value)
   {
-    std::string line;
+    std::string_view line;
     if (!parseLine(pos, line))
       return false;
     auto first = line.data();
@@ -39,11 +180,11 @@ namespace mini_redis
 
   bool RespParser::parseSimple(size_t &pos, RespType t, RespValue &out)
   {
-    std::string s;
+    std::string_view s;
     if (!parseLine(pos, s))
       return false;
     out.type = t;
-    out.bulk = std::move(s);
+    out.bulk.assign(s.data(), s.size());
     return true;
   }
 
@@ -60,7 +201,10 @@ namespace mini_redis
     if (len < 0)
       return false;
     if (buffer_.size() < pos + static_cast<size_t>(len) + 2)
+    {
+      need_ = pos + static_cast<size_t>(len) + 2;
       return false;
+    }
     out.type = RespType::kBulkString;
     out.bulk.assign(buffer_.data() + pos, static_cast<size_t>(len));
     pos += static_cast<size_t>(len);
@@ -89,126 +233,80 @@ namespace mini_redis
     {
       if (pos >= buffer_.size())
         return false;
-      char prefix = buffer_[pos++];
       RespValue elem;
-      bool ok = false;
-      switch (prefix)
-      {
-      case '+':
-        ok = parseSimple(pos, RespType::kSimpleString, elem);
-        break;
-      case '-':
-        ok = parseSimple(pos, RespType::kError, elem);
-        break;
-      case ':':
-      {
-        int64_t v = 0;
-        ok = parseInteger(pos, v);
-        if (ok)
-        {
-          elem.type = RespType::kInteger;
-          elem.bulk = std::to_string(v);
-        }
-        break;
-      }
-      case '$':
-        ok = parseBulkString(pos, elem);
-        break;
-      case '*':
-        ok = parseArray(pos, elem);
-        break;
-      default:
-        return false;
-      }
-      if (!ok)
+      bool bad = false;
+      if (!parseValue(pos, elem, bad))
         return false;
       out.array.emplace_back(std::move(elem));
     }
     return true;
   }
 
-  std::optional<RespValue> RespParser::tryParseOne()
+  // 按首字节分派；bad 表示遇到未知类型前缀（协议错误，而非数据不完整）
+  bool RespParser::parseValue(size_t &pos, RespValue &out, bool &bad)
   {
-    if (buffer_.empty())
-      return std::nullopt;
-    size_t pos = 0;
     char prefix = buffer_[pos++];
-    RespValue out;
-    bool ok = false;
     switch (prefix)
     {
     case '+':
-      ok = parseSimple(pos, RespType::kSimpleString, out);
-      break;
+      return parseSimple(pos, RespType::kSimpleString, out);
     case '-':
-      ok = parseSimple(pos, RespType::kError, out);
-      break;
+      return parseSimple(pos, RespType::kError, out);
     case ':':
     {
       int64_t v = 0;
-      ok = parseInteger(pos, v);
-      if (ok)
-      {
-        out.type = RespType::kInteger;
-        out.bulk = std::to_string(v);
-      }
-      break;
+      if (!parseInteger(pos, v))
+        return false;
+      out.type = RespType::kInteger;
+      out.bulk = std::to_string(v);
+      return true;
     }
     case '$':
-      ok = parseBulkString(pos, out);
-      break;
+      return parseBulkString(pos, out);
     case '*':
-      ok = parseArray(pos, out);
-      break;
+      return parseArray(pos, out);
     default:
-      return RespValue{RespType::kError, std::string("protocol error"), {}};
+      bad = true;
+      return false;
     }
-    if (!ok)
+  }
+
+  std::optional<RespValue> RespParser::tryParseOne()
+  {
+    if (rpos_ >= buffer_.size() || buffer_.size() < need_)
       return std::nullopt;
-    buffer_.erase(0, pos);
+    size_t pos = rpos_;
+    RespValue out;
+    bool bad = false;
+    if (!parseValue(pos, out, bad))
+    {
+      if (!bad)
+        return std::nullopt;
+      reset();
+      return RespValue{RespType::kError, std::string("protocol error"), {}};
+    }
+    rpos_ = pos;
+    need_ = 0;
     return out;
   }
 
   std::optional<std::pair<RespValue, std::string>> RespParser::tryParseOneWithRaw()
   {
-    if (buffer_.empty())
+    if (rpos_ >= buffer_.size() || buffer_.size() < need_)
       return std::nullopt;
-    size_t pos = 0;
-    char prefix = buffer_[pos++];
+    size_t pos = rpos_;
     RespValue out;
-    bool ok = false;
-    switch (prefix)
+    bool bad = false;
+    if (!parseValue(pos, out, bad))
     {
-    case '+':
-      ok = parseSimple(pos, RespType::kSimpleString, out);
-      break;
-    case '-':
-      ok = parseSimple(pos, RespType::kError, out);
-      break;
-    case ':':
-    {
-      int64_t v = 0;
-      ok = parseInteger(pos, v);
-      if (ok)
-      {
-        out.type = RespType::kInteger;
-        out.bulk = std::to_string(v);
-      }
-      break;
-    }
-    case '$':
-      ok = parseBulkString(pos, out);
-      break;
-    case '*':
-      ok = parseArray(pos, out);
-      break;
-    default:
+      if (!bad)
+        return std::nullopt;
+      reset();
       return std::make_optional(std::make_pair(RespValue{RespType::kError, std::string("protocol error"), {}}, std::string()));
     }
-    if (!ok)
-      return std::nullopt;
-    std::string raw(buffer_.data(), pos);
-    buffer_.erase(0, pos);
+    std::string raw(buffer_.data() + rpos_, pos - rpos_);
+    rpos_ = pos;
+    need_ = 0;
     return std::make_pair(std::move(out), std::move(raw));
   }
 
@@ -5,31 +5,45 @@
 
 #include "mini_redis/server.hpp"
 
+#include "mini_redis/commands.hpp"
 #include "mini_redis/resp.hpp"
 #include "mini_redis/kv.hpp"
 #include "mini_redis/config.hpp"
 #include "mini_redis/log.hpp"
 #include "mini_redis/aof.hpp"
 #include "mini_redis/rdb.hpp"
+#include "mini_redis/repl_backlog.hpp"
 #include "mini_redis/replica_client.hpp"
 #include "mini_redis/state.hpp"
+#include "mini_redis/uring.hpp"
 
 #include <arpa/inet.h>
 #include <errno.h>
 #include <fcntl.h>
 #include <netinet/in.h>
 #include <sys/epoll.h>
+#include <sys/eventfd.h>
 #include <sys/socket.h>
 #include <sys/timerfd.h>
 #include <netinet/tcp.h>
 #include <sys/uio.h>
 #include <unistd.h>
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <cstring>
 #include <cctype>
+#include <deque>
 #include <iostream>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <stdexcept>
 #include <string>
 #include <string_view>
+#include <thread>
 #include <unordered_map>
 #include <vector>
 
@@ -67,39 +81,234 @@ namespace mini_redis
       return epoll_ctl(epfd, EPOLL_CTL_MOD, fd, &ev);
     }
 
+    // 无盘全量同步：序列化线程把快照字节流分段放进 chunks，reactor 在连接写空后整批取走发送。
+    // 积压超过上限时序列化线程等待，慢 replica 的发送速度直接反压到快照编码，主库不落盘也不整份缓存
+    struct FullSyncJob
+    {
+      std::mutex mu;
+      std::condition_variable cv; // chunks 被取走或任务被取消
+      std::deque<std::string> chunks;
+      size_t queued_bytes = 0;
+      bool done = false;      // 字节流已全部放入 chunks
+      bool failed = false;
+      bool cancelled = false; // 连接已关闭，序列化线程应尽快退出
+      int64_t offset = 0;     // 快照对应的复制偏移
+      std::string mark;       // $EOF:<mark> 的结束标记
+    };
+
+    // 发送队列中的一块：普通回复自带字符串；复制数据只引用 backlog 中的共享块，多个 replica 不各自拷贝
+    struct OutChunk
+    {
+      std::string own;
+      ReplBlockRef ref;
+      std::string_view view;
+
+      OutChunk(std::string s) : own(std::move(s)) {}
+      OutChunk(const ReplSpan &span) : ref(span.block), view(span.bytes) {}
+      const char *data() const { return ref ? view.data() : own.data(); }
+      size_t size() const { return ref ? view.size() : own.size(); }
+    };
+
+    // appendfsync=always 下暂扣的回复：AOF 落盘到 seq 之后才能发出
+    struct HeldReply
+    {
+      int64_t seq = 0;
+      OutChunk chunk;
+    };
+
     struct Conn
     {
       int fd = -1;
       std::string in = "";
-      std::vector<std::string> out_chunks = {}; // 待发送块队列
+      std::vector<OutChunk> out_chunks = {}; // 待发送块队列
       size_t out_iov_idx = 0;                   // 当前发送到第几个块
       size_t out_offset = 0;                    // 当前块内偏移
       RespParser parser = {};
       bool is_replica = false;
+      RespCommand cmd = {}; // 复用的解析结果，视图指向 parser 缓冲
+      // I/O 线程模式下由 helper 线程填充：已解析但尚未执行的命令（前 nparsed 个有效）及本轮事件
+      std::vector<RespCommand> parsed = {};
+      size_t nparsed = 0;
+      bool proto_error = false;
+      uint32_t io_ev = 0;
+      // io_uring 后端：在途请求全部完成后才真正 close，避免 fd 被新连接复用后收到旧 CQE
+      bool recv_armed = false;
+      bool send_busy = false;
+      bool closing = false;                  // 对端关闭或出错：不再读，发完剩余回复（含暂扣的回复）后关闭
+      std::vector<OutChunk> sending = {}; // 在途 SEND 链引用的缓冲，链完成前不可改动
+      std::shared_ptr<FullSyncJob> sync_job = {}; // 正在进行的无盘全量同步
+      std::vector<OutChunk> repl_hold = {};       // 全量同步期间到达的复制数据，快照发完后再发送
+      uint64_t replica_id = 0;  // 在 g_replicas 中的登记号，0 表示不是 replica
+      int replica_port = 0;     // replica 通过 REPLCONF listening-port 上报的服务端口
+      bool blocked = false;     // WAIT 等待中：后续命令留在解析缓冲里，等结果回复后再执行
+      // 等待 AOF 落盘的回复，按序号递增。非空时之后的所有回复（包括读命令）都排在后面，保持回复顺序
+      std::deque<HeldReply> aof_hold = {};
+    };
+
+    // 阻塞中的 WAIT：只由所在 reactor 线程访问
+    struct WaitReq
+    {
+      int fd = -1;
+      int64_t target = 0;      // 需要被确认的复制偏移
+      int64_t numreplicas = 0;
+      int64_t deadline_ms = 0; // steady clock 毫秒，0 表示不超时
+    };
+
+    // Redis 6 风格的 I/O 线程池：helper 线程只负责 read+解析 与 writev，
+    // 命令仍由 reactor 线程串行执行。每次 run() 把连接按下标均分给 helper 与调用线程，
+    // 全部完成后才返回，因此执行阶段与 I/O 阶段不会同时访问同一个 Conn。
+    class IoOffloadPool
+    {
+    public:
+      explicit IoOffloadPool(int nthreads)
+      {
+        for (int i = 0; i < nthreads; ++i)
+          threads_.emplace_back([this, i]
+                                { worker(i); });
+      }
+
+      ~IoOffloadPool()
+      {
+        {
+          std::lock_guard<std::mutex> lk(mu_);
+          stop_ = true;
+        }
+        cv_start_.notify_all();
+        for (auto &t : threads_)
+          t.join();
+      }
+
+      void run(const std::vector<Conn *> &items, void (*fn)(Conn &))
+      {
+        if (items.empty())
+          return;
+        const size_t stride = threads_.size() + 1;
+        {
+          std::lock_guard<std::mutex> lk(mu_);
+          items_ = &items;
+          fn_ = fn;
+          remaining_ = threads_.size();
+          ++generation_;
+        }
+        cv_start_.notify_all();
+        // 调用线程处理最后一份
+        for (size_t i = threads_.size(); i < items.size(); i += stride)
+          fn(*items[i]);
+        std::unique_lock<std::mutex> lk(mu_);
+        cv_done_.wait(lk, [&]
+                      { return remaining_ == 0; });
+        items_ = nullptr;
+      }
+
+    private:
+      void worker(size_t idx)
+      {
+        uint64_t seen = 0;
+        while (true)
+        {
+          const std::vector<Conn *> *items = nullptr;
+          void (*fn)(Conn &) = nullptr;
+          {
+            std::unique_lock<std::mutex> lk(mu_);
+            cv_start_.wait(lk, [&]
+                           { return stop_ || generation_ != seen; });
+            if (stop_)
+              return;
+            seen = generation_;
+            items = items_;
+            fn = fn_;
+          }
+          const size_t stride = threads_.size() + 1;
+          for (size_t i = idx; i < items->size(); i += stride)
+            fn(*(*items)[i]);
+          std::lock_guard<std::mutex> lk(mu_);
+          if (--remaining_ == 0)
+            cv_done_.notify_one();
+        }
+      }
+
+      std::vector<std::thread> threads_;
+      std::mutex mu_;
+      std::condition_variable cv_start_;
+      std::condition_variable cv_done_;
+      uint64_t generation_ = 0;
+      size_t remaining_ = 0;
+      bool stop_ = false;
+      const std::vector<Conn *> *items_ = nullptr;
+      void (*fn_)(Conn &) = nullptr;
     };
 
   } // namespace
 
-  Server::Server(const ServerConfig &config) : config_(config) {}
-  Server::~Server()
+  struct Reactor
   {
-    if (listen_fd_ >= 0)
-      close(listen_fd_);
-    if (epoll_fd_ >= 0)
-      close(epoll_fd_);
-  }
+    int id = 0;
+    int listen_fd = -1;
+    int epoll_fd = -1;
+    int timer_fd = -1;
+    int wake_fd = -1; // eventfd：其它 reactor 投递复制数据后唤醒本线程
+    std::unordered_map<int, Conn> conns;
+    // 复制信箱：本 reactor 上每个 replica 连接待下发的数据，key 为 replica fd。
+    // 写命令可能在任意 reactor 上执行，由执行线程按全局顺序投递到这里。
+    std::mutex mbox_mu;
+    std::unordered_map<int, std::vector<OutChunk>> repl_mbox;
+    // I/O 线程模式（io_offload_threads > 0）：本轮 epoll 中可读的连接
+    std::unique_ptr<IoOffloadPool> io_pool;
+    std::vector<Conn *> read_batch;
+    // io_uring 后端（io_backend=io_uring 且初始化成功时非空）
+    std::unique_ptr<IoUring> ring;
+    uint64_t wake_buf = 0;
+    std::vector<int> dirty; // 本轮产生了回复或状态变化、需要提交 SEND/关闭检查的连接
+    std::vector<int> full_syncs; // 正在进行无盘全量同步的连接
+    // WAIT：replica 的 ACK 可能在任意 reactor 上到达，has_waits 为真时由 ACK 所在线程通过 wake_fd 唤醒本线程重新检查
+    std::vector<WaitReq> waits;
+    std::atomic<bool> has_waits{false};
+    int wait_timer_fd = -1; // 最早的 WAIT 超时时刻
+    uint64_t wait_timer_buf = 0;
+    // appendfsync=always 的组提交：有暂扣回复的连接。AOF writer 每次刷盘后，has_aof_hold 为真的 reactor 经 wake_fd 被唤醒放行
+    std::vector<int> aof_held;
+    std::atomic<bool> has_aof_hold{false};
 
-  int Server::setupListen()
+    ~Reactor()
+    {
+      io_pool.reset();
+      ring.reset();
+      for (auto &kv : conns)
+        close(kv.first);
+      if (listen_fd >= 0)
+        close(listen_fd);
+      if (epoll_fd >= 0)
+        close(epoll_fd);
+      if (timer_fd >= 0)
+        close(timer_fd);
+      if (wake_fd >= 0)
+        close(wake_fd);
+      if (wait_timer_fd >= 0)
+        close(wait_timer_fd);
+    }
+  };
+
+  Server::Server(const ServerConfig &config) : config_(config) {}
+  Server::~Server() = default;
+
+  int Server::setupListen(Reactor &r)
   {
-    listen_fd_ = ::socket(AF_INET, SOCK_STREAM, 0);
-    if (listen_fd_ < 0)
+    r.listen_fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    if (r.listen_fd < 0)
     {
       std::perror("socket");
       return -1;
     }
 
     int yes = 1;
-    setsockopt(listen_fd_, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+    setsockopt(r.listen_fd, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+    // 多 reactor：每个线程一个监听 socket，由内核按四元组哈希分发新连接
+    if (config_.io_threads > 1 &&
+        setsockopt(r.listen_fd, SOL_SOCKET, SO_REUSEPORT, &yes, sizeof(yes)) < 0)
+    {
+      std::perror("setsockopt SO_REUSEPORT");
+      return -1;
+    }
 
     sockaddr_in addr{};
     addr.sin_family = AF_INET;
@@ -110,17 +319,17 @@ namespace mini_redis
       return -1;
     }
 
-    if (bind(listen_fd_, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) < 0)
+    if (bind(r.listen_fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) < 0)
     {
       std::perror("bind");
       return -1;
     }
-    if (set_nonblocking(listen_fd_) < 0)
+    if (set_nonblocking(r.listen_fd) < 0)
     {
       std::perror("fcntl");
       return -1;
     }
-    if (listen(listen_fd_, 512) < 0)
+    if (listen(r.listen_fd, 512) < 0)
     {
       std::perror("listen");
       return -1;
@@ -128,22 +337,22 @@ namespace mini_redis
     return 0;
   }
 
-  int Server::setupEpoll()
+  int Server::setupEpoll(Reactor &r)
   {
-    epoll_fd_ = epoll_create1(0);
-    if (epoll_fd_ < 0)
+    r.epoll_fd = epoll_create1(0);
+    if (r.epoll_fd < 0)
     {
       std::perror("epoll_create1");
       return -1;
     }
-    if (add_epoll(epoll_fd_, listen_fd_, EPOLLIN | EPOLLET) < 0)
+    if (add_epoll(r.epoll_fd, r.listen_fd, EPOLLIN | EPOLLET) < 0)
     {
       std::perror("epoll_ctl add");
       return -1;
     }
     // setup periodic timer for active expire scan
-    timer_fd_ = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
-    if (timer_fd_ < 0)
+    r.timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (r.timer_fd < 0)
     {
       std::perror("timerfd_create");
       return -1;
@@ -152,23 +361,97 @@ namespace mini_redis
     its.it_interval.tv_sec = 0;
     its.it_interval.tv_nsec = 200 * 1000 * 1000; // 200ms
     its.it_value = its.it_interval;
-    if (timerfd_settime(timer_fd_, 0, &its, nullptr) < 0)
+    if (timerfd_settime(r.timer_fd, 0, &its, nullptr) < 0)
     {
       std::perror("timerfd_settime");
       return -1;
     }
-    if (add_epoll(epoll_fd_, timer_fd_, EPOLLIN | EPOLLET) < 0)
+    if (add_epoll(r.epoll_fd, r.timer_fd, EPOLLIN | EPOLLET) < 0)
     {
       std::perror("epoll_ctl add timer");
       return -1;
     }
+    r.wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (r.wake_fd < 0)
+    {
+      std::perror("eventfd");
+      return -1;
+    }
+    if (add_epoll(r.epoll_fd, r.wake_fd, EPOLLIN | EPOLLET) < 0)
+    {
+      std::perror("epoll_ctl add eventfd");
+      return -1;
+    }
+    r.wait_timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (r.wait_timer_fd < 0 || add_epoll(r.epoll_fd, r.wait_timer_fd, EPOLLIN | EPOLLET) < 0)
+    {
+      std::perror("wait timerfd");
+      return -1;
+    }
+    return 0;
+  }
+
+  // 创建 reactor 使用的 ring 并检查所需能力；不可用时返回 nullptr 并给出原因
+  static std::unique_ptr<IoUring> make_reactor_ring(std::string &err)
+  {
+    // multishot recv 与 provided buffer ring 需要 6.0+
+    if (!IoUring::kernelAtLeast(6, 0))
+    {
+      err = "kernel older than 6.0";
+      return nullptr;
+    }
+    auto ring = std::make_unique<IoUring>();
+    if (!ring->init(4096, err))
+      return nullptr;
+    const IoUring::Op ops[] = {IoUring::Op::kAccept, IoUring::Op::kRecv, IoUring::Op::kSend,
+                               IoUring::Op::kRead, IoUring::Op::kTimeout};
+    if (!ring->supports(ops, sizeof(ops) / sizeof(ops[0])))
+    {
+      err = "required opcode not supported";
+      return nullptr;
+    }
+    if (!ring->setupBufRing(0, 512, 8192, err))
+      return nullptr;
+    return ring;
+  }
+
+  int Server::setupUring(Reactor &r, std::string &err)
+  {
+    auto ring = make_reactor_ring(err);
+    if (!ring)
+      return -1;
+    // 失败时关掉已创建的 fd，reactor 不留半初始化的状态
+    auto fail = [&r, &err](const char *what)
+    {
+      err = std::string(what) + ": " + std::strerror(errno);
+      if (r.wake_fd >= 0)
+        close(r.wake_fd);
+      if (r.wait_timer_fd >= 0)
+        close(r.wait_timer_fd);
+      r.wake_fd = -1;
+      r.wait_timer_fd = -1;
+      return -1;
+    };
+    r.wake_fd = eventfd(0, EFD_CLOEXEC);
+    if (r.wake_fd < 0)
+      return fail("eventfd");
+    r.wait_timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+    if (r.wait_timer_fd < 0)
+      return fail("timerfd_create");
+    r.ring = std::move(ring);
     return 0;
   }
 
   KeyValueStore g_store;
+  std::atomic<bool> g_loading{false};
   static AofLogger g_aof;
   static Rdb g_rdb;
-  static std::vector<std::vector<std::string>> g_repl_queue;
+  // 写命令的执行、AOF 追加与复制投递都在该锁内完成，
+  // 多个 reactor 并发时 AOF 与复制流仍保持同一个全局顺序
+  static std::mutex g_write_mu;
+  static std::vector<Reactor *> g_reactors;
+  // 当前线程本批次投递过复制数据的 reactor，批次结束后统一唤醒
+  static thread_local std::vector<Reactor *> t_repl_wake;
   static inline bool has_pending(const Conn &c)
   {
     return c.out_iov_idx < c.out_chunks.size() || (c.out_iov_idx == c.out_chunks.size() && c.out_offset != 0);
@@ -186,7 +469,7 @@ namespace mini_redis
       size_t off = c.out_offset;
       while (idx < c.out_chunks.size() && iovcnt < (int)max_iov)
       {
-        const std::string &s = c.out_chunks[idx];
+        const OutChunk &s = c.out_chunks[idx];
         const char *base = s.data();
         size_t len = s.size();
         if (off >= len)
@@ -209,7 +492,7 @@ namespace mini_redis
         size_t rem = (size_t)w;
         while (rem > 0 && c.out_iov_idx < c.out_chunks.size())
         {
-          std::string &s = c.out_chunks[c.out_iov_idx];
+          const OutChunk &s = c.out_chunks[c.out_iov_idx];
           size_t avail = s.size() - c.out_offset;
           if (rem < avail)
           {
@@ -244,585 +527,1230 @@ namespace mini_redis
     }
   }
 
-  static inline void enqueue_out(Conn &c, std::string s)
+  static inline void enqueue_out(Conn &c, OutChunk chunk)
   {
-    if (!s.empty())
-      c.out_chunks.emplace_back(std::move(s));
+    if (chunk.size() == 0)
+      return;
+    if (!c.aof_hold.empty())
+    {
+      // 前面还有等落盘的回复，跟在它后面一起放行
+      int64_t seq = c.aof_hold.back().seq;
+      c.aof_hold.push_back(HeldReply{seq, std::move(chunk)});
+      return;
+    }
+    c.out_chunks.push_back(std::move(chunk));
   }
 
-  static std::string g_repl_backlog;
-  static const size_t kReplBacklogCap = 4 * 1024 * 1024; // 4MB
-  static int64_t g_repl_offset = 0;                    // total bytes produced
-  static int64_t g_backlog_start_offset = 0;           // offset of first byte in backlog buffer
+  // 复制积压缓冲：命令只编码一次，backlog 与各 replica 的发送队列共享同一块内存。只在 g_write_mu 内访问
+  static ReplBacklog g_repl_backlog;
 
-  static void appendToBacklog(const std::string &data)
+  // 追加到 replica 的待发送数据；与上一段在同一共享块中首尾相接时直接延长，连续命令合并为一个 iovec
+  static void append_repl_span(std::vector<OutChunk> &q, const ReplSpan &span)
   {
-    if (g_repl_backlog.size() + data.size() <= kReplBacklogCap)
-    {
-      g_repl_backlog.append(data);
-    }
-    else
+    if (!q.empty())
     {
-      size_t need = data.size();
-      if (need >= kReplBacklogCap)
-      {
-        g_repl_backlog.assign(data.data() + (need - kReplBacklogCap), kReplBacklogCap);
-      }
-      else
+      OutChunk &last = q.back();
+      if (last.ref == span.block && last.view.data() + last.view.size() == span.bytes.data())
       {
-        size_t drop = (g_repl_backlog.size() + need) - kReplBacklogCap;
-        g_repl_backlog.erase(0, drop);
-        g_repl_backlog.append(data);
+        last.view = std::string_view(last.view.data(), last.view.size() + span.bytes.size());
+        return;
       }
     }
-    // update start offset after appending
-    g_backlog_start_offset = g_repl_offset - static_cast<int64_t>(g_repl_backlog.size());
+    q.emplace_back(span);
+  }
+
+  // 调用方需持有 g_write_mu：分配复制偏移、写 backlog，并投递到所有 replica 的信箱。
+  // 偏移只计命令字节；每条命令前带 +OFFSET <结束偏移> 行，一起写进共享块，信箱里只放引用。
+  // cmd 为已编码好的 RESP 命令（通常就是客户端发来的原始字节）。
+  static void replicate(std::string_view cmd)
+  {
+    ReplSpan span{nullptr, g_repl_backlog.append(cmd)};
+    for (Reactor *r : g_reactors)
+    {
+      std::lock_guard<std::mutex> lk(r->mbox_mu);
+      if (r->repl_mbox.empty())
+        continue;
+      if (!span.block)
+        span.block = g_repl_backlog.tail();
+      for (auto &kv : r->repl_mbox)
+        append_repl_span(kv.second, span);
+      if (std::find(t_repl_wake.begin(), t_repl_wake.end(), r) == t_repl_wake.end())
+        t_repl_wake.push_back(r);
+    }
+  }
+
+  // 已连接的 replica。INFO 与 WAIT 可能在任意 reactor 上读取，ACK 在 replica 连接所在的 reactor 上更新
+  struct ReplicaInfo
+  {
+    uint64_t id = 0;
+    std::string ip;
+    int port = 0;         // REPLCONF listening-port 上报的端口，未上报时为对端端口
+    bool online = false;  // 快照已发完，开始接收命令流
+    int64_t ack_offset = 0;
+    int64_t ack_ms = 0;   // 最近一次 ACK（或登记）的时间
+  };
+  static std::mutex g_replicas_mu;
+  static std::vector<ReplicaInfo> g_replicas;
+  static uint64_t g_next_replica_id = 0;
+
+  // 本进程的复制 run id，启动时随机生成。replica 断线重连或重启后带着它 PSYNC，
+  // 不一致说明主库换了进程（偏移从头算起），只能全量同步
+  static std::string g_run_id;
+  // 同步统计：全量同步次数、PSYNC 续传成功 / 失败（转为全量）次数
+  static std::atomic<uint64_t> g_sync_full{0};
+  static std::atomic<uint64_t> g_sync_partial_ok{0};
+  static std::atomic<uint64_t> g_sync_partial_err{0};
+  // 本实例作为 replica 运行时的复制客户端，INFO 从这里取链路状态
+  static ReplicaClient *g_replica = nullptr;
+
+  static std::string random_hex(size_t n)
+  {
+    std::random_device rd;
+    std::mt19937_64 rng((static_cast<uint64_t>(rd()) << 32) ^ rd());
+    static const char kHex[] = "0123456789abcdef";
+    std::string out;
+    for (size_t i = 0; i < n; ++i)
+      out.push_back(kHex[rng() & 15]);
+    return out;
+  }
+
+  // 请 replica 立即回 ACK；不占复制偏移，也不进 backlog
+  static const char kGetAckCmd[] = "*3\r\n$8\r\nREPLCONF\r\n$6\r\nGETACK\r\n$1\r\n*\r\n";
+
+  static int64_t steady_ms()
+  {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+  }
+
+  static void set_replica_online(uint64_t id)
+  {
+    std::lock_guard<std::mutex> lk(g_replicas_mu);
+    for (auto &info : g_replicas)
+      if (info.id == id)
+        info.online = true;
+  }
+
+  static void unregister_replica(uint64_t id)
+  {
+    std::lock_guard<std::mutex> lk(g_replicas_mu);
+    g_replicas.erase(std::remove_if(g_replicas.begin(), g_replicas.end(), [id](const ReplicaInfo &info)
+                                    { return info.id == id; }),
+                     g_replicas.end());
+  }
+
+  static void register_replica(Conn &c, bool online, int64_t ack_offset)
+  {
+    if (c.replica_id)
+      unregister_replica(c.replica_id); // 同一连接重新 SYNC
+    sockaddr_in peer{};
+    socklen_t len = sizeof(peer);
+    char ip[INET_ADDRSTRLEN] = "?";
+    int port = 0;
+    if (getpeername(c.fd, reinterpret_cast<sockaddr *>(&peer), &len) == 0)
+    {
+      inet_ntop(AF_INET, &peer.sin_addr, ip, sizeof(ip));
+      port = ntohs(peer.sin_port);
+    }
+    std::lock_guard<std::mutex> lk(g_replicas_mu);
+    ReplicaInfo info;
+    info.id = ++g_next_replica_id;
+    info.ip = ip;
+    info.port = c.replica_port > 0 ? c.replica_port : port;
+    info.online = online;
+    info.ack_offset = ack_offset;
+    info.ack_ms = steady_ms();
+    g_replicas.push_back(info);
+    c.replica_id = info.id;
+  }
+
+  // 已确认到 target 的在线 replica 数
+  static int64_t count_acked(int64_t target)
+  {
+    std::lock_guard<std::mutex> lk(g_replicas_mu);
+    int64_t n = 0;
+    for (const auto &info : g_replicas)
+      if (info.online && info.ack_offset >= target)
+        ++n;
+    return n;
   }
 
-  static std::string handle_command(const RespValue &v, const std::string *raw)
+  // 按命令表分发：spec 由 execute_one 查好（一次查找），args 指向连接输入缓冲（见 RespCommand），
+  // raw 为整条命令的原始字节。写命令在 handler 标记 dirty 后原样写入 AOF 并复制。
+  // appendfsync=always 时 aof_seq 返回该命令的 AOF 序号，回复须等它落盘后再发（见 hold_reply），其余情况为 0
+  static std::string handle_command(const CommandSpec *spec, const std::vector<std::string_view> &args, std::string_view raw,
+                                    int64_t &aof_seq)
   {
-    if (v.type != RespType::kArray || v.array.empty())
+    if (args.empty())
       return respError("ERR protocol error");
-    const auto &head = v.array[0];
-    if (head.type != RespType::kBulkString && head.type != RespType::kSimpleString)
-      return respError("ERR wrong type");
-    std::string cmd;
-    cmd.reserve(head.bulk.size());
-    for (char c : head.bulk)
-      cmd.push_back(static_cast<char>(::toupper(c)));
-
-    if (cmd == "PING")
-    {
-      if (v.array.size() <= 1)
-        return respSimpleString("PONG");
-      if (v.array.size() == 2 && v.array[1].type == RespType::kBulkString)
-        return respBulk(v.array[1].bulk);
-      return respError("ERR wrong number of arguments for 'PING'");
-    }
-    if (cmd == "ECHO")
-    {
-      if (v.array.size() == 2 && v.array[1].type == RespType::kBulkString)
-        return respBulk(v.array[1].bulk);
-      return respError("ERR wrong number of arguments for 'ECHO'");
-    }
-    if (cmd == "SET")
-    {
-      if (v.array.size() < 3)
-        return respError("ERR wrong number of arguments for 'SET'");
-      if (v.array[1].type != RespType::kBulkString || v.array[2].type != RespType::kBulkString)
-        return respError("ERR syntax");
-      std::optional<int64_t> ttl_ms;
-      // minimal options support: EX seconds or PX milliseconds
-      size_t i = 3;
-      while (i < v.array.size())
-      {
-        if (v.array[i].type != RespType::kBulkString)
-          return respError("ERR syntax");
-        std::string opt;
-        opt.reserve(v.array[i].bulk.size());
-        for (char ch : v.array[i].bulk) opt.push_back(static_cast<char>(::toupper(ch)));
-        if (opt == "EX")
-        {
-          if (i + 1 >= v.array.size() || v.array[i + 1].type != RespType::kBulkString)
-            return respError("ERR syntax");
-          try {
-            int64_t sec = std::stoll(v.array[i + 1].bulk);
-            if (sec < 0) return respError("ERR invalid expire time in SET");
-            ttl_ms = sec * 1000;
-          } catch (...) { return respError("ERR value is not an integer or out of range"); }
-          i += 2;
-          continue;
-        }
-        else if (opt == "PX")
-        {
-          if (i + 1 >= v.array.size() || v.array[i + 1].type != RespType::kBulkString)
-            return respError("ERR syntax");
-          try {
-            int64_t ms = std::stoll(v.array[i + 1].bulk);
-            if (ms < 0) return respError("ERR invalid expire time in SET");
-            ttl_ms = ms;
-          } catch (...) { return respError("ERR value is not an integer or out of range"); }
-          i += 2;
-          continue;
-        }
-        else
-        {
-          // unsupported option for now
-          return respError("ERR syntax");
-        }
-      }
-      g_store.set(v.array[1].bulk, v.array[2].bulk, ttl_ms);
-      if (raw)
-        g_aof.appendRaw(*raw);
-      else
-      {
-        std::vector<std::string> parts;
-        parts.reserve(v.array.size());
-        for (const auto &e : v.array)
-          parts.push_back(e.bulk);
-        g_aof.appendCommand(parts);
-      }
-      // replicate original args
-      {
-        std::vector<std::string> parts;
-        parts.reserve(v.array.size());
-        for (const auto &e : v.array)
-          parts.push_back(e.bulk);
-        g_repl_queue.push_back(std::move(parts));
-      }
-      return respSimpleString("OK");
+    if (!spec)
+      return respError("ERR unknown command");
+    if (!commandArityOk(*spec, args.size()))
+      return respError(std::string("ERR wrong number of arguments for '") + spec->name + "'");
+    if (!spec->handler)
+      return respError("ERR unknown command");
+    std::unique_lock<std::mutex> write_lk(g_write_mu, std::defer_lock);
+    if (spec->flags & kCmdWrite)
+    {
+      write_lk.lock();
+      if (g_loading.load())
+        return respError("LOADING loading the dataset from master");
+    }
+    CommandContext ctx{g_store};
+    std::string reply;
+    try
+    {
+      reply = spec->handler(ctx, args);
     }
-    if (cmd == "GET")
+    catch (const WrongTypeError &e)
     {
-      if (v.array.size() != 2)
-        return respError("ERR wrong number of arguments for 'GET'");
-      if (v.array[1].type != RespType::kBulkString)
-        return respError("ERR syntax");
-      auto val = g_store.get(v.array[1].bulk);
-      if (!val.has_value())
-        return respNullBulk();
-      return respBulk(*val);
+      return respError(e.what());
     }
-    if (cmd == "KEYS")
+    if (ctx.dirty && (spec->flags & kCmdWrite))
     {
-      // 允许 KEYS 或 KEYS <pattern>，未带 pattern 时等价 '*'
+      int64_t seq = g_aof.appendRaw(raw);
+      if (g_aof.mode() == AofMode::kAlways)
+        aof_seq = seq;
+      replicate(raw);
+    }
+    return reply;
+  }
+
+  std::string bgsaveCommand(CommandContext &ctx, const CommandArgs &)
+  {
+    std::string err;
+    // 快照在保存线程里持 g_write_mu 拷贝，事件循环不等待
+    if (!g_rdb.bgSave(ctx.store, g_write_mu, err))
+    {
+      return respError(std::string("ERR ") + err);
+    }
+    return respSimpleString("Background saving started");
+  }
+
+  std::string saveCommand(CommandContext &ctx, const CommandArgs &)
+  {
+    std::string err;
+    // 与 Redis 一致，SAVE 在当前线程完成整个保存，期间阻塞所有写命令
+    std::lock_guard<std::mutex> lk(g_write_mu);
+    if (!g_rdb.save(ctx.store, err))
+    {
+      return respError(std::string("ERR rdb save failed: ") + err);
+    }
+    return respSimpleString("OK");
+  }
+
+  std::string bgrewriteaofCommand(CommandContext &ctx, const CommandArgs &)
+  {
+    std::string err;
+    if (!g_aof.isEnabled())
+      return respError("ERR AOF disabled");
+    // 与 BGSAVE 相同，快照在重写线程里持 g_write_mu 拷贝
+    if (!g_aof.bgRewrite(ctx.store, g_write_mu, err))
+    {
+      return respError(std::string("ERR ") + err);
+    }
+    return respSimpleString("OK");
+  }
+
+  std::string configCommand(CommandContext &, const CommandArgs &args)
+  {
+    std::string sub;
+    for (char c : args[1])
+      sub.push_back(static_cast<char>(::toupper(c)));
+    if (sub == "GET")
+    {
+      // 允许 CONFIG GET 与 CONFIG GET <pattern>（未提供时默认 "*")
       std::string pattern = "*";
-      if (v.array.size() == 2)
-      {
-        if (v.array[1].type == RespType::kBulkString || v.array[1].type == RespType::kSimpleString)
-        {
-          pattern = v.array[1].bulk;
-        }
-        else
-        {
-          return respError("ERR syntax");
-        }
-      }
-      else if (v.array.size() != 1)
+      if (args.size() >= 3)
       {
-        return respError("ERR wrong number of arguments for 'KEYS'");
+        pattern = args[2];
       }
-      // 仅支持 '*' 通配（返回所有 keys）。复杂模式可后续扩展。
-      auto keys = g_store.listKeys();
-      if (pattern != "*")
+      else if (args.size() != 2)
       {
-        // 简易实现：不支持复杂 glob，直接返回空，或可实现简单前缀/后缀匹配
-        // 这里先实现 '*'；其它模式后续扩展
-        keys.clear();
+        return respError("ERR wrong number of arguments for 'CONFIG GET'");
       }
-      std::string out = "*" + std::to_string(keys.size()) + "\r\n";
-      for (const auto &k : keys)
-        out += respBulk(k);
-      return out;
-    }
-    if (cmd == "FLUSHALL")
-    {
-      if (v.array.size() != 1)
-        return respError("ERR wrong number of arguments for 'FLUSHALL'");
-      // 清空所有数据结构
+      auto match = [&](const std::string &k) -> bool {
+        if (pattern == "*") return true;
+        return pattern == k;
+      };
+      std::vector<std::pair<std::string, std::string>> kvs;
+      // minimal set to satisfy tooling
+      kvs.emplace_back("appendonly", g_aof.isEnabled() ? "yes" : "no");
+      std::string appendfsync;
+      switch (g_aof.mode())
       {
-        // 直接使用快照删除，更安全的是在 KV 层提供 clear 接口
-        auto s1 = g_store.snapshot();
-        std::vector<std::string> keys;
-        keys.reserve(s1.size());
-        for (const auto &kvp : s1)
-          keys.push_back(kvp.first);
-        g_store.del(keys);
+      case AofMode::kNo:
+        appendfsync = "no";
+        break;
+      case AofMode::kEverySec:
+        appendfsync = "everysec";
+        break;
+      case AofMode::kAlways:
+        appendfsync = "always";
+        break;
       }
+      kvs.emplace_back("appendfsync", appendfsync);
+      kvs.emplace_back("dir", "./data");
+      kvs.emplace_back("dbfilename", "dump.rdb");
+      kvs.emplace_back("save", "");
+      kvs.emplace_back("timeout", "0");
+      kvs.emplace_back("databases", "16");
+      kvs.emplace_back("maxmemory", "0");
       {
-        auto s2 = g_store.snapshotHash();
-        for (const auto &kvp : s2)
-        {
-          std::vector<std::string> flds;
-          for (const auto &fv : kvp.second.fields)
-            flds.push_back(fv.first);
-          g_store.hdel(kvp.first, flds);
-        }
+        std::lock_guard<std::mutex> lk(g_write_mu);
+        kvs.emplace_back("repl-backlog-size", std::to_string(g_repl_backlog.capacity()));
       }
-      {
-        auto s3 = g_store.snapshotZSet();
-        for (const auto &flat : s3)
-        {
-          std::vector<std::string> mems;
-          mems.reserve(flat.items.size());
-          for (const auto &it : flat.items)
-            mems.push_back(it.second);
-          g_store.zrem(flat.key, mems);
-        }
+      std::string body;
+      size_t elems = 0;
+      if (pattern == "*") {
+        for (auto &p : kvs) { body += respBulk(p.first); body += respBulk(p.second); elems += 2; }
+      } else {
+        for (auto &p : kvs) { if (match(p.first)) { body += respBulk(p.first); body += respBulk(p.second); elems += 2; } }
       }
-      // AOF 记录
-      if (raw)
-        g_aof.appendRaw(*raw);
-      else
-        g_aof.appendCommand({"FLUSHALL"});
-      // 复制广播
-      g_repl_queue.push_back({"FLUSHALL"});
-      return respSimpleString("OK");
+      return "*" + std::to_string(elems) + "\r\n" + body;
     }
-    if (cmd == "DEL")
+    else if (sub == "SET")
     {
-      if (v.array.size() < 2)
-        return respError("ERR wrong number of arguments for 'DEL'");
-      std::vector<std::string> keys;
-      keys.reserve(v.array.size() - 1);
-      for (size_t i = 1; i < v.array.size(); ++i)
+      // 目前只支持运行时调整复制积压缓冲大小
+      if (args.size() != 4)
+        return respError("ERR wrong number of arguments for 'CONFIG SET'");
+      std::string name;
+      for (char c : args[2])
+        name.push_back(static_cast<char>(::tolower(c)));
+      if (name != "repl-backlog-size")
+        return respError("ERR Unsupported CONFIG parameter: " + std::string(args[2]));
+      int64_t bytes = 0;
+      try
       {
-        if (v.array[i].type != RespType::kBulkString)
-          return respError("ERR syntax");
-        keys.emplace_back(v.array[i].bulk);
+        bytes = parseInt64(args[3]);
       }
-      int removed = g_store.del(keys);
-      if (removed > 0)
+      catch (...)
       {
-        std::vector<std::string> parts;
-        parts.reserve(1 + keys.size());
-        parts.emplace_back("DEL");
-        for (auto &k : keys)
-          parts.emplace_back(k);
-        if (raw)
-          g_aof.appendRaw(*raw);
-        else
-          g_aof.appendCommand(parts);
-        g_repl_queue.push_back(parts);
+        return respError("ERR Invalid argument '" + std::string(args[3]) + "' for CONFIG SET 'repl-backlog-size'");
       }
-      return respInteger(removed);
+      if (bytes < static_cast<int64_t>(ReplBacklog::kBlockBytes))
+        return respError("ERR repl-backlog-size must be at least " + std::to_string(ReplBacklog::kBlockBytes));
+      std::lock_guard<std::mutex> lk(g_write_mu);
+      g_repl_backlog.setCapacity(static_cast<size_t>(bytes));
+      return respSimpleString("OK");
     }
-    if (cmd == "EXISTS")
+    else if (sub == "RESETSTAT")
     {
-      if (v.array.size() != 2)
-        return respError("ERR wrong number of arguments for 'EXISTS'");
-      if (v.array[1].type != RespType::kBulkString)
-        return respError("ERR syntax");
-      bool ex = g_store.exists(v.array[1].bulk);
-      return respInteger(ex ? 1 : 0);
+      if (args.size() != 2)
+        return respError("ERR wrong number of arguments for 'CONFIG RESETSTAT'");
+      return respSimpleString("OK");
     }
-    if (cmd == "EXPIRE")
+    else
     {
-      if (v.array.size() != 3)
-        return respError("ERR wrong number of arguments for 'EXPIRE'");
-      if (v.array[1].type != RespType::kBulkString || v.array[2].type != RespType::kBulkString)
-        return respError("ERR syntax");
-      try
-      {
-        int64_t seconds = std::stoll(v.array[2].bulk);
-        bool ok = g_store.expire(v.array[1].bulk, seconds);
-        if (ok)
-        {
-          if (raw)
-            g_aof.appendRaw(*raw);
-          else
-            g_aof.appendCommand({"EXPIRE", v.array[1].bulk, std::to_string(seconds)});
-        }
-        if (ok)
-          g_repl_queue.push_back({"EXPIRE", v.array[1].bulk, std::to_string(seconds)});
-        return respInteger(ok ? 1 : 0);
-      }
-      catch (...)
-      {
-        return respError("ERR value is not an integer or out of range");
-      }
+      return respError("ERR unsupported CONFIG subcommand");
     }
-    if (cmd == "TTL")
+  }
+
+  std::string infoCommand(CommandContext &, const CommandArgs &)
+  {
+    // INFO [section] -> ignore section for now
+    std::string info;
+    info.reserve(512);
+    info += "# Server\r\nredis_version:0.1.0\r\nrun_id:" + g_run_id + "\r\nrole:" + (g_replica ? "slave" : "master") + "\r\n";
+    info += "# Clients\r\nconnected_clients:0\r\n";
+    info += "# Stats\r\ntotal_connections_received:0\r\ntotal_commands_processed:0\r\ninstantaneous_ops_per_sec:0\r\n";
+    ExpireStats es = g_store.expireStats();
+    char stale[32];
+    std::snprintf(stale, sizeof(stale), "%.4f", es.stale_ratio);
+    info += "expired_keys:" + std::to_string(es.expired_keys) + "\r\nexpire_cycle_cpu_us:" + std::to_string(es.cycle_cpu_us) +
+            "\r\nstale_ratio:" + stale + "\r\n";
+    info += "# Persistence\r\naof_enabled:";
+    info += (g_aof.isEnabled() ? "1" : "0");
+    info += "\r\naof_rewrite_in_progress:";
+    info += (g_aof.rewriteInProgress() ? "1" : "0");
+    info += "\r\naof_last_rewrite_time_ms:" + std::to_string(g_aof.lastRewriteTimeMs());
+    info += "\r\naof_incr_segments:" + std::to_string(g_aof.manifest().incrs.size()) + "\r\nrdb_bgsave_in_progress:";
+    info += (g_rdb.bgSaveInProgress() ? "1" : "0");
+    info += "\r\nrdb_last_bgsave_status:";
+    info += (g_rdb.lastBgSaveOk() ? "ok" : "err");
+    info += "\r\nrdb_last_bgsave_time_ms:" + std::to_string(g_rdb.lastBgSaveTimeMs()) + "\r\n";
+    // 最近一次保存的压缩比（原始 / 压缩后）与压缩线程吞吐（原始 MB/s）
+    RdbCompressStats cs = g_rdb.lastCompressStats();
+    char comp[96];
+    std::snprintf(comp, sizeof(comp), "rdb_compression_ratio:%.2f\r\nrdb_compress_mb_per_sec:%.1f\r\n",
+                  cs.stored_bytes ? static_cast<double>(cs.raw_bytes) / static_cast<double>(cs.stored_bytes) : 0.0,
+                  cs.compress_us > 0 ? static_cast<double>(cs.raw_bytes) / static_cast<double>(cs.compress_us) : 0.0);
+    info += "rdb_compression:";
+    info += (g_rdb.compressionEnabled() ? "yes" : "no");
+    info += "\r\n";
+    info += comp;
+    int64_t repl_offset = 0, backlog_first = 0;
+    size_t backlog_size = 0, backlog_histlen = 0;
+    ReplicaStatus rs;
     {
-      if (v.array.size() != 2)
-        return respError("ERR wrong number of arguments for 'TTL'");
-      if (v.array[1].type != RespType::kBulkString)
-        return respError("ERR syntax");
-      int64_t t = g_store.ttl(v.array[1].bulk);
-      return respInteger(t);
+      std::lock_guard<std::mutex> lk(g_write_mu);
+      repl_offset = g_repl_backlog.offset();
+      backlog_first = g_repl_backlog.startOffset();
+      backlog_size = g_repl_backlog.capacity();
+      backlog_histlen = g_repl_backlog.histLen();
+      if (g_replica)
+        rs = g_replica->status();
     }
-    if (cmd == "HSET")
+    // 每个 replica 一行：lag 为距上次 ACK 的秒数（与 Redis 相同），lag_bytes 为尚未确认的复制字节数
+    std::string slaves;
+    size_t nslaves = 0;
     {
-      if (v.array.size() != 4)
-        return respError("ERR wrong number of arguments for 'HSET'");
-      if (v.array[1].type != RespType::kBulkString || v.array[2].type != RespType::kBulkString || v.array[3].type != RespType::kBulkString)
-        return respError("ERR syntax");
-      int created = g_store.hset(v.array[1].bulk, v.array[2].bulk, v.array[3].bulk);
-      if (raw)
-        g_aof.appendRaw(*raw);
-      else
-        g_aof.appendCommand({"HSET", v.array[1].bulk, v.array[2].bulk, v.array[3].bulk});
-      g_repl_queue.push_back({"HSET", v.array[1].bulk, v.array[2].bulk, v.array[3].bulk});
-      return respInteger(created);
-    }
-    if (cmd == "HGET")
-    {
-      if (v.array.size() != 3)
-        return respError("ERR wrong number of arguments for 'HGET'");
-      if (v.array[1].type != RespType::kBulkString || v.array[2].type != RespType::kBulkString)
-        return respError("ERR syntax");
-      auto val = g_store.hget(v.array[1].bulk, v.array[2].bulk);
-      if (!val.has_value())
-        return respNullBulk();
-      return respBulk(*val);
-    }
-    if (cmd == "HDEL")
-    {
-      if (v.array.size() < 3)
-        return respError("ERR wrong number of arguments for 'HDEL'");
-      if (v.array[1].type != RespType::kBulkString)
-        return respError("ERR syntax");
-      std::vector<std::string> fields;
-      for (size_t i = 2; i < v.array.size(); ++i)
+      std::lock_guard<std::mutex> lk(g_replicas_mu);
+      int64_t now = steady_ms();
+      for (const auto &info : g_replicas)
       {
-        if (v.array[i].type != RespType::kBulkString)
-          return respError("ERR syntax");
-        fields.emplace_back(v.array[i].bulk);
+        slaves += "slave" + std::to_string(nslaves++) + ":ip=" + info.ip + ",port=" + std::to_string(info.port) +
+                  ",state=" + (info.online ? "online" : "send_bulk") + ",offset=" + std::to_string(info.ack_offset) +
+                  ",lag=" + std::to_string((now - info.ack_ms) / 1000) +
+                  ",lag_bytes=" + std::to_string(std::max<int64_t>(repl_offset - info.ack_offset, 0)) + "\r\n";
       }
-      int removed = g_store.hdel(v.array[1].bulk, fields);
-      if (removed > 0)
-      {
-        std::vector<std::string> parts;
-        parts.reserve(2 + fields.size());
-        parts.emplace_back("HDEL");
-        parts.emplace_back(v.array[1].bulk);
-        for (auto &f : fields)
-          parts.emplace_back(f);
-        if (raw)
-          g_aof.appendRaw(*raw);
-        else
-          g_aof.appendCommand(parts);
-        g_repl_queue.push_back(parts);
-      }
-      return respInteger(removed);
-    }
-    if (cmd == "HEXISTS")
-    {
-      if (v.array.size() != 3)
-        return respError("ERR wrong number of arguments for 'HEXISTS'");
-      if (v.array[1].type != RespType::kBulkString || v.array[2].type != RespType::kBulkString)
-        return respError("ERR syntax");
-      bool ex = g_store.hexists(v.array[1].bulk, v.array[2].bulk);
-      return respInteger(ex ? 1 : 0);
-    }
-    if (cmd == "HGETALL")
-    {
-      if (v.array.size() != 2)
-        return respError("ERR wrong number of arguments for 'HGETALL'");
-      if (v.array[1].type != RespType::kBulkString)
-        return respError("ERR syntax");
-      auto flat = g_store.hgetallFlat(v.array[1].bulk);
-      RespValue arr;
-      arr.type = RespType::kArray;
-      arr.array.reserve(flat.size());
-      std::string out = "*" + std::to_string(flat.size()) + "\r\n";
-      for (const auto &s : flat)
-      {
-        out += respBulk(s);
-      }
-      return out;
     }
-    if (cmd == "HLEN")
+    info += "# Replication\r\n";
+    if (g_replica)
     {
-      if (v.array.size() != 2)
-        return respError("ERR wrong number of arguments for 'HLEN'");
-      if (v.array[1].type != RespType::kBulkString)
-        return respError("ERR syntax");
-      int n = g_store.hlen(v.array[1].bulk);
-      return respInteger(n);
+      info += "master_host:" + rs.master_host + "\r\nmaster_port:" + std::to_string(rs.master_port) +
+              "\r\nmaster_link_status:" + (rs.link_up ? "up" : "down") + "\r\nmaster_run_id:" + rs.position.run_id +
+              "\r\nslave_repl_offset:" + std::to_string(rs.position.offset) + "\r\nslave_full_syncs:" + std::to_string(rs.full_syncs) +
+              "\r\nslave_partial_syncs:" + std::to_string(rs.partial_syncs) + "\r\nslave_reconnects:" + std::to_string(rs.reconnects) + "\r\n";
     }
-    if (cmd == "ZADD")
+    info += "connected_slaves:" + std::to_string(nslaves) + "\r\n" + slaves;
+    info += "master_repl_offset:" + std::to_string(repl_offset) + "\r\n";
+    // 主库侧同步统计：PSYNC 命中率 = 续传成功 / 全部 PSYNC 请求
+    uint64_t pok = g_sync_partial_ok.load(), perr = g_sync_partial_err.load();
+    char hit[32];
+    std::snprintf(hit, sizeof(hit), "%.2f", pok + perr ? static_cast<double>(pok) / static_cast<double>(pok + perr) : 0.0);
+    info += "sync_full:" + std::to_string(g_sync_full.load()) + "\r\nsync_partial_ok:" + std::to_string(pok) +
+            "\r\nsync_partial_err:" + std::to_string(perr) + "\r\nsync_partial_hit_rate:" + hit + "\r\n";
+    info += "repl_backlog_size:" + std::to_string(backlog_size) + "\r\nrepl_backlog_first_byte_offset:" +
+            std::to_string(backlog_first) + "\r\nrepl_backlog_histlen:" + std::to_string(backlog_histlen) + "\r\n";
+    return respBulk(info);
+  }
+
+  static void close_conn(Reactor &r, std::unordered_map<int, Conn>::iterator it)
+  {
+    int fd = it->first;
+    if (auto job = it->second.sync_job)
     {
-      if (v.array.size() != 4)
-        return respError("ERR wrong number of arguments for 'ZADD'");
-      if (v.array[1].type != RespType::kBulkString || v.array[2].type != RespType::kBulkString || v.array[3].type != RespType::kBulkString)
-        return respError("ERR syntax");
-      try
+      // 先标记取消再注销信箱：序列化线程在 job->mu 内检查取消标记并登记信箱，两者不会交错
       {
-        double sc = std::stod(v.array[2].bulk);
-        int added = g_store.zadd(v.array[1].bulk, sc, v.array[3].bulk);
-        if (raw)
-          g_aof.appendRaw(*raw);
-        else
-          g_aof.appendCommand({"ZADD", v.array[1].bulk, v.array[2].bulk, v.array[3].bulk});
-        g_repl_queue.push_back({"ZADD", v.array[1].bulk, v.array[2].bulk, v.array[3].bulk});
-        return respInteger(added);
-      }
-      catch (...)
-      {
-        return respError("ERR value is not a valid float");
+        std::lock_guard<std::mutex> lk(job->mu);
+        job->cancelled = true;
       }
+      job->cv.notify_all();
     }
-    if (cmd == "ZREM")
+    if (it->second.is_replica)
     {
-      if (v.array.size() < 3)
-        return respError("ERR wrong number of arguments for 'ZREM'");
-      if (v.array[1].type != RespType::kBulkString)
-        return respError("ERR syntax");
-      std::vector<std::string> members;
-      for (size_t i = 2; i < v.array.size(); ++i)
-      {
-        if (v.array[i].type != RespType::kBulkString)
-          return respError("ERR syntax");
-        members.emplace_back(v.array[i].bulk);
-      }
-      int removed = g_store.zrem(v.array[1].bulk, members);
-      if (removed > 0)
+      std::lock_guard<std::mutex> lk(r.mbox_mu);
+      r.repl_mbox.erase(fd);
+    }
+    if (it->second.replica_id)
+      unregister_replica(it->second.replica_id);
+    if (!it->second.aof_hold.empty())
+      r.aof_held.erase(std::remove(r.aof_held.begin(), r.aof_held.end(), fd), r.aof_held.end());
+    if (it->second.blocked)
+    {
+      r.waits.erase(std::remove_if(r.waits.begin(), r.waits.end(), [fd](const WaitReq &w)
+                                   { return w.fd == fd; }),
+                    r.waits.end());
+      r.has_waits = !r.waits.empty();
+    }
+    if (!r.ring)
+      epoll_ctl(r.epoll_fd, EPOLL_CTL_DEL, fd, nullptr);
+    close(fd);
+    r.conns.erase(it);
+  }
+
+  // 将信箱中积累的复制数据挂到对应 replica 连接的发送队列
+  static void drain_repl_mbox(Reactor &r)
+  {
+    std::vector<std::pair<int, std::vector<OutChunk>>> ready;
+    {
+      std::lock_guard<std::mutex> lk(r.mbox_mu);
+      for (auto &kv : r.repl_mbox)
       {
-        std::vector<std::string> parts;
-        parts.reserve(2 + members.size());
-        parts.emplace_back("ZREM");
-        parts.emplace_back(v.array[1].bulk);
-        for (auto &m : members)
-          parts.emplace_back(m);
-        if (raw)
-          g_aof.appendRaw(*raw);
-        else
-          g_aof.appendCommand(parts);
-        g_repl_queue.push_back(parts);
+        if (kv.second.empty())
+          continue;
+        ready.emplace_back(kv.first, std::move(kv.second));
+        kv.second.clear();
       }
-      return respInteger(removed);
     }
-    if (cmd == "ZRANGE")
+    for (auto &item : ready)
     {
-      if (v.array.size() != 4)
-        return respError("ERR wrong number of arguments for 'ZRANGE'");
-      if (v.array[1].type != RespType::kBulkString || v.array[2].type != RespType::kBulkString || v.array[3].type != RespType::kBulkString)
-        return respError("ERR syntax");
-      try
+      auto it = r.conns.find(item.first);
+      if (it == r.conns.end())
+        continue;
+      Conn &rc = it->second;
+      if (rc.sync_job)
       {
-        int64_t start = std::stoll(v.array[2].bulk);
-        int64_t stop = std::stoll(v.array[3].bulk);
-        auto members = g_store.zrange(v.array[1].bulk, start, stop);
-        std::string out = "*" + std::to_string(members.size()) + "\r\n";
-        for (const auto &m : members)
-          out += respBulk(m);
-        return out;
+        // 快照还没发完，先攒着
+        for (auto &chunk : item.second)
+          rc.repl_hold.push_back(std::move(chunk));
+        continue;
       }
-      catch (...)
+      for (auto &chunk : item.second)
+        enqueue_out(rc, std::move(chunk));
+      if (r.ring)
+        r.dirty.push_back(rc.fd);
+      else if (has_pending(rc))
+        mod_epoll(r.epoll_fd, rc.fd, EPOLLIN | EPOLLET | EPOLLOUT | EPOLLRDHUP | EPOLLHUP);
+    }
+  }
+
+  static void wake_reactor(Reactor &r)
+  {
+    uint64_t one = 1;
+    ssize_t _w = ::write(r.wake_fd, &one, sizeof(one));
+    (void)_w;
+  }
+
+  // 唤醒本批次写命令投递过复制数据的 reactor；本线程的信箱直接处理
+  static void wake_repl_reactors(Reactor &self)
+  {
+    for (Reactor *r : t_repl_wake)
+    {
+      if (r == &self)
       {
-        return respError("ERR value is not an integer or out of range");
+        drain_repl_mbox(self);
+        continue;
       }
+      wake_reactor(*r);
     }
-    if (cmd == "ZSCORE")
+    t_repl_wake.clear();
+  }
+
+  // 把序列化线程已产出的块挪到发送队列；上一批还没写完时不取，由 socket 的发送速度反压序列化线程。
+  // 字节流结束后补上结束标记与快照偏移，再放出同步期间攒下的写命令。返回 false 表示快照失败，应关闭连接
+  static bool feed_full_sync(Conn &c)
+  {
+    if (has_pending(c) || c.send_busy)
+      return true;
+    FullSyncJob &job = *c.sync_job;
+    bool done = false, failed = false;
     {
-      if (v.array.size() != 3)
-        return respError("ERR wrong number of arguments for 'ZSCORE'");
-      if (v.array[1].type != RespType::kBulkString || v.array[2].type != RespType::kBulkString)
-        return respError("ERR syntax");
-      auto s = g_store.zscore(v.array[1].bulk, v.array[2].bulk);
-      if (!s.has_value())
-        return respNullBulk();
-      return respBulk(std::to_string(*s));
+      std::lock_guard<std::mutex> lk(job.mu);
+      for (auto &chunk : job.chunks)
+        enqueue_out(c, std::move(chunk));
+      job.chunks.clear();
+      job.queued_bytes = 0;
+      done = job.done;
+      failed = job.failed;
     }
-    if (cmd == "BGSAVE" || cmd == "SAVE")
+    job.cv.notify_all();
+    if (!done)
+      return true;
+    if (failed)
     {
-      if (v.array.size() != 1)
-        return respError("ERR wrong number of arguments for 'BGSAVE'");
-      std::string err;
-      if (!g_rdb.save(g_store, err))
-      {
-        return respError(std::string("ERR rdb save failed: ") + err);
-      }
-      return respSimpleString("OK");
+      c.sync_job.reset();
+      return false;
     }
-    if (cmd == "BGREWRITEAOF")
+    enqueue_out(c, job.mark);
+    enqueue_out(c, "+OFFSET " + std::to_string(job.offset) + "\r\n");
+    for (auto &chunk : c.repl_hold)
+      enqueue_out(c, std::move(chunk));
+    c.repl_hold.clear();
+    c.sync_job.reset();
+    set_replica_online(c.replica_id);
+    return true;
+  }
+
+  // 序列化线程有新数据或已结束时被唤醒调用；io_uring 后端交给 dirty 处理
+  static void pump_full_syncs(Reactor &r)
+  {
+    for (size_t i = 0; i < r.full_syncs.size();)
     {
-      if (v.array.size() != 1)
-        return respError("ERR wrong number of arguments for 'BGREWRITEAOF'");
-      std::string err;
-      if (!g_aof.isEnabled())
-        return respError("ERR AOF disabled");
-      if (!g_aof.bgRewrite(g_store, err))
+      int fd = r.full_syncs[i];
+      auto it = r.conns.find(fd);
+      if (it == r.conns.end() || !it->second.sync_job)
       {
-        return respError(std::string("ERR ") + err);
+        r.full_syncs[i] = r.full_syncs.back();
+        r.full_syncs.pop_back();
+        continue;
       }
-      return respSimpleString("OK");
+      ++i;
+      if (r.ring)
+      {
+        r.dirty.push_back(fd);
+        continue;
+      }
+      Conn &c = it->second;
+      uint32_t ev = 0;
+      if (!feed_full_sync(c))
+      {
+        MR_LOG("WARN", "diskless sync failed fd=" << fd);
+        close_conn(r, it);
+        continue;
+      }
+      try_flush_now(fd, c, ev);
+      if (has_pending(c))
+        mod_epoll(r.epoll_fd, fd, EPOLLIN | EPOLLET | EPOLLOUT | EPOLLRDHUP | EPOLLHUP);
+    }
+  }
+
+  // 无盘全量同步的序列化线程：分离运行，只通过 job 与 reactor 交互。
+  // 连接关闭时 job 被置取消标记，线程在下一次交付数据时退出
+  static void full_sync_thread(std::shared_ptr<FullSyncJob> job, Reactor *r, int fd, RdbOptions opts, size_t limit)
+  {
+    Rdb rdb(opts);
+    std::string err;
+    // 在拷贝快照的同一段 g_write_mu 临界区内登记信箱，之后的写命令一条不漏、也不会与快照重复
+    auto on_snapshot = [&]
+    {
+      std::lock_guard<std::mutex> lk(job->mu);
+      if (job->cancelled)
+        return false;
+      job->offset = g_repl_backlog.offset();
+      std::lock_guard<std::mutex> mlk(r->mbox_mu);
+      r->repl_mbox[fd];
+      return true;
+    };
+    Rdb::Sink sink = [&](const char *p, size_t n)
+    {
+      std::unique_lock<std::mutex> lk(job->mu);
+      job->cv.wait(lk, [&]
+                   { return job->cancelled || job->queued_bytes < limit; });
+      if (job->cancelled)
+        return false;
+      bool was_empty = job->chunks.empty();
+      job->chunks.emplace_back(p, n);
+      job->queued_bytes += n;
+      lk.unlock();
+      if (was_empty)
+        wake_reactor(*r);
+      return true;
+    };
+    bool ok = rdb.streamSnapshot(g_store, g_write_mu, on_snapshot, sink, err);
+    {
+      std::lock_guard<std::mutex> lk(job->mu);
+      if (job->cancelled)
+        return;
+      job->done = true;
+      job->failed = !ok;
     }
-    if (cmd == "CONFIG")
+    if (!ok)
+      MR_LOG("ERROR", "diskless sync stream failed: " << err);
+    wake_reactor(*r);
+  }
+
+  // 无盘全量同步：先回复 $EOF:<mark>，快照由后台线程拷贝并流式编码，reactor 边取边发
+  static void start_diskless_sync(Reactor &r, Conn &c, const ServerConfig &cfg)
+  {
+    auto job = std::make_shared<FullSyncJob>();
+    job->mark = random_hex(40);
+    c.is_replica = true;
+    c.sync_job = job;
+    register_replica(c, false, 0);
+    r.full_syncs.push_back(c.fd);
+    enqueue_out(c, "$EOF:" + job->mark + "\r\n");
+    size_t limit = std::max<size_t>(cfg.repl.diskless_buffer_bytes, 1);
+    std::thread(full_sync_thread, job, &r, c.fd, cfg.rdb, limit).detach();
+  }
+
+  // SYNC/PSYNC：在 g_write_mu 内完成快照与登记，保证 replica 不会漏掉或重复收到写命令
+  static void handle_sync(Reactor &r, Conn &c, const std::vector<std::string_view> &args, const CommandSpec &spec, const ServerConfig &cfg)
+  {
+    std::lock_guard<std::mutex> lk(g_write_mu);
+    if (std::string_view(spec.name) == "PSYNC")
     {
-      if (v.array.size() < 2)
-        return respError("ERR wrong number of arguments for 'CONFIG'");
-      if (v.array[1].type != RespType::kBulkString && v.array[1].type != RespType::kSimpleString)
-        return respError("ERR syntax");
-      std::string sub;
-      for (char c : v.array[1].bulk)
-        sub.push_back(static_cast<char>(::toupper(c)));
-      if (sub == "GET")
+      // PSYNC <run_id> <offset>；旧格式 PSYNC <offset> 不校验 run id
+      int64_t want = -1;
+      if (args.size() == 2 || (args.size() == 3 && args[1] == g_run_id))
       {
-        // 允许 CONFIG GET 与 CONFIG GET <pattern>（未提供时默认 "*")
-        std::string pattern = "*";
-        if (v.array.size() >= 3)
-        {
-          if (v.array[2].type != RespType::kBulkString && v.array[2].type != RespType::kSimpleString)
-            return respError("ERR wrong number of arguments for 'CONFIG GET'");
-          pattern = v.array[2].bulk;
-        }
-        else if (v.array.size() != 2)
+        try
         {
-          return respError("ERR wrong number of arguments for 'CONFIG GET'");
+          want = parseInt64(args.back());
         }
-        auto match = [&](const std::string &k) -> bool {
-          if (pattern == "*") return true;
-          return pattern == k;
-        };
-        std::vector<std::pair<std::string, std::string>> kvs;
-        // minimal set to satisfy tooling
-        kvs.emplace_back("appendonly", g_aof.isEnabled() ? "yes" : "no");
-        std::string appendfsync;
-        switch (g_aof.mode())
+        catch (...)
         {
-        case AofMode::kNo:
-          appendfsync = "no";
-          break;
-        case AofMode::kEverySec:
-          appendfsync = "everysec";
-          break;
-        case AofMode::kAlways:
-          appendfsync = "always";
-          break;
-        }
-        kvs.emplace_back("appendfsync", appendfsync);
-        kvs.emplace_back("dir", "./data");
-        kvs.emplace_back("dbfilename", "dump.rdb");
-        kvs.emplace_back("save", "");
-        kvs.emplace_back("timeout", "0");
-        kvs.emplace_back("databases", "16");
-        kvs.emplace_back("maxmemory", "0");
-        std::string body;
-        size_t elems = 0;
-        if (pattern == "*") {
-          for (auto &p : kvs) { body += respBulk(p.first); body += respBulk(p.second); elems += 2; }
-        } else {
-          for (auto &p : kvs) { if (match(p.first)) { body += respBulk(p.first); body += respBulk(p.second); elems += 2; } }
+          want = -1;
         }
-        return "*" + std::to_string(elems) + "\r\n" + body;
       }
-      else if (sub == "RESETSTAT")
+      // hit backlog? 续传的数据直接引用共享块，每条命令自带 +OFFSET 行
+      std::vector<ReplSpan> spans;
+      if (want >= 0 && g_repl_backlog.rangeFrom(want, spans))
       {
-        if (v.array.size() != 2)
-          return respError("ERR wrong number of arguments for 'CONFIG RESETSTAT'");
-        return respSimpleString("OK");
-      }
-      else
-      {
-        return respError("ERR unsupported CONFIG subcommand");
+        ++g_sync_partial_ok;
+        c.is_replica = true;
+        register_replica(c, true, want);
+        enqueue_out(c, "+OFFSET " + std::to_string(want) + "\r\n");
+        for (const auto &span : spans)
+          enqueue_out(c, span);
+        std::lock_guard<std::mutex> mlk(r.mbox_mu);
+        r.repl_mbox[c.fd];
+        return;
       }
+      // fallback to full resync using SYNC path below
+      ++g_sync_partial_err;
     }
-    if (cmd == "INFO")
-    {
-      // INFO [section] -> ignore section for now
-      std::string info;
-      info.reserve(512);
-      info += "# Server\r\nredis_version:0.1.0\r\nrole:master\r\n";
-      info += "# Clients\r\nconnected_clients:0\r\n";
-      info += "# Stats\r\ntotal_connections_received:0\r\ntotal_commands_processed:0\r\ninstantaneous_ops_per_sec:0\r\n";
-      info += "# Persistence\r\naof_enabled:";
-      info += (g_aof.isEnabled() ? "1" : "0");
-      info += "\r\naof_rewrite_in_progress:0\r\nrdb_bgsave_in_progress:0\r\n";
-      info += "# Replication\r\nconnected_slaves:0\r\nmaster_repl_offset:" + std::to_string(g_repl_offset) + "\r\n";
-      return respBulk(info);
-    }
-    return respError("ERR unknown command");
-  }
+    // 全量同步先告知 run id，replica 保存下来供之后 PSYNC 使用
+    ++g_sync_full;
+    enqueue_out(c, "+FULLRESYNC " + g_run_id + "\r\n");
+    if (cfg.repl.diskless_sync)
+    {
+      start_diskless_sync(r, c, cfg);
+      return;
+    }
+    // produce RDB snapshot bytes
+    std::string err;
+    // Save to temp path and read back。用独立的文件名（临时文件随之为 <filename>.sync.tmp）：
+    // g_rdb 的 BGSAVE 在自己的线程里写 dump.rdb.tmp 并 rename，共用文件名会互相覆盖；多个 SYNC 之间由 g_write_mu 串行
+    RdbOptions tmp = cfg.rdb;
+    if (!tmp.enabled)
+    {
+      tmp.enabled = true;
+    }
+    tmp.filename += ".sync";
+    Rdb rdb(tmp);
+    if (!rdb.save(g_store, err))
+    {
+      enqueue_out(c, respError("ERR sync save failed"));
+      return;
+    }
+    // read file
+    std::string path = rdb.path();
+    FILE *f = ::fopen(path.c_str(), "rb");
+    if (!f)
+    {
+      enqueue_out(c, respError("ERR open rdb"));
+      return;
+    }
+    std::string content;
+    char rb[8192];
+    size_t m;
+    while ((m = fread(rb, 1, sizeof(rb), f)) > 0)
+      content.append(rb, m);
+    fclose(f);
+    ::unlink(path.c_str());
+    enqueue_out(c, respBulk(content));
+    c.is_replica = true;
+    register_replica(c, true, 0);
+    // 发送当前 offset（简单实现：用 RESP 简单字符串）
+    std::string off = "+OFFSET " + std::to_string(g_repl_backlog.offset()) + "\r\n";
+    enqueue_out(c, std::move(off));
+    std::lock_guard<std::mutex> mlk(r.mbox_mu);
+    r.repl_mbox[c.fd];
+  }
 
-  int Server::loop()
+  // REPLCONF listening-port <port> | ACK <offset>。ACK 不回复（与 Redis 一致），否则回复会混进发给 replica 的命令流
+  static void handle_replconf(Conn &c, const std::vector<std::string_view> &args)
   {
-    std::unordered_map<int, Conn> conns;
+    std::string opt;
+    for (char ch : args[1])
+      opt.push_back(static_cast<char>(::tolower(ch)));
+    int64_t v = 0;
+    bool num_ok = true;
+    try
+    {
+      v = args.size() == 3 ? parseInt64(args[2]) : 0;
+    }
+    catch (...)
+    {
+      num_ok = false;
+    }
+    if (opt == "ack" && args.size() == 3)
+    {
+      if (!c.replica_id || !num_ok)
+        return;
+      {
+        std::lock_guard<std::mutex> lk(g_replicas_mu);
+        for (auto &info : g_replicas)
+        {
+          if (info.id != c.replica_id)
+            continue;
+          info.ack_offset = v;
+          info.ack_ms = steady_ms();
+        }
+      }
+      // 有 WAIT 在等的 reactor（包括本线程）在下一轮事件里重新检查
+      for (Reactor *o : g_reactors)
+        if (o->has_waits)
+          wake_reactor(*o);
+      return;
+    }
+    if (opt == "listening-port" && args.size() == 3)
+    {
+      if (!num_ok || v <= 0 || v > 65535)
+      {
+        enqueue_out(c, respError("ERR invalid port"));
+        return;
+      }
+      c.replica_port = static_cast<int>(v);
+      enqueue_out(c, respSimpleString("OK"));
+      return;
+    }
+    enqueue_out(c, respError("ERR Unrecognized REPLCONF option: " + std::string(args[1])));
+  }
+
+  // WAIT 截止时刻最早的一个到期时唤醒 reactor；没有带超时的 WAIT 时停掉定时器
+  static void arm_wait_timer(Reactor &r)
+  {
+    int64_t earliest = 0;
+    for (const auto &w : r.waits)
+      if (w.deadline_ms > 0 && (earliest == 0 || w.deadline_ms < earliest))
+        earliest = w.deadline_ms;
+    itimerspec its{};
+    its.it_value.tv_sec = earliest / 1000;
+    its.it_value.tv_nsec = (earliest % 1000) * 1000000;
+    timerfd_settime(r.wait_timer_fd, TFD_TIMER_ABSTIME, &its, nullptr);
+  }
+
+  // WAIT numreplicas timeout：不阻塞事件循环，只挂起当前连接，直到足够多的 replica 确认或超时（0 表示一直等）。
+  // 目标是执行 WAIT 时的全局复制偏移（含其它客户端更早的写入），回复已确认的 replica 数
+  static void handle_wait(Reactor &r, Conn &c, const std::vector<std::string_view> &args)
+  {
+    int64_t numreplicas = 0, timeout = 0;
+    try
+    {
+      numreplicas = parseInt64(args[1]);
+      timeout = parseInt64(args[2]);
+    }
+    catch (...)
+    {
+      enqueue_out(c, respError("ERR value is not an integer or out of range"));
+      return;
+    }
+    if (timeout < 0)
+    {
+      enqueue_out(c, respError("ERR timeout is negative"));
+      return;
+    }
+    int64_t target = 0;
+    {
+      std::lock_guard<std::mutex> lk(g_write_mu);
+      target = g_repl_backlog.offset();
+    }
+    int64_t acked = count_acked(target);
+    if (acked >= numreplicas)
+    {
+      enqueue_out(c, respInteger(acked));
+      return;
+    }
+    c.blocked = true;
+    r.waits.push_back(WaitReq{c.fd, target, numreplicas, timeout > 0 ? steady_ms() + timeout : 0});
+    r.has_waits = true;
+    arm_wait_timer(r);
+    // 不等下一次定时 ACK，请所有 replica 处理完已收到的命令后立即回 ACK
+    for (Reactor *o : g_reactors)
+    {
+      std::lock_guard<std::mutex> lk(o->mbox_mu);
+      if (o->repl_mbox.empty())
+        continue;
+      for (auto &kv : o->repl_mbox)
+        kv.second.emplace_back(std::string(kGetAckCmd, sizeof(kGetAckCmd) - 1));
+      if (std::find(t_repl_wake.begin(), t_repl_wake.end(), o) == t_repl_wake.end())
+        t_repl_wake.push_back(o);
+    }
+  }
+
+  // 写命令的回复在 AOF 落盘（syncedSeq 追上 seq）之前留在连接的 aof_hold 里，事件循环不等待，接着处理后续命令。
+  // 已落盘或无需等待时直接进入发送队列
+  static void hold_reply(Reactor &r, Conn &c, std::string reply, int64_t seq)
+  {
+    if (c.aof_hold.empty() && seq <= g_aof.syncedSeq())
+    {
+      enqueue_out(c, std::move(reply));
+      return;
+    }
+    if (c.aof_hold.empty())
+    {
+      r.aof_held.push_back(c.fd);
+      // 先置标记再由 release_aof_replies 重新读取 syncedSeq：writer 要么看到标记来唤醒，要么本轮就能放行
+      r.has_aof_hold = true;
+    }
+    else
+    {
+      seq = std::max(seq, c.aof_hold.back().seq);
+    }
+    c.aof_hold.push_back(HeldReply{seq, OutChunk(std::move(reply))});
+  }
+
+  // 放行已落盘的回复：每轮事件处理结束时调用，writer 刷盘后经 wake_fd 唤醒的那一轮也在这里放行。
+  // 一次 fdatasync 覆盖的所有命令，回复在同一轮里发出
+  static void release_aof_replies(Reactor &r)
+  {
+    if (r.aof_held.empty())
+      return;
+    const int64_t synced = g_aof.syncedSeq();
+    for (size_t i = 0; i < r.aof_held.size();)
+    {
+      int fd = r.aof_held[i];
+      auto it = r.conns.find(fd);
+      if (it != r.conns.end())
+      {
+        Conn &c = it->second;
+        bool released = false, closed = false;
+        while (!c.aof_hold.empty() && c.aof_hold.front().seq <= synced)
+        {
+          c.out_chunks.push_back(std::move(c.aof_hold.front().chunk));
+          c.aof_hold.pop_front();
+          released = true;
+        }
+        if (released)
+        {
+          if (r.ring)
+          {
+            r.dirty.push_back(fd);
+          }
+          else
+          {
+            uint32_t ev = 0;
+            try_flush_now(fd, c, ev);
+            if (ev & EPOLLRDHUP)
+              c.closing = true;
+            if (has_pending(c))
+            {
+              mod_epoll(r.epoll_fd, fd, EPOLLIN | EPOLLET | EPOLLOUT | EPOLLRDHUP | EPOLLHUP);
+            }
+            else if (c.closing && c.aof_hold.empty())
+            {
+              close_conn(r, it);
+              closed = true;
+            }
+          }
+        }
+        if (!closed && !c.aof_hold.empty())
+        {
+          ++i;
+          continue;
+        }
+      }
+      r.aof_held[i] = r.aof_held.back();
+      r.aof_held.pop_back();
+    }
+    r.has_aof_hold = !r.aof_held.empty();
+  }
+
+  static void execute_one(Reactor &r, Conn &c, const RespCommand &cmd, const ServerConfig &cfg)
+  {
+    const auto &args = cmd.args;
+    const CommandSpec *spec = args.empty() ? nullptr : lookupCommand(args[0]);
+    // 需要连接上下文的命令：SYNC/PSYNC 把连接变成 replica，REPLCONF 来自 replica，WAIT 会挂起连接
+    if (spec && (spec->flags & kCmdConnection) && commandArityOk(*spec, args.size()))
+    {
+      std::string_view name(spec->name);
+      if (name == "REPLCONF")
+        handle_replconf(c, args);
+      else if (name == "WAIT")
+        handle_wait(r, c, args);
+      else
+        handle_sync(r, c, args, *spec, cfg);
+      return;
+    }
+    int64_t aof_seq = 0;
+    std::string reply = handle_command(spec, args, cmd.raw, aof_seq);
+    hold_reply(r, c, std::move(reply), aof_seq);
+  }
+
+  // 解析连接输入缓冲中的完整命令并执行，回复追加到发送队列，整批执行完后再统一 writev 一次
+  static void process_input(Reactor &r, Conn &c, uint32_t &ev, const ServerConfig &cfg)
+  {
+    while (!c.blocked)
+    {
+      ParseStatus st = c.parser.tryParseCommand(c.cmd);
+      if (st == ParseStatus::kIncomplete)
+        break;
+      if (st == ParseStatus::kError)
+      {
+        // 回复错误后关闭连接
+        enqueue_out(c, respError("ERR protocol error"));
+        ev |= EPOLLRDHUP;
+        break;
+      }
+      execute_one(r, c, c.cmd, cfg);
+    }
+    // try immediate flush so pipe client can receive replies without waiting
+    try_flush_now(c.fd, c, ev);
+  }
+
+  // ---- I/O 线程模式：以下两个函数运行在 helper 线程 ----
+
+  static void offload_read(Conn &c)
+  {
+    char buf[16384];
+    while (true)
+    {
+      ssize_t rn = ::read(c.fd, buf, sizeof(buf));
+      if (rn > 0)
+      {
+        c.parser.append(std::string_view(buf, static_cast<size_t>(rn)));
+      }
+      else if (rn == 0)
+      {
+        c.io_ev |= EPOLLRDHUP;
+        break;
+      }
+      else
+      {
+        if (errno == EAGAIN || errno == EWOULDBLOCK)
+          break;
+        c.io_ev |= EPOLLRDHUP;
+        break;
+      }
+    }
+    c.nparsed = 0;
+    while (true)
+    {
+      if (c.parsed.size() <= c.nparsed)
+        c.parsed.emplace_back();
+      ParseStatus st = c.parser.tryParseCommand(c.parsed[c.nparsed]);
+      if (st == ParseStatus::kIncomplete)
+        break;
+      if (st == ParseStatus::kError)
+      {
+        c.proto_error = true;
+        c.io_ev |= EPOLLRDHUP;
+        break;
+      }
+      ++c.nparsed;
+    }
+  }
+
+  static void offload_write(Conn &c)
+  {
+    try_flush_now(c.fd, c, c.io_ev);
+  }
+
+  // 读/解析 -> 主线程执行 -> 写，三个阶段依次完成本轮所有可读连接
+  static void process_read_batch(Reactor &r, const ServerConfig &cfg)
+  {
+    r.io_pool->run(r.read_batch, offload_read);
+    std::vector<Conn *> writers;
+    writers.reserve(r.read_batch.size());
+    for (Conn *c : r.read_batch)
+    {
+      for (size_t i = 0; i < c->nparsed; ++i)
+      {
+        execute_one(r, *c, c->parsed[i], cfg);
+        if (c->blocked && i + 1 < c->nparsed && !c->proto_error)
+        {
+          // WAIT 挂起了连接：其后已解析的命令退回缓冲，等 WAIT 回复后再执行
+          c->parser.unread(c->parsed[i + 1]);
+          break;
+        }
+      }
+      c->nparsed = 0;
+      if (c->proto_error)
+      {
+        enqueue_out(*c, respError("ERR protocol error"));
+        c->proto_error = false;
+      }
+      if (has_pending(*c))
+        writers.push_back(c);
+    }
+    wake_repl_reactors(r);
+    r.io_pool->run(writers, offload_write);
+    for (Conn *c : r.read_batch)
+    {
+      int fd = c->fd;
+      if (has_pending(*c))
+        mod_epoll(r.epoll_fd, fd, EPOLLIN | EPOLLET | EPOLLOUT | EPOLLRDHUP | EPOLLHUP);
+      else if ((c->io_ev & EPOLLRDHUP) && !c->aof_hold.empty())
+        c->closing = true;
+      else if (c->io_ev & EPOLLRDHUP)
+        close_conn(r, r.conns.find(fd));
+    }
+    r.read_batch.clear();
+  }
+
+  // ---- io_uring 后端 ----
+
+  // user_data：高 8 位为请求类型，低 32 位为 fd
+  enum : uint64_t
+  {
+    kUdAccept = 1,
+    kUdRecv,
+    kUdSend,     // 链中间的 SEND，成功时不产生 CQE
+    kUdSendLast, // 链尾 SEND，链结束（成功、失败或被取消）时必有 CQE
+    kUdTimer,
+    kUdWake,
+    kUdWaitTimer
+  };
+  static const size_t kMaxSendChain = 256;
+
+  static inline uint64_t make_ud(uint64_t kind, int fd)
+  {
+    return (kind << 56) | static_cast<uint32_t>(fd);
+  }
+
+  // 为连接提交一条 SEND 链，或在无在途请求时完成关闭
+  static void uring_flush(Reactor &r, std::unordered_map<int, Conn>::iterator it)
+  {
+    IoUring &ring = *r.ring;
+    Conn &c = it->second;
+    if (c.send_busy)
+      return; // 链尾完成后会再次进入 dirty
+    if (!c.out_chunks.empty())
+    {
+      if (c.out_chunks.size() <= kMaxSendChain)
+      {
+        c.sending.swap(c.out_chunks);
+      }
+      else
+      {
+        auto mid = c.out_chunks.begin() + static_cast<std::ptrdiff_t>(kMaxSendChain);
+        c.sending.assign(std::make_move_iterator(c.out_chunks.begin()), std::make_move_iterator(mid));
+        c.out_chunks.erase(c.out_chunks.begin(), mid);
+      }
+      c.out_iov_idx = 0;
+      c.out_offset = 0;
+      // 整条链必须落在同一次提交里
+      if (ring.sqSpace() < c.sending.size())
+        ring.submit();
+      const size_t n = c.sending.size();
+      for (size_t i = 0; i < n; ++i)
+      {
+        bool last = i + 1 == n;
+        ring.prepSend(c.fd, c.sending[i].data(), c.sending[i].size(),
+                      make_ud(last ? kUdSendLast : kUdSend, c.fd), !last, !last);
+      }
+      c.send_busy = true;
+      return;
+    }
+    if (!c.closing || !c.aof_hold.empty())
+      return; // 还有等落盘的回复：放行后会再次进入 dirty
+    if (c.recv_armed)
+    {
+      // 让 multishot recv 以 0 结束，其 CQE 到达后再关闭
+      ::shutdown(c.fd, SHUT_RDWR);
+      return;
+    }
+    close_conn(r, it);
+  }
+
+  static void uring_execute_input(Reactor &r, Conn &c, const ServerConfig &cfg)
+  {
+    while (!c.closing && !c.blocked)
+    {
+      ParseStatus st = c.parser.tryParseCommand(c.cmd);
+      if (st == ParseStatus::kIncomplete)
+        break;
+      if (st == ParseStatus::kError)
+      {
+        enqueue_out(c, respError("ERR protocol error"));
+        c.closing = true;
+        break;
+      }
+      execute_one(r, c, c.cmd, cfg);
+    }
+  }
+
+  static void uring_on_recv(Reactor &r, const IoUring::Completion &cqe, int fd, const ServerConfig &cfg)
+  {
+    IoUring &ring = *r.ring;
+    auto it = r.conns.find(fd);
+    if (it == r.conns.end())
+    {
+      if (cqe.has_buf)
+        ring.recycleBuf(cqe.bid);
+      return;
+    }
+    Conn &c = it->second;
+    if (cqe.res > 0 && cqe.has_buf)
+    {
+      if (!c.closing)
+        c.parser.append(std::string_view(ring.bufAddr(cqe.bid), static_cast<size_t>(cqe.res)));
+      ring.recycleBuf(cqe.bid);
+      uring_execute_input(r, c, cfg);
+    }
+    else if (cqe.has_buf)
+    {
+      ring.recycleBuf(cqe.bid);
+    }
+    if (!cqe.more)
+    {
+      c.recv_armed = false;
+      // 缓冲暂时耗尽或内核主动结束 multishot 时重新挂上；0 / 出错 / 被取消视为对端关闭
+      if (!c.closing && (cqe.res > 0 || cqe.res == -ENOBUFS))
+        c.recv_armed = ring.prepRecvMultishot(fd, make_ud(kUdRecv, fd));
+      if (!c.recv_armed)
+        c.closing = true;
+    }
+    r.dirty.push_back(fd);
+  }
+
+  static void uring_on_send(Reactor &r, const IoUring::Completion &cqe, int fd, bool last)
+  {
+    auto it = r.conns.find(fd);
+    if (it == r.conns.end())
+      return;
+    Conn &c = it->second;
+    bool failed = cqe.res < 0;
+    if (last && !failed && !c.sending.empty() && static_cast<size_t>(cqe.res) != c.sending.back().size())
+      failed = true;
+    if (failed && !c.closing)
+    {
+      if (cqe.res != -ECANCELED && cqe.res != -EPIPE && cqe.res != -ECONNRESET)
+        MR_LOG("WARN", "send failed fd=" << fd << ": " << std::strerror(cqe.res < 0 ? -cqe.res : EIO));
+      c.closing = true;
+    }
+    if (failed)
+    {
+      c.out_chunks.clear(); // 连接已坏，丢弃剩余回复
+      c.aof_hold.clear();
+    }
+    if (!last)
+      return;
+    c.send_busy = false;
+    c.sending.clear();
+    r.dirty.push_back(fd);
+  }
+
+  // WAIT 有结果（足够多的 replica 已确认，或超时）时回复，并继续执行该连接挂起期间积压的命令
+  static void check_waits(Reactor &r, const ServerConfig &cfg)
+  {
+    if (r.waits.empty())
+      return;
+    int64_t now = steady_ms();
+    std::vector<std::pair<int, int64_t>> done;
+    for (size_t i = 0; i < r.waits.size();)
+    {
+      const WaitReq &w = r.waits[i];
+      int64_t acked = count_acked(w.target);
+      if (acked >= w.numreplicas || (w.deadline_ms > 0 && now >= w.deadline_ms))
+      {
+        done.emplace_back(w.fd, acked);
+        r.waits[i] = r.waits.back();
+        r.waits.pop_back();
+        continue;
+      }
+      ++i;
+    }
+    r.has_waits = !r.waits.empty();
+    arm_wait_timer(r);
+    for (const auto &d : done)
+    {
+      auto it = r.conns.find(d.first);
+      if (it == r.conns.end())
+        continue;
+      Conn &c = it->second;
+      c.blocked = false;
+      enqueue_out(c, respInteger(d.second));
+      if (r.ring)
+      {
+        uring_execute_input(r, c, cfg);
+        r.dirty.push_back(c.fd);
+        continue;
+      }
+      uint32_t ev = 0;
+      process_input(r, c, ev, cfg);
+      if (has_pending(c))
+        mod_epoll(r.epoll_fd, c.fd, EPOLLIN | EPOLLET | EPOLLOUT | EPOLLRDHUP | EPOLLHUP);
+      else if ((ev & EPOLLRDHUP) && !c.aof_hold.empty())
+        c.closing = true;
+      else if (ev & EPOLLRDHUP)
+        close_conn(r, it);
+    }
+    wake_repl_reactors(r);
+  }
+
+  int Server::loop(Reactor &r)
+  {
+    if (r.ring)
+      return loopUring(r);
+    auto &conns = r.conns;
     std::vector<epoll_event> events(128);
     while (true)
     {
-      int n = epoll_wait(epoll_fd_, events.data(), static_cast<int>(events.size()), -1);
+      g_store.activeExpireCycle(ExpireCycle::kFast, config_.active_expire_fast_budget_us);
+      int n = epoll_wait(r.epoll_fd, events.data(), static_cast<int>(events.size()), -1);
       if (n < 0)
       {
         if (errno == EINTR)
@@ -834,13 +1762,13 @@ namespace mini_redis
       {
         int fd = events[i].data.fd;
         uint32_t ev = events[i].events;
-        if (fd == listen_fd_)
+        if (fd == r.listen_fd)
         {
           while (true)
           {
             sockaddr_in cli{};
             socklen_t len = sizeof(cli);
-            int cfd = accept(listen_fd_, reinterpret_cast<sockaddr *>(&cli), &len);
+            int cfd = accept(r.listen_fd, reinterpret_cast<sockaddr *>(&cli), &len);
             if (cfd < 0)
             {
               if (errno == EAGAIN || errno == EWOULDBLOCK)
@@ -851,18 +1779,18 @@ namespace mini_redis
             set_nonblocking(cfd);
             int one = 1;
             setsockopt(cfd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
-            add_epoll(epoll_fd_, cfd, EPOLLIN | EPOLLET | EPOLLRDHUP | EPOLLHUP);
-            conns.emplace(cfd, Conn{cfd, std::string(), std::vector<std::string>{}, 0, 0, RespParser{}, false});
+            add_epoll(r.epoll_fd, cfd, EPOLLIN | EPOLLET | EPOLLRDHUP | EPOLLHUP);
+            conns.try_emplace(cfd).first->second.fd = cfd;
           }
           continue;
         }
 
-        if (fd == timer_fd_)
+        if (fd == r.timer_fd)
         {
           while (true)
           {
             uint64_t ticks;
-            ssize_t _r = ::read(timer_fd_, &ticks, sizeof(ticks));
+            ssize_t _r = ::read(r.timer_fd, &ticks, sizeof(ticks));
             if (_r < 0)
             {
               if (errno == EAGAIN || errno == EWOULDBLOCK)
@@ -873,7 +1801,29 @@ namespace mini_redis
             if (_r == 0)
               break;
           }
-          g_store.expireScanStep(64);
+          g_store.activeExpireCycle(ExpireCycle::kSlow, config_.active_expire_budget_us);
+          continue;
+        }
+
+        if (fd == r.wake_fd)
+        {
+          uint64_t cnt;
+          while (::read(r.wake_fd, &cnt, sizeof(cnt)) > 0)
+          {
+          }
+          drain_repl_mbox(r);
+          pump_full_syncs(r);
+          check_waits(r, config_);
+          continue;
+        }
+
+        if (fd == r.wait_timer_fd)
+        {
+          uint64_t cnt;
+          while (::read(r.wait_timer_fd, &cnt, sizeof(cnt)) > 0)
+          {
+          }
+          check_waits(r, config_);
           continue;
         }
 
@@ -885,9 +1835,15 @@ namespace mini_redis
         // Immediate close only on EPOLLHUP or EPOLLERR; defer EPOLLRDHUP until after flushing replies
         if ((ev & EPOLLHUP) || (ev & EPOLLERR))
         {
-          epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, fd, nullptr);
-          close(fd);
-          conns.erase(it);
+          close_conn(r, it);
+          continue;
+        }
+
+        if ((ev & EPOLLIN) && r.io_pool && !c.blocked)
+        {
+          // 交给 I/O 线程批量读取，EPOLLOUT 也随本批次一起写出
+          c.io_ev = ev;
+          r.read_batch.push_back(&c);
           continue;
         }
 
@@ -896,12 +1852,12 @@ namespace mini_redis
           char buf[4096];
           while (true)
           {
-            ssize_t r = ::read(fd, buf, sizeof(buf));
-            if (r > 0)
+            ssize_t rn = ::read(fd, buf, sizeof(buf));
+            if (rn > 0)
             {
-              c.parser.append(std::string_view(buf, static_cast<size_t>(r)));
+              c.parser.append(std::string_view(buf, static_cast<size_t>(rn)));
             }
-            else if (r == 0)
+            else if (rn == 0)
             {
               ev |= EPOLLRDHUP;
               break;
@@ -915,239 +1871,212 @@ namespace mini_redis
               break;
             }
           }
-          while (true)
-          {
-            auto maybe = c.parser.tryParseOneWithRaw();
-            if (!maybe.has_value())
-              break;
-            const RespValue &v = maybe->first;
-            const std::string &raw = maybe->second;
-            if (v.type == RespType::kError)
-            {
-              enqueue_out(c, respError("ERR protocol error"));
-            }
-            else
-            {
-              // Intercept SYNC: mark as replica and send RDB as RESP bulk
-              if (v.type == RespType::kArray && !v.array.empty() &&
-                  (v.array[0].type == RespType::kBulkString || v.array[0].type == RespType::kSimpleString))
-              {
-                std::string cmd;
-                cmd.reserve(v.array[0].bulk.size());
-                for (char ch : v.array[0].bulk)
-                  cmd.push_back(static_cast<char>(::toupper(ch)));
-                if (cmd == "PSYNC")
-                {
-                  // PSYNC <offset>
-                  if (v.array.size() == 2 && v.array[1].type == RespType::kBulkString)
-                  {
-                    int64_t want = 0;
-                    try
-                    {
-                      want = std::stoll(v.array[1].bulk);
-                    }
-                    catch (...)
-                    {
-                      want = -1;
-                    }
-                    // hit backlog?
-                    if (want >= g_backlog_start_offset && want <= g_repl_offset)
-                    {
-                      size_t start = static_cast<size_t>(want - g_backlog_start_offset);
-                      if (start < g_repl_backlog.size())
-                      {
-                        c.is_replica = true;
-                        std::string off = "+OFFSET " + std::to_string(g_repl_offset) + "\r\n";
-                        enqueue_out(c, off);
-                        enqueue_out(c, g_repl_backlog.substr(start));
-                        continue;
-                      }
-                    }
-                  }
-                  // fallback to full resync using SYNC path below
-                }
-                if (cmd == "SYNC")
-                {
-                  // produce RDB snapshot bytes
-                  std::string err;
-                  // Save to temp path and read back
-                  RdbOptions tmp = config_.rdb;
-                  if (!tmp.enabled)
-                  {
-                    tmp.enabled = true;
-                  }
-                  Rdb r(tmp);
-                  if (!r.save(g_store, err))
-                  {
-                    enqueue_out(c, respError("ERR sync save failed"));
-                  }
-                  else
-                  {
-                    // read file
-                    std::string path = r.path();
-                    FILE *f = ::fopen(path.c_str(), "rb");
-                    if (!f)
-                    {
-                      enqueue_out(c, respError("ERR open rdb"));
-                    }
-                    else
-                    {
-                      std::string content;
-                      content.resize(0);
-                      char rb[8192];
-                      size_t m;
-                      while ((m = fread(rb, 1, sizeof(rb), f)) > 0)
-                        content.append(rb, m);
-                      fclose(f);
-                      enqueue_out(c, respBulk(content));
-                      c.is_replica = true;
-                      // 发送当前 offset（简单实现：用 RESP 简单字符串）
-                      std::string off = "+OFFSET " + std::to_string(g_repl_offset) + "\r\n";
-                      enqueue_out(c, std::move(off));
-                    }
-                  }
-                  continue; // do not pass to normal handler
-                }
-              }
-              enqueue_out(c, handle_command(v, &raw));
-              // try immediate flush so pipe client can receive replies without waiting
-              try_flush_now(fd, c, ev);
-            }
-          }
+          process_input(r, c, ev, config_);
           // Broadcast any replication commands to replicas
-          if (!g_repl_queue.empty())
-          {
-            for (auto &kv : conns)
-            {
-              Conn &rc = kv.second;
-              if (!rc.is_replica)
-                continue;
-              for (const auto &parts : g_repl_queue)
-              {
-                std::string cmd = toRespArray(parts);
-                int64_t next_off = g_repl_offset + static_cast<int64_t>(cmd.size());
-                std::string off = "+OFFSET " + std::to_string(next_off) + "\r\n";
-                appendToBacklog(off);
-                appendToBacklog(cmd);
-                g_repl_offset = next_off;
-                enqueue_out(rc, std::move(off));
-                enqueue_out(rc, std::move(cmd));
-              }
-              if (has_pending(rc))
-              {
-                mod_epoll(epoll_fd_, rc.fd, EPOLLIN | EPOLLET | EPOLLOUT | EPOLLRDHUP | EPOLLHUP);
-              }
-            }
-            g_repl_queue.clear();
-          }
+          wake_repl_reactors(r);
           if (has_pending(c))
           {
-            mod_epoll(epoll_fd_, fd, EPOLLIN | EPOLLET | EPOLLOUT | EPOLLRDHUP | EPOLLHUP);
+            mod_epoll(r.epoll_fd, fd, EPOLLIN | EPOLLET | EPOLLOUT | EPOLLRDHUP | EPOLLHUP);
           }
           // If peer half-closed and nothing pending, close now
           if ((ev & EPOLLRDHUP) && !has_pending(c))
           {
-            epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, fd, nullptr);
-            close(fd);
-            conns.erase(it);
-            continue;
+            if (c.aof_hold.empty())
+            {
+              close_conn(r, it);
+              continue;
+            }
+            c.closing = true; // 等暂扣的回复放行发完再关
           }
         }
 
         if (ev & EPOLLOUT)
         {
-          while (has_pending(c))
+          try_flush_now(fd, c, ev);
+          if (!has_pending(c) && c.sync_job)
           {
-            const size_t max_iov = 64;
-            struct iovec iov[max_iov];
-            int iovcnt = 0;
-            size_t idx = c.out_iov_idx;
-            size_t off = c.out_offset;
-            while (idx < c.out_chunks.size() && iovcnt < (int)max_iov)
+            // 无盘全量同步：上一批已写完，接着取下一批
+            if (!feed_full_sync(c))
             {
-              const std::string &s = c.out_chunks[idx];
-              const char *base = s.data();
-              size_t len = s.size();
-              if (off >= len)
-              {
-                ++idx;
-                off = 0;
-                continue;
-              }
-              iov[iovcnt].iov_base = (void *)(base + off);
-              iov[iovcnt].iov_len = len - off;
-              ++iovcnt;
-              ++idx;
-              off = 0;
+              MR_LOG("WARN", "diskless sync failed fd=" << fd);
+              close_conn(r, it);
+              continue;
             }
-            if (iovcnt == 0)
-              break;
-            ssize_t w = ::writev(fd, iov, iovcnt);
-            if (w > 0)
+            try_flush_now(fd, c, ev);
+          }
+          if (!has_pending(c))
+          {
+            mod_epoll(r.epoll_fd, fd, EPOLLIN | EPOLLRDHUP | EPOLLHUP);
+            if ((ev & EPOLLRDHUP) || c.closing)
             {
-              size_t rem = (size_t)w;
-              while (rem > 0 && c.out_iov_idx < c.out_chunks.size())
-              {
-                std::string &s = c.out_chunks[c.out_iov_idx];
-                size_t avail = s.size() - c.out_offset;
-                if (rem < avail)
-                {
-                  c.out_offset += rem;
-                  rem = 0;
-                }
-                else
-                {
-                  rem -= avail;
-                  c.out_offset = 0;
-                  ++c.out_iov_idx;
-                }
-              }
-              if (c.out_iov_idx >= c.out_chunks.size())
+              if (c.aof_hold.empty())
               {
-                c.out_chunks.clear();
-                c.out_iov_idx = 0;
-                c.out_offset = 0;
+                close_conn(r, it);
+                continue;
               }
-            }
-            else if (w < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
-            {
-              break;
-            }
-            else
-            {
-              std::perror("writev");
-              ev |= EPOLLRDHUP;
-              break;
+              c.closing = true;
             }
           }
-          if (!has_pending(c))
+        }
+      }
+      if (!r.read_batch.empty())
+        process_read_batch(r, config_);
+      release_aof_replies(r);
+    }
+  }
+
+  // 每轮：收割全部 CQE 并执行命令 -> 为有待发数据的连接各提交一条 SEND 链 -> 一次 io_uring_enter 提交并等待
+  int Server::loopUring(Reactor &r)
+  {
+    IoUring &ring = *r.ring;
+    auto &conns = r.conns;
+    ring.prepAcceptMultishot(r.listen_fd, SOCK_NONBLOCK | SOCK_CLOEXEC, make_ud(kUdAccept, r.listen_fd));
+    ring.prepTimeout(200, make_ud(kUdTimer, -1));
+    ring.prepRead(r.wake_fd, &r.wake_buf, sizeof(r.wake_buf), make_ud(kUdWake, r.wake_fd));
+    ring.prepRead(r.wait_timer_fd, &r.wait_timer_buf, sizeof(r.wait_timer_buf), make_ud(kUdWaitTimer, r.wait_timer_fd));
+    IoUring::Completion cqe;
+    while (true)
+    {
+      g_store.activeExpireCycle(ExpireCycle::kFast, config_.active_expire_fast_budget_us);
+      if (ring.submitAndWait(1) < 0 && errno != EBUSY && errno != EAGAIN)
+      {
+        std::perror("io_uring_enter");
+        return -1;
+      }
+      while (ring.nextCompletion(cqe))
+      {
+        const uint64_t kind = cqe.user_data >> 56;
+        const int fd = static_cast<int>(static_cast<uint32_t>(cqe.user_data));
+        switch (kind)
+        {
+        case kUdAccept:
+        {
+          if (cqe.res >= 0)
           {
-            mod_epoll(epoll_fd_, fd, EPOLLIN | EPOLLRDHUP | EPOLLHUP);
-            if (ev & EPOLLRDHUP)
+            int cfd = cqe.res;
+            int one = 1;
+            setsockopt(cfd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+            Conn &c = conns.try_emplace(cfd).first->second;
+            c.fd = cfd;
+            c.recv_armed = ring.prepRecvMultishot(cfd, make_ud(kUdRecv, cfd));
+            if (!c.recv_armed)
             {
-              epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, fd, nullptr);
-              close(fd);
-              conns.erase(it);
-              continue;
+              c.closing = true;
+              r.dirty.push_back(cfd);
             }
           }
+          else if (cqe.res != -ECANCELED)
+          {
+            errno = -cqe.res;
+            std::perror("accept");
+          }
+          if (!cqe.more)
+            ring.prepAcceptMultishot(r.listen_fd, SOCK_NONBLOCK | SOCK_CLOEXEC, make_ud(kUdAccept, r.listen_fd));
+          break;
         }
+        case kUdRecv:
+          uring_on_recv(r, cqe, fd, config_);
+          break;
+        case kUdSend:
+        case kUdSendLast:
+          uring_on_send(r, cqe, fd, kind == kUdSendLast);
+          break;
+        case kUdTimer:
+          g_store.activeExpireCycle(ExpireCycle::kSlow, config_.active_expire_budget_us);
+          ring.prepTimeout(200, make_ud(kUdTimer, -1));
+          break;
+        case kUdWake:
+          drain_repl_mbox(r);
+          pump_full_syncs(r);
+          check_waits(r, config_);
+          ring.prepRead(r.wake_fd, &r.wake_buf, sizeof(r.wake_buf), make_ud(kUdWake, r.wake_fd));
+          break;
+        case kUdWaitTimer:
+          check_waits(r, config_);
+          ring.prepRead(r.wait_timer_fd, &r.wait_timer_buf, sizeof(r.wait_timer_buf), make_ud(kUdWaitTimer, r.wait_timer_fd));
+          break;
+        default:
+          break;
+        }
+      }
+      // Broadcast any replication commands to replicas
+      wake_repl_reactors(r);
+      release_aof_replies(r);
+      for (size_t i = 0; i < r.dirty.size(); ++i)
+      {
+        auto it = conns.find(r.dirty[i]);
+        if (it == conns.end())
+          continue;
+        if (it->second.sync_job && !it->second.closing && !feed_full_sync(it->second))
+        {
+          MR_LOG("WARN", "diskless sync failed fd=" << it->first);
+          it->second.closing = true;
+        }
+        uring_flush(r, it);
       }
+      r.dirty.clear();
     }
   }
 
   int Server::run()
   {
-    if (setupListen() < 0)
-      return -1;
-    if (setupEpoll() < 0)
-      return -1;
-    // init RDB then AOF and load
+    int nthreads = config_.io_threads > 0 ? config_.io_threads : 1;
+    if (config_.io_offload_threads > 0 && nthreads > 1)
+      MR_LOG("WARN", "io_offload_threads ignored when io_threads > 1");
+    bool use_uring = config_.io_backend == IoBackend::kIoUring;
+    if (use_uring && config_.io_offload_threads > 0 && nthreads == 1)
+    {
+      MR_LOG("WARN", "io_backend=io_uring ignored when io_offload_threads > 0, using epoll");
+      use_uring = false;
+    }
+    // 创建 reactor 之前先用一个临时 ring 探测，所有 reactor 使用同一种后端
+    if (use_uring)
+    {
+      std::string err;
+      if (!make_reactor_ring(err))
+      {
+        MR_LOG("WARN", "io_uring unavailable, falling back to epoll: " << err);
+        use_uring = false;
+      }
+    }
+    for (int i = 0; i < nthreads; ++i)
+    {
+      auto r = std::make_unique<Reactor>();
+      r->id = i;
+      if (setupListen(*r) < 0)
+        return -1;
+      if (use_uring)
+      {
+        // 探测已通过，这里失败是资源不足（如 memlock 上限），不在部分 reactor 上悄悄换成 epoll
+        std::string err;
+        if (setupUring(*r, err) < 0)
+        {
+          MR_LOG("ERROR", "io_uring setup failed on reactor " << i << ": " << err);
+          return -1;
+        }
+      }
+      else if (setupEpoll(*r) < 0)
+      {
+        return -1;
+      }
+      if (config_.io_offload_threads > 0 && nthreads == 1)
+        r->io_pool = std::make_unique<IoOffloadPool>(config_.io_offload_threads);
+      reactors_.push_back(std::move(r));
+    }
+    for (auto &r : reactors_)
+      g_reactors.push_back(r.get());
+    g_repl_backlog.setCapacity(config_.repl.backlog_bytes);
+    g_run_id = random_hex(40);
+    // init RDB then AOF and load；两者都开启时与 Redis 一致以 AOF 为准，不再预加载 RDB（AOF 回放在它之上会类型冲突）
     if (config_.rdb.enabled)
     {
       g_rdb.setOptions(config_.rdb);
       std::string err;
-      if (!g_rdb.load(g_store, err))
+      if (config_.aof.enabled)
+      {
+        MR_LOG("INFO", "AOF enabled, skip RDB load");
+      }
+      else if (!g_rdb.load(g_store, err))
       {
         MR_LOG("ERROR", "RDB load failed: " << err);
         return -1;
@@ -1157,23 +2086,66 @@ namespace mini_redis
     if (config_.aof.enabled)
     {
       std::string err;
-      if (!g_aof.init(config_.aof, err))
+      AofOptions aof_opts = config_.aof;
+      aof_opts.use_io_uring = config_.io_backend == IoBackend::kIoUring;
+      if (!g_aof.init(aof_opts, err))
       {
         MR_LOG("ERROR", "AOF init failed: " << err);
+        g_aof.shutdown();
         return -1;
       }
       if (!g_aof.load(g_store, err))
       {
         MR_LOG("ERROR", "AOF load failed: " << err);
+        g_aof.shutdown();
         return -1;
       }
+      // always 模式的组提交：writer 每次刷盘后唤醒有暂扣回复的 reactor。
+      // 回调访问 reactors_，只在它们存活期间安装，run() 返回前停掉 writer 并卸下
+      g_aof.setSyncedCallback([]
+                              {
+                                for (Reactor *r : g_reactors)
+                                  if (r->has_aof_hold.load())
+                                    wake_reactor(*r); });
     }
-    MR_LOG("INFO", "listening on " << config_.bind_address << ":" << config_.port);
+    MR_LOG("INFO", "listening on " << config_.bind_address << ":" << config_.port
+                                   << " io_threads=" << nthreads
+                                   << " io_backend=" << (reactors_[0]->ring ? "io_uring" : "epoll")
+                                   << " io_offload_threads=" << (reactors_[0]->io_pool ? config_.io_offload_threads : 0));
     // start replica client if configured
-    ReplicaClient repl(config_);
+    ReplicaClient repl(config_, g_write_mu, g_aof, g_rdb);
+    if (config_.replica.enabled)
+    {
+      g_replica = &repl;
+      // 数据只来自 RDB 时，快照旁的复制位置与之配套，首次连接即可 PSYNC 续传；
+      // 开启 AOF 时启动数据以 AOF 为准，位置未知，只能全量同步
+      ReplPosition pos;
+      if (config_.rdb.enabled && !config_.aof.enabled && g_rdb.loadReplPosition(pos))
+      {
+        MR_LOG("INFO", "resuming replication from offset " << pos.offset << " of master " << pos.run_id);
+        repl.resumeFrom(pos);
+      }
+      g_rdb.setReplPositionSource([&repl]
+                                  { return repl.position(); });
+    }
     repl.start();
-    int rc = loop();
+    // reactor 0 跑在当前线程，其余各占一个线程
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < reactors_.size(); ++i)
+    {
+      Reactor *r = reactors_[i].get();
+      threads.emplace_back([this, r]
+                           { loop(*r); });
+    }
+    int rc = loop(*reactors_[0]);
+    for (auto &t : threads)
+      t.join();
     repl.stop();
+    g_replica = nullptr;
+    // writer 最后一次刷盘仍会调用回调，须在 reactors_ 释放之前结束
+    g_aof.shutdown();
+    g_aof.setSyncedCallback(nullptr);
+    g_reactors.clear();
     return rc;
   }
 
@@ -0,0 +1,445 @@
+/**
+ * 创建者：程序员老廖
+ * 日期：2025年8月12日
+ */
+
+#include "mini_redis/uring.hpp"
+
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#define MINI_REDIS_HAVE_IO_URING 1
+#endif
+
+#ifdef MINI_REDIS_HAVE_IO_URING
+
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <sys/utsname.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+namespace mini_redis
+{
+
+  static int sysSetup(unsigned entries, io_uring_params *p)
+  {
+    return static_cast<int>(::syscall(__NR_io_uring_setup, entries, p));
+  }
+
+  static int sysEnter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags)
+  {
+    return static_cast<int>(::syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, nullptr, 0));
+  }
+
+  static int sysRegister(int fd, unsigned op, void *arg, unsigned nr)
+  {
+    return static_cast<int>(::syscall(__NR_io_uring_register, fd, op, arg, nr));
+  }
+
+  static inline unsigned loadAcquire(const unsigned *p)
+  {
+    return __atomic_load_n(p, __ATOMIC_ACQUIRE);
+  }
+
+  static inline void storeRelease(unsigned *p, unsigned v)
+  {
+    __atomic_store_n(p, v, __ATOMIC_RELEASE);
+  }
+
+  // 不用 br->bufs：C++ 下 __DECLARE_FLEX_ARRAY 展开出的空结构体占 1 字节，bufs 会整体错位 8 字节
+  static inline io_uring_buf *bufSlot(io_uring_buf_ring *br, unsigned idx)
+  {
+    return reinterpret_cast<io_uring_buf *>(br) + idx;
+  }
+
+  IoUring::~IoUring()
+  {
+    if (br_)
+    {
+      io_uring_buf_reg reg{};
+      reg.bgid = bgid_;
+      sysRegister(ring_fd_, IORING_UNREGISTER_PBUF_RING, &reg, 1);
+      ::munmap(br_, br_map_sz_);
+    }
+    delete[] bufs_;
+    if (sqes_)
+      ::munmap(sqes_, sqes_map_sz_);
+    if (cq_ptr_ && cq_ptr_ != sq_ptr_)
+      ::munmap(cq_ptr_, cq_map_sz_);
+    if (sq_ptr_)
+      ::munmap(sq_ptr_, sq_map_sz_);
+    if (ring_fd_ >= 0)
+      ::close(ring_fd_);
+  }
+
+  bool IoUring::init(unsigned entries, std::string &err)
+  {
+    io_uring_params p{};
+    p.flags = IORING_SETUP_CLAMP;
+    int fd = sysSetup(entries, &p);
+    if (fd < 0)
+    {
+      err = std::string("io_uring_setup: ") + std::strerror(errno);
+      return false;
+    }
+    ring_fd_ = fd;
+    features_ = p.features;
+    sq_map_sz_ = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    cq_map_sz_ = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+    bool single = (p.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (single)
+    {
+      if (cq_map_sz_ > sq_map_sz_)
+        sq_map_sz_ = cq_map_sz_;
+      cq_map_sz_ = sq_map_sz_;
+    }
+    sq_ptr_ = ::mmap(nullptr, sq_map_sz_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    if (sq_ptr_ == MAP_FAILED)
+    {
+      sq_ptr_ = nullptr;
+      err = "mmap sq ring failed";
+      return false;
+    }
+    if (single)
+    {
+      cq_ptr_ = sq_ptr_;
+    }
+    else
+    {
+      cq_ptr_ = ::mmap(nullptr, cq_map_sz_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+      if (cq_ptr_ == MAP_FAILED)
+      {
+        cq_ptr_ = nullptr;
+        err = "mmap cq ring failed";
+        return false;
+      }
+    }
+    sqes_map_sz_ = p.sq_entries * sizeof(io_uring_sqe);
+    void *sqes = ::mmap(nullptr, sqes_map_sz_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    if (sqes == MAP_FAILED)
+    {
+      err = "mmap sqes failed";
+      return false;
+    }
+    sqes_ = static_cast<io_uring_sqe *>(sqes);
+
+    char *sq = static_cast<char *>(sq_ptr_);
+    sq_head_ = reinterpret_cast<unsigned *>(sq + p.sq_off.head);
+    sq_tail_ = reinterpret_cast<unsigned *>(sq + p.sq_off.tail);
+    sq_mask_ = *reinterpret_cast<unsigned *>(sq + p.sq_off.ring_mask);
+    sq_entries_ = *reinterpret_cast<unsigned *>(sq + p.sq_off.ring_entries);
+    sq_array_ = reinterpret_cast<unsigned *>(sq + p.sq_off.array);
+    sq_local_tail_ = *sq_tail_;
+
+    char *cq = static_cast<char *>(cq_ptr_);
+    cq_head_ = reinterpret_cast<unsigned *>(cq + p.cq_off.head);
+    cq_tail_ = reinterpret_cast<unsigned *>(cq + p.cq_off.tail);
+    cq_mask_ = *reinterpret_cast<unsigned *>(cq + p.cq_off.ring_mask);
+    cqes_ = reinterpret_cast<io_uring_cqe *>(cq + p.cq_off.cqes);
+    return true;
+  }
+
+  static uint8_t opcodeOf(IoUring::Op op)
+  {
+    switch (op)
+    {
+    case IoUring::Op::kAccept:
+      return IORING_OP_ACCEPT;
+    case IoUring::Op::kRecv:
+      return IORING_OP_RECV;
+    case IoUring::Op::kSend:
+      return IORING_OP_SEND;
+    case IoUring::Op::kRead:
+      return IORING_OP_READ;
+    case IoUring::Op::kTimeout:
+      return IORING_OP_TIMEOUT;
+    case IoUring::Op::kWritev:
+      return IORING_OP_WRITEV;
+    case IoUring::Op::kFsync:
+      return IORING_OP_FSYNC;
+    }
+    return IORING_OP_LAST;
+  }
+
+  bool IoUring::supports(const Op *ops, size_t n) const
+  {
+    if (ring_fd_ < 0)
+      return false;
+    const size_t kOps = 256;
+    std::vector<char> mem(sizeof(io_uring_probe) + kOps * sizeof(io_uring_probe_op), 0);
+    auto *probe = reinterpret_cast<io_uring_probe *>(mem.data());
+    if (sysRegister(ring_fd_, IORING_REGISTER_PROBE, probe, kOps) < 0)
+      return false;
+    for (size_t i = 0; i < n; ++i)
+    {
+      uint8_t code = opcodeOf(ops[i]);
+      if (code > probe->last_op)
+        return false;
+      if (!(probe->ops[code].flags & IO_URING_OP_SUPPORTED))
+        return false;
+    }
+    return true;
+  }
+
+  bool IoUring::kernelAtLeast(int major, int minor)
+  {
+    utsname u{};
+    if (::uname(&u) != 0)
+      return false;
+    int ma = 0, mi = 0;
+    if (std::sscanf(u.release, "%d.%d", &ma, &mi) != 2)
+      return false;
+    return ma > major || (ma == major && mi >= minor);
+  }
+
+  io_uring_sqe *IoUring::getSqe()
+  {
+    unsigned head = loadAcquire(sq_head_);
+    if (sq_local_tail_ - head >= sq_entries_)
+    {
+      submit();
+      head = loadAcquire(sq_head_);
+      if (sq_local_tail_ - head >= sq_entries_)
+        return nullptr;
+    }
+    unsigned idx = sq_local_tail_ & sq_mask_;
+    io_uring_sqe *sqe = &sqes_[idx];
+    std::memset(sqe, 0, sizeof(*sqe));
+    sq_array_[idx] = idx;
+    ++sq_local_tail_;
+    return sqe;
+  }
+
+  unsigned IoUring::sqSpace() const
+  {
+    return sq_entries_ - (sq_local_tail_ - loadAcquire(sq_head_));
+  }
+
+  int IoUring::submitAndWait(unsigned wait_nr)
+  {
+    unsigned to_submit = sq_local_tail_ - *sq_tail_;
+    storeRelease(sq_tail_, sq_local_tail_);
+    if (to_submit == 0 && wait_nr == 0)
+      return 0;
+    unsigned flags = wait_nr > 0 ? IORING_ENTER_GETEVENTS : 0;
+    int ret;
+    do
+    {
+      ret = sysEnter(ring_fd_, to_submit, wait_nr, flags);
+    } while (ret < 0 && errno == EINTR);
+    return ret;
+  }
+
+  bool IoUring::nextCompletion(Completion &out)
+  {
+    unsigned head = *cq_head_;
+    if (head == loadAcquire(cq_tail_))
+      return false;
+    const io_uring_cqe &cqe = cqes_[head & cq_mask_];
+    out.user_data = cqe.user_data;
+    out.res = cqe.res;
+    out.more = (cqe.flags & IORING_CQE_F_MORE) != 0;
+    out.has_buf = (cqe.flags & IORING_CQE_F_BUFFER) != 0;
+    out.bid = static_cast<uint16_t>(cqe.flags >> IORING_CQE_BUFFER_SHIFT);
+    storeRelease(cq_head_, head + 1);
+    return true;
+  }
+
+  bool IoUring::prepAcceptMultishot(int fd, int flags, uint64_t user_data)
+  {
+    io_uring_sqe *sqe = getSqe();
+    if (!sqe)
+      return false;
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = fd;
+    sqe->accept_flags = static_cast<uint32_t>(flags);
+    sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+    sqe->user_data = user_data;
+    return true;
+  }
+
+  bool IoUring::prepRecvMultishot(int fd, uint64_t user_data)
+  {
+    io_uring_sqe *sqe = getSqe();
+    if (!sqe)
+      return false;
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = fd;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = bgid_;
+    sqe->user_data = user_data;
+    return true;
+  }
+
+  bool IoUring::prepSend(int fd, const void *buf, size_t len, uint64_t user_data, bool link, bool skip_success)
+  {
+    io_uring_sqe *sqe = getSqe();
+    if (!sqe)
+      return false;
+    sqe->opcode = IORING_OP_SEND;
+    sqe->fd = fd;
+    sqe->addr = reinterpret_cast<uint64_t>(buf);
+    sqe->len = static_cast<uint32_t>(len);
+    // 流式 socket 上 MSG_WAITALL 让内核自己重试短写，链中后续 SEND 不会乱序
+    sqe->msg_flags = MSG_WAITALL | MSG_NOSIGNAL;
+    if (link)
+      sqe->flags |= IOSQE_IO_LINK;
+    if (skip_success && (features_ & IORING_FEAT_CQE_SKIP))
+      sqe->flags |= IOSQE_CQE_SKIP_SUCCESS;
+    sqe->user_data = user_data;
+    return true;
+  }
+
+  bool IoUring::prepRead(int fd, void *buf, unsigned len, uint64_t user_data)
+  {
+    io_uring_sqe *sqe = getSqe();
+    if (!sqe)
+      return false;
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd = fd;
+    sqe->addr = reinterpret_cast<uint64_t>(buf);
+    sqe->len = len;
+    sqe->off = static_cast<uint64_t>(-1);
+    sqe->user_data = user_data;
+    return true;
+  }
+
+  bool IoUring::prepTimeout(unsigned ms, uint64_t user_data)
+  {
+    io_uring_sqe *sqe = getSqe();
+    if (!sqe)
+      return false;
+    timeout_ts_[0] = ms / 1000;
+    timeout_ts_[1] = static_cast<int64_t>(ms % 1000) * 1000000;
+    sqe->opcode = IORING_OP_TIMEOUT;
+    sqe->fd = -1;
+    sqe->addr = reinterpret_cast<uint64_t>(timeout_ts_);
+    sqe->len = 1;
+    sqe->user_data = user_data;
+    return true;
+  }
+
+  bool IoUring::prepWritev(int fd, const struct iovec *iov, unsigned n, uint64_t user_data, bool link)
+  {
+    io_uring_sqe *sqe = getSqe();
+    if (!sqe)
+      return false;
+    sqe->opcode = IORING_OP_WRITEV;
+    sqe->fd = fd;
+    sqe->addr = reinterpret_cast<uint64_t>(iov);
+    sqe->len = n;
+    sqe->off = static_cast<uint64_t>(-1); // 当前文件位置（O_APPEND 下即文件尾）
+    if (link)
+      sqe->flags |= IOSQE_IO_LINK;
+    sqe->user_data = user_data;
+    return true;
+  }
+
+  bool IoUring::prepFsync(int fd, bool datasync, uint64_t user_data)
+  {
+    io_uring_sqe *sqe = getSqe();
+    if (!sqe)
+      return false;
+    sqe->opcode = IORING_OP_FSYNC;
+    sqe->fd = fd;
+    if (datasync)
+      sqe->fsync_flags = IORING_FSYNC_DATASYNC;
+    sqe->user_data = user_data;
+    return true;
+  }
+
+  bool IoUring::setupBufRing(uint16_t bgid, unsigned count, unsigned buf_size, std::string &err)
+  {
+    if (count == 0 || (count & (count - 1)) != 0 || count > 32768)
+    {
+      err = "buffer ring size must be a power of two";
+      return false;
+    }
+    br_map_sz_ = count * sizeof(io_uring_buf);
+    void *mem = ::mmap(nullptr, br_map_sz_, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mem == MAP_FAILED)
+    {
+      err = "mmap buffer ring failed";
+      return false;
+    }
+    io_uring_buf_reg reg{};
+    reg.ring_addr = reinterpret_cast<uint64_t>(mem);
+    reg.ring_entries = count;
+    reg.bgid = bgid;
+    if (sysRegister(ring_fd_, IORING_REGISTER_PBUF_RING, &reg, 1) < 0)
+    {
+      err = std::string("register pbuf ring: ") + std::strerror(errno);
+      ::munmap(mem, br_map_sz_);
+      return false;
+    }
+    br_ = static_cast<io_uring_buf_ring *>(mem);
+    bgid_ = bgid;
+    buf_count_ = count;
+    buf_size_ = buf_size;
+    bufs_ = new char[static_cast<size_t>(count) * buf_size];
+    br_tail_ = 0;
+    for (unsigned i = 0; i < count; ++i)
+    {
+      io_uring_buf *b = bufSlot(br_, (br_tail_ + i) & (count - 1));
+      b->addr = reinterpret_cast<uint64_t>(bufAddr(static_cast<uint16_t>(i)));
+      b->len = buf_size;
+      b->bid = static_cast<uint16_t>(i);
+    }
+    br_tail_ = static_cast<uint16_t>(br_tail_ + count);
+    __atomic_store_n(&br_->tail, br_tail_, __ATOMIC_RELEASE);
+    return true;
+  }
+
+  void IoUring::recycleBuf(uint16_t bid)
+  {
+    io_uring_buf *b = bufSlot(br_, br_tail_ & (buf_count_ - 1));
+    b->addr = reinterpret_cast<uint64_t>(bufAddr(bid));
+    b->len = buf_size_;
+    b->bid = bid;
+    br_tail_ = static_cast<uint16_t>(br_tail_ + 1);
+    __atomic_store_n(&br_->tail, br_tail_, __ATOMIC_RELEASE);
+  }
+
+} // namespace mini_redis
+
+#else // !MINI_REDIS_HAVE_IO_URING
+
+namespace mini_redis
+{
+
+  IoUring::~IoUring() = default;
+  bool IoUring::init(unsigned, std::string &err)
+  {
+    err = "io_uring not available on this platform";
+    return false;
+  }
+  bool IoUring::supports(const Op *, size_t) const { return false; }
+  bool IoUring::kernelAtLeast(int, int) { return false; }
+  io_uring_sqe *IoUring::getSqe() { return nullptr; }
+  bool IoUring::prepAcceptMultishot(int, int, uint64_t) { return false; }
+  bool IoUring::prepRecvMultishot(int, uint64_t) { return false; }
+  bool IoUring::prepSend(int, const void *, size_t, uint64_t, bool, bool) { return false; }
+  bool IoUring::prepRead(int, void *, unsigned, uint64_t) { return false; }
+  bool IoUring::prepTimeout(unsigned, uint64_t) { return false; }
+  bool IoUring::prepWritev(int, const struct iovec *, unsigned, uint64_t, bool) { return false; }
+  bool IoUring::prepFsync(int, bool, uint64_t) { return false; }
+  unsigned IoUring::sqSpace() const { return 0; }
+  int IoUring::submitAndWait(unsigned) { return -1; }
+  bool IoUring::nextCompletion(Completion &) { return false; }
+  bool IoUring::setupBufRing(uint16_t, unsigned, unsigned, std::string &err)
+  {
+    err = "io_uring not available on this platform";
+    return false;
+  }
+  void IoUring::recycleBuf(uint16_t) {}
+
+} // namespace mini_redis
+
+#endif
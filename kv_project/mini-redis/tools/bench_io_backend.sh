@@ -0,0 +1,56 @@
+#!/usr/bin/env bash
+# A/B：io_backend=epoll 对比 io_backend=io_uring，pipeline 下压 SET/GET，输出 requests per second；
+# 第二组开启 appendfsync=always，比较 writev+fdatasync 与链式 WRITEV->FSYNC。
+# 装有 perf 时额外统计服务进程每个请求的系统调用数。
+set -euo pipefail
+
+BIN=${BIN:-./build/mini_redis}
+PORT=${PORT:-6392}
+CLIENTS=${CLIENTS:-200}
+PIPE=${PIPE:-32}
+REQS=${REQS:-2000000}
+RB_THREADS=${RB_THREADS:-4}
+
+command -v redis-benchmark >/dev/null 2>&1 || { echo "[io-backend] redis-benchmark not found"; exit 1; }
+has_perf=0
+command -v perf >/dev/null 2>&1 && has_perf=1
+
+tmp=$(mktemp -d)
+trap 'rm -rf "$tmp"' EXIT
+
+printf "%-10s %-8s %15s %15s %15s\n" "backend" "aof" "SET rps" "GET rps" "syscalls/req"
+for aof in off always; do
+  for backend in epoll io_uring; do
+    rm -rf "$tmp/data"
+    cat >"$tmp/backend.conf" <<CONF
+port=${PORT}
+io_backend=${backend}
+aof.enabled=$([ "$aof" = off ] && echo false || echo true)
+aof.mode=always
+aof.dir=${tmp}/data
+rdb.enabled=false
+CONF
+    "$BIN" --config "$tmp/backend.conf" >"$tmp/server.log" 2>&1 &
+    pid=$!
+    sleep 0.5
+    grep -q "io_backend=${backend}" "$tmp/server.log" || echo "[io-backend] ${backend} not active, see server log" >&2
+    if (( has_perf )); then
+      perf stat -e raw_syscalls:sys_enter -p "$pid" -x, -o "$tmp/perf.txt" &
+      perf_pid=$!
+    fi
+    out=$(redis-benchmark -h 127.0.0.1 -p "$PORT" -t set,get -n "$REQS" -c "$CLIENTS" -P "$PIPE" \
+          --threads "$RB_THREADS" -r 1000000 -q 2>/dev/null | tr '\r' '\n')
+    per_req="n/a"
+    if (( has_perf )); then
+      kill -INT "$perf_pid" 2>/dev/null || true
+      wait "$perf_pid" 2>/dev/null || true
+      calls=$(awk -F, '/raw_syscalls/ {print $1}' "$tmp/perf.txt")
+      [ -n "$calls" ] && per_req=$(awk -v c="$calls" -v n="$REQS" 'BEGIN {printf "%.3f", c / (2 * n)}')
+    fi
+    set_rps=$(echo "$out" | awk '/^SET:/ {print $2}' | tail -1)
+    get_rps=$(echo "$out" | awk '/^GET:/ {print $2}' | tail -1)
+    printf "%-10s %-8s %15s %15s %15s\n" "$backend" "$aof" "${set_rps:-n/a}" "${get_rps:-n/a}" "$per_req"
+    kill -9 "$pid" 2>/dev/null || true
+    wait "$pid" 2>/dev/null || true
+  done
+done
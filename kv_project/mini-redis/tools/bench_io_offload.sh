@@ -0,0 +1,37 @@
+#!/usr/bin/env bash
+# A/B：单 reactor 原始路径（io_offload_threads=0）对比 I/O 线程模式（io_offload_threads=N），
+# 高连接数 + pipeline 下压 SET/GET，输出两种模式的 requests per second。
+set -euo pipefail
+
+BIN=${BIN:-./build/mini_redis}
+PORT=${PORT:-6391}
+OFFLOAD=${OFFLOAD:-4}
+CLIENTS=${CLIENTS:-1000}
+PIPE=${PIPE:-8}
+REQS=${REQS:-2000000}
+RB_THREADS=${RB_THREADS:-4}
+
+command -v redis-benchmark >/dev/null 2>&1 || { echo "[io-offload] redis-benchmark not found"; exit 1; }
+
+tmp=$(mktemp -d)
+trap 'rm -rf "$tmp"' EXIT
+
+printf "%-20s %15s %15s\n" "mode" "SET rps" "GET rps"
+for n in 0 "$OFFLOAD"; do
+  cat >"$tmp/offload.conf" <<CONF
+port=${PORT}
+io_offload_threads=${n}
+aof.enabled=false
+rdb.enabled=false
+CONF
+  "$BIN" --config "$tmp/offload.conf" >"$tmp/server.log" 2>&1 &
+  pid=$!
+  sleep 0.5
+  out=$(redis-benchmark -h 127.0.0.1 -p "$PORT" -t set,get -n "$REQS" -c "$CLIENTS" -P "$PIPE" \
+        --threads "$RB_THREADS" -r 1000000 -q 2>/dev/null | tr '\r' '\n')
+  set_rps=$(echo "$out" | awk '/^SET:/ {print $2}' | tail -1)
+  get_rps=$(echo "$out" | awk '/^GET:/ {print $2}' | tail -1)
+  printf "%-20s %15s %15s\n" "io_offload_threads=$n" "${set_rps:-n/a}" "${get_rps:-n/a}"
+  kill -9 "$pid" 2>/dev/null || true
+  wait "$pid" 2>/dev/null || true
+done
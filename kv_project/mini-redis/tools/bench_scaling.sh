@@ -0,0 +1,42 @@
+#!/usr/bin/env bash
+# 吞吐随 io_threads 变化的扩展性测试：依次以 1..MAX_THREADS 个 reactor 启动服务，
+# 用 redis-benchmark 压 SET/GET，输出每档的 requests per second。
+set -euo pipefail
+
+BIN=${BIN:-./build/mini_redis}
+PORT=${PORT:-6390}
+MAX_THREADS=${MAX_THREADS:-$(nproc)}
+CLIENTS=${CLIENTS:-200}
+PIPE=${PIPE:-16}
+REQS=${REQS:-1000000}
+# redis-benchmark 自身也要用多线程，否则客户端先成为瓶颈
+RB_THREADS=${RB_THREADS:-4}
+
+command -v redis-benchmark >/dev/null 2>&1 || { echo "[scaling] redis-benchmark not found"; exit 1; }
+
+tmp=$(mktemp -d)
+trap 'rm -rf "$tmp"' EXIT
+
+printf "%-10s %15s %15s\n" "io_threads" "SET rps" "GET rps"
+t=1
+while (( t <= MAX_THREADS )); do
+  cat >"$tmp/scaling.conf" <<EOF
+port=${PORT}
+io_threads=${t}
+aof.enabled=false
+rdb.enabled=false
+EOF
+  "$BIN" --config "$tmp/scaling.conf" >"$tmp/server.log" 2>&1 &
+  pid=$!
+  sleep 0.5
+  out=$(redis-benchmark -h 127.0.0.1 -p "$PORT" -t set,get -n "$REQS" -c "$CLIENTS" -P "$PIPE" \
+        --threads "$RB_THREADS" -r 1000000 -q 2>/dev/null | tr '\r' '\n')
+  set_rps=$(echo "$out" | awk '/^SET:/ {print $2}' | tail -1)
+  get_rps=$(echo "$out" | awk '/^GET:/ {print $2}' | tail -1)
+  printf "%-10s %15s %15s\n" "$t" "${set_rps:-n/a}" "${get_rps:-n/a}"
+  kill "$pid" 2>/dev/null || true
+  sleep 0.2
+  kill -9 "$pid" 2>/dev/null || true
+  wait "$pid" 2>/dev/null || true
+  t=$(( t * 2 ))
+done
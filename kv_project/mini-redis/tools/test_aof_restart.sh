@@ -0,0 +1,155 @@
+#!/usr/bin/env bash
+# AOF 重启等价性测试：按数据类型写入数据（string / 带 TTL 的 string / hash / zset / DEL / FLUSHALL），
+# 记下全部 key 的内容后 kill -9 重启，从 AOF 回放后内容必须一致。增量段设得很小，写入过程中会多次切段。依次覆盖：
+#   1. 原始命令日志回放（多个增量段）
+#   2. BGREWRITEAOF 之后的 base + 增量段回放，旧文件已删除
+#   3. 最后一段末尾残留半条命令（写入中途宕机）时丢弃残缺部分照常启动
+set -euo pipefail
+
+BIN=${BIN:-./build/mini_redis}
+HOST=127.0.0.1
+PORT=${PORT:-6393}
+
+command -v redis-cli >/dev/null 2>&1 || { echo "[aof-restart] redis-cli not found"; exit 1; }
+
+red() { printf "\e[31m%s\e[0m\n" "$*"; }
+green() { printf "\e[32m%s\e[0m\n" "$*"; }
+fail() { red "[FAIL] $*"; exit 1; }
+ok() { green "[OK] $*"; }
+
+tmp=$(mktemp -d)
+pid=
+cleanup() { [[ -n "$pid" ]] && crash; rm -rf "$tmp"; }
+trap cleanup EXIT
+
+cat >"$tmp/aof.conf" <<CONF
+port=${PORT}
+aof.enabled=true
+aof.mode=always
+aof.dir=${tmp}
+aof.filename=appendonly.aof
+aof.segment_bytes=512
+rdb.enabled=false
+CONF
+
+rc() { redis-cli --raw -h "$HOST" -p "$PORT" "$@"; }
+
+start() {
+  "$BIN" --config "$tmp/aof.conf" >>"$tmp/server.log" 2>&1 &
+  pid=$!
+  for _ in $(seq 50); do
+    rc PING >/dev/null 2>&1 && return 0
+    kill -0 "$pid" 2>/dev/null || fail "server exited, see log:"$'\n'"$(tail -5 "$tmp/server.log")"
+    sleep 0.1
+  done
+  fail "server did not start"
+}
+
+crash() {
+  kill -9 "$pid" 2>/dev/null || true
+  wait "$pid" 2>/dev/null || true
+  pid=
+}
+
+# 按 key 排序输出类型与内容；带 TTL 的 key 只记录“有过期时间”，剩余秒数会随时间变化
+dump() {
+  local k t
+  for k in $(rc KEYS '*' | tr -d '\r' | sort); do
+    t=$(rc TYPE "$k" | tr -d '\r')
+    case "$t" in
+      string) printf "%s string %s" "$k" "$(rc GET "$k" | tr -d '\r')" ;;
+      hash) printf "%s hash %s" "$k" "$(rc HGETALL "$k" | tr -d '\r' | paste -d= - - | sort | tr '\n' ' ')" ;;
+      zset)
+        printf "%s zset" "$k"
+        for m in $(rc ZRANGE "$k" 0 -1 | tr -d '\r'); do printf " %s:%s" "$m" "$(rc ZSCORE "$k" "$m" | tr -d '\r')"; done
+        ;;
+      *) printf "%s %s" "$k" "$t" ;;
+    esac
+    [[ $(rc TTL "$k" | tr -d '\r') -gt 0 ]] && printf " (ttl)"
+    printf "\n"
+  done
+}
+
+check_same() {
+  local got
+  got=$(dump)
+  [[ -n "${VERBOSE:-}" ]] && printf "%s\n" "$got"
+  [[ "$got" == "$expected" ]] || fail "$1: dataset differs after restart"$'\n'"--- expected"$'\n'"$expected"$'\n'"--- got"$'\n'"$got"
+  ok "$1 ($(printf "%s\n" "$expected" | wc -l) keys)"
+}
+
+start
+
+# FLUSHALL：之前写入的数据回放后也必须被清掉
+rc SET gone1 x >/dev/null
+rc HSET gone2 f v >/dev/null
+rc ZADD gone3 1 m >/dev/null
+rc FLUSHALL >/dev/null
+
+# String
+rc SET s:plain hello >/dev/null
+rc SET s:over first >/dev/null
+rc SET s:over second >/dev/null
+rc SET s:ex v1 EX 1000 >/dev/null
+rc SET s:px v2 PX 1000000 >/dev/null
+rc SET s:expire v3 >/dev/null
+rc EXPIRE s:expire 1000 >/dev/null
+rc SET s:del1 x >/dev/null
+rc SET s:del2 x >/dev/null
+rc SET s:keep x >/dev/null
+rc DEL s:del1 s:del2 s:missing >/dev/null
+
+# Hash
+rc HSET h:user name alice >/dev/null
+rc HSET h:user age 30 >/dev/null
+rc HSET h:user tmp 1 >/dev/null
+rc HSET h:user age 31 >/dev/null
+rc HDEL h:user tmp >/dev/null
+rc HSET h:empty f v >/dev/null
+rc HDEL h:empty f >/dev/null
+rc HSET h:ttl f v >/dev/null
+rc EXPIRE h:ttl 1000 >/dev/null
+
+# ZSet
+rc ZADD z:rank 1 a >/dev/null
+rc ZADD z:rank 2.5 b >/dev/null
+rc ZADD z:rank 3 c >/dev/null
+rc ZADD z:rank 0.5 a >/dev/null
+rc ZREM z:rank c >/dev/null
+rc ZADD z:ttl 1 m >/dev/null
+rc EXPIRE z:ttl 1000 >/dev/null
+
+expected=$(dump)
+[[ -n "$expected" ]] || fail "empty dataset before restart"
+
+manifest="$tmp/appendonly.aof.manifest"
+segments() { grep -c '^incr ' "$manifest"; }
+(( $(segments) > 1 )) || fail "expected several incr segments, manifest:"$'\n'"$(cat "$manifest")"
+
+crash
+start
+check_same "replay command log ($(segments) segments)"
+
+rc BGREWRITEAOF >/dev/null
+sleep 1
+crash
+start
+check_same "replay rewritten AOF"
+grep -q '^base ' "$manifest" || fail "no base after rewrite"
+for f in "$tmp"/appendonly.aof.*.incr "$tmp"/appendonly.aof.*.base; do
+  grep -q " $(basename "$f")\$" "$manifest" || fail "stale file left after rewrite: $(basename "$f")"
+done
+
+# 最后一段末尾追加半条命令，模拟写入中途宕机
+crash
+last=$(awk '$1 == "incr" { f = $2 } END { print f }' "$manifest")
+printf '*3\r\n$3\r\nSET\r\n$4\r\ntorn' >>"$tmp/$last"
+start
+check_same "truncated tail discarded"
+rc SET after torn >/dev/null
+expected=$(dump)
+crash
+start
+check_same "append after truncation"
+
+ok "AOF restart equivalence passed"
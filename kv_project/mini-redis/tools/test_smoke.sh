@@ -57,8 +57,9 @@ if have_cli; then
   check_eq OK FLUSHALL
   k2=$(rc KEYS '*'); [[ -z "$k2" ]] || fail "FLUSHALL not empty: $k2"; ok "FLUSHALL emptied keys"
 
-  # BGSAVE
-  check_eq OK BGSAVE
+  # SAVE / BGSAVE
+  check_eq OK SAVE
+  check_eq "Background saving started" BGSAVE
   ok "All tests passed via redis-cli"
 else
   # Fallback minimal nc checks